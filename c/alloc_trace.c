@@ -0,0 +1,144 @@
+/**
+ * @file alloc_trace.c
+ * @brief Encoder and decoder of the allocation trace.
+ *        This file must not call malloc because the recorder uses it inside of malloc.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-22
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "alloc_trace.h"
+
+
+static inline size_t put_varint(uint8_t* buf, uint64_t v) {
+    size_t n = 0;
+    while (0x80 <= v) {
+        buf[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    buf[n++] = (uint8_t)v;
+
+    return n;
+}
+
+
+/* Return the number of the read bytes, 0 if buf is too short or broken. */
+static inline size_t get_varint(uint8_t const* buf, size_t len, uint64_t* v) {
+    uint64_t x = 0;
+    for (size_t i = 0; i < len && i < 10; i++) {
+        x |= (uint64_t)(buf[i] & 0x7f) << (7 * i);
+        if ((buf[i] & 0x80) == 0) {
+            *v = x;
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
+
+
+static inline size_t put_addr(Alloc_trace_state* s, uint8_t* buf, uintptr_t addr) {
+    int64_t const d = (int64_t)(addr - s->last_addr);
+    s->last_addr    = addr;
+
+    return put_varint(buf, ((uint64_t)d << 1) ^ (uint64_t)(d >> 63));
+}
+
+
+static inline size_t get_addr(Alloc_trace_state* s, uint8_t const* buf, size_t len, uintptr_t* addr) {
+    uint64_t z;
+    size_t n = get_varint(buf, len, &z);
+    if (n != 0) {
+        s->last_addr += (uintptr_t)((z >> 1) ^ (~(z & 1) + 1));
+        *addr = s->last_addr;
+    }
+
+    return n;
+}
+
+
+/*
+ * Write e into buf and return the number of the written bytes.
+ * buf must have ALLOC_TRACE_EVENT_MAX_SIZE bytes.
+ */
+size_t alloc_trace_encode(Alloc_trace_state* s, Alloc_trace_event const* e, uint8_t* buf) {
+    size_t n = 0;
+
+    buf[n++] = e->op;
+    switch (e->op) {
+        case ALLOC_TRACE_MALLOC:
+            n += put_varint(buf + n, e->size);
+            n += put_addr(s, buf + n, e->addr);
+            break;
+        case ALLOC_TRACE_FREE:
+            n += put_addr(s, buf + n, e->addr);
+            break;
+        case ALLOC_TRACE_REALLOC:
+            n += put_addr(s, buf + n, e->old_addr);
+            n += put_varint(buf + n, e->size);
+            n += put_addr(s, buf + n, e->addr);
+            break;
+        case ALLOC_TRACE_MEMALIGN:
+            n += put_varint(buf + n, e->align);
+            n += put_varint(buf + n, e->size);
+            n += put_addr(s, buf + n, e->addr);
+            break;
+        default:
+            return 0;
+    }
+
+    return n;
+}
+
+
+/*
+ * Read one event from buf and return the number of the read bytes.
+ * 0 is returned if buf does not have a whole event or it is broken, then s is not changed.
+ */
+size_t alloc_trace_decode(Alloc_trace_state* s, uint8_t const* buf, size_t len, Alloc_trace_event* e) {
+    if (len == 0) {
+        return 0;
+    }
+
+    Alloc_trace_state t = *s;
+    uint64_t v[2]       = {0, 0};
+    size_t n            = 1;
+    size_t r            = 1;
+
+    e->op       = buf[0];
+    e->old_addr = 0;
+    e->align    = 0;
+    switch (e->op) {
+        case ALLOC_TRACE_MALLOC:
+            n += r = get_varint(buf + n, len - n, &v[0]);
+            n += r = (r == 0) ? 0 : get_addr(&t, buf + n, len - n, &e->addr);
+            break;
+        case ALLOC_TRACE_FREE:
+            n += r = get_addr(&t, buf + n, len - n, &e->addr);
+            break;
+        case ALLOC_TRACE_REALLOC:
+            n += r = get_addr(&t, buf + n, len - n, &e->old_addr);
+            n += r = (r == 0) ? 0 : get_varint(buf + n, len - n, &v[0]);
+            n += r = (r == 0) ? 0 : get_addr(&t, buf + n, len - n, &e->addr);
+            break;
+        case ALLOC_TRACE_MEMALIGN:
+            n += r = get_varint(buf + n, len - n, &v[1]);
+            n += r = (r == 0) ? 0 : get_varint(buf + n, len - n, &v[0]);
+            n += r = (r == 0) ? 0 : get_addr(&t, buf + n, len - n, &e->addr);
+            break;
+        default:
+            return 0;
+    }
+
+    if (r == 0) {
+        return 0;
+    }
+
+    e->size  = (size_t)v[0];
+    e->align = (size_t)v[1];
+    *s       = t;
+
+    return n;
+}
@@ -0,0 +1,65 @@
+/**
+ * @file alloc_trace.h
+ * @brief Binary trace of malloc/free/realloc events.
+ *
+ *        A trace file is ALLOC_TRACE_MAGIC and the encoded events.
+ *        An event is one op byte and LEB128 varints.
+ *          MALLOC   : size, addr
+ *          FREE     : addr
+ *          REALLOC  : old_addr, size, addr
+ *          MEMALIGN : align, size, addr
+ *        Every address is the zigzag encoded difference from the previous address in the trace,
+ *        so addresses close to each other take a few bytes.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-22
+ */
+
+#ifndef _ALLOC_TRACE_H_
+#define _ALLOC_TRACE_H_
+
+
+#include <stddef.h>
+#include <stdint.h>
+
+
+#define ALLOC_TRACE_MAGIC "ATR1"
+
+
+enum {
+    ALLOC_TRACE_MAGIC_SIZE     = 4,
+    ALLOC_TRACE_EVENT_MAX_SIZE = 1 + 10 * 3, /* The op and three varints. */
+};
+
+
+enum alloc_trace_op {
+    ALLOC_TRACE_MALLOC = 1,
+    ALLOC_TRACE_FREE,
+    ALLOC_TRACE_REALLOC,
+    ALLOC_TRACE_MEMALIGN,
+};
+
+
+struct alloc_trace_event {
+    uint8_t op;
+    uintptr_t addr;     /* The result of the allocation or the freed address. NULL if the allocation failed. */
+    uintptr_t old_addr; /* Only REALLOC. */
+    size_t size;
+    size_t align;       /* Only MEMALIGN. */
+};
+typedef struct alloc_trace_event Alloc_trace_event;
+
+
+/* The encoder and the decoder keep the previous address. */
+struct alloc_trace_state {
+    uintptr_t last_addr;
+};
+typedef struct alloc_trace_state Alloc_trace_state;
+
+
+extern size_t alloc_trace_encode(Alloc_trace_state*, Alloc_trace_event const*, uint8_t*);
+extern size_t alloc_trace_decode(Alloc_trace_state*, uint8_t const*, size_t, Alloc_trace_event*);
+
+
+
+#endif
@@ -0,0 +1,222 @@
+/**
+ * @file alloc_trace_record.c
+ * @brief LD_PRELOAD recorder of the allocation trace.
+ *        gcc -O2 -shared -fPIC alloc_trace_record.c alloc_trace.c -o alloc_trace_record.so -lpthread
+ *        ALLOC_TRACE_FILE=app.trace LD_PRELOAD=./alloc_trace_record.so ./app
+ *
+ *        The events of all threads are serialized by one lock, so the order in the trace is a valid order.
+ *        The allocations are forwarded to the glibc entries (__libc_malloc etc.),
+ *        this avoids dlsym() which calls calloc() by itself.
+ *        A forked child stops recording because it shares the file with the parent.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-22
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "alloc_trace.h"
+
+
+enum {
+    BUFFER_SIZE     = 1 << 20,
+    FLUSH_THRESHOLD = BUFFER_SIZE - ALLOC_TRACE_EVENT_MAX_SIZE,
+};
+
+
+extern void* __libc_malloc(size_t);
+extern void __libc_free(void*);
+extern void* __libc_calloc(size_t, size_t);
+extern void* __libc_realloc(void*, size_t);
+extern void* __libc_memalign(size_t, size_t);
+
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t buffer[BUFFER_SIZE];
+static size_t buffer_size;
+static Alloc_trace_state state;
+static int fd          = -1;
+static bool is_stopped = false;
+static __thread bool is_in_hook;
+
+
+static void write_all(uint8_t const* p, size_t n) {
+    while (n != 0) {
+        ssize_t r = write(fd, p, n);
+        if (r < 0 && errno == EINTR) {
+            continue;
+        }
+        if (r <= 0) {
+            is_stopped = true;
+            return;
+        }
+        p += r;
+        n -= (size_t)r;
+    }
+}
+
+
+static void flush(void) {
+    if (fd != -1 && buffer_size != 0) {
+        write_all(buffer, buffer_size);
+    }
+    buffer_size = 0;
+}
+
+
+static void stop_in_child(void) {
+    is_stopped  = true;
+    buffer_size = 0;
+    fd          = -1;
+}
+
+
+static bool open_trace(void) {
+    char const* path = getenv("ALLOC_TRACE_FILE");
+    fd = open((path == NULL) ? "alloc.trace" : path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        return false;
+    }
+
+    memcpy(buffer, ALLOC_TRACE_MAGIC, ALLOC_TRACE_MAGIC_SIZE);
+    buffer_size = ALLOC_TRACE_MAGIC_SIZE;
+    pthread_atfork(NULL, NULL, stop_in_child);
+
+    return true;
+}
+
+
+/*
+ * Take the lock for recording.
+ * It returns false without the lock if the event must not be recorded.
+ */
+static bool lock_trace(void) {
+    if (is_in_hook == true || is_stopped == true) {
+        return false;
+    }
+    is_in_hook = true;
+
+    pthread_mutex_lock(&lock);
+    if (fd != -1 || (is_stopped == false && open_trace() == true)) {
+        return true;
+    }
+    is_stopped = true;
+    pthread_mutex_unlock(&lock);
+
+    is_in_hook = false;
+    return false;
+}
+
+
+static void unlock_trace(void) {
+    pthread_mutex_unlock(&lock);
+    is_in_hook = false;
+}
+
+
+/* The lock must be held. */
+static void encode(Alloc_trace_event const* e) {
+    buffer_size += alloc_trace_encode(&state, e, buffer + buffer_size);
+    if (FLUSH_THRESHOLD <= buffer_size) {
+        flush();
+    }
+}
+
+
+static void record(Alloc_trace_event const* e) {
+    if (lock_trace() == true) {
+        encode(e);
+        unlock_trace();
+    }
+}
+
+
+__attribute__((destructor)) static void finish(void) {
+    pthread_mutex_lock(&lock);
+    flush();
+    if (fd != -1) {
+        close(fd);
+        fd = -1;
+    }
+    is_stopped = true;
+    pthread_mutex_unlock(&lock);
+}
+
+
+void* malloc(size_t size) {
+    void* p = __libc_malloc(size);
+    record(&(Alloc_trace_event){.op = ALLOC_TRACE_MALLOC, .addr = (uintptr_t)p, .size = size});
+    return p;
+}
+
+
+void free(void* p) {
+    if (p != NULL) {
+        record(&(Alloc_trace_event){.op = ALLOC_TRACE_FREE, .addr = (uintptr_t)p});
+    }
+    __libc_free(p);
+}
+
+
+void* calloc(size_t n, size_t size) {
+    void* p = __libc_calloc(n, size);
+    size_t s;
+    if (__builtin_mul_overflow(n, size, &s) == false) {
+        record(&(Alloc_trace_event){.op = ALLOC_TRACE_MALLOC, .addr = (uintptr_t)p, .size = s});
+    }
+    return p;
+}
+
+
+/*
+ * The lock is held across __libc_realloc().
+ * Otherwise other thread can get old from malloc() and record it before this REALLOC frees old in the trace.
+ */
+void* realloc(void* old, size_t size) {
+    bool const is_recorded = lock_trace();
+    void* p = __libc_realloc(old, size);
+    if (is_recorded == true) {
+        encode(&(Alloc_trace_event){.op = ALLOC_TRACE_REALLOC, .addr = (uintptr_t)p, .old_addr = (uintptr_t)old, .size = size});
+        unlock_trace();
+    }
+    return p;
+}
+
+
+void* memalign(size_t align, size_t size) {
+    void* p = __libc_memalign(align, size);
+    record(&(Alloc_trace_event){.op = ALLOC_TRACE_MEMALIGN, .addr = (uintptr_t)p, .size = size, .align = align});
+    return p;
+}
+
+
+void* aligned_alloc(size_t align, size_t size) {
+    return memalign(align, size);
+}
+
+
+int posix_memalign(void** r, size_t align, size_t size) {
+    if (align < sizeof(void*) || (align & (align - 1)) != 0) {
+        return EINVAL;
+    }
+
+    void* p = memalign(align, size);
+    if (p == NULL) {
+        return ENOMEM;
+    }
+    *r = p;
+
+    return 0;
+}
+
+
+void* valloc(size_t size) {
+    return memalign((size_t)sysconf(_SC_PAGESIZE), size);
+}
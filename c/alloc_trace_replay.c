@@ -0,0 +1,659 @@
+/**
+ * @file alloc_trace_replay.c
+ * @brief Replay an allocation trace against the allocators in this directory and glibc.
+ *        gcc -O2 -DTLSF_LIBRARY -DBUDDY_SYSTEM_LIBRARY -DFIT_ALLOCATORS_LIBRARY alloc_trace_replay.c alloc_trace.c tlsf.c buddy_system.c fit_allocators.c -lpthread
+ *        ./a.out app.trace [allocator name]
+ *
+ *        The addresses in the trace are converted into object ids before the replay.
+ *        Each allocator runs in a forked child, so its peak RSS is measured alone.
+ *        Like the real process, the replay writes one byte to each page of every allocated object.
+ *        fragmentation is 1 - (peak live bytes) / (peak RSS increase).
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-22
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include "alloc_trace.h"
+#include "buddy_system.h"
+#include "fit_allocators.h"
+#include "tlsf.h"
+
+
+enum {
+    PAGE_SIZE_LOG2      = 12,
+    REPLAY_PAGE_SIZE    = 1 << PAGE_SIZE_LOG2,
+    TLSF_MAX_ALIGN      = 4096,
+    BUDDY_MAX_ORDER     = 20,
+    FIT_UNIT_SIZE       = 16,
+    MIN_HEAP_SIZE       = 256 * 1024 * 1024,
+    ADDR_MAP_INIT_SIZE  = 1024,
+};
+
+
+/* The replayed event, objects are identified by the index of the slots. */
+struct replay_op {
+    uint8_t op;
+    uint32_t id;
+    size_t size;
+    size_t align;
+};
+typedef struct replay_op Replay_op;
+
+
+struct replay_trace {
+    Replay_op* ops;
+    size_t op_nr;
+    size_t id_nr;
+    size_t peak_live_size;
+};
+typedef struct replay_trace Replay_trace;
+
+
+struct replay_allocator {
+    char const* name;
+    bool (*init)(size_t);
+    void (*destruct)(void);
+    void* (*malloc)(size_t, size_t);
+    void* (*realloc)(void*, size_t, size_t);
+    void (*free)(void*);
+};
+typedef struct replay_allocator Replay_allocator;
+
+
+struct replay_result {
+    double sec;
+    size_t peak_rss;
+    size_t failed_nr;
+};
+typedef struct replay_result Replay_result;
+
+
+/*
+ * ==================== Allocators. ====================
+ */
+
+
+static bool glibc_init(size_t heap_size) {
+    (void)heap_size;
+    return true;
+}
+
+
+static void glibc_destruct(void) {
+}
+
+
+static void* glibc_malloc(size_t size, size_t align) {
+    if (align == 0) {
+        return malloc(size);
+    }
+
+    void* p;
+    return (posix_memalign(&p, (align < sizeof(void*)) ? sizeof(void*) : align, size) == 0) ? p : NULL;
+}
+
+
+static void* glibc_realloc(void* p, size_t old_size, size_t size) {
+    (void)old_size;
+    return realloc(p, size);
+}
+
+
+static void glibc_free(void* p) {
+    free(p);
+}
+
+
+static Tlsf_manager tman;
+
+
+static bool tlsf_replay_init(size_t heap_size) {
+    tlsf_init_mmap(&tman, TLSF_REGION_MMAP);
+    return tlsf_supply_memory(&tman, heap_size) != NULL;
+}
+
+
+static void tlsf_replay_destruct(void) {
+    tlsf_destruct(&tman);
+}
+
+
+static void* tlsf_replay_malloc(size_t size, size_t align) {
+    return (TLSF_MAX_ALIGN < align) ? NULL : tlsf_malloc_align(&tman, size, align);
+}
+
+
+static void* tlsf_replay_realloc(void* p, size_t old_size, size_t size) {
+    (void)old_size;
+    return tlsf_realloc(&tman, p, size);
+}
+
+
+static void tlsf_replay_free(void* p) {
+    tlsf_free(&tman, p);
+}
+
+
+static Buddy_manager bman;
+
+
+static bool buddy_replay_init(size_t heap_size) {
+    return buddy_init_mmap(&bman, heap_size, REPLAY_PAGE_SIZE, BUDDY_MAX_ORDER) != NULL;
+}
+
+
+static void buddy_replay_destruct(void) {
+    buddy_destruct(&bman);
+}
+
+
+/* Every block is aligned to its size. */
+static void* buddy_replay_malloc(size_t size, size_t align) {
+    return buddy_alloc_memory(&bman, buddy_size_to_order(&bman, (size < align) ? align : size));
+}
+
+
+static void buddy_replay_free(void* p) {
+    buddy_free_memory(&bman, p);
+}
+
+
+static void* buddy_replay_realloc(void* p, size_t old_size, size_t size) {
+    void* n = buddy_replay_malloc(size, 0);
+    if (n != NULL) {
+        memcpy(n, p, (old_size < size) ? old_size : size);
+        buddy_replay_free(p);
+    }
+
+    return n;
+}
+
+
+static Fit_allocator* fman;
+
+
+static bool fit_replay_init(Fit_policy policy, size_t heap_size) {
+    fman = fit_allocator_create(policy, heap_size, FIT_UNIT_SIZE);
+    return fman != NULL;
+}
+
+
+static bool first_fit_replay_init(size_t heap_size) {
+    return fit_replay_init(FIT_FIRST, heap_size);
+}
+
+
+static bool next_fit_replay_init(size_t heap_size) {
+    return fit_replay_init(FIT_NEXT, heap_size);
+}
+
+
+static bool best_fit_replay_init(size_t heap_size) {
+    return fit_replay_init(FIT_BEST, heap_size);
+}
+
+
+static bool worst_fit_replay_init(size_t heap_size) {
+    return fit_replay_init(FIT_WORST, heap_size);
+}
+
+
+static void fit_replay_destruct(void) {
+    fit_allocator_destroy(fman);
+}
+
+
+/* Objects are aligned to the unit size only. */
+static void* fit_replay_malloc(size_t size, size_t align) {
+    return (FIT_UNIT_SIZE < align) ? NULL : fit_alloc(fman, (size == 0) ? 1 : size);
+}
+
+
+static void fit_replay_free(void* p) {
+    fit_free(fman, p);
+}
+
+
+static void* fit_replay_realloc(void* p, size_t old_size, size_t size) {
+    void* n = fit_replay_malloc(size, 0);
+    if (n != NULL) {
+        memcpy(n, p, (old_size < size) ? old_size : size);
+        fit_replay_free(p);
+    }
+
+    return n;
+}
+
+
+static Replay_allocator const allocators[] = {
+    {"glibc", glibc_init, glibc_destruct, glibc_malloc, glibc_realloc, glibc_free},
+    {"tlsf", tlsf_replay_init, tlsf_replay_destruct, tlsf_replay_malloc, tlsf_replay_realloc, tlsf_replay_free},
+    {"buddy", buddy_replay_init, buddy_replay_destruct, buddy_replay_malloc, buddy_replay_realloc, buddy_replay_free},
+    {"first-fit", first_fit_replay_init, fit_replay_destruct, fit_replay_malloc, fit_replay_realloc, fit_replay_free},
+    {"next-fit", next_fit_replay_init, fit_replay_destruct, fit_replay_malloc, fit_replay_realloc, fit_replay_free},
+    {"best-fit", best_fit_replay_init, fit_replay_destruct, fit_replay_malloc, fit_replay_realloc, fit_replay_free},
+    {"worst-fit", worst_fit_replay_init, fit_replay_destruct, fit_replay_malloc, fit_replay_realloc, fit_replay_free},
+};
+
+
+/*
+ * ==================== Trace loading. ====================
+ * Live addresses are mapped to ids by an open addressing hash table.
+ */
+
+
+struct addr_map {
+    uintptr_t* keys; /* 0 means the empty slot. */
+    uint32_t* ids;
+    size_t size;
+    size_t nr;
+};
+typedef struct addr_map Addr_map;
+
+
+static inline size_t addr_map_hash(Addr_map const* m, uintptr_t addr) {
+    return (size_t)((uint64_t)addr * UINT64_C(0x9E3779B97F4A7C15) >> 32) & (m->size - 1);
+}
+
+
+static size_t addr_map_find_slot(Addr_map const* m, uintptr_t addr) {
+    size_t i = addr_map_hash(m, addr);
+    while (m->keys[i] != addr && m->keys[i] != 0) {
+        i = (i + 1) & (m->size - 1);
+    }
+
+    return i;
+}
+
+
+/* It returns false if the table cannot be extended, the map is kept. */
+static bool addr_map_insert(Addr_map* m, uintptr_t addr, uint32_t id) {
+    if (m->size <= (m->nr + 1) * 2) {
+        Addr_map old = *m;
+        m->size      = (old.size == 0) ? ADDR_MAP_INIT_SIZE : old.size * 2;
+        m->keys      = calloc(m->size, sizeof(uintptr_t));
+        m->ids       = malloc(m->size * sizeof(uint32_t));
+        if (m->keys == NULL || m->ids == NULL) {
+            free(m->keys);
+            free(m->ids);
+            *m = old;
+            return false;
+        }
+        for (size_t i = 0; i < old.size; i++) {
+            if (old.keys[i] != 0) {
+                size_t j   = addr_map_find_slot(m, old.keys[i]);
+                m->keys[j] = old.keys[i];
+                m->ids[j]  = old.ids[i];
+            }
+        }
+        free(old.keys);
+        free(old.ids);
+    }
+
+    size_t i = addr_map_find_slot(m, addr);
+    m->nr += (m->keys[i] == 0);
+    m->keys[i] = addr;
+    m->ids[i]  = id;
+
+    return true;
+}
+
+
+/* Remove addr and return its id, UINT32_MAX if it is not found. */
+static uint32_t addr_map_remove(Addr_map* m, uintptr_t addr) {
+    if (m->nr == 0) {
+        return UINT32_MAX;
+    }
+
+    size_t i = addr_map_find_slot(m, addr);
+    if (m->keys[i] == 0) {
+        return UINT32_MAX;
+    }
+    uint32_t const id = m->ids[i];
+
+    /* Backward shift deletion. */
+    size_t const mask = m->size - 1;
+    for (size_t j = (i + 1) & mask; m->keys[j] != 0; j = (j + 1) & mask) {
+        size_t h = addr_map_hash(m, m->keys[j]);
+        if (((j - h) & mask) >= ((j - i) & mask)) {
+            m->keys[i] = m->keys[j];
+            m->ids[i]  = m->ids[j];
+            i          = j;
+        }
+    }
+    m->keys[i] = 0;
+    --m->nr;
+
+    return id;
+}
+
+
+static uint8_t* read_file(char const* path, size_t* size) {
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return NULL;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long const s = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    uint8_t* buf = (s <= 0) ? NULL : malloc((size_t)s);
+    if (buf != NULL && fread(buf, 1, (size_t)s, fp) != (size_t)s) {
+        free(buf);
+        buf = NULL;
+    }
+    fclose(fp);
+
+    *size = (size_t)s;
+    return buf;
+}
+
+
+static bool push_op(Replay_trace* t, size_t* capacity, Replay_op op) {
+    if (t->op_nr == *capacity) {
+        size_t const c = (*capacity == 0) ? 4096 : *capacity * 2;
+        Replay_op* ops = realloc(t->ops, c * sizeof(Replay_op));
+        if (ops == NULL) {
+            return false;
+        }
+        t->ops    = ops;
+        *capacity = c;
+    }
+    t->ops[t->op_nr++] = op;
+
+    return true;
+}
+
+
+/*
+ * Events which touch unknown addresses (allocated before the recording) and failed allocations are dropped.
+ * A realloc keeps the id of the object.
+ */
+static bool load_trace(char const* path, Replay_trace* t) {
+    size_t len;
+    uint8_t* buf = read_file(path, &len);
+    if (buf == NULL || len < ALLOC_TRACE_MAGIC_SIZE || memcmp(buf, ALLOC_TRACE_MAGIC, ALLOC_TRACE_MAGIC_SIZE) != 0) {
+        free(buf);
+        return false;
+    }
+
+    Addr_map map         = {NULL, NULL, 0, 0};
+    Alloc_trace_state s  = {0};
+    size_t capacity      = 0;
+    size_t* sizes        = NULL;
+    size_t sizes_nr      = 0;
+    size_t live_size     = 0;
+    bool is_ok           = true;
+    memset(t, 0, sizeof(Replay_trace));
+
+    Alloc_trace_event e;
+    for (size_t pos = ALLOC_TRACE_MAGIC_SIZE, n; (n = alloc_trace_decode(&s, buf + pos, len - pos, &e)) != 0; pos += n) {
+        uint32_t id;
+        switch (e.op) {
+            case ALLOC_TRACE_MALLOC:
+            case ALLOC_TRACE_MEMALIGN:
+                if (e.addr == 0 || e.size == 0) {
+                    continue;
+                }
+                id = (uint32_t)t->id_nr++;
+                is_ok = (addr_map_insert(&map, e.addr, id) == true && push_op(t, &capacity, (Replay_op){ALLOC_TRACE_MALLOC, id, e.size, e.align}) == true);
+                break;
+            case ALLOC_TRACE_FREE:
+                id = addr_map_remove(&map, e.addr);
+                if (id == UINT32_MAX) {
+                    continue;
+                }
+                is_ok = push_op(t, &capacity, (Replay_op){ALLOC_TRACE_FREE, id, 0, 0});
+                break;
+            case ALLOC_TRACE_REALLOC:
+                if (e.old_addr == 0) {
+                    if (e.addr == 0) {
+                        continue;
+                    }
+                    id = (uint32_t)t->id_nr++;
+                    is_ok = (addr_map_insert(&map, e.addr, id) == true && push_op(t, &capacity, (Replay_op){ALLOC_TRACE_MALLOC, id, e.size, 0}) == true);
+                    break;
+                }
+                if (e.addr == 0 && e.size != 0) {
+                    /* Failed, the old object is alive. */
+                    continue;
+                }
+                id = addr_map_remove(&map, e.old_addr);
+                if (id == UINT32_MAX) {
+                    continue;
+                }
+                if (e.addr == 0) {
+                    is_ok = push_op(t, &capacity, (Replay_op){ALLOC_TRACE_FREE, id, 0, 0});
+                    break;
+                }
+                is_ok = (addr_map_insert(&map, e.addr, id) == true && push_op(t, &capacity, (Replay_op){ALLOC_TRACE_REALLOC, id, e.size, 0}) == true);
+                break;
+            default:
+                continue;
+        }
+        if (is_ok == false) {
+            break;
+        }
+
+        /* Track the live bytes. */
+        if (sizes_nr < t->id_nr) {
+            size_t* ss = realloc(sizes, t->id_nr * 2 * sizeof(size_t));
+            if (ss == NULL) {
+                is_ok = false;
+                break;
+            }
+            sizes    = ss;
+            sizes_nr = t->id_nr * 2;
+        }
+        Replay_op const* op = &t->ops[t->op_nr - 1];
+        if (op->op == ALLOC_TRACE_MALLOC) {
+            sizes[op->id] = 0;
+        }
+        live_size -= sizes[op->id];
+        sizes[op->id] = op->size;
+        live_size += op->size;
+        if (t->peak_live_size < live_size) {
+            t->peak_live_size = live_size;
+        }
+    }
+
+    free(sizes);
+    free(map.keys);
+    free(map.ids);
+    free(buf);
+
+    if (is_ok == false) {
+        free(t->ops);
+        memset(t, 0, sizeof(Replay_trace));
+    }
+
+    return is_ok;
+}
+
+
+/*
+ * ==================== Replay. ====================
+ */
+
+
+static double clock_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static size_t read_status_kb(char const* key) {
+    FILE* fp = fopen("/proc/self/status", "r");
+    char line[256];
+    size_t v = 0;
+    size_t const key_len = strlen(key);
+
+    while (fp != NULL && fgets(line, sizeof(line), fp) != NULL) {
+        if (strncmp(line, key, key_len) == 0) {
+            v = strtoul(line + key_len, NULL, 10);
+            break;
+        }
+    }
+    if (fp != NULL) {
+        fclose(fp);
+    }
+
+    return v;
+}
+
+
+/* Reset the peak RSS (VmHWM) of this process. */
+static void reset_peak_rss(void) {
+    FILE* fp = fopen("/proc/self/clear_refs", "w");
+    if (fp != NULL) {
+        fputs("5", fp);
+        fclose(fp);
+    }
+}
+
+
+static inline void touch(void* p, size_t from, size_t to) {
+    for (size_t off = from; off < to; off += REPLAY_PAGE_SIZE) {
+        ((uint8_t volatile*)p)[off] = 1;
+    }
+}
+
+
+static Replay_result replay(Replay_allocator const* a, Replay_trace const* t) {
+    Replay_result r = {0, 0, 0};
+    void** objs     = calloc(t->id_nr, sizeof(void*));
+    size_t* sizes   = calloc(t->id_nr, sizeof(size_t));
+    size_t heap     = t->peak_live_size * 4;
+
+    if (objs == NULL || sizes == NULL || a->init((heap < MIN_HEAP_SIZE) ? MIN_HEAP_SIZE : heap) == false) {
+        r.failed_nr = t->op_nr;
+        return r;
+    }
+
+    reset_peak_rss();
+    size_t const base_rss = read_status_kb("VmRSS:");
+
+    double const begin = clock_sec();
+    for (size_t i = 0; i < t->op_nr; i++) {
+        Replay_op const* op = &t->ops[i];
+        void* p             = objs[op->id];
+        switch (op->op) {
+            case ALLOC_TRACE_MALLOC:
+                p = a->malloc(op->size, op->align);
+                if (p != NULL) {
+                    touch(p, 0, op->size);
+                }
+                break;
+            case ALLOC_TRACE_FREE:
+                if (p != NULL) {
+                    a->free(p);
+                }
+                p = NULL;
+                break;
+            case ALLOC_TRACE_REALLOC:
+                if (p == NULL) {
+                    break;
+                }
+                p = a->realloc(p, sizes[op->id], op->size);
+                if (p != NULL) {
+                    touch(p, sizes[op->id], op->size);
+                }
+                break;
+        }
+
+        if (p == NULL && op->op != ALLOC_TRACE_FREE) {
+            ++r.failed_nr;
+            if (op->op == ALLOC_TRACE_REALLOC) {
+                /* The old object is still alive. */
+                continue;
+            }
+        }
+        objs[op->id]  = p;
+        sizes[op->id] = (p == NULL) ? 0 : op->size;
+    }
+    r.sec = clock_sec() - begin;
+
+    size_t const peak_rss = read_status_kb("VmHWM:");
+    r.peak_rss            = (base_rss < peak_rss) ? (peak_rss - base_rss) << 10 : 0;
+
+    for (size_t i = 0; i < t->id_nr; i++) {
+        if (objs[i] != NULL) {
+            a->free(objs[i]);
+        }
+    }
+    a->destruct();
+    free(objs);
+    free(sizes);
+
+    return r;
+}
+
+
+static bool run_in_child(Replay_allocator const* a, Replay_trace const* t, Replay_result* r) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+
+    pid_t const pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        Replay_result cr = replay(a, t);
+        ssize_t w        = write(fds[1], &cr, sizeof(cr));
+        _exit((w == (ssize_t)sizeof(cr)) ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    close(fds[1]);
+
+    bool is_ok = (0 < pid) && read(fds[0], r, sizeof(*r)) == (ssize_t)sizeof(*r);
+    close(fds[0]);
+    if (0 < pid) {
+        waitpid(pid, NULL, 0);
+    }
+
+    return is_ok;
+}
+
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s trace [allocator]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    Replay_trace t;
+    if (load_trace(argv[1], &t) == false) {
+        fprintf(stderr, "cannot read trace %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    printf("%zu events, %zu objects, peak live %.2f MiB\n", t.op_nr, t.id_nr, t.peak_live_size / 1048576.0);
+
+    printf("allocator,  time ms,  ns/op, peak RSS MiB, fragmentation, failed\n");
+    for (size_t i = 0; i < sizeof(allocators) / sizeof(allocators[0]); i++) {
+        Replay_allocator const* a = &allocators[i];
+        if (argc < 3 || strcmp(argv[2], a->name) == 0) {
+            Replay_result r;
+            if (run_in_child(a, &t, &r) == false) {
+                printf("%-9s, failed\n", a->name);
+                continue;
+            }
+
+            double const frag = (r.peak_rss == 0) ? 0.0 : 1.0 - (double)t.peak_live_size / (double)r.peak_rss;
+            printf("%-9s, %8.1f, %6.1f, %12.2f, %13.3f, %zu\n", a->name, r.sec * 1e3, r.sec * 1e9 / (t.op_nr == 0 ? 1 : t.op_nr), r.peak_rss / 1048576.0, frag, r.failed_nr);
+        }
+    }
+
+    free(t.ops);
+
+    return EXIT_SUCCESS;
+}
@@ -1,6 +1,7 @@
 /**
  * @file aqueue.c
  * @brief Queue implemented by array.
+ *        Elements are stored in one ring buffer and they are addressed by the index directly.
  * @author mopp
  * @version 0.1
  * @date 2014-04-27
@@ -13,24 +14,40 @@
 #include "aqueue.h"
 
 
+static inline void* get_element(Aqueue const* q, size_t i) {
+    return (uint8_t*)q->data + i * q->data_type_size;
+}
+
+
 Aqueue* aqueue_init(Aqueue* q, size_t type_size, size_t capacity, release_func f) {
     assert(q != NULL);
 
-    q->data = (void**)malloc(sizeof(void*) * capacity);
-
     /* allocate all element area. */
-    void* elements = malloc(type_size * capacity);
-    uintptr_t addr = (uintptr_t)elements;
-
-    for (size_t i = 0; i < capacity; i++) {
-        q->data[i] = (void*)(addr + (i * type_size));
-    }
+    q->data = malloc(type_size * capacity);
 
     q->first = q->last = 0;
     q->capacity = capacity;
     q->size = 0;
     q->data_type_size = type_size;
     q->free = f;
+    q->is_growable = false;
+
+    return q;
+}
+
+
+/**
+ * @brief Initialize queue which is never full.
+ *        When the queue is full, aqueue_insert() doubles the buffer.
+ * @param q Pointer to queue.
+ * @param type_size Size of stored data type.
+ * @param capacity Initial capacity.
+ * @param f Pointer to function for release data or NULL.
+ * @return Pointer to queue.
+ */
+Aqueue* aqueue_init_growable(Aqueue* q, size_t type_size, size_t capacity, release_func f) {
+    aqueue_init(q, type_size, capacity, f);
+    q->is_growable = true;
 
     return q;
 }
@@ -57,14 +74,14 @@ void* aqueue_get_first(Aqueue* q) {
         return NULL;
     }
 
-    return q->data[q->first];
+    return get_element(q, q->first);
 }
 
 
 void aqueue_delete_first(Aqueue* q) {
     assert(q != NULL);
 
-    if (aqueue_is_empty(q) == true || q->data[q->first] == NULL) {
+    if (aqueue_is_empty(q) == true) {
         return;
     }
 
@@ -74,12 +91,63 @@ void aqueue_delete_first(Aqueue* q) {
 }
 
 
+/**
+ * @brief Double the buffer until it has the capacity.
+ *        The elements of wrapped ring are "first ... capacity - 1, 0 ... last - 1",
+ *        the shorter part is moved so that they become contiguous in the new buffer.
+ * @param q Pointer to queue.
+ * @param capacity Required capacity.
+ * @return true if succeeded.
+ */
+static bool aqueue_grow(Aqueue* q, size_t capacity) {
+    size_t const old_capacity = q->capacity;
+    size_t const s = q->data_type_size;
+    size_t new_capacity = (old_capacity == 0) ? 1 : old_capacity;
+
+    while (new_capacity < capacity) {
+        if (SIZE_MAX / 2 / s < new_capacity) {
+            return false;
+        }
+        new_capacity *= 2;
+    }
+
+    if (new_capacity == old_capacity) {
+        return true;
+    }
+
+    void* d = realloc(q->data, new_capacity * s);
+    if (d == NULL) {
+        return false;
+    }
+    q->data = d;
+    q->capacity = new_capacity;
+
+    if (q->size == 0 || q->first < q->last) {
+        /* Not wrapped. */
+        return true;
+    }
+
+    if (q->last <= old_capacity - q->first) {
+        /* Move the head part after the tail part. */
+        memcpy(get_element(q, old_capacity), get_element(q, 0), q->last * s);
+        q->last += old_capacity;
+    } else {
+        /* Move the tail part to the end of the new buffer. */
+        size_t const n = old_capacity - q->first;
+        memcpy(get_element(q, new_capacity - n), get_element(q, q->first), n * s);
+        q->first = new_capacity - n;
+    }
+
+    return true;
+}
+
+
 void* aqueue_insert(Aqueue* q, void* data) {
-    if (aqueue_is_full(q) == true) {
+    if (aqueue_is_full(q) == true && (q->is_growable == false || aqueue_grow(q, q->capacity + 1) == false)) {
         return NULL;
     }
 
-    memcpy(q->data[q->last], data, q->data_type_size);
+    memcpy(get_element(q, q->last), data, q->data_type_size);
 
     q->last = (q->last + 1 == q->capacity) ? 0 : q->last + 1;
 
@@ -89,18 +157,101 @@ void* aqueue_insert(Aqueue* q, void* data) {
 }
 
 
+/**
+ * @brief Insert the array of elements at once.
+ *        The elements are copied by at most two memcpy() for the ring wraparound.
+ *        Fixed queue inserts the elements as many as it can.
+ * @param q Pointer to queue.
+ * @param data Pointer to the array of inserted elements.
+ * @param n The number of element in array.
+ * @return The number of inserted element.
+ */
+size_t aqueue_insert_n(Aqueue* q, void const* data, size_t n) {
+    assert(q != NULL && (n == 0 || data != NULL));
+
+    if (q->capacity - q->size < n) {
+        if (q->is_growable == false || SIZE_MAX - q->size < n || aqueue_grow(q, q->size + n) == false) {
+            n = q->capacity - q->size;
+        }
+    }
+
+    if (n == 0) {
+        return 0;
+    }
+
+    size_t const s = q->data_type_size;
+    size_t const tail_nr = q->capacity - q->last;
+    if (n < tail_nr) {
+        memcpy(get_element(q, q->last), data, n * s);
+        q->last += n;
+    } else {
+        memcpy(get_element(q, q->last), data, tail_nr * s);
+        memcpy(get_element(q, 0), (uint8_t const*)data + tail_nr * s, (n - tail_nr) * s);
+        q->last = n - tail_nr;
+    }
+    q->size += n;
+
+    return n;
+}
+
+
+/**
+ * @brief Remove the first elements at once.
+ *        The elements are copied by at most two memcpy() for the ring wraparound.
+ *        And this NOT releases the elements like aqueue_delete_first().
+ * @param q Pointer to queue.
+ * @param out Pointer to the array to copy the removed elements or NULL.
+ * @param n The maximum number of removed element.
+ * @return The number of removed element.
+ */
+size_t aqueue_pop_n(Aqueue* q, void* out, size_t n) {
+    assert(q != NULL);
+
+    n = (q->size < n) ? q->size : n;
+    if (n == 0) {
+        return 0;
+    }
+
+    size_t const s = q->data_type_size;
+    size_t const tail_nr = q->capacity - q->first;
+    if (n < tail_nr) {
+        if (out != NULL) {
+            memcpy(out, get_element(q, q->first), n * s);
+        }
+        q->first += n;
+    } else {
+        if (out != NULL) {
+            memcpy(out, get_element(q, q->first), tail_nr * s);
+            memcpy((uint8_t*)out + tail_nr * s, get_element(q, 0), (n - tail_nr) * s);
+        }
+        q->first = n - tail_nr;
+    }
+    q->size -= n;
+
+    return n;
+}
+
+
+/**
+ * @brief Release queue.
+ *        The release function is called with the pointer to each element remaining in queue.
+ * @param q Pointer to queue.
+ */
 void aqueue_destruct(Aqueue* q) {
     assert(q != NULL);
 
-    size_t const size = aqueue_get_size(q);
-    for (int i = 0; i < size; i++) {
-        ((q->free != NULL) ? q->free : free)(q->data[i]);
+    if (q->free != NULL) {
+        size_t i = q->first;
+        for (size_t n = aqueue_get_size(q); n != 0; n--) {
+            q->free(get_element(q, i));
+            i = (i + 1 == q->capacity) ? 0 : i + 1;
+        }
     }
 
-    free(q->data[0]); /* In aqueue_init, malloced addr is set at index 0 of array. */
     free(q->data);
 
     q->capacity = 0;
+    q->size = 0;
     q->free = 0;
 }
 
@@ -18,22 +18,26 @@ typedef void (*release_func)(void*);
 
 
 struct aqueue {
-    void** data; /* pointer to any data(void*) array. */
+    void* data; /* element buffer, element i is at data + i * data_type_size. */
     size_t first, last;
     size_t capacity;
     size_t size;
     size_t data_type_size; /* it provided by sizeof(data). */
     release_func free;
+    bool is_growable; /* if true, the buffer is doubled when it is full. */
 };
 typedef struct aqueue Aqueue;
 
 
 extern Aqueue* aqueue_init(Aqueue*, size_t, size_t, release_func);
+extern Aqueue* aqueue_init_growable(Aqueue*, size_t, size_t, release_func);
 extern bool aqueue_is_empty(Aqueue const*);
 extern bool aqueue_is_full(Aqueue const*);
 extern void* aqueue_get_first(Aqueue*);
 extern void aqueue_delete_first(Aqueue*);
 extern void* aqueue_insert(Aqueue*, void*);
+extern size_t aqueue_insert_n(Aqueue*, void const*, size_t);
+extern size_t aqueue_pop_n(Aqueue*, void*, size_t);
 extern void aqueue_destruct(Aqueue*);
 extern size_t aqueue_get_size(Aqueue const*);
 extern size_t aqueue_get_capacity(Aqueue const*);
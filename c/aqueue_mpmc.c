@@ -0,0 +1,229 @@
+/**
+ * @file aqueue_mpmc.c
+ * @brief Bounded lock-free multi-producer/multi-consumer queue implemented by array.
+ *        This is based on Dmitry Vyukov's bounded MPMC queue.
+ *        http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-12
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aqueue_mpmc.h"
+
+
+static inline size_t round_up_power_of_2(size_t x) {
+    size_t p = 1;
+    while (p < x) {
+        p <<= 1;
+    }
+    return p;
+}
+
+
+static inline void* get_slot(Aqueue_mpmc const* q, size_t pos) {
+    return (void*)((uintptr_t)q->elements + (pos & q->mask) * q->data_type_size);
+}
+
+
+/*
+ * Copy n elements from src into the slots starting at pos.
+ * The range is split at most once where the ring wraps.
+ */
+static inline void copy_into_slots(Aqueue_mpmc* q, size_t pos, void const* src, size_t n) {
+    size_t const idx   = pos & q->mask;
+    size_t const first = (n < q->capacity - idx) ? n : q->capacity - idx;
+    size_t const ts    = q->data_type_size;
+
+    memcpy(get_slot(q, pos), src, first * ts);
+    memcpy(q->elements, (uint8_t const*)src + first * ts, (n - first) * ts);
+}
+
+
+static inline void copy_from_slots(Aqueue_mpmc* q, size_t pos, void* dst, size_t n) {
+    size_t const idx   = pos & q->mask;
+    size_t const first = (n < q->capacity - idx) ? n : q->capacity - idx;
+    size_t const ts    = q->data_type_size;
+
+    memcpy(dst, get_slot(q, pos), first * ts);
+    memcpy((uint8_t*)dst + first * ts, q->elements, (n - first) * ts);
+}
+
+
+/**
+ * @brief Initialize queue.
+ * @param q Pointer to queue.
+ * @param type_size Size of stored data type in queue.
+ * @param capacity The number of element, it is rounded up to power of 2.
+ * @return Pointer to queue or NULL if allocation failed.
+ */
+Aqueue_mpmc* aqueue_mpmc_init(Aqueue_mpmc* q, size_t type_size, size_t capacity) {
+    assert(q != NULL);
+    assert(type_size != 0 && capacity != 0);
+
+    capacity    = round_up_power_of_2(capacity);
+    q->seqs     = malloc(sizeof(atomic_size_t) * capacity);
+    q->elements = malloc(type_size * capacity);
+    if (q->seqs == NULL || q->elements == NULL) {
+        free(q->seqs);
+        free(q->elements);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&q->seqs[i], i);
+    }
+
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    q->capacity       = capacity;
+    q->mask           = capacity - 1;
+    q->data_type_size = type_size;
+
+    return q;
+}
+
+
+/**
+ * @brief Release all element area.
+ *        No thread may use the queue after this.
+ * @param q Pointer to queue.
+ */
+void aqueue_mpmc_destruct(Aqueue_mpmc* q) {
+    assert(q != NULL);
+
+    free(q->seqs);
+    free(q->elements);
+    q->seqs     = NULL;
+    q->elements = NULL;
+    q->capacity = 0;
+}
+
+
+/**
+ * @brief Insert one element.
+ * @param q Pointer to queue.
+ * @param data Pointer to inserted data, data_type_size bytes are copied.
+ * @return false if queue is full.
+ */
+bool aqueue_mpmc_try_insert(Aqueue_mpmc* q, void const* data) {
+    return aqueue_mpmc_try_insert_n(q, data, 1) == 1;
+}
+
+
+/**
+ * @brief Get and delete the first element.
+ * @param q Pointer to queue.
+ * @param data Pointer to buffer, the element is copied into it.
+ * @return false if queue is empty.
+ */
+bool aqueue_mpmc_try_get(Aqueue_mpmc* q, void* data) {
+    return aqueue_mpmc_try_get_n(q, data, 1) == 1;
+}
+
+
+/**
+ * @brief Insert at most n contiguous elements with one reservation.
+ * @param q Pointer to queue.
+ * @param data Pointer to array of data.
+ * @param n The number of element in data.
+ * @return The number of inserted element, 0 means queue is full.
+ */
+size_t aqueue_mpmc_try_insert_n(Aqueue_mpmc* q, void const* data, size_t n) {
+    assert(q != NULL && data != NULL);
+
+    if (n == 0) {
+        return 0;
+    }
+
+    size_t k;
+    size_t pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    for (;;) {
+        /* Count empty slots for this round. */
+        k = 0;
+        while (k < n && k < q->capacity && atomic_load_explicit(&q->seqs[(pos + k) & q->mask], memory_order_acquire) == pos + k) {
+            ++k;
+        }
+
+        if (k == 0) {
+            size_t const seq = atomic_load_explicit(&q->seqs[pos & q->mask], memory_order_acquire);
+            if ((intptr_t)(seq - pos) < 0) {
+                /* The slot is not consumed yet in previous round. */
+                return 0;
+            }
+            /* Other producer took pos. */
+            pos = atomic_load_explicit(&q->tail, memory_order_relaxed);
+            continue;
+        }
+
+        if (atomic_compare_exchange_weak_explicit(&q->tail, &pos, pos + k, memory_order_relaxed, memory_order_relaxed) == true) {
+            break;
+        }
+    }
+
+    copy_into_slots(q, pos, data, k);
+    for (size_t i = 0; i < k; i++) {
+        atomic_store_explicit(&q->seqs[(pos + i) & q->mask], pos + i + 1, memory_order_release);
+    }
+
+    return k;
+}
+
+
+/**
+ * @brief Get and delete at most n contiguous elements with one reservation.
+ * @param q Pointer to queue.
+ * @param data Pointer to buffer which has n element area.
+ * @param n The number of element to get.
+ * @return The number of got element, 0 means queue is empty.
+ */
+size_t aqueue_mpmc_try_get_n(Aqueue_mpmc* q, void* data, size_t n) {
+    assert(q != NULL && data != NULL);
+
+    if (n == 0) {
+        return 0;
+    }
+
+    size_t k;
+    size_t pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+    for (;;) {
+        /* Count filled slots. */
+        k = 0;
+        while (k < n && k < q->capacity && atomic_load_explicit(&q->seqs[(pos + k) & q->mask], memory_order_acquire) == pos + k + 1) {
+            ++k;
+        }
+
+        if (k == 0) {
+            size_t const seq = atomic_load_explicit(&q->seqs[pos & q->mask], memory_order_acquire);
+            if ((intptr_t)(seq - (pos + 1)) < 0) {
+                /* The slot is not filled yet. */
+                return 0;
+            }
+            /* Other consumer took pos. */
+            pos = atomic_load_explicit(&q->head, memory_order_relaxed);
+            continue;
+        }
+
+        if (atomic_compare_exchange_weak_explicit(&q->head, &pos, pos + k, memory_order_relaxed, memory_order_relaxed) == true) {
+            break;
+        }
+    }
+
+    copy_from_slots(q, pos, data, k);
+    for (size_t i = 0; i < k; i++) {
+        /* Make the slot empty for the next round. */
+        atomic_store_explicit(&q->seqs[(pos + i) & q->mask], pos + i + q->capacity, memory_order_release);
+    }
+
+    return k;
+}
+
+
+size_t aqueue_mpmc_get_capacity(Aqueue_mpmc const* q) {
+    assert(q != NULL);
+
+    return q->capacity;
+}
@@ -0,0 +1,49 @@
+/**
+ * @file aqueue_mpmc.h
+ * @brief Lock-free multi-producer/multi-consumer array queue header.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-12
+ */
+
+#ifndef _ARRAY_QUEUE_MPMC_H_
+#define _ARRAY_QUEUE_MPMC_H_
+
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+
+#define AQUEUE_CACHE_LINE_SIZE 64
+
+
+/*
+ * Elements are stored in one contiguous area like Aqueue.
+ * Each slot has a sequence number which tells the state of the slot for a position.
+ *   seqs[i] == pos         : the slot is empty and can be written by the producer of pos.
+ *   seqs[i] == pos + 1     : the slot is filled and can be read by the consumer of pos.
+ * head and tail are placed on their own cache lines to avoid false sharing between producers and consumers.
+ */
+struct aqueue_mpmc {
+    _Alignas(AQUEUE_CACHE_LINE_SIZE) atomic_size_t tail; /* next insert position. */
+    _Alignas(AQUEUE_CACHE_LINE_SIZE) atomic_size_t head; /* next get position. */
+    _Alignas(AQUEUE_CACHE_LINE_SIZE) atomic_size_t* seqs;
+    void* elements;
+    size_t capacity; /* power of 2. */
+    size_t mask;
+    size_t data_type_size; /* it provided by sizeof(data). */
+};
+typedef struct aqueue_mpmc Aqueue_mpmc;
+
+
+extern Aqueue_mpmc* aqueue_mpmc_init(Aqueue_mpmc*, size_t, size_t);
+extern void aqueue_mpmc_destruct(Aqueue_mpmc*);
+extern bool aqueue_mpmc_try_insert(Aqueue_mpmc*, void const*);
+extern bool aqueue_mpmc_try_get(Aqueue_mpmc*, void*);
+extern size_t aqueue_mpmc_try_insert_n(Aqueue_mpmc*, void const*, size_t);
+extern size_t aqueue_mpmc_try_get_n(Aqueue_mpmc*, void*, size_t);
+extern size_t aqueue_mpmc_get_capacity(Aqueue_mpmc const*);
+
+
+#endif
@@ -0,0 +1,316 @@
+/**
+ * @file aqueue_spsc.c
+ * @brief Bounded wait-free single-producer/single-consumer queue implemented by array.
+ *        Only one thread may insert and only one thread may get.
+ *        The indices are published by release store and read by acquire load,
+ *        there is neither read-modify-write nor full fence in the try operations of non-blocking queue.
+ *
+ *        Blocking queue uses futex to sleep.
+ *        A waiter sets its flag and checks the queue again, the other side checks the flag after publishing its index.
+ *        Both sides put a seq_cst fence between them, so either the waiter sees the index or the other side sees the flag.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-30
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aqueue_spsc.h"
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <sched.h>
+#endif
+
+
+enum {
+    SPIN_NR = 128, /* The number of retry before sleeping. */
+};
+
+
+static inline size_t round_up_power_of_2(size_t x) {
+    size_t p = 1;
+    while (p < x) {
+        p <<= 1;
+    }
+    return p;
+}
+
+
+static inline void* get_slot(Aqueue_spsc const* q, size_t pos) {
+    return (void*)((uintptr_t)q->elements + (pos & q->mask) * q->data_type_size);
+}
+
+
+/*
+ * Copy n elements from src into the slots starting at pos.
+ * The range is split at most once where the ring wraps.
+ */
+static inline void copy_into_slots(Aqueue_spsc* q, size_t pos, void const* src, size_t n) {
+    size_t const idx   = pos & q->mask;
+    size_t const first = (n < q->capacity - idx) ? n : q->capacity - idx;
+    size_t const ts    = q->data_type_size;
+
+    memcpy(get_slot(q, pos), src, first * ts);
+    memcpy(q->elements, (uint8_t const*)src + first * ts, (n - first) * ts);
+}
+
+
+static inline void copy_from_slots(Aqueue_spsc* q, size_t pos, void* dst, size_t n) {
+    size_t const idx   = pos & q->mask;
+    size_t const first = (n < q->capacity - idx) ? n : q->capacity - idx;
+    size_t const ts    = q->data_type_size;
+
+    memcpy(dst, get_slot(q, pos), first * ts);
+    memcpy((uint8_t*)dst + first * ts, q->elements, (n - first) * ts);
+}
+
+
+/*
+ * Sleep while the word is 1.
+ * It may return spuriously, the caller checks the queue again.
+ */
+static inline void wait_on(atomic_uint* word) {
+#if defined(__linux__)
+    syscall(SYS_futex, (unsigned int*)word, FUTEX_WAIT_PRIVATE, 1, NULL, NULL, 0);
+#else
+    (void)word;
+    sched_yield();
+#endif
+}
+
+
+/*
+ * Wake the other side if it sleeps.
+ * It is called after the index is published.
+ */
+static inline void wake_up(atomic_uint* word) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(word, memory_order_relaxed) == 0) {
+        return;
+    }
+
+    atomic_store_explicit(word, 0, memory_order_relaxed);
+#if defined(__linux__)
+    syscall(SYS_futex, (unsigned int*)word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#endif
+}
+
+
+/**
+ * @brief Initialize queue.
+ * @param q Pointer to queue.
+ * @param type_size Size of stored data type in queue.
+ * @param capacity The number of element, it is rounded up to power of 2.
+ * @return Pointer to queue or NULL if allocation failed.
+ */
+Aqueue_spsc* aqueue_spsc_init(Aqueue_spsc* q, size_t type_size, size_t capacity) {
+    assert(q != NULL);
+    assert(type_size != 0 && capacity != 0);
+
+    capacity    = round_up_power_of_2(capacity);
+    q->elements = malloc(type_size * capacity);
+    if (q->elements == NULL) {
+        return NULL;
+    }
+
+    atomic_init(&q->head, 0);
+    atomic_init(&q->tail, 0);
+    atomic_init(&q->producer_waiting, 0);
+    atomic_init(&q->consumer_waiting, 0);
+    q->cached_head    = 0;
+    q->cached_tail    = 0;
+    q->capacity       = capacity;
+    q->mask           = capacity - 1;
+    q->data_type_size = type_size;
+    q->is_blocking    = false;
+
+    return q;
+}
+
+
+/**
+ * @brief Initialize queue which supports aqueue_spsc_insert() and aqueue_spsc_get().
+ *        Every try operation costs one more fence to wake the other side up.
+ * @param q Pointer to queue.
+ * @param type_size Size of stored data type in queue.
+ * @param capacity The number of element, it is rounded up to power of 2.
+ * @return Pointer to queue or NULL if allocation failed.
+ */
+Aqueue_spsc* aqueue_spsc_init_blocking(Aqueue_spsc* q, size_t type_size, size_t capacity) {
+    if (aqueue_spsc_init(q, type_size, capacity) == NULL) {
+        return NULL;
+    }
+    q->is_blocking = true;
+
+    return q;
+}
+
+
+/**
+ * @brief Release all element area.
+ *        No thread may use the queue after this.
+ * @param q Pointer to queue.
+ */
+void aqueue_spsc_destruct(Aqueue_spsc* q) {
+    assert(q != NULL);
+
+    free(q->elements);
+    q->elements = NULL;
+    q->capacity = 0;
+}
+
+
+/**
+ * @brief Insert one element, only the producer can call this.
+ * @param q Pointer to queue.
+ * @param data Pointer to inserted data, data_type_size bytes are copied.
+ * @return false if queue is full.
+ */
+bool aqueue_spsc_try_insert(Aqueue_spsc* q, void const* data) {
+    return aqueue_spsc_try_insert_n(q, data, 1) == 1;
+}
+
+
+/**
+ * @brief Get and delete the first element, only the consumer can call this.
+ * @param q Pointer to queue.
+ * @param data Pointer to buffer, the element is copied into it.
+ * @return false if queue is empty.
+ */
+bool aqueue_spsc_try_get(Aqueue_spsc* q, void* data) {
+    return aqueue_spsc_try_get_n(q, data, 1) == 1;
+}
+
+
+/**
+ * @brief Insert at most n contiguous elements, only the producer can call this.
+ * @param q Pointer to queue.
+ * @param data Pointer to array of data.
+ * @param n The number of element in data.
+ * @return The number of inserted element, 0 means queue is full.
+ */
+size_t aqueue_spsc_try_insert_n(Aqueue_spsc* q, void const* data, size_t n) {
+    assert(q != NULL && data != NULL);
+
+    size_t const tail = atomic_load_explicit(&q->tail, memory_order_relaxed);
+    size_t space      = q->capacity - (tail - q->cached_head);
+    if (space < n) {
+        /* The slots are released by the consumer after it copied them. */
+        q->cached_head = atomic_load_explicit(&q->head, memory_order_acquire);
+        space          = q->capacity - (tail - q->cached_head);
+    }
+
+    n = (space < n) ? space : n;
+    if (n == 0) {
+        return 0;
+    }
+
+    copy_into_slots(q, tail, data, n);
+    atomic_store_explicit(&q->tail, tail + n, memory_order_release);
+
+    if (q->is_blocking == true) {
+        wake_up(&q->consumer_waiting);
+    }
+
+    return n;
+}
+
+
+/**
+ * @brief Get and delete at most n contiguous elements, only the consumer can call this.
+ * @param q Pointer to queue.
+ * @param data Pointer to buffer which has n element area.
+ * @param n The number of element to get.
+ * @return The number of got element, 0 means queue is empty.
+ */
+size_t aqueue_spsc_try_get_n(Aqueue_spsc* q, void* data, size_t n) {
+    assert(q != NULL && data != NULL);
+
+    size_t const head = atomic_load_explicit(&q->head, memory_order_relaxed);
+    size_t filled     = q->cached_tail - head;
+    if (filled < n) {
+        q->cached_tail = atomic_load_explicit(&q->tail, memory_order_acquire);
+        filled         = q->cached_tail - head;
+    }
+
+    n = (filled < n) ? filled : n;
+    if (n == 0) {
+        return 0;
+    }
+
+    copy_from_slots(q, head, data, n);
+    atomic_store_explicit(&q->head, head + n, memory_order_release);
+
+    if (q->is_blocking == true) {
+        wake_up(&q->producer_waiting);
+    }
+
+    return n;
+}
+
+
+/**
+ * @brief Insert one element, the producer sleeps while queue is full.
+ *        The queue must be initialized by aqueue_spsc_init_blocking().
+ * @param q Pointer to queue.
+ * @param data Pointer to inserted data, data_type_size bytes are copied.
+ */
+void aqueue_spsc_insert(Aqueue_spsc* q, void const* data) {
+    assert(q != NULL && q->is_blocking == true);
+
+    for (;;) {
+        for (size_t i = 0; i < SPIN_NR; i++) {
+            if (aqueue_spsc_try_insert(q, data) == true) {
+                return;
+            }
+        }
+
+        atomic_store_explicit(&q->producer_waiting, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (aqueue_spsc_try_insert(q, data) == true) {
+            atomic_store_explicit(&q->producer_waiting, 0, memory_order_relaxed);
+            return;
+        }
+        wait_on(&q->producer_waiting);
+    }
+}
+
+
+/**
+ * @brief Get and delete the first element, the consumer sleeps while queue is empty.
+ *        The queue must be initialized by aqueue_spsc_init_blocking().
+ * @param q Pointer to queue.
+ * @param data Pointer to buffer, the element is copied into it.
+ */
+void aqueue_spsc_get(Aqueue_spsc* q, void* data) {
+    assert(q != NULL && q->is_blocking == true);
+
+    for (;;) {
+        for (size_t i = 0; i < SPIN_NR; i++) {
+            if (aqueue_spsc_try_get(q, data) == true) {
+                return;
+            }
+        }
+
+        atomic_store_explicit(&q->consumer_waiting, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (aqueue_spsc_try_get(q, data) == true) {
+            atomic_store_explicit(&q->consumer_waiting, 0, memory_order_relaxed);
+            return;
+        }
+        wait_on(&q->consumer_waiting);
+    }
+}
+
+
+size_t aqueue_spsc_get_capacity(Aqueue_spsc const* q) {
+    assert(q != NULL);
+
+    return q->capacity;
+}
@@ -0,0 +1,58 @@
+/**
+ * @file aqueue_spsc.h
+ * @brief Wait-free single-producer/single-consumer array queue header.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-30
+ */
+
+#ifndef _ARRAY_QUEUE_SPSC_H_
+#define _ARRAY_QUEUE_SPSC_H_
+
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+
+#ifndef AQUEUE_CACHE_LINE_SIZE
+#define AQUEUE_CACHE_LINE_SIZE 64
+#endif
+
+
+/*
+ * Elements are stored in one contiguous area like Aqueue.
+ * tail is written by only the producer, head is written by only the consumer.
+ * Each side keeps a copy of the other index and reloads it only when the copy says full or empty,
+ * so the line of the other side is not touched at every operation.
+ * The producer state, the consumer state and the waiting flags are placed on their own cache lines.
+ */
+struct aqueue_spsc {
+    _Alignas(AQUEUE_CACHE_LINE_SIZE) atomic_size_t tail; /* next insert position. */
+    size_t cached_head;                                   /* head seen by the producer. */
+    _Alignas(AQUEUE_CACHE_LINE_SIZE) atomic_size_t head; /* next get position. */
+    size_t cached_tail;                                   /* tail seen by the consumer. */
+    _Alignas(AQUEUE_CACHE_LINE_SIZE) atomic_uint producer_waiting; /* futex word, 1 while the producer sleeps on full. */
+    atomic_uint consumer_waiting;                                   /* futex word, 1 while the consumer sleeps on empty. */
+    _Alignas(AQUEUE_CACHE_LINE_SIZE) void* elements;
+    size_t capacity; /* power of 2. */
+    size_t mask;
+    size_t data_type_size; /* it provided by sizeof(data). */
+    bool is_blocking;      /* if true, aqueue_spsc_insert() and aqueue_spsc_get() can be used. */
+};
+typedef struct aqueue_spsc Aqueue_spsc;
+
+
+extern Aqueue_spsc* aqueue_spsc_init(Aqueue_spsc*, size_t, size_t);
+extern Aqueue_spsc* aqueue_spsc_init_blocking(Aqueue_spsc*, size_t, size_t);
+extern void aqueue_spsc_destruct(Aqueue_spsc*);
+extern bool aqueue_spsc_try_insert(Aqueue_spsc*, void const*);
+extern bool aqueue_spsc_try_get(Aqueue_spsc*, void*);
+extern size_t aqueue_spsc_try_insert_n(Aqueue_spsc*, void const*, size_t);
+extern size_t aqueue_spsc_try_get_n(Aqueue_spsc*, void*, size_t);
+extern void aqueue_spsc_insert(Aqueue_spsc*, void const*);
+extern void aqueue_spsc_get(Aqueue_spsc*, void*);
+extern size_t aqueue_spsc_get_capacity(Aqueue_spsc const*);
+
+
+#endif
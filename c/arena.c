@@ -0,0 +1,221 @@
+/**
+ * @file arena.c
+ * @brief Arena (region) allocator.
+ *        Objects are carved from chunks by a pointer bump, and they are freed all at once.
+ *        arena_reset() and arena_rollback() just move the pointer back in O(1),
+ *        the chunks are kept in the list and reused by the next allocations.
+ *        The chunks are obtained from a Tlsf_manager or mmap().
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-26
+ */
+
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "align.h"
+#include "arena.h"
+
+
+#define CHUNK_HEADER_SIZE align_up(sizeof(Arena_chunk), ARENA_DEFAULT_ALIGN)
+
+
+static inline uintptr_t get_chunk_begin(Arena_chunk const* c) {
+    return (uintptr_t)c + CHUNK_HEADER_SIZE;
+}
+
+
+static inline uintptr_t get_chunk_end(Arena_chunk const* c) {
+    return (uintptr_t)c + c->size;
+}
+
+
+static Arena_chunk* alloc_chunk(Arena* a, size_t need) {
+    size_t size = need + CHUNK_HEADER_SIZE;
+    size        = (size < a->chunk_size) ? a->chunk_size : size;
+
+    Arena_chunk* c;
+    if (a->tman != NULL) {
+        c = tlsf_malloc_align(a->tman, size, ARENA_DEFAULT_ALIGN);
+    } else {
+        size = align_up(size, (size_t)sysconf(_SC_PAGESIZE));
+        c    = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        c    = (c == MAP_FAILED) ? NULL : c;
+    }
+
+    if (c != NULL) {
+        c->next = NULL;
+        c->size = size;
+    }
+
+    return c;
+}
+
+
+static void release_chunk(Arena* a, Arena_chunk* c) {
+    if (a->tman != NULL) {
+        tlsf_free(a->tman, c);
+    } else {
+        munmap(c, c->size);
+    }
+}
+
+
+static inline void set_current(Arena* a, Arena_chunk* c, uintptr_t top) {
+    a->current = c;
+    a->top     = top;
+    a->end     = get_chunk_end(c);
+}
+
+
+/**
+ * @brief Initialize the arena, no chunk is allocated until the first allocation.
+ * @param a
+ * @param chunk_size The size of each chunk, 0 means ARENA_CHUNK_SIZE.
+ * @param tman       The allocator of the chunks, NULL means mmap().
+ * @return The given arena.
+ */
+Arena* arena_init(Arena* a, size_t chunk_size, Tlsf_manager* tman) {
+    if (a == NULL) {
+        return NULL;
+    }
+
+    a->head       = NULL;
+    a->current    = NULL;
+    a->top        = 0;
+    a->end        = 0;
+    a->chunk_size = (chunk_size == 0) ? ARENA_CHUNK_SIZE : chunk_size;
+    a->tman       = tman;
+
+    return a;
+}
+
+
+void arena_destruct(Arena* a) {
+    Arena_chunk* c = a->head;
+    while (c != NULL) {
+        Arena_chunk* next = c->next;
+        release_chunk(a, c);
+        c = next;
+    }
+
+    arena_init(a, a->chunk_size, a->tman);
+}
+
+
+/* Move to the next chunk, a new chunk is inserted if the next one is too small. */
+static void* alloc_slow(Arena* a, size_t size, size_t align) {
+    if (SIZE_MAX - align < size) {
+        return NULL;
+    }
+
+    size_t const need = size + ((ARENA_DEFAULT_ALIGN < align) ? align - ARENA_DEFAULT_ALIGN : 0);
+    Arena_chunk* next = (a->current == NULL) ? a->head : a->current->next;
+
+    if (next == NULL || get_chunk_end(next) - get_chunk_begin(next) < need) {
+        Arena_chunk* c = alloc_chunk(a, need);
+        if (c == NULL) {
+            return NULL;
+        }
+
+        c->next = next;
+        if (a->current == NULL) {
+            a->head = c;
+        } else {
+            a->current->next = c;
+        }
+        next = c;
+    }
+
+    set_current(a, next, get_chunk_begin(next));
+
+    uintptr_t const p = align_address(a->top, align);
+    a->top            = p + size;
+
+    return (void*)p;
+}
+
+
+/**
+ * @brief Allocate memory from the arena.
+ * @param a
+ * @param size
+ * @param align Power of 2, 0 means ARENA_DEFAULT_ALIGN.
+ * @return NULL if failed.
+ */
+void* arena_alloc_align(Arena* a, size_t size, size_t align) {
+    align = (align < ARENA_DEFAULT_ALIGN) ? ARENA_DEFAULT_ALIGN : align;
+    if (is_power_of_2(align) == false) {
+        return NULL;
+    }
+
+    uintptr_t const p = align_address(a->top, align);
+    if (a->current != NULL && p <= a->end && size <= a->end - p) {
+        a->top = p + size;
+        return (void*)p;
+    }
+
+    return alloc_slow(a, size, align);
+}
+
+
+void* arena_alloc(Arena* a, size_t size) {
+    return arena_alloc_align(a, size, ARENA_DEFAULT_ALIGN);
+}
+
+
+Arena_savepoint arena_save(Arena const* a) {
+    return (Arena_savepoint){a->current, a->top};
+}
+
+
+/**
+ * @brief Free all memory allocated after the savepoint.
+ *        The savepoint must be taken after the last arena_reset() or arena_rollback() to an older savepoint.
+ */
+void arena_rollback(Arena* a, Arena_savepoint sp) {
+    if (sp.chunk == NULL) {
+        arena_reset(a);
+        return;
+    }
+
+    set_current(a, sp.chunk, sp.top);
+}
+
+
+/**
+ * @brief Free all memory in the arena, the chunks are kept.
+ */
+void arena_reset(Arena* a) {
+    if (a->head != NULL) {
+        set_current(a, a->head, get_chunk_begin(a->head));
+    }
+}
+
+
+/**
+ * @brief Release the chunks which are not used now.
+ */
+void arena_trim(Arena* a) {
+    if (a->current == NULL) {
+        return;
+    }
+
+    Arena_chunk* c = a->current->next;
+    while (c != NULL) {
+        Arena_chunk* next = c->next;
+        release_chunk(a, c);
+        c = next;
+    }
+    a->current->next = NULL;
+}
+
+
+size_t arena_get_chunk_nr(Arena const* a) {
+    size_t n = 0;
+    for (Arena_chunk const* c = a->head; c != NULL; c = c->next) {
+        n++;
+    }
+
+    return n;
+}
@@ -0,0 +1,64 @@
+/**
+ * @file arena.h
+ * @brief Arena (region) allocator.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-26
+ */
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+
+
+#include <stddef.h>
+#include <stdint.h>
+#include "tlsf.h"
+
+
+enum {
+    ARENA_CHUNK_SIZE    = 64 * 1024,
+    ARENA_DEFAULT_ALIGN = 16,
+};
+
+
+/* Header at the head of each chunk. */
+struct arena_chunk {
+    struct arena_chunk* next;
+    size_t size; /* Including this header. */
+};
+typedef struct arena_chunk Arena_chunk;
+
+
+struct arena {
+    Arena_chunk* head;    /* The first chunk, reset() returns to here. */
+    Arena_chunk* current; /* Chunks after this are kept for the reuse. */
+    uintptr_t top;        /* The next free address in current. */
+    uintptr_t end;
+    size_t chunk_size;
+    Tlsf_manager* tman; /* Chunks are allocated from this, or mmap() if NULL. */
+};
+typedef struct arena Arena;
+
+
+/* State of an arena, arena_rollback() frees everything allocated after arena_save(). */
+struct arena_savepoint {
+    Arena_chunk* chunk;
+    uintptr_t top;
+};
+typedef struct arena_savepoint Arena_savepoint;
+
+
+extern Arena* arena_init(Arena*, size_t, Tlsf_manager*);
+extern void arena_destruct(Arena*);
+extern void* arena_alloc_align(Arena*, size_t, size_t);
+extern void* arena_alloc(Arena*, size_t);
+extern Arena_savepoint arena_save(Arena const*);
+extern void arena_rollback(Arena*, Arena_savepoint);
+extern void arena_reset(Arena*);
+extern void arena_trim(Arena*);
+extern size_t arena_get_chunk_nr(Arena const*);
+
+
+
+#endif
@@ -0,0 +1,169 @@
+/**
+ * @file bench_aqueue_mpmc.c
+ * @brief Compare a mutex wrapped Aqueue with Aqueue_mpmc under contention.
+ *        gcc -O2 aqueue.c aqueue_mpmc.c bench_aqueue_mpmc.c -lpthread
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-12
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "aqueue.h"
+#include "aqueue_mpmc.h"
+
+
+enum {
+    MAX_THREAD_NR = 32,
+    ITEM_NR       = 1000000,
+    CAPACITY      = 1024,
+    BATCH_SIZE    = 32,
+};
+
+
+typedef struct {
+    Aqueue q;
+    pthread_mutex_t lock;
+} Locked_aqueue;
+
+
+typedef struct {
+    Locked_aqueue* lq;
+    Aqueue_mpmc* mq;
+    size_t batch; /* 1 means try_insert/try_get. */
+} Bench_arg;
+
+
+static double clock_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static bool locked_insert(Locked_aqueue* lq, size_t* v) {
+    pthread_mutex_lock(&lq->lock);
+    bool r = (aqueue_insert(&lq->q, v) != NULL);
+    pthread_mutex_unlock(&lq->lock);
+    return r;
+}
+
+
+static bool locked_get(Locked_aqueue* lq, size_t* v) {
+    bool r = false;
+
+    pthread_mutex_lock(&lq->lock);
+    if (aqueue_is_empty(&lq->q) == false) {
+        *v = aqueue_get(size_t, &lq->q);
+        aqueue_delete_first(&lq->q);
+        r = true;
+    }
+    pthread_mutex_unlock(&lq->lock);
+
+    return r;
+}
+
+
+static void* producer(void* p) {
+    Bench_arg* arg = p;
+    size_t buf[BATCH_SIZE];
+
+    for (size_t i = 0; i < ITEM_NR;) {
+        size_t n;
+        if (arg->lq != NULL) {
+            n = locked_insert(arg->lq, &i) ? 1 : 0;
+        } else if (arg->batch == 1) {
+            n = aqueue_mpmc_try_insert(arg->mq, &i) ? 1 : 0;
+        } else {
+            size_t const m = (ITEM_NR - i < arg->batch) ? ITEM_NR - i : arg->batch;
+            for (size_t j = 0; j < m; j++) {
+                buf[j] = i + j;
+            }
+            n = aqueue_mpmc_try_insert_n(arg->mq, buf, m);
+        }
+
+        if (n == 0) {
+            sched_yield();
+        }
+        i += n;
+    }
+
+    return NULL;
+}
+
+
+static void* consumer(void* p) {
+    Bench_arg* arg = p;
+    size_t buf[BATCH_SIZE];
+
+    for (size_t got = 0; got < ITEM_NR;) {
+        size_t n;
+        if (arg->lq != NULL) {
+            n = locked_get(arg->lq, buf) ? 1 : 0;
+        } else if (arg->batch == 1) {
+            n = aqueue_mpmc_try_get(arg->mq, buf) ? 1 : 0;
+        } else {
+            n = aqueue_mpmc_try_get_n(arg->mq, buf, (ITEM_NR - got < arg->batch) ? ITEM_NR - got : arg->batch);
+        }
+
+        if (n == 0) {
+            sched_yield();
+        }
+        got += n;
+    }
+
+    return NULL;
+}
+
+
+/* pair_nr producers and pair_nr consumers move pair_nr * ITEM_NR items. */
+static double run(Bench_arg* arg, size_t pair_nr) {
+    pthread_t producers[MAX_THREAD_NR], consumers[MAX_THREAD_NR];
+
+    double begin = clock_sec();
+    for (size_t i = 0; i < pair_nr; i++) {
+        pthread_create(&producers[i], NULL, producer, arg);
+        pthread_create(&consumers[i], NULL, consumer, arg);
+    }
+    for (size_t i = 0; i < pair_nr; i++) {
+        pthread_join(producers[i], NULL);
+        pthread_join(consumers[i], NULL);
+    }
+
+    return (double)pair_nr * ITEM_NR / (clock_sec() - begin) / 1e6;
+}
+
+
+int main(int argc, char** argv) {
+    size_t max_pair_nr = (argc < 2) ? 4 : strtoul(argv[1], NULL, 10);
+    if (max_pair_nr == 0 || MAX_THREAD_NR < max_pair_nr) {
+        fprintf(stderr, "pair number must be 1 - %d\n", MAX_THREAD_NR);
+        return EXIT_FAILURE;
+    }
+
+    printf("producer/consumer pairs, mutex Aqueue Mops/s, mpmc Mops/s, mpmc batch(%d) Mops/s\n", BATCH_SIZE);
+    for (size_t n = 1; n <= max_pair_nr; n *= 2) {
+        Locked_aqueue lq;
+        Aqueue_mpmc mq;
+
+        aqueue_init(&lq.q, sizeof(size_t), CAPACITY, NULL);
+        pthread_mutex_init(&lq.lock, NULL);
+        aqueue_mpmc_init(&mq, sizeof(size_t), CAPACITY);
+
+        double locked = run(&(Bench_arg){.lq = &lq, .mq = NULL, .batch = 1}, n);
+        double single = run(&(Bench_arg){.lq = NULL, .mq = &mq, .batch = 1}, n);
+        double batch  = run(&(Bench_arg){.lq = NULL, .mq = &mq, .batch = BATCH_SIZE}, n);
+
+        printf("%zu, %.2f, %.2f, %.2f\n", n, locked, single, batch);
+
+        pthread_mutex_destroy(&lq.lock);
+        aqueue_destruct(&lq.q);
+        aqueue_mpmc_destruct(&mq);
+    }
+
+    return EXIT_SUCCESS;
+}
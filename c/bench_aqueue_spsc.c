@@ -0,0 +1,237 @@
+/**
+ * @file bench_aqueue_spsc.c
+ * @brief Measure Aqueue_spsc with Aqueue_mpmc as the baseline.
+ *        gcc -O2 aqueue_mpmc.c aqueue_spsc.c bench_aqueue_spsc.c -lpthread
+ *        ./a.out
+ *
+ *        ping-pong : one item goes to the other thread and comes back, the result is round trip time.
+ *        throughput: one producer sends ITEM_NR items to one consumer, the result is time per item.
+ *        The spinning sides call sched_yield() when the queue is full or empty, then this also finishes on one core.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-30
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <time.h>
+#include "aqueue_mpmc.h"
+#include "aqueue_spsc.h"
+
+
+enum {
+    PING_PONG_NR = 100000,
+    ITEM_NR      = 10000000,
+    CAPACITY     = 1024,
+    BATCH_SIZE   = 32,
+};
+
+
+typedef enum {
+    QUEUE_MPMC,
+    QUEUE_SPSC,
+    QUEUE_SPSC_BLOCKING,
+} Queue_kind;
+
+
+typedef struct {
+    Queue_kind kind;
+    Aqueue_mpmc mq[2];
+    Aqueue_spsc sq[2];
+    size_t batch; /* 1 means one item operations. */
+} Bench;
+
+
+static double clock_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void put(Bench* b, int i, size_t const* v, size_t n) {
+    switch (b->kind) {
+        case QUEUE_MPMC:
+            while (n != 0) {
+                size_t k = aqueue_mpmc_try_insert_n(&b->mq[i], v, n);
+                if (k == 0) {
+                    sched_yield();
+                }
+                v += k;
+                n -= k;
+            }
+            break;
+        case QUEUE_SPSC:
+            while (n != 0) {
+                size_t k = aqueue_spsc_try_insert_n(&b->sq[i], v, n);
+                if (k == 0) {
+                    sched_yield();
+                }
+                v += k;
+                n -= k;
+            }
+            break;
+        case QUEUE_SPSC_BLOCKING:
+            for (size_t j = 0; j < n; j++) {
+                aqueue_spsc_insert(&b->sq[i], &v[j]);
+            }
+            break;
+    }
+}
+
+
+static size_t take(Bench* b, int i, size_t* v, size_t n) {
+    switch (b->kind) {
+        case QUEUE_MPMC:
+            return aqueue_mpmc_try_get_n(&b->mq[i], v, n);
+        case QUEUE_SPSC:
+            return aqueue_spsc_try_get_n(&b->sq[i], v, n);
+        case QUEUE_SPSC_BLOCKING:
+            aqueue_spsc_get(&b->sq[i], v);
+            return 1;
+    }
+
+    return 0;
+}
+
+
+static void* pong(void* arg) {
+    Bench* b = arg;
+    size_t v;
+
+    for (size_t i = 0; i < PING_PONG_NR; i++) {
+        while (take(b, 0, &v, 1) == 0) {
+            sched_yield();
+        }
+        v++;
+        put(b, 1, &v, 1);
+    }
+
+    return NULL;
+}
+
+
+static void* producer(void* arg) {
+    Bench* b = arg;
+    size_t buf[BATCH_SIZE];
+
+    for (size_t i = 0; i < ITEM_NR; i += b->batch) {
+        for (size_t j = 0; j < b->batch; j++) {
+            buf[j] = i + j;
+        }
+        put(b, 0, buf, b->batch);
+    }
+
+    return NULL;
+}
+
+
+static void init(Bench* b, Queue_kind kind, size_t batch) {
+    b->kind  = kind;
+    b->batch = batch;
+    for (int i = 0; i < 2; i++) {
+        switch (kind) {
+            case QUEUE_MPMC:
+                aqueue_mpmc_init(&b->mq[i], sizeof(size_t), CAPACITY);
+                break;
+            case QUEUE_SPSC:
+                aqueue_spsc_init(&b->sq[i], sizeof(size_t), CAPACITY);
+                break;
+            case QUEUE_SPSC_BLOCKING:
+                aqueue_spsc_init_blocking(&b->sq[i], sizeof(size_t), CAPACITY);
+                break;
+        }
+    }
+}
+
+
+static void destruct(Bench* b) {
+    for (int i = 0; i < 2; i++) {
+        if (b->kind == QUEUE_MPMC) {
+            aqueue_mpmc_destruct(&b->mq[i]);
+        } else {
+            aqueue_spsc_destruct(&b->sq[i]);
+        }
+    }
+}
+
+
+static char const* kind_name(Queue_kind kind) {
+    static char const* const names[] = {"mpmc", "spsc", "spsc_blocking"};
+    return names[kind];
+}
+
+
+static bool bench_ping_pong(Queue_kind kind) {
+    static Bench b;
+    pthread_t t;
+    size_t v = 0;
+
+    init(&b, kind, 1);
+    pthread_create(&t, NULL, pong, &b);
+
+    double t1 = clock_sec();
+    for (size_t i = 0; i < PING_PONG_NR; i++) {
+        put(&b, 0, &v, 1);
+        while (take(&b, 1, &v, 1) == 0) {
+            sched_yield();
+        }
+    }
+    double t2 = clock_sec();
+
+    pthread_join(t, NULL);
+    destruct(&b);
+    printf("%-13s, ping-pong ,    1, %10.1f\n", kind_name(kind), (t2 - t1) * 1e9 / PING_PONG_NR);
+
+    return v == PING_PONG_NR;
+}
+
+
+static bool bench_throughput(Queue_kind kind, size_t batch) {
+    static Bench b;
+    pthread_t t;
+    size_t buf[BATCH_SIZE];
+    size_t expected = 0;
+    bool is_ordered = true;
+
+    init(&b, kind, batch);
+
+    double t1 = clock_sec();
+    pthread_create(&t, NULL, producer, &b);
+    while (expected < ITEM_NR) {
+        size_t n = take(&b, 0, buf, batch);
+        if (n == 0) {
+            sched_yield();
+        }
+        for (size_t i = 0; i < n; i++) {
+            is_ordered &= (buf[i] == expected++);
+        }
+    }
+    pthread_join(t, NULL);
+    double t2 = clock_sec();
+
+    destruct(&b);
+    printf("%-13s, throughput, %4zu, %10.2f\n", kind_name(kind), batch, (t2 - t1) * 1e9 / ITEM_NR);
+
+    return is_ordered;
+}
+
+
+int main(void) {
+    bool is_ok = true;
+
+    printf("queue        , test      , batch, ns\n");
+    for (Queue_kind k = QUEUE_MPMC; k <= QUEUE_SPSC_BLOCKING; k++) {
+        is_ok &= bench_ping_pong(k);
+    }
+    for (Queue_kind k = QUEUE_MPMC; k <= QUEUE_SPSC_BLOCKING; k++) {
+        is_ok &= bench_throughput(k, 1);
+        if (k != QUEUE_SPSC_BLOCKING) {
+            is_ok &= bench_throughput(k, BATCH_SIZE);
+        }
+    }
+
+    return (is_ok == true) ? 0 : 1;
+}
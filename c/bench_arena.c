@@ -0,0 +1,102 @@
+/**
+ * @file bench_arena.c
+ * @brief Compare the arena with tlsf_malloc()/tlsf_free() and malloc()/free() for per-request scratch memory.
+ *        gcc -O2 -DTLSF_LIBRARY tlsf.c arena.c bench_arena.c -lpthread
+ *        ./a.out
+ *
+ *        A request allocates OBJECT_NR objects of 8 - 512 bytes, then all of them are freed at the end of the request.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-26
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "arena.h"
+#include "tlsf.h"
+
+
+enum {
+    REQUEST_NR      = 20000,
+    OBJECT_NR       = 200,
+    MAX_OBJECT_SIZE = 512,
+    POOL_SIZE       = 16 * 1024 * 1024,
+};
+
+
+static double clock_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static inline size_t next_size(uint32_t* x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return 8 + *x % (MAX_OBJECT_SIZE - 8);
+}
+
+
+static void print_result(char const* name, double sec) {
+    printf("%-6s, %11.1f, %13.2f\n", name, sec * 1e9 / REQUEST_NR, sec * 1e9 / ((double)REQUEST_NR * OBJECT_NR));
+}
+
+
+int main(void) {
+    static void* objs[OBJECT_NR];
+    Tlsf_manager tman;
+    Arena arena;
+    uint32_t x;
+
+    tlsf_init(&tman);
+    tlsf_supply_memory(&tman, POOL_SIZE);
+    arena_init(&arena, 0, &tman);
+
+    printf("kind  , ns/request, ns/allocation\n");
+
+    x         = 2463534242U;
+    double t1 = clock_sec();
+    for (size_t r = 0; r < REQUEST_NR; r++) {
+        for (size_t i = 0; i < OBJECT_NR; i++) {
+            objs[i]                     = malloc(next_size(&x));
+            *(uint8_t volatile*)objs[i] = 1;
+        }
+        for (size_t i = 0; i < OBJECT_NR; i++) {
+            free(objs[i]);
+        }
+    }
+    print_result("malloc", clock_sec() - t1);
+
+    x  = 2463534242U;
+    t1 = clock_sec();
+    for (size_t r = 0; r < REQUEST_NR; r++) {
+        for (size_t i = 0; i < OBJECT_NR; i++) {
+            objs[i]                     = tlsf_malloc(&tman, next_size(&x));
+            *(uint8_t volatile*)objs[i] = 1;
+        }
+        for (size_t i = 0; i < OBJECT_NR; i++) {
+            tlsf_free(&tman, objs[i]);
+        }
+    }
+    print_result("tlsf", clock_sec() - t1);
+
+    x  = 2463534242U;
+    t1 = clock_sec();
+    for (size_t r = 0; r < REQUEST_NR; r++) {
+        for (size_t i = 0; i < OBJECT_NR; i++) {
+            objs[i]                     = arena_alloc(&arena, next_size(&x));
+            *(uint8_t volatile*)objs[i] = 1;
+        }
+        arena_reset(&arena);
+    }
+    print_result("arena", clock_sec() - t1);
+
+    arena_destruct(&arena);
+    tlsf_destruct(&tman);
+
+    return 0;
+}
@@ -0,0 +1,229 @@
+/**
+ * @file bench_buddy_system.c
+ * @brief Allocation rate of Buddy_manager with a large number of frames.
+ *        And order 0/1 churn of a mutex wrapped Buddy_manager and the per-CPU caches by threads.
+ *        gcc -O2 -DBUDDY_SYSTEM_LIBRARY buddy_system.c bench_buddy_system.c -lpthread
+ *        ./a.out [the number of frame] [max thread number]
+ * @author mopp
+ * @version 0.1
+ * @date 2014-09-23
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "buddy_system.h"
+
+
+enum {
+    DEFAULT_FRAME_NR = 1 << 20, /* 4 GB */
+    CHURN_LOOP_NR    = 10000000,
+    MAX_CHURN_ORDER  = 3,
+    MAX_THREAD_NR    = 64,
+    MT_LOOP_NR       = 1000000,
+    MT_LIVE_NR       = 256,
+};
+
+
+struct worker_arg {
+    Buddy_pcp_manager* pman;
+    pthread_mutex_t* lock; /* If this is not NULL, use the locked shared manager. */
+    unsigned int seed;
+};
+typedef struct worker_arg Worker_arg;
+
+
+static double clock_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static inline uint32_t xorshift(uint32_t* s) {
+    uint32_t x = *s;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *s = x;
+}
+
+
+static void report(char const* name, size_t op_nr, double sec) {
+    printf("%-28s: %10zu ops, %8.3f sec, %8.2f Mops/sec, %6.1f ns/op\n", name, op_nr, sec, op_nr / sec * 1e-6, sec * 1e9 / op_nr);
+}
+
+
+/* Take all frames one by one, then return them in the random order. */
+static void bench_fill_order0(Buddy_manager* bman, Frame** frames, size_t frame_nr) {
+    double t1 = clock_sec();
+    for (size_t i = 0; i < frame_nr; i++) {
+        frames[i] = buddy_alloc_frames(bman, 0);
+    }
+    double t2 = clock_sec();
+    report("alloc order 0 until empty", frame_nr, t2 - t1);
+
+    uint32_t seed = 2463534242U;
+    for (size_t i = frame_nr - 1; 0 < i; i--) {
+        size_t j = xorshift(&seed) % (i + 1);
+        Frame* t  = frames[i];
+        frames[i] = frames[j];
+        frames[j] = t;
+    }
+
+    t1 = clock_sec();
+    for (size_t i = 0; i < frame_nr; i++) {
+        buddy_free_frames(bman, frames[i]);
+    }
+    t2 = clock_sec();
+    report("free order 0 in random order", frame_nr, t2 - t1);
+}
+
+
+/* Keep half of frames allocated and replace a random one with a random order. */
+static void bench_churn(Buddy_manager* bman, Frame** frames, size_t frame_nr) {
+    size_t const live_nr = frame_nr / 2 / BUDDY_SYSTEM_ORDER_NR(MAX_CHURN_ORDER);
+    uint32_t seed        = 88675123U;
+
+    for (size_t i = 0; i < live_nr; i++) {
+        frames[i] = buddy_alloc_frames(bman, xorshift(&seed) % (MAX_CHURN_ORDER + 1));
+    }
+
+    double t1 = clock_sec();
+    for (size_t i = 0; i < CHURN_LOOP_NR; i++) {
+        size_t j = xorshift(&seed) % live_nr;
+        buddy_free_frames(bman, frames[j]);
+        frames[j] = buddy_alloc_frames(bman, xorshift(&seed) % (MAX_CHURN_ORDER + 1));
+    }
+    double t2 = clock_sec();
+    report("random churn order 0-3", CHURN_LOOP_NR * 2, t2 - t1);
+
+    for (size_t i = 0; i < live_nr; i++) {
+        buddy_free_frames(bman, frames[i]);
+    }
+}
+
+
+static inline Frame* worker_alloc(Worker_arg* a, uint8_t order) {
+    if (a->lock == NULL) {
+        return buddy_pcp_alloc_frames(a->pman, order, false);
+    }
+
+    pthread_mutex_lock(a->lock);
+    Frame* f = buddy_alloc_frames(&a->pman->bman, order);
+    pthread_mutex_unlock(a->lock);
+    return f;
+}
+
+
+static inline void worker_free(Worker_arg* a, Frame* f) {
+    if (a->lock == NULL) {
+        buddy_pcp_free_frames(a->pman, f, false);
+        return;
+    }
+
+    pthread_mutex_lock(a->lock);
+    buddy_free_frames(&a->pman->bman, f);
+    pthread_mutex_unlock(a->lock);
+}
+
+
+static void* worker(void* arg) {
+    Worker_arg* a = arg;
+    Frame* frames[MT_LIVE_NR] = {NULL};
+    uint32_t seed = a->seed;
+
+    for (size_t i = 0; i < MT_LOOP_NR; i++) {
+        size_t idx = xorshift(&seed) % MT_LIVE_NR;
+        if (frames[idx] != NULL) {
+            worker_free(a, frames[idx]);
+        }
+        frames[idx] = worker_alloc(a, xorshift(&seed) & 1);
+    }
+
+    for (size_t i = 0; i < MT_LIVE_NR; i++) {
+        if (frames[i] != NULL) {
+            worker_free(a, frames[i]);
+        }
+    }
+
+    return NULL;
+}
+
+
+static double run_workers(Buddy_pcp_manager* pman, pthread_mutex_t* lock, size_t thread_nr) {
+    pthread_t threads[MAX_THREAD_NR];
+    Worker_arg args[MAX_THREAD_NR];
+
+    double t1 = clock_sec();
+    for (size_t i = 0; i < thread_nr; i++) {
+        args[i] = (Worker_arg){pman, lock, 2463534242U + (unsigned int)i * 7919U};
+        pthread_create(&threads[i], NULL, worker, &args[i]);
+    }
+    for (size_t i = 0; i < thread_nr; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    return clock_sec() - t1;
+}
+
+
+static void bench_pcp(size_t frame_nr, size_t max_thread_nr) {
+    Buddy_pcp_manager pman;
+    pthread_mutex_t lock;
+
+    if (buddy_pcp_init(&pman, FRAME_SIZE * frame_nr) == NULL) {
+        fprintf(stderr, "cannot initialize per-CPU caches\n");
+        return;
+    }
+    pthread_mutex_init(&lock, NULL);
+
+    printf("threads, locked Mops/sec, per-CPU Mops/sec\n");
+    for (size_t n = 1; n <= max_thread_nr; n *= 2) {
+        double locked = run_workers(&pman, &lock, n);
+        double pcp    = run_workers(&pman, NULL, n);
+        double ops    = (double)n * MT_LOOP_NR * 2;
+        printf("%7zu, %17.2f, %17.2f\n", n, ops / locked * 1e-6, ops / pcp * 1e-6);
+        buddy_pcp_drain_all(&pman);
+    }
+
+    pthread_mutex_destroy(&lock);
+    buddy_pcp_destruct(&pman);
+}
+
+
+int main(int argc, char** argv) {
+    size_t frame_nr = (argc < 2) ? DEFAULT_FRAME_NR : strtoul(argv[1], NULL, 10);
+    size_t thread_nr = (argc < 3) ? 8 : strtoul(argv[2], NULL, 10);
+    thread_nr = (thread_nr == 0 || MAX_THREAD_NR < thread_nr) ? MAX_THREAD_NR : thread_nr;
+    Buddy_manager bman;
+
+    if (frame_nr == 0 || buddy_init(&bman, FRAME_SIZE * frame_nr) == NULL) {
+        fprintf(stderr, "cannot initialize buddy system\n");
+        return EXIT_FAILURE;
+    }
+
+    Frame** frames = malloc(sizeof(Frame*) * frame_nr);
+    if (frames == NULL) {
+        fprintf(stderr, "cannot allocate frame table\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%zu frames (%zu MB)\n", frame_nr, buddy_get_total_memory_size(&bman) >> 20);
+    bench_fill_order0(&bman, frames, frame_nr);
+    bench_churn(&bman, frames, frame_nr);
+
+    int r = (buddy_get_free_memory_size(&bman) == buddy_get_total_memory_size(&bman)) ? EXIT_SUCCESS : EXIT_FAILURE;
+    if (r != EXIT_SUCCESS) {
+        fprintf(stderr, "frames are leaked\n");
+    }
+
+    free(frames);
+    buddy_destruct(&bman);
+
+    bench_pcp(frame_nr, thread_nr);
+
+    return r;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file bench_dlist_search.c
+ * @brief Compare dlist_search_node() with and without the hash index.
+ *        gcc -O2 dlist.c bench_dlist_search.c
+ *        ./a.out
+ *
+ *        The lists have int64_t 0 .. n-1, and random keys are searched.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-28
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include "dlist.h"
+
+
+enum {
+    MIN_ELEMENT_NR_LOG10 = 3,
+    MAX_ELEMENT_NR_LOG10 = 6,
+    LINEAR_TOUCHED_NR    = 100000000, /* Linear search visits this number of nodes at least. */
+    INDEXED_SEARCH_NR    = 1000000,
+};
+
+
+static double clock_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static inline int64_t next_key(uint32_t* x, size_t n) {
+    *x ^= *x << 13;
+    *x ^= *x >> 17;
+    *x ^= *x << 5;
+    return (int64_t)(*x % n);
+}
+
+
+static size_t bench(size_t n, bool is_indexed) {
+    Dlist l;
+    uint32_t x   = 2463534242U;
+    size_t found = 0;
+
+    dlist_init(&l, sizeof(int64_t), NULL);
+    if (is_indexed == true) {
+        dlist_enable_index(&l, NULL, NULL);
+    }
+
+    double t1 = clock_sec();
+    for (int64_t i = 0; i < (int64_t)n; i++) {
+        dlist_insert_data_last(&l, &i);
+    }
+    double t2 = clock_sec();
+
+    size_t const search_nr = (is_indexed == true) ? INDEXED_SEARCH_NR : LINEAR_TOUCHED_NR / n + 1;
+    for (size_t i = 0; i < search_nr; i++) {
+        int64_t key = next_key(&x, n);
+        found += (dlist_search_node(&l, &key) != NULL);
+    }
+    double t3 = clock_sec();
+
+    printf("%-7s, %8zu, %9.1f, %12.1f\n", (is_indexed == true) ? "indexed" : "linear", n, (t2 - t1) * 1e9 / n, (t3 - t2) * 1e9 / search_nr);
+    dlist_destruct(&l);
+
+    return found;
+}
+
+
+int main(void) {
+    size_t found = 0;
+
+    printf("search , elements, insert ns, search ns\n");
+
+    size_t n = 1;
+    for (int i = 0; i < MIN_ELEMENT_NR_LOG10; i++) {
+        n *= 10;
+    }
+
+    for (int i = MIN_ELEMENT_NR_LOG10; i <= MAX_ELEMENT_NR_LOG10; i++, n *= 10) {
+        found += bench(n, false);
+        found += bench(n, true);
+    }
+
+    return (found == 0);
+}
@@ -0,0 +1,109 @@
+/**
+ * @file bench_fit_allocators.c
+ * @brief Compare fragmentation of first-fit, next-fit, best-fit and worst-fit.
+ *        gcc -O2 -DFIT_ALLOCATORS_LIBRARY fit_allocators.c bench_fit_allocators.c
+ *        ./a.out
+ *
+ *        Every policy replays the same random sequence of allocations and frees.
+ *        The object sizes are log-uniform, so there are many small objects and a few large ones.
+ *        fragmentation is 1 - (largest free run) / (free size), it is sampled after each failed allocation.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-24
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "fit_allocators.h"
+
+
+enum {
+    HEAP_SIZE       = 24 * 1024 * 1024,
+    UNIT_SIZE       = 16,
+    SLOT_NR         = 16384,
+    OP_NR           = 4000000,
+    MIN_SIZE_LOG2   = 4,
+    MAX_SIZE_LOG2   = 14,
+};
+
+
+static double clock_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static inline uint32_t xorshift(uint32_t* s) {
+    uint32_t x = *s;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *s = x;
+}
+
+
+static size_t random_size(uint32_t* s) {
+    uint32_t const log2 = MIN_SIZE_LOG2 + xorshift(s) % (MAX_SIZE_LOG2 - MIN_SIZE_LOG2);
+    return ((size_t)1 << log2) + xorshift(s) % ((size_t)1 << log2);
+}
+
+
+static void bench(Fit_policy policy) {
+    static void* objs[SLOT_NR];
+    Fit_allocator* fa = fit_allocator_create(policy, HEAP_SIZE, UNIT_SIZE);
+    uint32_t seed     = 2463534242U;
+    size_t failed_nr  = 0;
+    size_t live_size  = 0;
+    size_t peak_live  = 0;
+    double frag_sum   = 0;
+
+    double t1 = clock_sec();
+    for (size_t n = 0; n < OP_NR; n++) {
+        uint32_t const i = xorshift(&seed) % SLOT_NR;
+        size_t const size = random_size(&seed);
+
+        if (objs[i] != NULL) {
+            live_size -= fit_usable_size(fa, objs[i]);
+            fit_free(fa, objs[i]);
+            objs[i] = NULL;
+            continue;
+        }
+
+        objs[i] = fit_alloc(fa, size);
+        if (objs[i] == NULL) {
+            failed_nr++;
+            frag_sum += 1.0 - (double)fit_largest_free_size(fa) / fit_free_size(fa);
+            continue;
+        }
+        live_size += fit_usable_size(fa, objs[i]);
+        peak_live = (peak_live < live_size) ? live_size : peak_live;
+    }
+    double t2 = clock_sec();
+
+    printf("%8s, %9.1f, %9zu, %13.3f, %9zu, %13.1f\n",
+           fit_policy_name(policy),
+           (t2 - t1) * 1e9 / OP_NR,
+           failed_nr,
+           (failed_nr == 0) ? 0.0 : frag_sum / failed_nr,
+           fit_free_run_nr(fa),
+           peak_live / (1024.0 * 1024.0));
+
+    for (size_t i = 0; i < SLOT_NR; i++) {
+        fit_free(fa, objs[i]);
+        objs[i] = NULL;
+    }
+    fit_allocator_destroy(fa);
+}
+
+
+int main(void) {
+    printf("  policy, ns per op, failed nr, fragmentation, free runs, peak live MiB\n");
+    for (Fit_policy p = FIT_FIRST; p < FIT_POLICY_NR; p++) {
+        bench(p);
+    }
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file bench_malloc.c
+ * @brief Throughput and RSS of the process malloc().
+ *        gcc -O2 bench_malloc.c -lpthread
+ *        ./a.out [thread number]
+ *        LD_PRELOAD=./libtlsf_malloc.so ./a.out [thread number]
+ *
+ *        Each thread keeps LIVE_OBJECT_NR objects and replaces a random one.
+ *        Then the most of objects are freed, and RSS shows how much memory is given back.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-22
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+enum {
+    MAX_THREAD_NR   = 64,
+    LOOP_NR         = 2000000,
+    LIVE_OBJECT_NR  = 4096,
+    MAX_OBJECT_SIZE = 4096,
+    LARGE_RATIO     = 64, /* One of LARGE_RATIO objects is large. */
+    LARGE_SIZE      = 256 * 1024,
+    KEEP_RATIO      = 16, /* One of KEEP_RATIO objects is kept at the end. */
+};
+
+
+struct worker_arg {
+    unsigned int seed;
+    void** objs;
+};
+typedef struct worker_arg Worker_arg;
+
+
+static double clock_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static size_t read_status_kb(char const* key) {
+    FILE* fp = fopen("/proc/self/status", "r");
+    char line[256];
+    size_t v = 0;
+    size_t const key_len = strlen(key);
+
+    while (fp != NULL && fgets(line, sizeof(line), fp) != NULL) {
+        if (strncmp(line, key, key_len) == 0) {
+            v = strtoul(line + key_len, NULL, 10);
+            break;
+        }
+    }
+    if (fp != NULL) {
+        fclose(fp);
+    }
+
+    return v;
+}
+
+
+static void* worker(void* p) {
+    Worker_arg* arg = p;
+    void** objs     = arg->objs;
+
+    for (size_t i = 0; i < LOOP_NR; i++) {
+        size_t idx  = (size_t)rand_r(&arg->seed) % LIVE_OBJECT_NR;
+        size_t r    = (size_t)rand_r(&arg->seed);
+        size_t size = (r % LARGE_RATIO == 0) ? LARGE_SIZE : r % MAX_OBJECT_SIZE + 1u;
+
+        free(objs[idx]);
+        objs[idx] = malloc(size);
+        ((uint8_t volatile*)objs[idx])[0]        = 1;
+        ((uint8_t volatile*)objs[idx])[size - 1] = 1;
+    }
+
+    /* Keep a few objects scattered in the heap. */
+    for (size_t i = 0; i < LIVE_OBJECT_NR; i++) {
+        if (i % KEEP_RATIO != 0) {
+            free(objs[i]);
+            objs[i] = NULL;
+        }
+    }
+
+    return NULL;
+}
+
+
+int main(int argc, char** argv) {
+    size_t thread_nr = (argc < 2) ? 4 : strtoul(argv[1], NULL, 10);
+    thread_nr        = (thread_nr == 0 || MAX_THREAD_NR < thread_nr) ? MAX_THREAD_NR : thread_nr;
+    pthread_t threads[MAX_THREAD_NR];
+    Worker_arg args[MAX_THREAD_NR];
+
+    double t1 = clock_sec();
+    for (size_t i = 0; i < thread_nr; i++) {
+        args[i] = (Worker_arg){2463534242U + (unsigned int)i * 7919U, calloc(LIVE_OBJECT_NR, sizeof(void*))};
+        pthread_create(&threads[i], NULL, worker, &args[i]);
+    }
+    for (size_t i = 0; i < thread_nr; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double t2 = clock_sec();
+
+    double const op_nr = (double)thread_nr * LOOP_NR * 2;
+    printf("threads, Mops/sec, peak RSS MiB, RSS after free MiB\n");
+    printf("%7zu, %8.2f, %12.1f, %18.1f\n", thread_nr, op_nr / (t2 - t1) * 1e-6, read_status_kb("VmHWM:") / 1024.0, read_status_kb("VmRSS:") / 1024.0);
+
+    for (size_t i = 0; i < thread_nr; i++) {
+        for (size_t j = 0; j < LIVE_OBJECT_NR; j++) {
+            free(args[i].objs[j]);
+        }
+        free(args[i].objs);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,345 @@
+/**
+ * @file bench_mem.c
+ * @brief Size sweep benchmark for memcpy and memset families.
+ *        gcc -O2 -fno-tree-loop-distribute-patterns memcpy.c memset.c cpu_features.c bench_mem.c -o bench_mem
+ *        (without the option, gcc turns the byte loops of the experiments into memcpy/memset calls.)
+ *        ./bench_mem [memcpy|memset|all] [max size in byte] > result.csv
+ *
+ *        Each case is run once as warmup, then repeated SAMPLE_NR times.
+ *        One sample calls the function enough times to take at least SAMPLE_BYTES,
+ *        and the median and 99th percentile of the samples are reported.
+ *        Cycles are TSC ticks, so they are reference cycles, not core cycles.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-22
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <x86intrin.h>
+#include "cpu_features.h"
+#include "macro.h"
+#include "memcpy.h"
+#include "memset.h"
+
+
+enum {
+    SAMPLE_NR          = 31,
+    LARGE_SAMPLE_NR    = 7, /* for sizes above LARGE_SIZE, they take long. */
+    LARGE_SIZE         = 16 << 20,
+    SAMPLE_BYTES       = 1 << 20,
+    MAX_ALIGN_OFFSET   = 64,
+    DEFAULT_MAX_SIZE   = 256 << 20,
+};
+
+
+typedef struct {
+    char const* name;
+    memcpy_f f;
+    bool (*is_available)(void);
+} Memcpy_entry;
+
+
+typedef struct {
+    char const* name;
+    memset_f f;
+    bool (*is_available)(void);
+} Memset_entry;
+
+
+typedef struct {
+    size_t dst;
+    size_t src;
+} Align_offset;
+
+
+typedef struct {
+    double ns;
+    double cycles;
+} Sample;
+
+
+static bool always(void) {
+    return true;
+}
+
+
+static bool has_avx2(void) {
+    return cpu_features_get()->avx2;
+}
+
+
+static bool has_avx512(void) {
+    return cpu_features_get()->avx512f;
+}
+
+
+/* Call glibc through pointers so that the compiler does not replace them with builtins. */
+static void* (*volatile glibc_memcpy)(void*, void const*, size_t) = memcpy;
+static void* (*volatile glibc_memset)(void*, int, size_t)         = memset;
+
+
+static void* call_glibc_memcpy(void* restrict d, void const* restrict s, size_t n) {
+    return glibc_memcpy(d, s, n);
+}
+
+
+static void* call_glibc_memset(void* s, int c, size_t n) {
+    return glibc_memset(s, c, n);
+}
+
+
+/* memset_zero ignores the byte, so the bench fills zero for it. */
+static void* call_memset_zero(void* s, int c, size_t n) {
+    (void)c;
+    return memset_zero(s, n);
+}
+
+
+static Memcpy_entry const memcpy_entries[] = {
+    {"memcpy0", memcpy0, always},
+    {"memcpy1", memcpy1, always},
+    {"memcpy2", memcpy2, always},
+    {"memcpy3", memcpy3, always},
+    {"memcpy_erms", memcpy_erms, always},
+    {"memcpy_sse2", memcpy_sse2, always},
+    {"memcpy_avx2", memcpy_avx2, has_avx2},
+    {"memcpy_avx512", memcpy_avx512, has_avx512},
+    {"memcpy_fast", memcpy_fast, always},
+    {"glibc", call_glibc_memcpy, always},
+};
+
+
+static Memset_entry const memset_entries[] = {
+    {"memset0", memset0, always},
+    {"memset1", memset1, always},
+    {"memset2", memset2, always},
+    {"memset3", memset3, always},
+    {"memset4", memset4, always},
+    {"memset_erms", memset_erms, always},
+    {"memset_sse2", memset_sse2, always},
+    {"memset_avx2", memset_avx2, has_avx2},
+    {"memset_avx512", memset_avx512, has_avx512},
+    {"memset_fast", memset_fast, always},
+    {"memset_zero", call_memset_zero, always},
+    {"glibc", call_glibc_memset, always},
+};
+
+
+static Align_offset const align_offsets[] = {
+    {0, 0},
+    {1, 1},
+    {3, 7},
+    {32, 0},
+};
+
+
+static inline double clock_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+
+static inline uint64_t read_tsc(void) {
+    _mm_lfence();
+    uint64_t t = __rdtsc();
+    _mm_lfence();
+    return t;
+}
+
+
+static int compare_double(void const* a, void const* b) {
+    double x = *(double const*)a;
+    double y = *(double const*)b;
+    return (x < y) ? -1 : (y < x) ? 1 : 0;
+}
+
+
+/* Nearest rank percentile, samples are sorted. */
+static double percentile(double* samples, size_t n, double p) {
+    qsort(samples, n, sizeof(double), compare_double);
+    size_t idx = (size_t)(p * (double)n + 0.999999);
+    idx = (idx == 0) ? 0 : idx - 1;
+    return samples[(n <= idx) ? n - 1 : idx];
+}
+
+
+static void print_header(void) {
+    printf("op,func,size,dst_offset,src_offset,calls_per_sample,median_ns,p99_ns,median_gbps,p99_gbps,median_cpb,p99_cpb\n");
+}
+
+
+static void print_result(char const* op, char const* name, size_t size, Align_offset const* a, size_t calls, Sample const* samples, size_t sample_nr) {
+    double ns[SAMPLE_NR], cycles[SAMPLE_NR];
+
+    for (size_t i = 0; i < sample_nr; i++) {
+        ns[i]     = samples[i].ns;
+        cycles[i] = samples[i].cycles;
+    }
+
+    /* p99 is the slow side, so it is the higher time and the lower bandwidth. */
+    double const median_ns = percentile(ns, sample_nr, 0.5);
+    double const p99_ns    = percentile(ns, sample_nr, 0.99);
+    double const median_cy = percentile(cycles, sample_nr, 0.5);
+    double const p99_cy    = percentile(cycles, sample_nr, 0.99);
+    double const s         = (double)size;
+
+    printf("%s,%s,%zu,%zu,%zu,%zu,%.2f,%.2f,%.3f,%.3f,%.4f,%.4f\n",
+            op, name, size, a->dst, a->src, calls,
+            median_ns, p99_ns,
+            s / median_ns, s / p99_ns,
+            median_cy / s, p99_cy / s);
+}
+
+
+static size_t get_calls_per_sample(size_t size) {
+    return (SAMPLE_BYTES <= size) ? 1 : SAMPLE_BYTES / size;
+}
+
+
+static size_t get_sample_nr(size_t size) {
+    return (LARGE_SIZE < size) ? LARGE_SAMPLE_NR : SAMPLE_NR;
+}
+
+
+static bool bench_memcpy(Memcpy_entry const* e, uint8_t* dst, uint8_t* src, size_t size, Align_offset const* a) {
+    uint8_t* d = dst + a->dst;
+    uint8_t* s = src + a->src;
+    size_t const calls     = get_calls_per_sample(size);
+    size_t const sample_nr = get_sample_nr(size);
+    Sample samples[SAMPLE_NR];
+
+    /* Warmup and validation. */
+    memset(d, 0, size);
+    e->f(d, s, size);
+    if (memcmp(d, s, size) != 0) {
+        fprintf(stderr, "%s: validation failed at size %zu\n", e->name, size);
+        return false;
+    }
+
+    for (size_t i = 0; i < sample_nr; i++) {
+        double t1   = clock_ns();
+        uint64_t c1 = read_tsc();
+        for (size_t j = 0; j < calls; j++) {
+            e->f(d, s, size);
+        }
+        uint64_t c2 = read_tsc();
+        double t2   = clock_ns();
+
+        samples[i].ns     = (t2 - t1) / (double)calls;
+        samples[i].cycles = (double)(c2 - c1) / (double)calls;
+    }
+
+    print_result("memcpy", e->name, size, a, calls, samples, sample_nr);
+
+    return true;
+}
+
+
+static bool bench_memset(Memset_entry const* e, uint8_t* dst, size_t size, Align_offset const* a) {
+    uint8_t* d = dst + a->dst;
+    size_t const calls     = get_calls_per_sample(size);
+    size_t const sample_nr = get_sample_nr(size);
+    Sample samples[SAMPLE_NR];
+
+    /* Warmup and validation. */
+    int const c = (e->f == call_memset_zero) ? 0 : 0x5a;
+    memset(d, 0xff, size);
+    e->f(d, c, size);
+    for (size_t i = 0; i < size; i++) {
+        if (d[i] != c) {
+            fprintf(stderr, "%s: validation failed at size %zu\n", e->name, size);
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < sample_nr; i++) {
+        double t1   = clock_ns();
+        uint64_t c1 = read_tsc();
+        for (size_t j = 0; j < calls; j++) {
+            e->f(d, (int)(j & 0xff), size);
+        }
+        uint64_t c2 = read_tsc();
+        double t2   = clock_ns();
+
+        samples[i].ns     = (t2 - t1) / (double)calls;
+        samples[i].cycles = (double)(c2 - c1) / (double)calls;
+    }
+
+    print_result("memset", e->name, size, a, calls, samples, sample_nr);
+
+    return true;
+}
+
+
+/*
+ * Sizes are powers of 2 and the middle points between them.
+ * 1, 2, 3, 4, 6, 8, 12, 16, ...
+ */
+static size_t next_size(size_t size) {
+    if (size < 2) {
+        return size + 1;
+    }
+
+    bool is_power_of_2 = (size & (size - 1)) == 0;
+    return is_power_of_2 ? size + size / 2 : (size / 3) * 4;
+}
+
+
+int main(int argc, char** argv) {
+    char const* target = (argc < 2) ? "all" : argv[1];
+    size_t max_size    = (argc < 3) ? DEFAULT_MAX_SIZE : strtoul(argv[2], NULL, 10);
+    bool do_memcpy     = (strcmp(target, "all") == 0) || (strcmp(target, "memcpy") == 0);
+    bool do_memset     = (strcmp(target, "all") == 0) || (strcmp(target, "memset") == 0);
+
+    if ((do_memcpy == false && do_memset == false) || max_size == 0) {
+        fprintf(stderr, "usage: %s [memcpy|memset|all] [max size in byte]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    uint8_t* dst = malloc(max_size + MAX_ALIGN_OFFSET);
+    uint8_t* src = malloc(max_size + MAX_ALIGN_OFFSET);
+    if (dst == NULL || src == NULL) {
+        fprintf(stderr, "cannot allocate buffers\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Touch all pages before measurement. */
+    for (size_t i = 0; i < max_size + MAX_ALIGN_OFFSET; i++) {
+        src[i] = (uint8_t)(i * 131 + 17);
+    }
+    memset(dst, 0, max_size + MAX_ALIGN_OFFSET);
+
+    fprintf(stderr, "memcpy_fast: %s, memset_fast: %s, LLC: %zu KB\n", memcpy_fast_name(), memset_fast_name(), cpu_features_get()->llc_size >> 10);
+    print_header();
+
+    bool is_ok = true;
+    for (size_t size = 1; size <= max_size; size = next_size(size)) {
+        fprintf(stderr, "size %zu\n", size);
+        for (size_t i = 0; i < ARRAY_SIZE_OF(align_offsets); i++) {
+            Align_offset const* a = &align_offsets[i];
+
+            for (size_t j = 0; do_memcpy && j < ARRAY_SIZE_OF(memcpy_entries); j++) {
+                if (memcpy_entries[j].is_available() == true) {
+                    is_ok &= bench_memcpy(&memcpy_entries[j], dst, src, size, a);
+                }
+            }
+
+            for (size_t j = 0; do_memset && j < ARRAY_SIZE_OF(memset_entries); j++) {
+                if (memset_entries[j].is_available() == true) {
+                    is_ok &= bench_memset(&memset_entries[j], dst, size, a);
+                }
+            }
+        }
+    }
+
+    free(dst);
+    free(src);
+
+    return is_ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
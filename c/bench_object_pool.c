@@ -0,0 +1,138 @@
+/**
+ * @file bench_object_pool.c
+ * @brief Compare the object pool with malloc() for same-sized objects.
+ *        gcc -O2 object_pool.c bench_object_pool.c -lpthread
+ *        ./a.out [thread number]
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-25
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "object_pool.h"
+
+
+enum {
+    OBJECT_SIZE   = 64,
+    OBJECT_NR     = 10000,
+    LOOP_NR       = 200,
+    MAX_THREAD_NR = 64,
+};
+
+
+enum kind {
+    KIND_MALLOC,
+    KIND_POOL,
+    KIND_POOL_MT,
+};
+typedef enum kind Kind;
+
+
+static Object_pool pool;
+static Object_pool_mt pool_mt;
+
+
+static double clock_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static inline void* alloc(Kind k) {
+    switch (k) {
+        case KIND_MALLOC:
+            return malloc(OBJECT_SIZE);
+        case KIND_POOL:
+            return object_pool_alloc(&pool);
+        default:
+            return object_pool_mt_alloc(&pool_mt);
+    }
+}
+
+
+static inline void release(Kind k, void* p) {
+    switch (k) {
+        case KIND_MALLOC:
+            free(p);
+            break;
+        case KIND_POOL:
+            object_pool_free(&pool, p);
+            break;
+        default:
+            object_pool_mt_free(&pool_mt, p);
+            break;
+    }
+}
+
+
+/* Allocate all objects, then free them in a shuffled order. */
+static void* worker(void* arg) {
+    Kind const k = (Kind)(uintptr_t)arg;
+    void** objs  = malloc(sizeof(void*) * OBJECT_NR);
+    uint32_t x   = 2463534242U;
+
+    for (size_t l = 0; l < LOOP_NR; l++) {
+        for (size_t i = 0; i < OBJECT_NR; i++) {
+            objs[i]                     = alloc(k);
+            *(uint8_t volatile*)objs[i] = (uint8_t)i;
+        }
+        for (size_t i = OBJECT_NR - 1; 0 < i; i--) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            size_t j = x % (i + 1);
+            void* t  = objs[i];
+            objs[i]  = objs[j];
+            objs[j]  = t;
+        }
+        for (size_t i = 0; i < OBJECT_NR; i++) {
+            release(k, objs[i]);
+        }
+    }
+
+    free(objs);
+
+    return NULL;
+}
+
+
+static void bench(char const* name, Kind k, size_t thread_nr) {
+    pthread_t threads[MAX_THREAD_NR];
+
+    double t1 = clock_sec();
+    for (size_t i = 0; i < thread_nr; i++) {
+        pthread_create(&threads[i], NULL, worker, (void*)(uintptr_t)k);
+    }
+    for (size_t i = 0; i < thread_nr; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double t2 = clock_sec();
+
+    printf("%-12s, %7zu, %10.2f\n", name, thread_nr, (t2 - t1) * 1e9 / ((double)OBJECT_NR * LOOP_NR * thread_nr * 2));
+}
+
+
+int main(int argc, char** argv) {
+    size_t thread_nr = (argc < 2) ? 4 : strtoul(argv[1], NULL, 10);
+    thread_nr        = (thread_nr == 0 || MAX_THREAD_NR < thread_nr) ? MAX_THREAD_NR : thread_nr;
+
+    object_pool_init(&pool, OBJECT_SIZE, OBJECT_NR);
+    object_pool_mt_init(&pool_mt, OBJECT_SIZE, OBJECT_NR * MAX_THREAD_NR);
+
+    printf("allocator   , threads, ns per op\n");
+    bench("malloc", KIND_MALLOC, 1);
+    bench("pool", KIND_POOL, 1);
+    bench("pool_mt", KIND_POOL_MT, 1);
+    bench("malloc", KIND_MALLOC, thread_nr);
+    bench("pool_mt", KIND_POOL_MT, thread_nr);
+
+    object_pool_mt_destruct(&pool_mt);
+    object_pool_destruct(&pool);
+
+    return 0;
+}
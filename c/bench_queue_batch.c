@@ -0,0 +1,153 @@
+/**
+ * @file bench_queue_batch.c
+ * @brief Compare one element operations of queues with batch operations.
+ *        gcc -O2 dlist.c aqueue.c lqueue.c bench_queue_batch.c
+ *        ./a.out
+ *
+ *        Each round inserts BATCH_NR int64_t and removes them.
+ *        Results are nanoseconds per element.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-29
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include "aqueue.h"
+#include "lqueue.h"
+
+
+enum {
+    BATCH_NR        = 256,
+    AQUEUE_ROUND_NR = 200000,
+    LQUEUE_ROUND_NR = 20000,
+    LQUEUE_SLAB_NR  = 1024,
+};
+
+
+static double clock_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static int64_t in[BATCH_NR], out[BATCH_NR];
+static int64_t sum;
+
+
+static void report(char const* name, double t, size_t round_nr) {
+    printf("%-22s, %8.2f\n", name, t * 1e9 / ((double)round_nr * BATCH_NR));
+}
+
+
+static void bench_aqueue(void) {
+    Aqueue q;
+    aqueue_init(&q, sizeof(int64_t), BATCH_NR + BATCH_NR / 2, NULL);
+
+    /* Offset first so that the batches wrap around. */
+    aqueue_insert_n(&q, in, BATCH_NR / 3);
+    aqueue_pop_n(&q, NULL, BATCH_NR / 3);
+
+    double t1 = clock_sec();
+    for (size_t r = 0; r < AQUEUE_ROUND_NR; r++) {
+        for (size_t i = 0; i < BATCH_NR; i++) {
+            aqueue_insert(&q, &in[i]);
+        }
+        for (size_t i = 0; i < BATCH_NR; i++) {
+            out[i] = aqueue_get(int64_t, &q);
+            aqueue_delete_first(&q);
+        }
+        sum += out[r % BATCH_NR];
+    }
+    double t2 = clock_sec();
+    for (size_t r = 0; r < AQUEUE_ROUND_NR; r++) {
+        aqueue_insert_n(&q, in, BATCH_NR);
+        aqueue_pop_n(&q, out, BATCH_NR);
+        sum += out[r % BATCH_NR];
+    }
+    double t3 = clock_sec();
+
+    report("aqueue insert/delete", t2 - t1, AQUEUE_ROUND_NR);
+    report("aqueue insert_n/pop_n", t3 - t2, AQUEUE_ROUND_NR);
+    aqueue_destruct(&q);
+}
+
+
+static void bench_lqueue(void) {
+    Lqueue q, r;
+    lqueue_init(&q, sizeof(int64_t), NULL);
+    lqueue_init(&r, sizeof(int64_t), NULL);
+
+    double t1 = clock_sec();
+    for (size_t k = 0; k < LQUEUE_ROUND_NR; k++) {
+        for (size_t i = 0; i < BATCH_NR; i++) {
+            lqueue_insert(&q, &in[i]);
+        }
+        for (size_t i = 0; i < BATCH_NR; i++) {
+            out[i] = lqueue_get(int64_t, &q);
+            lqueue_delete_first(&q);
+        }
+        sum += out[k % BATCH_NR];
+    }
+    double t2 = clock_sec();
+    for (size_t k = 0; k < LQUEUE_ROUND_NR; k++) {
+        lqueue_insert_n(&q, in, BATCH_NR);
+        lqueue_pop_n(&q, out, BATCH_NR);
+        sum += out[k % BATCH_NR];
+    }
+    double t3 = clock_sec();
+
+    /* Pipeline stage: pass the whole batch to the next queue and back. */
+    lqueue_insert_n(&q, in, BATCH_NR);
+    double t4 = clock_sec();
+    for (size_t k = 0; k < LQUEUE_ROUND_NR; k++) {
+        lqueue_move_n(&r, &q, BATCH_NR);
+        lqueue_move_n(&q, &r, BATCH_NR);
+    }
+    double t5 = clock_sec();
+
+    report("lqueue insert/delete", t2 - t1, LQUEUE_ROUND_NR);
+    report("lqueue insert_n/pop_n", t3 - t2, LQUEUE_ROUND_NR);
+    report("lqueue move_n x2", t5 - t4, LQUEUE_ROUND_NR);
+    lqueue_destruct(&q);
+    lqueue_destruct(&r);
+
+    lqueue_init_pooled(&q, sizeof(int64_t), NULL, LQUEUE_SLAB_NR);
+    t1 = clock_sec();
+    for (size_t k = 0; k < LQUEUE_ROUND_NR; k++) {
+        for (size_t i = 0; i < BATCH_NR; i++) {
+            lqueue_insert(&q, &in[i]);
+        }
+        for (size_t i = 0; i < BATCH_NR; i++) {
+            out[i] = lqueue_get(int64_t, &q);
+            lqueue_delete_first(&q);
+        }
+        sum += out[k % BATCH_NR];
+    }
+    t2 = clock_sec();
+    for (size_t k = 0; k < LQUEUE_ROUND_NR; k++) {
+        lqueue_insert_n(&q, in, BATCH_NR);
+        lqueue_pop_n(&q, out, BATCH_NR);
+        sum += out[k % BATCH_NR];
+    }
+    t3 = clock_sec();
+
+    report("pooled insert/delete", t2 - t1, LQUEUE_ROUND_NR);
+    report("pooled insert_n/pop_n", t3 - t2, LQUEUE_ROUND_NR);
+    lqueue_destruct(&q);
+}
+
+
+int main(void) {
+    for (size_t i = 0; i < BATCH_NR; i++) {
+        in[i] = (int64_t)i;
+    }
+
+    printf("operation             , ns/element\n");
+    bench_aqueue();
+    bench_lqueue();
+
+    return (sum == 0);
+}
@@ -0,0 +1,101 @@
+/**
+ * @file bench_tlsf_free.c
+ * @brief Free latency of Tlsf_manager with thousands of supplied regions.
+ *        gcc -O2 -DTLSF_LIBRARY tlsf.c bench_tlsf_free.c -lpthread
+ *        ./a.out [max region number]
+ *
+ *        Every region is filled with blocks and they are freed in the random order.
+ *        When the last block of a region is freed, the region is given back by the watermark path.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-09-29
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "tlsf.h"
+
+
+enum {
+    REGION_SIZE         = 64 * 1024,
+    OBJECT_SIZE         = 15000,
+    WATERMARK_REGION_NR = 4,
+    WATERMARK_SIZE      = 4096 + 5 * 1024 * 1024 * 2 + 64, /* Larger than the watermark block of tlsf.c. */
+    DEFAULT_MAX_REGION  = 8192,
+};
+
+
+static double clock_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static inline uint32_t xorshift(uint32_t* s) {
+    uint32_t x = *s;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *s = x;
+}
+
+
+static void bench(size_t region_nr) {
+    Tlsf_manager tman;
+    tlsf_init(&tman);
+
+    /* Keep enough free watermark blocks so that fully free regions are given back. */
+    for (size_t i = 0; i < WATERMARK_REGION_NR; i++) {
+        tlsf_supply_memory(&tman, WATERMARK_SIZE);
+    }
+    for (size_t i = 0; i < region_nr; i++) {
+        tlsf_supply_memory(&tman, REGION_SIZE);
+    }
+    size_t const supplied = tman.total_memory_size;
+
+    size_t const max_obj_nr = region_nr * (REGION_SIZE / OBJECT_SIZE);
+    void** objs = malloc(sizeof(void*) * max_obj_nr);
+    size_t obj_nr = 0;
+    while (obj_nr < max_obj_nr) {
+        void* p = tlsf_malloc(&tman, OBJECT_SIZE);
+        if (p == NULL) {
+            break;
+        }
+        objs[obj_nr++] = p;
+    }
+
+    uint32_t seed = 2463534242U;
+    for (size_t i = obj_nr - 1; 0 < i; i--) {
+        size_t j  = xorshift(&seed) % (i + 1);
+        void* t   = objs[i];
+        objs[i]   = objs[j];
+        objs[j]   = t;
+    }
+
+    double t1 = clock_sec();
+    for (size_t i = 0; i < obj_nr; i++) {
+        tlsf_free(&tman, objs[i]);
+    }
+    double t2 = clock_sec();
+
+    size_t released = (supplied - tman.total_memory_size) / REGION_SIZE;
+    printf("%8zu, %8zu, %8zu, %10.1f\n", region_nr, obj_nr, released, (t2 - t1) * 1e9 / obj_nr);
+
+    free(objs);
+    tlsf_destruct(&tman);
+}
+
+
+int main(int argc, char** argv) {
+    size_t max_region_nr = (argc < 2) ? DEFAULT_MAX_REGION : strtoul(argv[1], NULL, 10);
+
+    printf(" regions,  objects, released, ns/free\n");
+    for (size_t n = 256; n <= max_region_nr; n *= 2) {
+        bench(n);
+    }
+
+    return EXIT_SUCCESS;
+}
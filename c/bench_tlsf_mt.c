@@ -0,0 +1,115 @@
+/**
+ * @file bench_tlsf_mt.c
+ * @brief Compare a mutex wrapped Tlsf_manager with the multi-threaded mode.
+ *        gcc -O2 -DTLSF_LIBRARY tlsf.c bench_tlsf_mt.c -lpthread
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-05
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "tlsf.h"
+
+
+enum {
+    MAX_THREAD_NR   = 64,
+    LOOP_NR         = 1000000,
+    LIVE_OBJECT_NR  = 64,
+    MAX_OBJECT_SIZE = 512,
+};
+
+
+struct worker_arg {
+    Tlsf_mt_manager* mt;
+    pthread_mutex_t* lock; /* If this is not NULL, use the locked single manager. */
+    unsigned int seed;
+};
+typedef struct worker_arg Worker_arg;
+
+
+static double clock_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void* worker(void* p) {
+    Worker_arg* arg    = p;
+    Tlsf_manager* tman = &arg->mt->tman;
+    void* objs[LIVE_OBJECT_NR] = {NULL};
+
+    for (size_t i = 0; i < LOOP_NR; i++) {
+        size_t idx  = (size_t)rand_r(&arg->seed) % LIVE_OBJECT_NR;
+        size_t size = (size_t)rand_r(&arg->seed) % MAX_OBJECT_SIZE + 1u;
+
+        if (arg->lock != NULL) {
+            pthread_mutex_lock(arg->lock);
+            tlsf_free(tman, objs[idx]);
+            objs[idx] = tlsf_malloc(tman, size);
+            pthread_mutex_unlock(arg->lock);
+        } else {
+            tlsf_mt_free(arg->mt, objs[idx]);
+            objs[idx] = tlsf_mt_malloc(arg->mt, size);
+        }
+    }
+
+    for (size_t i = 0; i < LIVE_OBJECT_NR; i++) {
+        if (arg->lock != NULL) {
+            pthread_mutex_lock(arg->lock);
+            tlsf_free(tman, objs[i]);
+            pthread_mutex_unlock(arg->lock);
+        } else {
+            tlsf_mt_free(arg->mt, objs[i]);
+        }
+    }
+
+    return NULL;
+}
+
+
+static double run(Tlsf_mt_manager* mt, pthread_mutex_t* lock, size_t thread_nr) {
+    pthread_t threads[MAX_THREAD_NR];
+    Worker_arg args[MAX_THREAD_NR];
+
+    double begin = clock_sec();
+    for (size_t i = 0; i < thread_nr; i++) {
+        args[i] = (Worker_arg){.mt = mt, .lock = lock, .seed = (unsigned int)i + 1u};
+        pthread_create(&threads[i], NULL, worker, &args[i]);
+    }
+    for (size_t i = 0; i < thread_nr; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    return clock_sec() - begin;
+}
+
+
+int main(int argc, char** argv) {
+    size_t max_thread_nr = (argc < 2) ? 8 : strtoul(argv[1], NULL, 10);
+    if (max_thread_nr == 0 || MAX_THREAD_NR < max_thread_nr) {
+        fprintf(stderr, "thread number must be 1 - %d\n", MAX_THREAD_NR);
+        return EXIT_FAILURE;
+    }
+
+    printf("threads, locked Mops/s, mt Mops/s\n");
+    for (size_t n = 1; n <= max_thread_nr; n *= 2) {
+        Tlsf_mt_manager mt;
+        pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+        double const ops     = (double)n * LOOP_NR / 1e6;
+
+        tlsf_mt_init(&mt);
+        tlsf_mt_supply_memory(&mt, 64 << 20);
+        double locked = run(&mt, &lock, n);
+        double cached = run(&mt, NULL, n);
+        tlsf_mt_destruct(&mt);
+
+        printf("%zu, %.2f, %.2f\n", n, ops / locked, ops / cached);
+    }
+
+    return EXIT_SUCCESS;
+}
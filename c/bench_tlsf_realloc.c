@@ -0,0 +1,91 @@
+/**
+ * @file bench_tlsf_realloc.c
+ * @brief Growing vectors by tlsf_realloc and by malloc + copy + free.
+ *        gcc -O2 -DTLSF_LIBRARY tlsf.c bench_tlsf_realloc.c -lpthread
+ *        ./a.out
+ *
+ *        Each vector grows by GROW_STEP bytes up to MAX_VECTOR_SIZE.
+ *        The vectors are grown in turn, so a vector may be blocked by its neighbor.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-09-29
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "tlsf.h"
+
+
+enum {
+    MAX_VECTOR_NR   = 64,
+    GROW_STEP       = 64,
+    MAX_VECTOR_SIZE = 256 * 1024,
+    POOL_SIZE       = 64 * 1024 * 1024,
+};
+
+
+static double clock_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void* grow_by_copy(Tlsf_manager* tman, void* p, size_t old_size, size_t new_size) {
+    void* n = tlsf_malloc(tman, new_size);
+    if (n != NULL && p != NULL) {
+        memcpy(n, p, old_size);
+        tlsf_free(tman, p);
+    }
+
+    return n;
+}
+
+
+static void bench(size_t vector_nr, int is_realloc) {
+    Tlsf_manager tman;
+    void* vectors[MAX_VECTOR_NR] = {NULL};
+    size_t grow_nr = 0, moved_nr = 0;
+
+    tlsf_init(&tman);
+    tlsf_supply_memory(&tman, POOL_SIZE);
+
+    double t1 = clock_sec();
+    for (size_t s = GROW_STEP; s <= MAX_VECTOR_SIZE; s += GROW_STEP) {
+        for (size_t i = 0; i < vector_nr; i++) {
+            void* p = (is_realloc != 0) ? tlsf_realloc(&tman, vectors[i], s) : grow_by_copy(&tman, vectors[i], s - GROW_STEP, s);
+            if (p == NULL) {
+                fprintf(stderr, "out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+
+            /* Touch the new tail like push_back. */
+            memset((uint8_t*)p + s - GROW_STEP, (int)i, GROW_STEP);
+            moved_nr += (p != vectors[i]);
+            vectors[i] = p;
+            ++grow_nr;
+        }
+    }
+    double t2 = clock_sec();
+
+    printf("%7zu, %-8s, %10.1f, %8.1f%%\n", vector_nr, (is_realloc != 0) ? "realloc" : "copy", (t2 - t1) * 1e9 / grow_nr, 100.0 * moved_nr / grow_nr);
+
+    for (size_t i = 0; i < vector_nr; i++) {
+        tlsf_free(&tman, vectors[i]);
+    }
+    tlsf_destruct(&tman);
+}
+
+
+int main(void) {
+    printf("vectors, method  , ns/grow, moved\n");
+    for (size_t n = 1; n <= MAX_VECTOR_NR; n *= 4) {
+        bench(n, 0);
+        bench(n, 1);
+    }
+
+    return EXIT_SUCCESS;
+}
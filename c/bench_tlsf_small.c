@@ -0,0 +1,77 @@
+/**
+ * @file bench_tlsf_small.c
+ * @brief Compare small object runs with TLSF blocks for 16 - 256 byte objects.
+ *        gcc -O2 -DTLSF_LIBRARY tlsf.c bench_tlsf_small.c -lpthread
+ *        ./a.out
+ *
+ *        Requests aligned to 32 byte skip the runs, so they measure the plain TLSF blocks.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-09-29
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "tlsf.h"
+
+
+enum {
+    OBJECT_NR   = 100000,
+    LOOP_NR     = 10,
+    POOL_SIZE   = 64 * 1024 * 1024,
+    BLOCK_ALIGN = 32,
+};
+
+
+static double clock_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void bench(size_t size, size_t align, char const* name) {
+    Tlsf_manager tman;
+    static void* objs[OBJECT_NR];
+    double malloc_sec = 0, free_sec = 0;
+    size_t used = 0;
+
+    tlsf_init(&tman);
+    tlsf_supply_memory(&tman, POOL_SIZE);
+
+    for (size_t l = 0; l < LOOP_NR; l++) {
+        double t1 = clock_sec();
+        for (size_t i = 0; i < OBJECT_NR; i++) {
+            objs[i] = tlsf_malloc_align(&tman, size, align);
+        }
+        double t2 = clock_sec();
+
+        used = tman.total_memory_size - tman.free_memory_size;
+
+        for (size_t i = 0; i < OBJECT_NR; i++) {
+            tlsf_free(&tman, objs[i]);
+        }
+        double t3 = clock_sec();
+
+        malloc_sec += t2 - t1;
+        free_sec += t3 - t2;
+    }
+
+    double const op_nr = (double)OBJECT_NR * LOOP_NR;
+    printf("%5zu, %-6s, %10.1f, %10.1f, %12.1f\n", size, name, malloc_sec * 1e9 / op_nr, free_sec * 1e9 / op_nr, (double)used / OBJECT_NR);
+
+    tlsf_destruct(&tman);
+}
+
+
+int main(void) {
+    printf(" size, path  , malloc ns,   free ns, bytes/object\n");
+    for (size_t s = 16; s <= TLSF_SMALL_MAX_SIZE; s *= 2) {
+        bench(s, 0, "run");
+        bench(s, BLOCK_ALIGN, "block");
+    }
+
+    return EXIT_SUCCESS;
+}
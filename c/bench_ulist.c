@@ -0,0 +1,116 @@
+/**
+ * @file bench_ulist.c
+ * @brief Compare iteration and search of Ulist with Dlist.
+ *        gcc -O2 dlist.c ulist.c bench_ulist.c
+ *        ./a.out
+ *
+ *        The lists have int64_t 0 .. n-1, the search looks for the last element.
+ *        Results are nanoseconds per element.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-27
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include "dlist.h"
+#include "ulist.h"
+
+
+enum {
+    MIN_ELEMENT_NR_LOG10 = 3,
+    MAX_ELEMENT_NR_LOG10 = 7,
+    TOUCHED_ELEMENT_NR   = 100000000, /* Each measurement visits this number of elements at least. */
+    DLIST_SLAB_NODE_NR   = 1024,
+};
+
+
+static double clock_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static int64_t sum;
+
+
+static bool dlist_sum(Dlist* l, void* d) {
+    sum += *(int64_t*)d;
+    return false;
+}
+
+
+static bool ulist_sum(Ulist* l, void* d) {
+    sum += *(int64_t*)d;
+    return false;
+}
+
+
+static void bench_dlist(Dlist* l, char const* name, size_t n, size_t rep) {
+    for (int64_t i = 0; i < (int64_t)n; i++) {
+        dlist_insert_data_last(l, &i);
+    }
+
+    double t1 = clock_sec();
+    for (size_t r = 0; r < rep; r++) {
+        dlist_for_each(l, dlist_sum, false);
+    }
+    double t2 = clock_sec();
+
+    int64_t key = (int64_t)n - 1;
+    for (size_t r = 0; r < rep; r++) {
+        sum += (dlist_search_node(l, &key) != NULL);
+    }
+    double t3 = clock_sec();
+
+    printf("%-12s, %9zu, %12.2f, %12.2f\n", name, n, (t2 - t1) * 1e9 / ((double)n * rep), (t3 - t2) * 1e9 / ((double)n * rep));
+    dlist_destruct(l);
+}
+
+
+static void bench_ulist(size_t n, size_t rep) {
+    Ulist l;
+    ulist_init(&l, sizeof(int64_t), NULL, 0);
+
+    for (int64_t i = 0; i < (int64_t)n; i++) {
+        ulist_insert_data_last(&l, &i);
+    }
+
+    double t1 = clock_sec();
+    for (size_t r = 0; r < rep; r++) {
+        ulist_for_each(&l, ulist_sum, false);
+    }
+    double t2 = clock_sec();
+
+    int64_t key = (int64_t)n - 1;
+    for (size_t r = 0; r < rep; r++) {
+        sum += (ulist_iter_is_end(ulist_search(&l, &key)) == false);
+    }
+    double t3 = clock_sec();
+
+    printf("%-12s, %9zu, %12.2f, %12.2f\n", "ulist", n, (t2 - t1) * 1e9 / ((double)n * rep), (t3 - t2) * 1e9 / ((double)n * rep));
+    ulist_destruct(&l);
+}
+
+
+int main(void) {
+    printf("list        ,  elements, for_each ns,   search ns\n");
+
+    size_t n = 1;
+    for (int i = 0; i < MIN_ELEMENT_NR_LOG10; i++) {
+        n *= 10;
+    }
+
+    for (int i = MIN_ELEMENT_NR_LOG10; i <= MAX_ELEMENT_NR_LOG10; i++, n *= 10) {
+        size_t const rep = (n < TOUCHED_ELEMENT_NR) ? TOUCHED_ELEMENT_NR / n : 1;
+        Dlist l;
+
+        bench_dlist(dlist_init(&l, sizeof(int64_t), NULL), "dlist", n, rep);
+        bench_dlist(dlist_init_pooled(&l, sizeof(int64_t), NULL, DLIST_SLAB_NODE_NR), "dlist_pooled", n, rep);
+        bench_ulist(n, rep);
+    }
+
+    return (sum == 0);
+}
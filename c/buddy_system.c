@@ -1,57 +1,32 @@
 /**
  * @file buddy_system.c
  * @brief This is CUI simulater of Buddy System allocater for x86_32.
+ *        With BUDDY_SYSTEM_LIBRARY, this is a page allocater library, buddy_init_mmap() manages real memory.
  * @author mopp
  * @version 0.1
  * @date 2014-09-23
  */
 
+#define _GNU_SOURCE /* for sched_getcpu */
 #include <assert.h>
+#include <pthread.h>
+#include <sched.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "minunit.h"
+#include <sys/mman.h>
+#include <unistd.h>
 #include "elist.h"
+#include "buddy_system.h"
 
 
-/* Order in buddy system: 0 1 2 3  4  5  6   7   8   9   10 */
-/* The number of frame  : 1 2 4 8 16 32 64 128 256 512 1024 */
-#define BUDDY_SYSTEM_MAX_ORDER (10 + 1)
-#define BUDDY_SYSTEM_ORDER_NR(order) (1U << (order))
-
-/* frame size is 4 KB in x86_32. */
-#define FRAME_SIZE 0x1000U
-
-#define ORDER_FRAME_SIZE(order) (BUDDY_SYSTEM_ORDER_NR(order) * FRAME_SIZE)
-
 #define TO_KB(x) (x >> 11)
 
-
-struct frame {
-    Elist list;
-    uint8_t status;
-    uint8_t order;
-};
-typedef struct frame Frame;
-
-
-enum frame_constants {
-    FRAME_STATE_FREE = 0,
-    FRAME_STATE_ALLOC,
-};
-
-
-/* Buddy system manager. */
-struct buddy_manager {
-    Frame* frame_pool;                            /* 管理用の全フレーム */
-    size_t total_frame_nr;                        /* マネージャの持つ全フレーム数 */
-    size_t free_frame_nr[BUDDY_SYSTEM_MAX_ORDER]; /* 各オーダーの空きフレーム数 */
-    Elist frames[BUDDY_SYSTEM_MAX_ORDER];         /* 各オーダーのリスト先頭要素(ダミー), 実際のデータはこのリストのnext要素から始まる. */
-};
-typedef struct buddy_manager Buddy_manager;
+#define BITMAP_WORD_BIT_NR 64
+#define BITMAP_WORD_NR(n) (((n) + BITMAP_WORD_BIT_NR - 1) / BITMAP_WORD_BIT_NR)
 
 
 static inline Frame* elist_get_frame(Elist const* const l) {
@@ -82,7 +57,7 @@ static inline size_t get_frame_idx(Buddy_manager const* const bman, Frame const*
 uintptr_t get_frame_addr(Buddy_manager const* const bman, Frame const* const frame) {
     assert(bman != NULL);
     assert(frame != NULL);
-    return get_frame_idx(bman, frame) * FRAME_SIZE;
+    return bman->base_addr + (get_frame_idx(bman, frame) << bman->frame_size_log2);
 }
 
 
@@ -93,7 +68,7 @@ uintptr_t get_frame_addr(Buddy_manager const* const bman, Frame const* const fra
  * @return
  */
 Frame* get_frame_by_addr(Buddy_manager const * const bman, uintptr_t addr) {
-    return &bman->frame_pool[addr / FRAME_SIZE];
+    return &bman->frame_pool[(addr - bman->base_addr) >> bman->frame_size_log2];
 }
 
 
@@ -119,17 +94,62 @@ static inline Frame* get_buddy_frame(Buddy_manager const* const bman, Frame cons
 }
 
 
+static inline bool is_free_frame(Buddy_manager const* const bman, size_t idx) {
+    return ((bman->free_bitmap[idx / BITMAP_WORD_BIT_NR] >> (idx % BITMAP_WORD_BIT_NR)) & 1) != 0;
+}
+
+
+static inline void set_free_frame(Buddy_manager* const bman, size_t idx) {
+    bman->free_bitmap[idx / BITMAP_WORD_BIT_NR] |= (UINT64_C(1) << (idx % BITMAP_WORD_BIT_NR));
+}
+
+
+static inline void clear_free_frame(Buddy_manager* const bman, size_t idx) {
+    bman->free_bitmap[idx / BITMAP_WORD_BIT_NR] &= ~(UINT64_C(1) << (idx % BITMAP_WORD_BIT_NR));
+}
+
+
 /**
- * @brief バディマネージャを初期化.
- * @param bman        初期化対象
- * @param memory_size バディマネージャの管理するメモリーサイズ.
- * @return 初期化出来なかった場合NULL, それ以外は引数のマネージャが返る.
+ * @brief フレームを指定オーダーのリストへ繋ぎ, 空きとして記録する.
+ * @param bman  フレームの属するマネージャ.
+ * @param frame 繋ぐフレーム.
+ * @param order 繋ぐオーダー.
  */
-Buddy_manager* buddy_init(Buddy_manager* const bman, size_t memory_size) {
-    size_t frame_nr = memory_size / FRAME_SIZE;
+static inline void push_free_frame(Buddy_manager* const bman, Frame* const frame, uint8_t order) {
+    frame->order = order;
+    elist_insert_next(&bman->frames[order], &frame->list);
+    ++bman->free_frame_nr[order];
+    bman->order_bitmap |= (1U << order);
+    set_free_frame(bman, get_frame_idx(bman, frame));
+}
+
+
+/**
+ * @brief フレームを指定オーダーのリストから外し, 使用中として記録する.
+ *        リストが空になったらオーダーのビットを落とす.
+ * @param bman  フレームの属するマネージャ.
+ * @param frame 外すフレーム.
+ * @param order フレームのオーダー.
+ */
+static inline void pop_free_frame(Buddy_manager* const bman, Frame* const frame, uint8_t order) {
+    elist_remove(&frame->list);
+    --bman->free_frame_nr[order];
+    bman->order_bitmap &= ~((uint32_t)(bman->free_frame_nr[order] == 0) << order);
+    clear_free_frame(bman, get_frame_idx(bman, frame));
+}
 
+
+/**
+ * @brief フレームとリストを構築してマネージャを初期化する.
+ * @param bman       初期化対象
+ * @param base_addr  0番フレームのアドレス.
+ * @param frame_nr   フレーム数.
+ * @param frame_size フレームサイズ, 2の累乗.
+ * @param max_order  オーダーの数.
+ * @return 初期化出来なかった場合NULL, それ以外は引数のマネージャが返る.
+ */
+static Buddy_manager* init_manager(Buddy_manager* const bman, uintptr_t base_addr, size_t frame_nr, size_t frame_size, uint8_t max_order) {
     assert(bman != NULL);
-    assert(memory_size != 0);
     assert(frame_nr != 0);
 
     /* TODO: address align check. */
@@ -139,34 +159,38 @@ Buddy_manager* buddy_init(Buddy_manager* const bman, size_t memory_size) {
         return NULL;
     }
 
-    /* 確保した全フレーム初期化. */
-    Frame* p = frames;
-    Frame* end = frames + frame_nr;
-    do {
-        p->status = FRAME_STATE_FREE;
-    } while (++p <= end);
+    uint64_t* bitmap = calloc(BITMAP_WORD_NR(frame_nr), sizeof(uint64_t));
+    if (bitmap == NULL) {
+        free(frames);
+        return NULL;
+    }
 
     /* マネージャを初期化 */
     bman->frame_pool = frames;
     bman->total_frame_nr = frame_nr;
-    for (uint8_t i = 0; i < BUDDY_SYSTEM_MAX_ORDER; ++i) {
+    bman->free_bitmap = bitmap;
+    bman->order_bitmap = 0;
+    bman->max_order = max_order;
+    bman->frame_size = frame_size;
+    bman->frame_size_log2 = (uint8_t)__builtin_ctzl(frame_size);
+    bman->base_addr = base_addr;
+    bman->region = NULL;
+    bman->region_size = 0;
+    for (uint8_t i = 0; i < BUDDY_SYSTEM_MAX_ORDER_LIMIT; ++i) {
         bman->free_frame_nr[i] = 0;
         elist_init(bman->frames + i);
     }
 
     /* フレームを大きいオーダーからまとめてリストを構築. */
     size_t n = frame_nr;
-    uint8_t order = BUDDY_SYSTEM_MAX_ORDER;
+    uint8_t order = max_order;
     Frame* itr = frames;
     do {
         --order;
         size_t o_nr = BUDDY_SYSTEM_ORDER_NR(order);
         while (n != 0 && o_nr <= n) {
             /* フレームを現在オーダのリストに追加. */
-            itr->order  = order;
-            itr->status = FRAME_STATE_FREE;
-            elist_insert_next(&bman->frames[order], &itr->list);
-            ++(bman->free_frame_nr[order]);
+            push_free_frame(bman, itr, order);
 
             itr += o_nr; /* 次のフレームへ. */
             n -= o_nr;   /* 取ったフレーム分を引く. */
@@ -177,12 +201,86 @@ Buddy_manager* buddy_init(Buddy_manager* const bman, size_t memory_size) {
 }
 
 
+/**
+ * @brief バディマネージャを初期化.
+ *        アドレスは0から始まるものとして扱い, 実際のメモリは持たない.
+ * @param bman        初期化対象
+ * @param memory_size バディマネージャの管理するメモリーサイズ.
+ * @return 初期化出来なかった場合NULL, それ以外は引数のマネージャが返る.
+ */
+Buddy_manager* buddy_init(Buddy_manager* const bman, size_t memory_size) {
+    size_t frame_nr = memory_size / FRAME_SIZE;
+
+    assert(bman != NULL);
+    assert(memory_size != 0);
+    assert(frame_nr != 0);
+
+    return init_manager(bman, 0, frame_nr, FRAME_SIZE, BUDDY_SYSTEM_MAX_ORDER);
+}
+
+
+/**
+ * @brief mmapした領域を管理するバディマネージャを初期化.
+ *        領域の先頭は最大オーダーのブロックサイズに揃えるので, 全てのブロックは自身のサイズに整列する.
+ * @param bman        初期化対象
+ * @param memory_size バディマネージャの管理するメモリーサイズ, フレームサイズの倍数に切り下げる.
+ * @param frame_size  フレームサイズ, ページサイズ以上の2の累乗.
+ * @param max_order   オーダーの数, 1以上BUDDY_SYSTEM_MAX_ORDER_LIMIT以下.
+ * @return 初期化出来なかった場合NULL, それ以外は引数のマネージャが返る.
+ */
+Buddy_manager* buddy_init_mmap(Buddy_manager* const bman, size_t memory_size, size_t frame_size, uint8_t max_order) {
+    size_t const page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+    assert(bman != NULL);
+    if (frame_size < page_size || (frame_size & (frame_size - 1)) != 0 || max_order == 0 || BUDDY_SYSTEM_MAX_ORDER_LIMIT < max_order) {
+        return NULL;
+    }
+
+    size_t frame_nr = memory_size / frame_size;
+    if (frame_nr == 0) {
+        return NULL;
+    }
+
+    /* 先頭を揃えるために余分に確保し, 前後の余りを返す. */
+    size_t const align = frame_size << (max_order - 1);
+    size_t const size  = frame_nr * frame_size;
+    size_t const map_size = size + align - page_size;
+    uint8_t* p = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+
+    uintptr_t base = ((uintptr_t)p + align - 1) & ~(uintptr_t)(align - 1);
+    size_t head = base - (uintptr_t)p;
+    size_t tail = map_size - head - size;
+    if (head != 0) {
+        munmap(p, head);
+    }
+    if (tail != 0) {
+        munmap((void*)(base + size), tail);
+    }
+
+    if (init_manager(bman, base, frame_nr, frame_size, max_order) == NULL) {
+        munmap((void*)base, size);
+        return NULL;
+    }
+    bman->region = (void*)base;
+    bman->region_size = size;
+
+    return bman;
+}
+
+
 /**
  * @brief バディマネージャを破棄.
  * @param bman        破棄対象
  */
 void buddy_destruct(Buddy_manager* const bman) {
+    if (bman->region != NULL) {
+        munmap(bman->region, bman->region_size);
+    }
     free(bman->frame_pool);
+    free(bman->free_bitmap);
     memset(bman, 0, sizeof(Buddy_manager));
 }
 
@@ -195,58 +293,56 @@ void buddy_destruct(Buddy_manager* const bman) {
  */
 Frame* buddy_alloc_frames(Buddy_manager* const bman, uint8_t request_order) {
     assert(bman != NULL);
-    Elist* frames = bman->frames;
-
-    /* O(10 * 10) ? */
-    uint8_t order = request_order;
-    while (order < BUDDY_SYSTEM_MAX_ORDER) {
-        Elist* l = &frames[order];
-        if (elist_is_empty(l) == false) {
-            --bman->free_frame_nr[order];
-            Frame* rm_frame = elist_get_frame(elist_remove(l->next));
-            rm_frame->order = request_order;
-            rm_frame->status = FRAME_STATE_ALLOC;
-
-            /* 要求オーダーよりも大きいオーダーからフレームを取得した場合、余分なフレームを繋ぎ直す. */
-            while (request_order < order--) {
-                Frame* bf = get_buddy_frame(bman, rm_frame, order); /* 2分割 */
-                bf->order = order;                                  /* 分割したのでバディのオーダーを設定.これをやらないと解放時に困る. */
-                elist_insert_next(&frames[order], &bf->list);       /* バディを一つしたのオーダーのリストへ接続 */
-                ++bman->free_frame_nr[order];
-            }
-
-            return rm_frame;
-        }
-        /* requested order is NOT found. */
 
-        ++order;
+    if (bman->max_order <= request_order) {
+        return NULL;
     }
 
-    /* Error */
-    return NULL;
+    /* 要求オーダー以上で空きのある最小のオーダーをビットマップから求める. */
+    uint32_t candidates = bman->order_bitmap & ~((1U << request_order) - 1U);
+    if (candidates == 0) {
+        /* Error */
+        return NULL;
+    }
+
+    uint8_t order = (uint8_t)__builtin_ctz(candidates);
+    Frame* rm_frame = elist_get_frame(bman->frames[order].next);
+    pop_free_frame(bman, rm_frame, order);
+    rm_frame->order = request_order;
+
+    /* 要求オーダーよりも大きいオーダーからフレームを取得した場合、余分なフレームを繋ぎ直す. */
+    while (request_order < order--) {
+        Frame* bf = get_buddy_frame(bman, rm_frame, order); /* 2分割 */
+        push_free_frame(bman, bf, order);                   /* バディを一つしたのオーダーのリストへ接続 */
+    }
+
+    return rm_frame;
 }
 
 
 /**
  * @brief フレームを解放する.
+ *        バディが空きかどうかはビットマップで調べる.
  * @param bman フレームの返却先マネージャ.
  * @param ffs  解放するフレーム.
  */
 void buddy_free_frames(Buddy_manager* const bman, Frame* ffs) {
-    Frame* bf;
     uint8_t order = ffs->order;
+    size_t idx = get_frame_idx(bman, ffs);
 
     // 開放するフレームのバディが空きであれば、2つを合わせる.
-    while ((order < (BUDDY_SYSTEM_MAX_ORDER - 1)) && ((bf = get_buddy_frame(bman, ffs, order)) != NULL) && (order == bf->order) && (bf->status == FRAME_STATE_FREE)) {
-        elist_remove(&bf->list);
-        --bman->free_frame_nr[bf->order];
+    while (order < (bman->max_order - 1)) {
+        size_t bidx = idx ^ BUDDY_SYSTEM_ORDER_NR(order);
+        if (bman->total_frame_nr <= bidx || is_free_frame(bman, bidx) == false || bman->frame_pool[bidx].order != order) {
+            break;
+        }
+
+        pop_free_frame(bman, &bman->frame_pool[bidx], order);
+        idx &= ~(size_t)BUDDY_SYSTEM_ORDER_NR(order); /* 合わせたブロックの先頭は小さい方. */
         ++order;
     }
 
-    ++bman->free_frame_nr[order];
-    ffs->order = order;
-    ffs->status = FRAME_STATE_FREE;
-    elist_insert_next(&bman->frames[order], &ffs->list);
+    push_free_frame(bman, &bman->frame_pool[idx], order);
 }
 
 
@@ -257,8 +353,8 @@ void buddy_free_frames(Buddy_manager* const bman, Frame* ffs) {
  */
 size_t buddy_get_free_memory_size(Buddy_manager const* const bman) {
     size_t free_mem_size = 0;
-    for (uint8_t i = 0; i < BUDDY_SYSTEM_MAX_ORDER; i++) {
-        free_mem_size += (bman->free_frame_nr[i] * ORDER_FRAME_SIZE(i));
+    for (uint8_t i = 0; i < bman->max_order; i++) {
+        free_mem_size += (bman->free_frame_nr[i] << (bman->frame_size_log2 + i));
     }
 
     return free_mem_size;
@@ -271,7 +367,7 @@ size_t buddy_get_free_memory_size(Buddy_manager const* const bman) {
  * @return 使用メモリ容量.
  */
 size_t buddy_get_alloc_memory_size(Buddy_manager const* const bman) {
-    return (bman->total_frame_nr * FRAME_SIZE) - buddy_get_free_memory_size(bman);
+    return buddy_get_total_memory_size(bman) - buddy_get_free_memory_size(bman);
 }
 
 
@@ -281,10 +377,316 @@ size_t buddy_get_alloc_memory_size(Buddy_manager const* const bman) {
  * @return 全メモリ量.
  */
 size_t buddy_get_total_memory_size(Buddy_manager const* const bman) {
-    return bman->total_frame_nr * FRAME_SIZE;
+    return bman->total_frame_nr * bman->frame_size;
+}
+
+
+/**
+ * @brief 指定サイズを満たす最小のオーダーを求める.
+ * @param bman 対象のマネージャ.
+ * @param size 求めるサイズ.
+ * @return オーダー, sizeが最大ブロックより大きい場合はmax_orderが返る.
+ */
+uint8_t buddy_size_to_order(Buddy_manager const* const bman, size_t size) {
+    size_t frame_nr = (size + bman->frame_size - 1) >> bman->frame_size_log2;
+    if (frame_nr <= 1) {
+        return 0;
+    }
+
+    /* ceil(log2(frame_nr)) */
+    size_t order = (size_t)(sizeof(unsigned long) * 8) - (size_t)__builtin_clzl(frame_nr - 1);
+    return (bman->max_order < order) ? bman->max_order : (uint8_t)order;
+}
+
+
+/**
+ * @brief 指定オーダーのメモリを確保する.
+ * @param bman  buddy_init_mmap()で初期化したマネージャ.
+ * @param order 確保するオーダー.
+ * @return 確保したメモリ, 確保出来なかった場合NULLが返る.
+ */
+void* buddy_alloc_memory(Buddy_manager* const bman, uint8_t order) {
+    assert(bman->region != NULL);
+
+    Frame* f = buddy_alloc_frames(bman, order);
+    return (f == NULL) ? NULL : (void*)get_frame_addr(bman, f);
+}
+
+
+/**
+ * @brief buddy_alloc_memory()で確保したメモリを解放する.
+ * @param bman 確保元のマネージャ.
+ * @param p    解放するメモリ, NULLの場合は何もしない.
+ */
+void buddy_free_memory(Buddy_manager* const bman, void* p) {
+    if (p == NULL) {
+        return;
+    }
+
+    assert(bman->region != NULL);
+    assert(bman->base_addr <= (uintptr_t)p && (uintptr_t)p < bman->base_addr + bman->region_size);
+    assert(((uintptr_t)p & (bman->frame_size - 1)) == 0);
+
+    buddy_free_frames(bman, get_frame_by_addr(bman, (uintptr_t)p));
+}
+
+
+/* ==================== Per-CPU frame caches. ==================== */
+
+static inline void lock_buddy(Buddy_pcp_manager* const pman) {
+    pthread_mutex_lock(&pman->lock);
+}
+
+
+static inline void unlock_buddy(Buddy_pcp_manager* const pman) {
+    pthread_mutex_unlock(&pman->lock);
+}
+
+
+/**
+ * @brief 実行中のCPUのキャッシュを取得してロックする.
+ *        取得後にスレッドが移動してもロックしているので問題はない.
+ * @param pman 対象のマネージャ.
+ * @return ロック済みのキャッシュ.
+ */
+static inline Buddy_pcp* lock_this_cpu(Buddy_pcp_manager* const pman) {
+    int cpu = sched_getcpu();
+    Buddy_pcp* pcp = &pman->pcps[(cpu < 0) ? 0 : (size_t)cpu % pman->cpu_nr];
+    pthread_mutex_lock(&pcp->lock);
+    return pcp;
+}
+
+
+static inline void unlock_cpu(Buddy_pcp* pcp) {
+    pthread_mutex_unlock(&pcp->lock);
+}
+
+
+/**
+ * @brief 共有マネージャからまとめてフレームを取ってきてリストへ繋ぐ.
+ * @param pman  対象のマネージャ.
+ * @param l     補充するリスト.
+ * @param order 補充するオーダー.
+ */
+static inline void refill_pcp_list(Buddy_pcp_manager* const pman, Buddy_pcp_list* l, uint8_t order) {
+    lock_buddy(pman);
+    for (size_t i = 0; i < pman->batch; i++) {
+        Frame* f = buddy_alloc_frames(&pman->bman, order);
+        if (f == NULL) {
+            break;
+        }
+        elist_insert_prev(&l->frames, &f->list);
+        ++l->count;
+    }
+    unlock_buddy(pman);
+}
+
+
+/**
+ * @brief リストの末尾(冷たい方)からn個のフレームを共有マネージャへ返す.
+ * @param pman  対象のマネージャ.
+ * @param l     返却元のリスト.
+ * @param n     返却するフレーム数.
+ */
+static inline void drain_pcp_list(Buddy_pcp_manager* const pman, Buddy_pcp_list* l, size_t n) {
+    assert(n <= l->count);
+
+    lock_buddy(pman);
+    for (size_t i = 0; i < n; i++) {
+        buddy_free_frames(&pman->bman, elist_get_frame(elist_remove(l->frames.prev)));
+    }
+    unlock_buddy(pman);
+
+    l->count -= n;
+}
+
+
+/**
+ * @brief CPU毎のキャッシュを持つバディマネージャを初期化.
+ *        キャッシュはオンラインでないCPUの分も含め, 全CPU分作る.
+ * @param pman        初期化対象
+ * @param memory_size バディマネージャの管理するメモリーサイズ.
+ * @return 初期化出来なかった場合NULL, それ以外は引数のマネージャが返る.
+ */
+Buddy_pcp_manager* buddy_pcp_init(Buddy_pcp_manager* const pman, size_t memory_size) {
+    assert(pman != NULL);
+
+    long n = sysconf(_SC_NPROCESSORS_CONF);
+    pman->cpu_nr = (n < 1) ? 1 : (size_t)n;
+    pman->high   = BUDDY_PCP_HIGH;
+    pman->low    = BUDDY_PCP_LOW;
+    pman->batch  = BUDDY_PCP_BATCH;
+
+    pman->pcps = aligned_alloc(_Alignof(Buddy_pcp), sizeof(Buddy_pcp) * pman->cpu_nr);
+    if (pman->pcps == NULL) {
+        return NULL;
+    }
+
+    if (buddy_init(&pman->bman, memory_size) == NULL) {
+        free(pman->pcps);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pman->lock, NULL);
+    for (size_t i = 0; i < pman->cpu_nr; i++) {
+        Buddy_pcp* pcp = &pman->pcps[i];
+        pthread_mutex_init(&pcp->lock, NULL);
+        for (uint8_t j = 0; j <= BUDDY_PCP_MAX_ORDER; j++) {
+            elist_init(&pcp->lists[j].frames);
+            pcp->lists[j].count = 0;
+        }
+    }
+
+    return pman;
+}
+
+
+/**
+ * @brief CPU毎のキャッシュを持つバディマネージャを破棄.
+ * @param pman 破棄対象
+ */
+void buddy_pcp_destruct(Buddy_pcp_manager* const pman) {
+    for (size_t i = 0; i < pman->cpu_nr; i++) {
+        pthread_mutex_destroy(&pman->pcps[i].lock);
+    }
+    pthread_mutex_destroy(&pman->lock);
+    free(pman->pcps);
+    buddy_destruct(&pman->bman);
+    memset(pman, 0, sizeof(Buddy_pcp_manager));
+}
+
+
+/**
+ * @brief 指定オーダーのフレームを確保する.
+ *        BUDDY_PCP_MAX_ORDER以下のオーダーは実行中CPUのキャッシュから取る.
+ * @param pman          確保先のマネージャ.
+ * @param request_order 確保するオーダー.
+ * @param is_cold       trueの場合, キャッシュに残っていなさそうなフレームを返す(DMA向けなど).
+ * @return 確保出来なかった場合NULLが返る.
+ */
+Frame* buddy_pcp_alloc_frames(Buddy_pcp_manager* const pman, uint8_t request_order, bool is_cold) {
+    assert(pman != NULL);
+
+    if (BUDDY_PCP_MAX_ORDER < request_order) {
+        lock_buddy(pman);
+        Frame* f = buddy_alloc_frames(&pman->bman, request_order);
+        unlock_buddy(pman);
+        return f;
+    }
+
+    Buddy_pcp* pcp    = lock_this_cpu(pman);
+    Buddy_pcp_list* l = &pcp->lists[request_order];
+
+    if (l->count == 0) {
+        refill_pcp_list(pman, l, request_order);
+    }
+
+    Frame* f = NULL;
+    if (l->count != 0) {
+        f = elist_get_frame(elist_remove((is_cold == true) ? l->frames.prev : l->frames.next));
+        --l->count;
+    }
+    unlock_cpu(pcp);
+
+    return f;
+}
+
+
+/**
+ * @brief フレームを解放する.
+ *        BUDDY_PCP_MAX_ORDER以下のオーダーは実行中CPUのキャッシュへ返し, highを超えたらlowまで共有マネージャへ返す.
+ * @param pman    フレームの返却先マネージャ.
+ * @param ffs     解放するフレーム.
+ * @param is_cold trueの場合, フレームの内容がCPUキャッシュに乗っていないのでリスト末尾に繋ぐ.
+ */
+void buddy_pcp_free_frames(Buddy_pcp_manager* const pman, Frame* ffs, bool is_cold) {
+    assert(pman != NULL);
+    assert(ffs != NULL);
+
+    uint8_t order = ffs->order;
+    if (BUDDY_PCP_MAX_ORDER < order) {
+        lock_buddy(pman);
+        buddy_free_frames(&pman->bman, ffs);
+        unlock_buddy(pman);
+        return;
+    }
+
+    Buddy_pcp* pcp    = lock_this_cpu(pman);
+    Buddy_pcp_list* l = &pcp->lists[order];
+
+    if (is_cold == true) {
+        elist_insert_prev(&l->frames, &ffs->list);
+    } else {
+        elist_insert_next(&l->frames, &ffs->list);
+    }
+    ++l->count;
+
+    if (pman->high < l->count) {
+        drain_pcp_list(pman, l, l->count - pman->low);
+    }
+    unlock_cpu(pcp);
+}
+
+
+/**
+ * @brief 全CPUのキャッシュを共有マネージャへ返す.
+ *        大きいオーダーが断片化で確保できない時などに呼ぶ.
+ * @param pman 対象のマネージャ.
+ */
+void buddy_pcp_drain_all(Buddy_pcp_manager* const pman) {
+    for (size_t i = 0; i < pman->cpu_nr; i++) {
+        Buddy_pcp* pcp = &pman->pcps[i];
+        pthread_mutex_lock(&pcp->lock);
+        for (uint8_t j = 0; j <= BUDDY_PCP_MAX_ORDER; j++) {
+            drain_pcp_list(pman, &pcp->lists[j], pcp->lists[j].count);
+        }
+        unlock_cpu(pcp);
+    }
+}
+
+
+/**
+ * @brief 全CPUのキャッシュにあるフレーム数を求める.
+ * @param pman 対象のマネージャ.
+ * @return フレーム数(オーダー0換算).
+ */
+size_t buddy_pcp_get_cached_frame_nr(Buddy_pcp_manager* const pman) {
+    size_t n = 0;
+    for (size_t i = 0; i < pman->cpu_nr; i++) {
+        Buddy_pcp* pcp = &pman->pcps[i];
+        pthread_mutex_lock(&pcp->lock);
+        for (uint8_t j = 0; j <= BUDDY_PCP_MAX_ORDER; j++) {
+            n += pcp->lists[j].count * BUDDY_SYSTEM_ORDER_NR(j);
+        }
+        unlock_cpu(pcp);
+    }
+
+    return n;
+}
+
+
+/**
+ * @brief キャッシュにあるフレームも含めた空きメモリ容量を求める.
+ * @param pman 求める対象のマネージャ.
+ * @return 空きメモリ容量.
+ */
+size_t buddy_pcp_get_free_memory_size(Buddy_pcp_manager* const pman) {
+    size_t cached = buddy_pcp_get_cached_frame_nr(pman) * pman->bman.frame_size;
+
+    lock_buddy(pman);
+    size_t s = buddy_get_free_memory_size(&pman->bman);
+    unlock_buddy(pman);
+
+    return s + cached;
 }
 
 
+#ifndef BUDDY_SYSTEM_LIBRARY
+
+
+#include "minunit.h"
+
+
 /* ==================== Test functions. ==================== */
 
 static char const* test_elist_foreach(void) {
@@ -327,6 +729,8 @@ static char const* test_elist_foreach(void) {
 static char const* test_get_frame_addr(void) {
     Buddy_manager bman;
     bman.frame_pool = malloc(sizeof(Frame) * 10);
+    bman.base_addr = 0;
+    bman.frame_size_log2 = 12;
 
     MIN_UNIT_ASSERT("get_frame_addr is wrong.", 0 == get_frame_addr(&bman, bman.frame_pool));
     MIN_UNIT_ASSERT("get_frame_addr is wrong.", FRAME_SIZE == get_frame_addr(&bman, bman.frame_pool + 1));
@@ -386,6 +790,52 @@ static char const* test_buddy_alloc_free(void) {
     MIN_UNIT_ASSERT("buddy_init is wrong.", 0 == buddy_get_free_memory_size(&bman));
     MIN_UNIT_ASSERT("buddy_init is wrong.", memory_size == buddy_get_alloc_memory_size(&bman));
 
+    buddy_destruct(&bman);
+
+    return NULL;
+}
+
+
+static char const* test_buddy_bitmap(void) {
+    size_t const frame_nr = 1000;
+    Buddy_manager bman;
+    buddy_init(&bman, FRAME_SIZE * frame_nr);
+
+    /* 1000 = 512 + 256 + 128 + 64 + 32 + 8 */
+    MIN_UNIT_ASSERT("order_bitmap is wrong.", bman.order_bitmap == 0x3e8);
+
+    Frame* fs[1000];
+    for (size_t i = 0; i < frame_nr; i++) {
+        fs[i] = buddy_alloc_frames(&bman, 0);
+        MIN_UNIT_ASSERT("buddy_alloc_frames is wrong.", fs[i] != NULL);
+    }
+    MIN_UNIT_ASSERT("buddy_alloc_frames is wrong.", buddy_alloc_frames(&bman, 0) == NULL);
+    MIN_UNIT_ASSERT("order_bitmap is wrong.", bman.order_bitmap == 0);
+
+    /* Free odd frames first, no buddy can be merged. */
+    for (size_t i = 1; i < frame_nr; i += 2) {
+        buddy_free_frames(&bman, fs[i]);
+    }
+    MIN_UNIT_ASSERT("buddy_free_frames is wrong.", bman.order_bitmap == 0x1);
+    MIN_UNIT_ASSERT("buddy_free_frames is wrong.", bman.free_frame_nr[0] == frame_nr / 2);
+
+    for (size_t i = 0; i < frame_nr; i += 2) {
+        buddy_free_frames(&bman, fs[i]);
+    }
+    MIN_UNIT_ASSERT("buddy_free_frames is wrong.", bman.order_bitmap == 0x3e8);
+    MIN_UNIT_ASSERT("buddy_free_frames is wrong.", buddy_get_free_memory_size(&bman) == FRAME_SIZE * frame_nr);
+
+    /* Splitting takes the smallest order which is larger than the request. */
+    Frame* f = buddy_alloc_frames(&bman, 1);
+    MIN_UNIT_ASSERT("buddy_alloc_frames is wrong.", get_frame_addr(&bman, f) == FRAME_SIZE * 992);
+    MIN_UNIT_ASSERT("buddy_alloc_frames is wrong.", bman.order_bitmap == 0x3e6);
+    buddy_free_frames(&bman, f);
+    MIN_UNIT_ASSERT("buddy_free_frames is wrong.", bman.order_bitmap == 0x3e8);
+
+    MIN_UNIT_ASSERT("buddy_alloc_frames is wrong.", buddy_alloc_frames(&bman, BUDDY_SYSTEM_MAX_ORDER) == NULL);
+
+    buddy_destruct(&bman);
+
     return NULL;
 }
 
@@ -396,6 +846,7 @@ static char const* all_tests(void) {
     MIN_UNIT_RUN(test_get_buddy_frame);
     MIN_UNIT_RUN(test_buddy_init);
     MIN_UNIT_RUN(test_buddy_alloc_free);
+    MIN_UNIT_RUN(test_buddy_bitmap);
 
     return NULL;
 }
@@ -427,19 +878,19 @@ static inline void newline(void) {
 
 static inline void print_frame_info(Buddy_manager const * const bman, Frame const * const f) {
     uintptr_t s = get_frame_addr(bman, f);
-    printf("idx: %5zd, addr: 0x%08zx ~ 0x%08zx\n", get_frame_idx(bman, f), s, s + (FRAME_SIZE * BUDDY_SYSTEM_ORDER_NR(f->order)));
+    printf("idx: %5zd, addr: 0x%08zx ~ 0x%08zx\n", get_frame_idx(bman, f), s, s + (bman->frame_size * BUDDY_SYSTEM_ORDER_NR(f->order)));
 }
 
 
 static inline void print_buddy_system(Buddy_manager* const bman) {
-    size_t total_mem_size = (bman->total_frame_nr * FRAME_SIZE);
+    size_t total_mem_size = buddy_get_total_memory_size(bman);
     printf("Total Frame       : %zd\n", bman->total_frame_nr);
     printf("Total Memory Size : %zd KB\n", TO_KB(total_mem_size));
     printf("Free Memory Size  : %zd KB\n", TO_KB(buddy_get_free_memory_size(bman)));
     printf("Alloc Memory Size : %zd KB\n", TO_KB(buddy_get_alloc_memory_size(bman)));
-    printf("Address region: 0x00000000 ~ 0x%08zx\n", FRAME_SIZE * bman->total_frame_nr);
+    printf("Address region: 0x%08zx ~ 0x%08zx\n", bman->base_addr, bman->base_addr + total_mem_size);
 
-    for (uint8_t i = 0; i < BUDDY_SYSTEM_MAX_ORDER; i++) {
+    for (uint8_t i = 0; i < bman->max_order; i++) {
         printf("  Order %02u\n", i);
 
         size_t n = bman->free_frame_nr[i];
@@ -559,3 +1010,6 @@ int main(void) {
 
     return EXIT_SUCCESS;
 }
+
+
+#endif
@@ -0,0 +1,125 @@
+/**
+ * @file buddy_system.h
+ * @brief Buddy System allocater header.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-09-23
+ */
+
+#ifndef _BUDDY_SYSTEM_H_
+#define _BUDDY_SYSTEM_H_
+
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "elist.h"
+
+
+/* Order in buddy system: 0 1 2 3  4  5  6   7   8   9   10 */
+/* The number of frame  : 1 2 4 8 16 32 64 128 256 512 1024 */
+#define BUDDY_SYSTEM_MAX_ORDER (10 + 1)
+#define BUDDY_SYSTEM_ORDER_NR(order) (1U << (order))
+
+/* frame size is 4 KB in x86_32. */
+#define FRAME_SIZE 0x1000U
+
+#define ORDER_FRAME_SIZE(order) (BUDDY_SYSTEM_ORDER_NR(order) * FRAME_SIZE)
+
+/* Upper limit of max_order given to buddy_init_mmap(). */
+#define BUDDY_SYSTEM_MAX_ORDER_LIMIT (20 + 1)
+
+
+struct frame {
+    Elist list;
+    uint8_t order;
+};
+typedef struct frame Frame;
+
+
+/* Buddy system manager. */
+struct buddy_manager {
+    Frame* frame_pool;                                  /* 管理用の全フレーム */
+    size_t total_frame_nr;                              /* マネージャの持つ全フレーム数 */
+    size_t free_frame_nr[BUDDY_SYSTEM_MAX_ORDER_LIMIT]; /* 各オーダーの空きフレーム数 */
+    Elist frames[BUDDY_SYSTEM_MAX_ORDER_LIMIT];         /* 各オーダーのリスト先頭要素(ダミー), 実際のデータはこのリストのnext要素から始まる. */
+    uint64_t* free_bitmap;                              /* 空きブロック先頭フレームのビットが立つ. フレームの状態はこれで管理する. */
+    uint32_t order_bitmap;                              /* リストが空でないオーダーのビットが立つ. */
+    uint8_t max_order;                                  /* オーダーの数, buddy_init()ではBUDDY_SYSTEM_MAX_ORDER. */
+    uint8_t frame_size_log2;
+    size_t frame_size;
+    uintptr_t base_addr;                                /* 0番フレームのアドレス, シミュレータでは0. */
+    void* region;                                       /* mmapした領域, シミュレータではNULL. */
+    size_t region_size;
+};
+typedef struct buddy_manager Buddy_manager;
+
+
+extern Buddy_manager* buddy_init(Buddy_manager* const, size_t);
+extern Buddy_manager* buddy_init_mmap(Buddy_manager* const, size_t, size_t, uint8_t);
+extern void buddy_destruct(Buddy_manager* const);
+extern Frame* buddy_alloc_frames(Buddy_manager* const, uint8_t);
+extern void buddy_free_frames(Buddy_manager* const, Frame*);
+extern uintptr_t get_frame_addr(Buddy_manager const* const, Frame const* const);
+extern Frame* get_frame_by_addr(Buddy_manager const* const, uintptr_t);
+extern size_t buddy_get_free_memory_size(Buddy_manager const* const);
+extern size_t buddy_get_alloc_memory_size(Buddy_manager const* const);
+extern size_t buddy_get_total_memory_size(Buddy_manager const* const);
+extern void* buddy_alloc_memory(Buddy_manager* const, uint8_t);
+extern void buddy_free_memory(Buddy_manager* const, void*);
+extern uint8_t buddy_size_to_order(Buddy_manager const* const, size_t);
+
+
+/*
+ * Per-CPU frame caches.
+ * Small orders are served from the list of the running CPU,
+ * the shared Buddy_manager is touched only to refill or drain BUDDY_PCP_BATCH frames.
+ */
+enum {
+    BUDDY_PCP_MAX_ORDER = 1,   /* Orders up to this are cached. */
+    BUDDY_PCP_BATCH     = 32,  /* The number of frames moved at once. */
+    BUDDY_PCP_HIGH      = 192, /* Drain when the list has more frames than this. */
+    BUDDY_PCP_LOW       = 64,  /* The number of frames left after draining. */
+};
+
+
+/* Hot frames are at the head of the list and cold frames are at the tail. */
+struct buddy_pcp_list {
+    Elist frames;
+    size_t count;
+};
+typedef struct buddy_pcp_list Buddy_pcp_list;
+
+
+struct buddy_pcp {
+    _Alignas(64) pthread_mutex_t lock; /* Threads on the same CPU and migrated threads share this. */
+    Buddy_pcp_list lists[BUDDY_PCP_MAX_ORDER + 1];
+};
+typedef struct buddy_pcp Buddy_pcp;
+
+
+struct buddy_pcp_manager {
+    Buddy_manager bman;
+    pthread_mutex_t lock; /* for bman. */
+    Buddy_pcp* pcps;
+    size_t cpu_nr;
+    size_t high;
+    size_t low;
+    size_t batch;
+};
+typedef struct buddy_pcp_manager Buddy_pcp_manager;
+
+
+extern Buddy_pcp_manager* buddy_pcp_init(Buddy_pcp_manager* const, size_t);
+extern void buddy_pcp_destruct(Buddy_pcp_manager* const);
+extern Frame* buddy_pcp_alloc_frames(Buddy_pcp_manager* const, uint8_t, bool);
+extern void buddy_pcp_free_frames(Buddy_pcp_manager* const, Frame*, bool);
+extern void buddy_pcp_drain_all(Buddy_pcp_manager* const);
+extern size_t buddy_pcp_get_cached_frame_nr(Buddy_pcp_manager* const);
+extern size_t buddy_pcp_get_free_memory_size(Buddy_pcp_manager* const);
+
+
+
+#endif
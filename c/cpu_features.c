@@ -0,0 +1,132 @@
+/**
+ * @file cpu_features.c
+ * @brief CPU feature detection by cpuid.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-20
+ */
+
+#include <cpuid.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "cpu_features.h"
+
+
+enum {
+    CPUID_1_ECX_OSXSAVE  = 1u << 27,
+    CPUID_1_ECX_AVX      = 1u << 28,
+    CPUID_1_EDX_SSE2     = 1u << 26,
+    CPUID_7_EBX_AVX2     = 1u << 5,
+    CPUID_7_EBX_ERMS     = 1u << 9,
+    CPUID_7_EBX_AVX512F  = 1u << 16,
+    XCR0_SSE_AVX         = 0x06, /* XMM and YMM state. */
+    XCR0_AVX512          = 0xe6, /* XMM, YMM, opmask and ZMM state. */
+    DEFAULT_LLC_SIZE     = 8 * 1024 * 1024,
+};
+
+
+static Cpu_features features;
+static bool is_detected = false;
+
+
+static inline uint64_t read_xcr0(void) {
+    uint32_t eax, edx;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((uint64_t)edx << 32) | eax;
+}
+
+
+/*
+ * Find the largest data/unified cache by cpuid leaf 4 (deterministic cache parameters).
+ * Some CPUs do not have the leaf, so sysconf is tried next.
+ */
+static size_t detect_llc_size(void) {
+    size_t llc = 0;
+    unsigned int eax, ebx, ecx, edx;
+
+    if (4 <= __get_cpuid_max(0, NULL)) {
+        for (unsigned int i = 0; i < 16; i++) {
+            __cpuid_count(4, i, eax, ebx, ecx, edx);
+            unsigned int type = eax & 0x1f;
+            if (type == 0) {
+                break;
+            }
+            if (type == 2) {
+                /* Instruction cache. */
+                continue;
+            }
+
+            size_t ways       = ((ebx >> 22) & 0x3ff) + 1;
+            size_t partitions = ((ebx >> 12) & 0x3ff) + 1;
+            size_t line_size  = (ebx & 0xfff) + 1;
+            size_t sets       = (size_t)ecx + 1;
+            size_t s          = ways * partitions * line_size * sets;
+            if (llc < s) {
+                llc = s;
+            }
+        }
+    }
+
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    if (llc == 0) {
+        long s = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        llc = (0 < s) ? (size_t)s : 0;
+    }
+#endif
+
+    return (llc == 0) ? DEFAULT_LLC_SIZE : llc;
+}
+
+
+static void detect_cpu_features(void) {
+    unsigned int eax, ebx, ecx, edx;
+
+    is_detected = true;
+
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0) {
+        features.llc_size = DEFAULT_LLC_SIZE;
+        return;
+    }
+
+    features.sse2 = (edx & CPUID_1_EDX_SSE2) != 0;
+
+    uint64_t xcr0 = 0;
+    bool has_avx  = false;
+    if ((ecx & CPUID_1_ECX_OSXSAVE) != 0) {
+        xcr0    = read_xcr0();
+        has_avx = ((ecx & CPUID_1_ECX_AVX) != 0) && ((xcr0 & XCR0_SSE_AVX) == XCR0_SSE_AVX);
+    }
+
+    if (7 <= __get_cpuid_max(0, NULL)) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        features.erms    = (ebx & CPUID_7_EBX_ERMS) != 0;
+        features.avx2    = has_avx && ((ebx & CPUID_7_EBX_AVX2) != 0);
+        features.avx512f = has_avx && ((ebx & CPUID_7_EBX_AVX512F) != 0) && ((xcr0 & XCR0_AVX512) == XCR0_AVX512);
+    }
+
+    features.llc_size = detect_llc_size();
+}
+
+
+/*
+ * Detect before main() so that other threads never race on the first call.
+ * cpu_features_get() also detects for constructors in other files which may run before this.
+ */
+__attribute__((constructor)) static void init_cpu_features(void) {
+    if (is_detected == false) {
+        detect_cpu_features();
+    }
+}
+
+
+/**
+ * @brief Get features of the running CPU.
+ * @return Pointer to features.
+ */
+Cpu_features const* cpu_features_get(void) {
+    if (is_detected == false) {
+        detect_cpu_features();
+    }
+
+    return &features;
+}
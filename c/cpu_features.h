@@ -0,0 +1,32 @@
+/**
+ * @file cpu_features.h
+ * @brief CPU feature detection by cpuid header.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-20
+ */
+
+#ifndef _CPU_FEATURES_H_
+#define _CPU_FEATURES_H_
+
+
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+struct cpu_features {
+    bool sse2;
+    bool avx2;     /* AVX2 and OS saves YMM state. */
+    bool avx512f;  /* AVX-512F and OS saves ZMM state. */
+    bool erms;     /* Enhanced REP MOVSB/STOSB. */
+    size_t llc_size; /* Last level cache size in byte. */
+};
+typedef struct cpu_features Cpu_features;
+
+
+extern Cpu_features const* cpu_features_get(void);
+
+
+
+#endif
@@ -12,9 +12,49 @@
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include "dlist.h"
 
 
+/*
+ * Slab header.
+ * In pooled list, a slab has the nodes below.
+ *      | slab | node 0 | data 0 | node 1 | data 1 | ... |
+ */
+struct dlist_slab {
+    struct dlist_slab* next;
+};
+typedef struct dlist_slab Dlist_slab;
+
+
+/*
+ * Hash index.
+ * Open addressing with linear probing, the load factor is kept under 1/2.
+ * Entries are removed by backward shift, so there is no tombstone.
+ */
+struct dlist_index_entry {
+    size_t hash;
+    Dlist_node* node; /* NULL means empty entry. */
+};
+typedef struct dlist_index_entry Dlist_index_entry;
+
+struct dlist_index {
+    Dlist_index_entry* entries;
+    size_t size; /* the number of entry, it is power of 2. */
+    size_t nr;   /* the number of used entry. */
+    dlist_hash_func hash;
+    dlist_comp_func comp;
+};
+typedef struct dlist_index Dlist_index;
+
+
+#define ALIGN_UP(x, a) (((x) + ((a) - 1u)) & ~((a) - 1u))
+#define POOL_ALIGN _Alignof(max_align_t)
+#define SLAB_HEADER_SIZE ALIGN_UP(sizeof(Dlist_slab), POOL_ALIGN)
+#define POOLED_NODE_SIZE ALIGN_UP(sizeof(Dlist_node), POOL_ALIGN)
+#define INDEX_INIT_SIZE 16
+
+
 /**
  * @brief List default free function.
  * @param l This is not used.
@@ -25,6 +65,16 @@ static void default_free(Dlist* l, void* d) {
 }
 
 
+/**
+ * @brief Pooled list default free function.
+ *        Data is in slab, so it must NOT be freed.
+ * @param l This is not used.
+ * @param d This is not used.
+ */
+static void pooled_default_free(Dlist* l, void* d) {
+}
+
+
 /**
  * @brief Initialize list.
  * @param l Pointer to list.
@@ -37,11 +87,247 @@ Dlist* dlist_init(Dlist* l, size_t size, dlist_release_func f) {
     l->free = (f == NULL) ? (default_free) : (f);
     l->size = 0;
     l->data_type_size = size;
+    l->slabs = NULL;
+    l->free_nodes = NULL;
+    l->slab_node_nr = 0;
+    l->index = NULL;
 
     return l;
 }
 
 
+/**
+ * @brief Initialize pooled list.
+ *        Nodes and their data are allocated from slabs owned by the list,
+ *        and all slabs are released at once in dlist_destruct().
+ *        So, f must NOT free the data pointer itself (it is in slab).
+ *        f is only needed when the data has other resources.
+ *        Nodes removed by dlist_remove_node() are kept until dlist_destruct() and must NOT be freed.
+ * @param l Pointer to list.
+ * @param size Size of stored data type in list.
+ * @param f Pointer to function for release data in list or NULL.
+ * @param slab_node_nr The number of node in one slab.
+ * @return Pointer to list.
+ */
+Dlist* dlist_init_pooled(Dlist* l, size_t size, dlist_release_func f, size_t slab_node_nr) {
+    assert(slab_node_nr != 0);
+
+    dlist_init(l, size, f);
+    l->free = (f == NULL) ? (pooled_default_free) : (f);
+    l->slab_node_nr = slab_node_nr;
+
+    return l;
+}
+
+
+/**
+ * @brief Check list uses slabs or not.
+ * @param l Pointer to list.
+ * @return true if list is pooled.
+ */
+bool dlist_is_pooled(Dlist const* l) {
+    return (l->slab_node_nr != 0) ? true : false;
+}
+
+
+/**
+ * @brief Allocate new slab and push its nodes into free node list.
+ * @param l Pointer to pooled list.
+ * @return Pointer to slab or NULL.
+ */
+static Dlist_slab* dlist_add_slab(Dlist* l) {
+    size_t const stride = POOLED_NODE_SIZE + ALIGN_UP(l->data_type_size, POOL_ALIGN);
+    Dlist_slab* s = malloc(SLAB_HEADER_SIZE + stride * l->slab_node_nr);
+    if (s == NULL) {
+        return NULL;
+    }
+
+    s->next = l->slabs;
+    l->slabs = s;
+
+    /* Push in reverse order, then nodes are used from lower address. */
+    uintptr_t addr = (uintptr_t)s + SLAB_HEADER_SIZE + stride * l->slab_node_nr;
+    for (size_t i = 0; i < l->slab_node_nr; i++) {
+        addr -= stride;
+        Dlist_node* n = (Dlist_node*)addr;
+        n->data = (void*)(addr + POOLED_NODE_SIZE);
+        n->next = l->free_nodes;
+        l->free_nodes = n;
+    }
+
+    return s;
+}
+
+
+/**
+ * @brief Take node from slab.
+ *        NOTE: n->data is NOT set here.
+ *        It always points data area in slab, but it may not be the next area of n after dlist_swap_data().
+ * @param l Pointer to pooled list.
+ * @return Pointer to node or NULL.
+ */
+static inline Dlist_node* dlist_take_pooled_node(Dlist* l) {
+    if (l->free_nodes == NULL && dlist_add_slab(l) == NULL) {
+        return NULL;
+    }
+
+    Dlist_node* n = l->free_nodes;
+    l->free_nodes = n->next;
+
+    return n;
+}
+
+
+/**
+ * @brief Release data and node.
+ * @param l Pointer to list.
+ * @param n Pointer to released node.
+ */
+static inline void dlist_release_node(Dlist* l, Dlist_node* n) {
+    l->free(l, n->data);
+
+    if (dlist_is_pooled(l) == true) {
+        n->next = l->free_nodes;
+        l->free_nodes = n;
+    } else {
+        free(n);
+    }
+}
+
+
+/**
+ * @brief Default hash function, FNV-1a of the data bytes.
+ * @param l Pointer to list.
+ * @param d Pointer to data.
+ * @return Hash value.
+ */
+static size_t default_hash(Dlist* l, void const* d) {
+    uint8_t const* p = d;
+    uint64_t h = 14695981039346656037ULL;
+
+    for (size_t i = 0; i < l->data_type_size; i++) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+
+    return (size_t)(h ^ (h >> 32));
+}
+
+
+/**
+ * @brief Default comparison function, it compares the data bytes.
+ */
+static bool default_comp(Dlist* l, void* x, void* y) {
+    return (0 == memcmp(x, y, l->data_type_size)) ? true : false;
+}
+
+
+/**
+ * @brief Put node into index entries, the entries must have an empty entry.
+ */
+static inline void dlist_index_put(Dlist_index* idx, size_t hash, Dlist_node* n) {
+    size_t const mask = idx->size - 1;
+    size_t i = hash & mask;
+
+    while (idx->entries[i].node != NULL) {
+        i = (i + 1) & mask;
+    }
+
+    idx->entries[i].hash = hash;
+    idx->entries[i].node = n;
+}
+
+
+/**
+ * @brief Change the number of entry in index.
+ * @param idx Pointer to index.
+ * @param size New number of entry, it must be power of 2.
+ * @return true if succeeded.
+ */
+static bool dlist_index_resize(Dlist_index* idx, size_t size) {
+    Dlist_index_entry* entries = calloc(size, sizeof(Dlist_index_entry));
+    if (entries == NULL) {
+        return false;
+    }
+
+    Dlist_index_entry* old = idx->entries;
+    size_t const old_size = idx->size;
+    idx->entries = entries;
+    idx->size = size;
+
+    for (size_t i = 0; i < old_size; i++) {
+        if (old[i].node != NULL) {
+            dlist_index_put(idx, old[i].hash, old[i].node);
+        }
+    }
+    free(old);
+
+    return true;
+}
+
+
+/**
+ * @brief Add node into index of list.
+ *        If the index cannot be extended, it is disabled and search falls back to scanning.
+ * @param l Pointer to list.
+ * @param n Pointer to added node.
+ */
+static inline void dlist_index_insert(Dlist* l, Dlist_node* n) {
+    Dlist_index* idx = l->index;
+    if (idx == NULL) {
+        return;
+    }
+
+    if (idx->size < (idx->nr + 1) * 2 && dlist_index_resize(idx, idx->size * 2) == false) {
+        dlist_disable_index(l);
+        return;
+    }
+
+    dlist_index_put(idx, idx->hash(l, n->data), n);
+    idx->nr++;
+}
+
+
+/**
+ * @brief Remove node from index of list.
+ * @param l Pointer to list.
+ * @param n Pointer to removed node.
+ */
+static inline void dlist_index_remove(Dlist* l, Dlist_node* n) {
+    Dlist_index* idx = l->index;
+    if (idx == NULL) {
+        return;
+    }
+
+    size_t const mask = idx->size - 1;
+    size_t i = idx->hash(l, n->data) & mask;
+    while (idx->entries[i].node != n) {
+        if (idx->entries[i].node == NULL) {
+            /* The data was changed after insertion, find it by the whole scan. */
+            for (i = 0; i <= mask && idx->entries[i].node != n; i++) {
+            }
+            if (mask < i) {
+                return;
+            }
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+
+    /* Move the following entries back if their home is not between i and j. */
+    for (size_t j = (i + 1) & mask; idx->entries[j].node != NULL; j = (j + 1) & mask) {
+        size_t const home = idx->entries[j].hash & mask;
+        if (((j - home) & mask) >= ((j - i) & mask)) {
+            idx->entries[i] = idx->entries[j];
+            i = j;
+        }
+    }
+
+    idx->entries[i].node = NULL;
+    idx->nr--;
+}
+
+
 /**
  * @brief Allocate new node and set data in it.
  * @param l Pointer to list.
@@ -49,6 +335,18 @@ Dlist* dlist_init(Dlist* l, size_t size, dlist_release_func f) {
  * @return Pointer to new node.
  */
 Dlist_node* dlist_get_new_node(Dlist* l, void* data) {
+    if (dlist_is_pooled(l) == true) {
+        Dlist_node* n = dlist_take_pooled_node(l);
+        if (n == NULL) {
+            return NULL;
+        }
+
+        n->next = n->prev = NULL;
+        memcpy(n->data, data, l->data_type_size);
+
+        return n;
+    }
+
     Dlist_node* n = (Dlist_node*)malloc(sizeof(Dlist_node));
     if (n == NULL) {
         return NULL;
@@ -85,6 +383,7 @@ Dlist_node* dlist_insert_node_next(Dlist* l, Dlist_node* target, Dlist_node* new
     new->prev->next = new;
 
     ++(l->size);
+    dlist_index_insert(l, new);
 
     return new;
 }
@@ -124,6 +423,7 @@ Dlist_node* dlist_insert_node_prev(Dlist* l, Dlist_node* target, Dlist_node* new
     target->prev = new;
 
     ++(l->size);
+    dlist_index_insert(l, new);
 
     return new;
 }
@@ -158,6 +458,7 @@ static inline void dlist_insert_first_node(Dlist* l, Dlist_node* new) {
     l->node->next = l->node->prev = l->node;
 
     ++l->size;
+    dlist_index_insert(l, new);
 
     assert(l->node != NULL);
 }
@@ -234,6 +535,8 @@ Dlist* dlist_insert_data_last(Dlist* l, void* data) {
 Dlist_node* dlist_remove_node(Dlist* l, Dlist_node* target) {
     assert(target != NULL);
 
+    dlist_index_remove(l, target);
+
     if (l->size == 1) {
         /*
          * Size equals 1.
@@ -265,17 +568,107 @@ Dlist_node* dlist_remove_node(Dlist* l, Dlist_node* target) {
 void dlist_delete_node(Dlist* l, Dlist_node* target) {
     assert(target != NULL);
 
-    Dlist_node* n = dlist_remove_node(l, target);
-    l->free(l, n->data);
-    free(n);
+    dlist_release_node(l, dlist_remove_node(l, target));
+}
+
+
+/**
+ * @brief Move the first nodes of src to the last of dst.
+ *        The nodes are relinked as one chain, so neither node nor data is allocated or copied.
+ *        Both lists must NOT be pooled because the nodes in slab cannot move to other list.
+ * @param dst Pointer to destination list.
+ * @param src Pointer to source list.
+ * @param n The maximum number of moved node.
+ * @return The number of moved node.
+ */
+size_t dlist_splice_last(Dlist* dst, Dlist* src, size_t n) {
+    assert(dst != src && dst->data_type_size == src->data_type_size);
+    assert(dlist_is_pooled(dst) == false && dlist_is_pooled(src) == false);
+
+    n = (src->size < n) ? src->size : n;
+    if (n == 0) {
+        return 0;
+    }
+
+    Dlist_node* head = src->node;
+    Dlist_node* tail = head;
+    for (size_t i = 1; i < n; i++) {
+        tail = tail->next;
+    }
+
+    if (src->index != NULL) {
+        Dlist_node* t = head;
+        for (size_t i = 0; i < n; i++, t = t->next) {
+            dlist_index_remove(src, t);
+        }
+    }
+
+    /* Cut the chain from src. */
+    if (n == src->size) {
+        src->node = NULL;
+    } else {
+        head->prev->next = tail->next;
+        tail->next->prev = head->prev;
+        src->node = tail->next;
+    }
+    src->size -= n;
+
+    /* Link the chain after the last of dst. */
+    if (dst->node == NULL) {
+        head->prev = tail;
+        tail->next = head;
+        dst->node = head;
+    } else {
+        Dlist_node* last = dst->node->prev;
+        last->next = head;
+        head->prev = last;
+        tail->next = dst->node;
+        dst->node->prev = tail;
+    }
+    dst->size += n;
+
+    if (dst->index != NULL) {
+        Dlist_node* t = head;
+        for (size_t i = 0; i < n; i++, t = t->next) {
+            dlist_index_insert(dst, t);
+        }
+    }
+
+    return n;
 }
 
 
 /**
  * @brief All node in list be freed.
+ *        In pooled list without release function, this only releases slabs.
  * @param l Pointer to list.
  */
 void dlist_destruct(Dlist* l) {
+    dlist_disable_index(l);
+
+    if (dlist_is_pooled(l) == true) {
+        if (l->node != NULL && l->free != pooled_default_free) {
+            Dlist_node* n = l->node;
+            do {
+                l->free(l, n->data);
+                n = n->next;
+            } while (n != l->node);
+        }
+
+        Dlist_slab* s = l->slabs;
+        while (s != NULL) {
+            Dlist_slab* next = s->next;
+            free(s);
+            s = next;
+        }
+
+        l->slabs = NULL;
+        l->free_nodes = NULL;
+        l->node = NULL;
+        l->size = 0;
+        return;
+    }
+
     if (l->node == NULL) {
         /* Do nothing. */
         return;
@@ -288,13 +681,11 @@ void dlist_destruct(Dlist* l) {
     if (l->size != 1) {
         do {
             t = n->next;
-            l->free(l, n->data);
-            free(n);
+            dlist_release_node(l, n);
             n = t;
         } while (n != limit);
     }
-    l->free(l, t->data);
-    free(t);
+    dlist_release_node(l, t);
 
     l->node = NULL;
     l->size = 0;
@@ -371,6 +762,8 @@ static bool search_loop(Dlist* l, void* data) {
 
 /**
  * @brief Search node witch has argument data.
+ *        If list is indexed, this is O(1) expected time,
+ *        and one of nodes which have equal data is returned (not always the first one).
  * @param l Pointer to list.
  * @param data Pointer to search key data.
  * @return Pointer to searched node.
@@ -380,6 +773,21 @@ Dlist_node* dlist_search_node(Dlist* l, void* data) {
         return NULL;
     }
 
+    if (l->index != NULL) {
+        Dlist_index const* idx = l->index;
+        size_t const mask = idx->size - 1;
+        size_t const hash = idx->hash(l, data);
+
+        for (size_t i = hash & mask; idx->entries[i].node != NULL; i = (i + 1) & mask) {
+            Dlist_node* n = idx->entries[i].node;
+            if (idx->entries[i].hash == hash && (n->data == data || true == idx->comp(l, data, n->data))) {
+                return n;
+            }
+        }
+
+        return NULL;
+    }
+
     Searchable_list sl = {.list = *l, .target = data};
 
     Dlist_node* n = dlist_for_each(&(sl.list), search_loop, false);
@@ -398,3 +806,93 @@ void dlist_swap_data(Dlist_node* x, Dlist_node* y) {
     x->data = y->data;
     y->data = t;
 }
+
+
+/**
+ * @brief Enable hash index for dlist_search_node().
+ *        Data in indexed list must NOT be changed while it is in list,
+ *        call dlist_rebuild_index() after changing data or dlist_swap_data().
+ * @param l Pointer to list.
+ * @param hash Pointer to hash function or NULL, NULL means the hash of the data bytes.
+ * @param comp Pointer to comparison function or NULL, NULL means comparing the data bytes.
+ * @return Pointer to list or NULL if failed.
+ */
+Dlist* dlist_enable_index(Dlist* l, dlist_hash_func hash, dlist_comp_func comp) {
+    dlist_disable_index(l);
+
+    Dlist_index* idx = malloc(sizeof(Dlist_index));
+    if (idx == NULL) {
+        return NULL;
+    }
+
+    idx->entries = NULL;
+    idx->size = 0;
+    idx->nr = 0;
+    idx->hash = (hash == NULL) ? (default_hash) : (hash);
+    idx->comp = (comp == NULL) ? (default_comp) : (comp);
+
+    size_t size = INDEX_INIT_SIZE;
+    while (size < l->size * 2) {
+        size *= 2;
+    }
+
+    if (dlist_index_resize(idx, size) == false) {
+        free(idx);
+        return NULL;
+    }
+    l->index = idx;
+
+    return dlist_rebuild_index(l);
+}
+
+
+/**
+ * @brief Disable and release hash index.
+ * @param l Pointer to list.
+ */
+void dlist_disable_index(Dlist* l) {
+    if (l->index == NULL) {
+        return;
+    }
+
+    free(l->index->entries);
+    free(l->index);
+    l->index = NULL;
+}
+
+
+/**
+ * @brief Check list has hash index or not.
+ * @param l Pointer to list.
+ * @return true if list is indexed.
+ */
+bool dlist_is_indexed(Dlist const* l) {
+    return (l->index != NULL) ? true : false;
+}
+
+
+/**
+ * @brief Make hash index again from all node in list.
+ * @param l Pointer to indexed list.
+ * @return Pointer to list or NULL if index is disabled.
+ */
+Dlist* dlist_rebuild_index(Dlist* l) {
+    Dlist_index* idx = l->index;
+    if (idx == NULL) {
+        return NULL;
+    }
+
+    memset(idx->entries, 0, sizeof(Dlist_index_entry) * idx->size);
+    idx->nr = 0;
+
+    if (l->node != NULL) {
+        Dlist_node* n = l->node;
+        do {
+            dlist_index_put(idx, idx->hash(l, n->data), n);
+            idx->nr++;
+            n = n->next;
+        } while (n != l->node);
+    }
+
+    return l;
+}
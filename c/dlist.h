@@ -30,10 +30,18 @@ typedef void (*dlist_release_func)(struct dlist*, void*);
 
 /*
  * comparison function for list node.
- * It is used in search_list_node().
+ * It returns true if two data are equal.
+ * It is used in the hash index of dlist_search_node().
  */
 typedef bool (*dlist_comp_func)(struct dlist*, void*, void*);
 
+/*
+ * hash function for list node.
+ * Equal data must have the same hash.
+ * It is used in the hash index of dlist_search_node().
+ */
+typedef size_t (*dlist_hash_func)(struct dlist*, void const*);
+
 
 /*
  * List node structure.
@@ -46,6 +54,18 @@ struct dlist_node {
 };
 typedef struct dlist_node Dlist_node;
 
+/*
+ * Slab for pooled list.
+ * Nodes and their data are carved from it.
+ */
+struct dlist_slab;
+
+/*
+ * Hash index from data to node.
+ * It is maintained by insertion and removal.
+ */
+struct dlist_index;
+
 /* List structure */
 struct dlist {
     Dlist_node* node;      /* start position pointer to node.
@@ -54,11 +74,17 @@ struct dlist {
     dlist_release_func free;     /* function for releasing allocated data. */
     size_t size;           /* the number of node. */
     size_t data_type_size; /* it provided by sizeof(data). */
+    struct dlist_slab* slabs;    /* allocated slabs, NULL if list is NOT pooled. */
+    Dlist_node* free_nodes;      /* unused nodes in slabs, they are linked by next. */
+    size_t slab_node_nr;         /* the number of node in one slab, 0 if list is NOT pooled. */
+    struct dlist_index* index;   /* hash index for dlist_search_node(), NULL if list is NOT indexed. */
 };
 typedef struct dlist Dlist;
 
 
 extern Dlist* dlist_init(Dlist*, size_t, dlist_release_func);
+extern Dlist* dlist_init_pooled(Dlist*, size_t, dlist_release_func, size_t);
+extern bool dlist_is_pooled(Dlist const*);
 extern Dlist_node* dlist_get_new_node(Dlist*, void*);
 extern Dlist_node* dlist_insert_node_next(Dlist*, Dlist_node*, Dlist_node*);
 extern Dlist_node* dlist_insert_data_next(Dlist*, Dlist_node*, void*);
@@ -70,12 +96,17 @@ extern Dlist* dlist_insert_node_last(Dlist*, Dlist_node*);
 extern Dlist* dlist_insert_data_last(Dlist*, void*);
 extern Dlist_node* dlist_remove_node(Dlist*, Dlist_node* target);
 extern void dlist_delete_node(Dlist*, Dlist_node* target);
+extern size_t dlist_splice_last(Dlist*, Dlist*, size_t);
 extern void dlist_destruct(Dlist*);
 extern size_t dlist_get_size(Dlist const*);
 extern Dlist_node* dlist_for_each(Dlist* const, dlist_for_each_func const, bool const);
 extern Dlist_node* dlist_node_for_each(Dlist* const, Dlist_node*, dlist_for_each_func const, bool const);
 extern Dlist_node* dlist_search_node(Dlist*, void*);
 extern void dlist_swap_data(Dlist_node*, Dlist_node*);
+extern Dlist* dlist_enable_index(Dlist*, dlist_hash_func, dlist_comp_func);
+extern void dlist_disable_index(Dlist*);
+extern bool dlist_is_indexed(Dlist const*);
+extern Dlist* dlist_rebuild_index(Dlist*);
 
 
 #define dlist_get_data(type, node_p) (*(type*)((node_p)->data))
@@ -1,108 +1,473 @@
+/**
+ * @file fit_allocators.c
+ * @brief First-fit, next-fit, best-fit and worst-fit allocators.
+ *        The memory is divided into units, an object takes a run of contiguous units.
+ *        Adjacent free runs are coalesced by the boundary tags in the descriptors of the head and the tail unit.
+ *        First-fit and next-fit scan the heads of free runs in the bitmap by the address order.
+ *        Best-fit and worst-fit use a treap of free runs ordered by (size, index), they are O(log n).
+ *        With FIT_ALLOCATORS_LIBRARY, main() is not compiled.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-24
+ */
+
+#include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <assert.h>
+#include "fit_allocators.h"
 
-struct block {
-    uintptr_t addr;
-    size_t size;
-    bool is_alloc;
-};
-typedef struct block Block;
 
-static const size_t TOTAL_MEMORY_SIZE_BYTE      = 1024 * 8;
-static const size_t BLOCK_MEMORY_UNIT_SIZE_BYTE = 256;
-static const size_t BLOCK_COUNT = TOTAL_MEMORY_SIZE_BYTE / BLOCK_MEMORY_UNIT_SIZE_BYTE;
+#define FIT_NIL UINT32_MAX
+#define ALLOC_FLAG 0x80000000U
+#define MAX_UNIT_NR (ALLOC_FLAG - 1)
+#define BITMAP_WORD_BIT_NR 64U
 
-struct block_strage {
-    Block blocks[BLOCK_COUNT];
+
+static char const* const policy_names[FIT_POLICY_NR] = {
+    "FirstFit",
+    "NextFit",
+    "BestFit",
+    "WorstFit",
 };
-typedef struct block_strage BlockStrage;
 
 
+static inline uint32_t run_size(Fit_allocator const* fa, uint32_t i)
+{
+    return fa->blocks[i].size & ~ALLOC_FLAG;
+}
 
-static BlockStrage* block_strage_create();
-static void block_strage_destroy(BlockStrage*);
-static size_t block_strage_free_size(BlockStrage const*);
-static void block_strage_dump(char const*, BlockStrage const*);
-static void* alloc_firstfit(BlockStrage*, size_t);
 
+static inline bool is_alloc(Fit_allocator const* fa, uint32_t i)
+{
+    return (fa->blocks[i].size & ALLOC_FLAG) != 0;
+}
 
-int main(void)
+
+/* Write the boundary tags. */
+static inline void set_run(Fit_allocator* fa, uint32_t head, uint32_t size, bool alloc)
 {
-    BlockStrage* bs_first_fit = block_strage_create();
-    /* BlockStrage* next_fit = block_strage_create(); */
+    uint32_t s = size | ((alloc == true) ? ALLOC_FLAG : 0);
 
-    alloc_firstfit(bs_first_fit, 100);
-    alloc_firstfit(bs_first_fit, 100);
-    block_strage_dump("FirstFit", bs_first_fit);
-    assert(block_strage_free_size(bs_first_fit) == (TOTAL_MEMORY_SIZE_BYTE - BLOCK_MEMORY_UNIT_SIZE_BYTE * 2));
+    fa->blocks[head].size            = s;
+    fa->blocks[head + size - 1].size = s;
+}
 
-    block_strage_destroy(bs_first_fit);
 
-    return 0;
+/*
+ * ==================== Size ordered treap. ====================
+ * The priority is a hash of the index, so the descriptor does not store it.
+ */
+
+
+static inline uint32_t get_priority(uint32_t i)
+{
+    i *= 0x9E3779B1U;
+    return i ^ (i >> 15);
+}
+
+
+static inline bool is_key_less(Fit_allocator const* fa, uint32_t t, uint32_t size, uint32_t idx)
+{
+    uint32_t s = run_size(fa, t);
+    return (s < size) || (s == size && t < idx);
 }
 
 
-static BlockStrage* block_strage_create()
+/* Nodes less than (size, idx) go to l, the others go to r. */
+static void tree_split(Fit_allocator* fa, uint32_t t, uint32_t size, uint32_t idx, uint32_t* l, uint32_t* r)
 {
-    BlockStrage* bs = malloc(sizeof(BlockStrage));
+    if (t == FIT_NIL) {
+        *l = *r = FIT_NIL;
+        return;
+    }
 
-    uintptr_t addr =  (uintptr_t)malloc(TOTAL_MEMORY_SIZE_BYTE);
-    for (size_t i = 0; i < BLOCK_COUNT; i++) {
-        Block* b    = &bs->blocks[i];
-        b->addr     = addr;
-        b->size     = BLOCK_MEMORY_UNIT_SIZE_BYTE;
-        b->is_alloc = false;
-        addr += BLOCK_MEMORY_UNIT_SIZE_BYTE;
+    if (is_key_less(fa, t, size, idx) == true) {
+        tree_split(fa, fa->blocks[t].right, size, idx, &fa->blocks[t].right, r);
+        *l = t;
+    } else {
+        tree_split(fa, fa->blocks[t].left, size, idx, l, &fa->blocks[t].left);
+        *r = t;
     }
+}
 
-    return bs;
+
+/* All keys in a are less than the keys in b. */
+static uint32_t tree_merge(Fit_allocator* fa, uint32_t a, uint32_t b)
+{
+    if (a == FIT_NIL) {
+        return b;
+    }
+    if (b == FIT_NIL) {
+        return a;
+    }
+
+    if (get_priority(b) < get_priority(a)) {
+        fa->blocks[a].right = tree_merge(fa, fa->blocks[a].right, b);
+        return a;
+    }
+
+    fa->blocks[b].left = tree_merge(fa, a, fa->blocks[b].left);
+    return b;
 }
 
 
-static void block_strage_destroy(BlockStrage* bs)
+static void tree_insert(Fit_allocator* fa, uint32_t n)
 {
-    free((void*)bs->blocks[0].addr);
-    free(bs);
+    uint32_t l, r;
+
+    fa->blocks[n].left  = FIT_NIL;
+    fa->blocks[n].right = FIT_NIL;
+    tree_split(fa, fa->root, run_size(fa, n), n, &l, &r);
+    fa->root = tree_merge(fa, tree_merge(fa, l, n), r);
 }
 
-static size_t block_strage_free_size(BlockStrage const* bs)
+
+static void tree_remove(Fit_allocator* fa, uint32_t n)
+{
+    uint32_t l, m, r;
+
+    tree_split(fa, fa->root, run_size(fa, n), n, &l, &r);
+    tree_split(fa, r, run_size(fa, n), n + 1, &m, &r);
+    assert(m == n);
+    fa->root = tree_merge(fa, l, r);
+}
+
+
+/* The smallest run which has size units at least, the lowest index is taken in the same size. */
+static uint32_t tree_lower_bound(Fit_allocator const* fa, uint32_t size)
 {
-    size_t sum = 0;
-    for (size_t i = 0; i < BLOCK_COUNT; i++) {
-        Block const* b = &bs->blocks[i];
+    uint32_t found = FIT_NIL;
 
-        if (b->is_alloc == false) {
-            sum += b->size;
+    for (uint32_t t = fa->root; t != FIT_NIL;) {
+        if (size <= run_size(fa, t)) {
+            found = t;
+            t     = fa->blocks[t].left;
+        } else {
+            t = fa->blocks[t].right;
         }
     }
 
-    return sum;
+    return found;
 }
 
 
-static void block_strage_dump(char const* tag, BlockStrage const* bs)
+static uint32_t tree_max(Fit_allocator const* fa)
 {
-    printf("%s\n", tag);
-    printf("  Free size: %zd byte\n", block_strage_free_size(bs));
-    printf("  Used size: %zd byte\n", TOTAL_MEMORY_SIZE_BYTE - block_strage_free_size(bs));
+    uint32_t t = fa->root;
+
+    if (t != FIT_NIL) {
+        while (fa->blocks[t].right != FIT_NIL) {
+            t = fa->blocks[t].right;
+        }
+    }
+
+    return t;
 }
 
 
-static void* alloc_firstfit(BlockStrage* bs, size_t size)
+/*
+ * ==================== Free runs. ====================
+ */
+
+
+static inline void set_free_bit(Fit_allocator* fa, uint32_t i)
+{
+    fa->free_bitmap[i / BITMAP_WORD_BIT_NR] |= 1ULL << (i % BITMAP_WORD_BIT_NR);
+}
+
+
+static inline void clear_free_bit(Fit_allocator* fa, uint32_t i)
 {
-    for (size_t i = 0; i < BLOCK_COUNT; i++) {
-        Block* b = &bs->blocks[i];
+    fa->free_bitmap[i / BITMAP_WORD_BIT_NR] &= ~(1ULL << (i % BITMAP_WORD_BIT_NR));
+}
+
+
+/* The head of the first free run at from or after. */
+static uint32_t find_next_free(Fit_allocator const* fa, uint32_t from)
+{
+    if (fa->unit_nr <= from) {
+        return FIT_NIL;
+    }
 
-        // TODO alloc continuous blocks.
-        if ((b->is_alloc == false) && (size <= b->size)) {
-            b->is_alloc = true;
-            return (void*)b->addr;
+    uint32_t w    = from / BITMAP_WORD_BIT_NR;
+    uint64_t bits = fa->free_bitmap[w] & (~0ULL << (from % BITMAP_WORD_BIT_NR));
+    uint32_t const word_nr = (fa->unit_nr + BITMAP_WORD_BIT_NR - 1) / BITMAP_WORD_BIT_NR;
+
+    while (bits == 0) {
+        if (word_nr <= ++w) {
+            return FIT_NIL;
         }
+        bits = fa->free_bitmap[w];
     }
 
-    return NULL;
+    return w * BITMAP_WORD_BIT_NR + (uint32_t)__builtin_ctzll(bits);
+}
+
+
+static void insert_free_run(Fit_allocator* fa, uint32_t head, uint32_t size)
+{
+    set_run(fa, head, size, false);
+    set_free_bit(fa, head);
+    tree_insert(fa, head);
+    fa->free_unit_nr += size;
+    fa->free_run_nr++;
+}
+
+
+static void remove_free_run(Fit_allocator* fa, uint32_t head)
+{
+    tree_remove(fa, head);
+    clear_free_bit(fa, head);
+    fa->free_unit_nr -= run_size(fa, head);
+    fa->free_run_nr--;
 }
+
+
+/* Scan the free runs in [from, to). */
+static uint32_t scan_fit(Fit_allocator const* fa, uint32_t size, uint32_t from, uint32_t to)
+{
+    for (uint32_t i = find_next_free(fa, from); i < to; i = find_next_free(fa, i + run_size(fa, i))) {
+        if (size <= run_size(fa, i)) {
+            return i;
+        }
+    }
+
+    return FIT_NIL;
+}
+
+
+static uint32_t find_fit(Fit_allocator const* fa, uint32_t size)
+{
+    uint32_t i;
+
+    switch (fa->policy) {
+        case FIT_FIRST:
+            return scan_fit(fa, size, 0, fa->unit_nr);
+        case FIT_NEXT:
+            i = scan_fit(fa, size, fa->cursor, fa->unit_nr);
+            return (i != FIT_NIL) ? i : scan_fit(fa, size, 0, fa->cursor);
+        case FIT_BEST:
+            return tree_lower_bound(fa, size);
+        case FIT_WORST:
+            i = tree_max(fa);
+            return (i != FIT_NIL && size <= run_size(fa, i)) ? i : FIT_NIL;
+        default:
+            return FIT_NIL;
+    }
+}
+
+
+/*
+ * ==================== Interfaces. ====================
+ */
+
+
+/**
+ * @brief Create an allocator which manages total_size bytes.
+ * @param policy    The placement policy.
+ * @param total_size The size of the managed memory, it is rounded down to the unit size.
+ * @param unit_size The allocation unit, it must be a power of 2.
+ * @return NULL if failed.
+ */
+Fit_allocator* fit_allocator_create(Fit_policy policy, size_t total_size, size_t unit_size)
+{
+    if (FIT_POLICY_NR <= policy || unit_size == 0 || (unit_size & (unit_size - 1)) != 0) {
+        return NULL;
+    }
+
+    size_t const unit_nr = total_size / unit_size;
+    if (unit_nr == 0 || MAX_UNIT_NR < unit_nr) {
+        return NULL;
+    }
+
+    Fit_allocator* fa = malloc(sizeof(Fit_allocator));
+    if (fa == NULL) {
+        return NULL;
+    }
+
+    void* mem;
+    size_t const word_nr = (unit_nr + BITMAP_WORD_BIT_NR - 1) / BITMAP_WORD_BIT_NR;
+    fa->blocks           = malloc(sizeof(Fit_block) * unit_nr);
+    fa->free_bitmap      = calloc(word_nr, sizeof(uint64_t));
+    if (posix_memalign(&mem, (unit_size < sizeof(void*)) ? sizeof(void*) : unit_size, unit_nr * unit_size) != 0) {
+        mem = NULL;
+    }
+
+    if (fa->blocks == NULL || fa->free_bitmap == NULL || mem == NULL) {
+        free(fa->blocks);
+        free(fa->free_bitmap);
+        free(mem);
+        free(fa);
+        return NULL;
+    }
+
+    fa->policy         = policy;
+    fa->base_addr      = (uintptr_t)mem;
+    fa->unit_size      = unit_size;
+    fa->unit_size_log2 = (uint8_t)__builtin_ctzll(unit_size);
+    fa->unit_nr        = (uint32_t)unit_nr;
+    fa->root           = FIT_NIL;
+    fa->cursor         = 0;
+    fa->free_unit_nr   = 0;
+    fa->free_run_nr    = 0;
+    insert_free_run(fa, 0, fa->unit_nr);
+
+    return fa;
+}
+
+
+void fit_allocator_destroy(Fit_allocator* fa)
+{
+    free((void*)fa->base_addr);
+    free(fa->blocks);
+    free(fa->free_bitmap);
+    free(fa);
+}
+
+
+/**
+ * @brief Allocate contiguous units which can store size bytes.
+ *        The object is taken from the head of the found free run, the rest remains free.
+ * @return NULL if there is no enough free run.
+ */
+void* fit_alloc(Fit_allocator* fa, size_t size)
+{
+    if (size == 0 || ((size_t)fa->unit_nr << fa->unit_size_log2) < size) {
+        return NULL;
+    }
+
+    uint32_t const n = (uint32_t)((size + fa->unit_size - 1) >> fa->unit_size_log2);
+    uint32_t const i = find_fit(fa, n);
+    if (i == FIT_NIL) {
+        return NULL;
+    }
+
+    uint32_t const s = run_size(fa, i);
+    remove_free_run(fa, i);
+    if (n < s) {
+        insert_free_run(fa, i + n, s - n);
+    }
+    set_run(fa, i, n, true);
+    fa->cursor = (i + n == fa->unit_nr) ? 0 : i + n;
+
+    return (void*)(fa->base_addr + ((uintptr_t)i << fa->unit_size_log2));
+}
+
+
+/**
+ * @brief Free the object and coalesce it with the adjacent free runs.
+ */
+void fit_free(Fit_allocator* fa, void* p)
+{
+    if (p == NULL) {
+        return;
+    }
+
+    uint32_t const i = (uint32_t)(((uintptr_t)p - fa->base_addr) >> fa->unit_size_log2);
+    assert(is_alloc(fa, i) == true);
+
+    uint32_t head = i;
+    uint32_t size = run_size(fa, i);
+
+    uint32_t const next = i + size;
+    if (next < fa->unit_nr && is_alloc(fa, next) == false) {
+        size += run_size(fa, next);
+        remove_free_run(fa, next);
+    }
+
+    if (0 < i && is_alloc(fa, i - 1) == false) {
+        head = i - run_size(fa, i - 1);
+        size += run_size(fa, head);
+        remove_free_run(fa, head);
+    }
+
+    /* Next-fit does not start in the middle of a free run. */
+    if (head <= fa->cursor && fa->cursor < head + size) {
+        fa->cursor = head;
+    }
+
+    insert_free_run(fa, head, size);
+}
+
+
+size_t fit_usable_size(Fit_allocator const* fa, void const* p)
+{
+    uint32_t const i = (uint32_t)(((uintptr_t)p - fa->base_addr) >> fa->unit_size_log2);
+    return (size_t)run_size(fa, i) << fa->unit_size_log2;
+}
+
+
+size_t fit_free_size(Fit_allocator const* fa)
+{
+    return (size_t)fa->free_unit_nr << fa->unit_size_log2;
+}
+
+
+size_t fit_largest_free_size(Fit_allocator const* fa)
+{
+    uint32_t const t = tree_max(fa);
+    return (t == FIT_NIL) ? 0 : (size_t)run_size(fa, t) << fa->unit_size_log2;
+}
+
+
+size_t fit_free_run_nr(Fit_allocator const* fa)
+{
+    return fa->free_run_nr;
+}
+
+
+char const* fit_policy_name(Fit_policy policy)
+{
+    return (policy < FIT_POLICY_NR) ? policy_names[policy] : "Unknown";
+}
+
+
+void fit_allocator_dump(char const* tag, Fit_allocator const* fa)
+{
+    size_t const total = (size_t)fa->unit_nr << fa->unit_size_log2;
+
+    printf("%s (%s)\n", tag, fit_policy_name(fa->policy));
+    printf("  Free size: %zd byte\n", fit_free_size(fa));
+    printf("  Used size: %zd byte\n", total - fit_free_size(fa));
+    printf("  Free runs: %zd\n", fit_free_run_nr(fa));
+    printf("  Largest free run: %zd byte\n", fit_largest_free_size(fa));
+}
+
+
+#ifndef FIT_ALLOCATORS_LIBRARY
+
+
+static const size_t TOTAL_MEMORY_SIZE_BYTE      = 1024 * 8;
+static const size_t BLOCK_MEMORY_UNIT_SIZE_BYTE = 256;
+
+
+int main(void)
+{
+    for (Fit_policy p = FIT_FIRST; p < FIT_POLICY_NR; p++) {
+        Fit_allocator* fa = fit_allocator_create(p, TOTAL_MEMORY_SIZE_BYTE, BLOCK_MEMORY_UNIT_SIZE_BYTE);
+
+        void* a = fit_alloc(fa, 100);
+        void* b = fit_alloc(fa, 100);
+        assert(fit_free_size(fa) == (TOTAL_MEMORY_SIZE_BYTE - BLOCK_MEMORY_UNIT_SIZE_BYTE * 2));
+
+        /* Contiguous blocks. */
+        void* c = fit_alloc(fa, BLOCK_MEMORY_UNIT_SIZE_BYTE * 3);
+        assert(fit_usable_size(fa, c) == BLOCK_MEMORY_UNIT_SIZE_BYTE * 3);
+        fit_allocator_dump(policy_names[p], fa);
+
+        fit_free(fa, b);
+        fit_free(fa, a);
+        fit_free(fa, c);
+        assert(fit_free_size(fa) == TOTAL_MEMORY_SIZE_BYTE && fit_free_run_nr(fa) == 1);
+
+        fit_allocator_destroy(fa);
+    }
+
+    return 0;
+}
+
+
+#endif
@@ -0,0 +1,71 @@
+/**
+ * @file fit_allocators.h
+ * @brief First-fit, next-fit, best-fit and worst-fit allocators.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-24
+ */
+
+#ifndef _FIT_ALLOCATORS_H_
+#define _FIT_ALLOCATORS_H_
+
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+enum fit_policy {
+    FIT_FIRST,
+    FIT_NEXT,
+    FIT_BEST,
+    FIT_WORST,
+    FIT_POLICY_NR,
+};
+typedef enum fit_policy Fit_policy;
+
+
+/*
+ * Descriptor of one unit.
+ * Only the head and the tail unit of a run are valid.
+ * The tree links are used at the head of a free run.
+ */
+struct fit_block {
+    uint32_t size; /* The number of units in the run, the top bit is the allocated flag. */
+    uint32_t left;
+    uint32_t right;
+};
+typedef struct fit_block Fit_block;
+
+
+struct fit_allocator {
+    Fit_policy policy;
+    uintptr_t base_addr;
+    size_t unit_size;
+    uint8_t unit_size_log2;
+    uint32_t unit_nr;
+    Fit_block* blocks;     /* Descriptors of the all units. */
+    uint64_t* free_bitmap; /* The bit of the head unit of each free run is set. */
+    uint32_t root;         /* Free runs ordered by (size, index). */
+    uint32_t cursor;       /* Where next-fit starts searching. */
+    uint32_t free_unit_nr;
+    uint32_t free_run_nr;
+};
+typedef struct fit_allocator Fit_allocator;
+
+
+extern Fit_allocator* fit_allocator_create(Fit_policy, size_t, size_t);
+extern void fit_allocator_destroy(Fit_allocator*);
+extern void* fit_alloc(Fit_allocator*, size_t);
+extern void fit_free(Fit_allocator*, void*);
+extern size_t fit_usable_size(Fit_allocator const*, void const*);
+extern size_t fit_free_size(Fit_allocator const*);
+extern size_t fit_largest_free_size(Fit_allocator const*);
+extern size_t fit_free_run_nr(Fit_allocator const*);
+extern char const* fit_policy_name(Fit_policy);
+extern void fit_allocator_dump(char const*, Fit_allocator const*);
+
+
+
+#endif
@@ -7,6 +7,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include "lqueue.h"
 
@@ -22,6 +23,20 @@ Lqueue* lqueue_init(Lqueue* q, size_t size, lqueue_release_func f) {
 }
 
 
+/*
+ * Nodes are taken from slabs in the list, see dlist_init_pooled().
+ */
+Lqueue* lqueue_init_pooled(Lqueue* q, size_t size, lqueue_release_func f, size_t slab_node_nr) {
+    assert(q != NULL);
+
+    q->list = (Dlist*)malloc(sizeof(Dlist));
+
+    dlist_init_pooled(q->list, size, (dlist_release_func)f, slab_node_nr);
+
+    return q;
+}
+
+
 bool lqueue_is_empty(Lqueue const* q) {
     assert(q != NULL);
 
@@ -60,6 +75,63 @@ void* lqueue_insert(Lqueue* q, void* data) {
 }
 
 
+/*
+ * Insert the array of data at once.
+ * It returns the number of inserted data, it is less than n if allocation failed.
+ */
+size_t lqueue_insert_n(Lqueue* q, void const* data, size_t n) {
+    assert(q != NULL && (n == 0 || data != NULL));
+
+    Dlist* const l = q->list;
+    unsigned char const* d = data;
+
+    for (size_t i = 0; i < n; i++, d += l->data_type_size) {
+        Dlist_node* node = dlist_get_new_node(l, (void*)d);
+        if (node == NULL) {
+            return i;
+        }
+        dlist_insert_node_last(l, node);
+    }
+
+    return n;
+}
+
+
+/*
+ * Remove the first data at once.
+ * Each data is copied into out if it is not NULL, and then it is released like lqueue_delete_first().
+ * It returns the number of removed data.
+ */
+size_t lqueue_pop_n(Lqueue* q, void* out, size_t n) {
+    assert(q != NULL);
+
+    Dlist* const l = q->list;
+    unsigned char* o = out;
+
+    n = (l->size < n) ? l->size : n;
+    for (size_t i = 0; i < n; i++) {
+        if (o != NULL) {
+            memcpy(o, l->node->data, l->data_type_size);
+            o += l->data_type_size;
+        }
+        dlist_delete_node(l, l->node);
+    }
+
+    return n;
+}
+
+
+/*
+ * Move the first data of src to the last of dst without copy, see dlist_splice_last().
+ * It returns the number of moved data.
+ */
+size_t lqueue_move_n(Lqueue* dst, Lqueue* src, size_t n) {
+    assert(dst != NULL && src != NULL);
+
+    return dlist_splice_last(dst->list, src->list, n);
+}
+
+
 void lqueue_destruct(Lqueue* q) {
     assert(q != NULL);
 
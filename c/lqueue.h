@@ -26,15 +26,19 @@ typedef struct lqueue Lqueue;
 typedef void (*lqueue_release_func)(struct lqueue*, void*);
 
 extern Lqueue* lqueue_init(Lqueue*, size_t, lqueue_release_func);
+extern Lqueue* lqueue_init_pooled(Lqueue*, size_t, lqueue_release_func, size_t);
 extern bool lqueue_is_empty(Lqueue const*);
 extern void* lqueue_get_first(Lqueue*);
 extern void lqueue_delete_first(Lqueue*);
 extern void* lqueue_insert(Lqueue*, void*);
+extern size_t lqueue_insert_n(Lqueue*, void const*, size_t);
+extern size_t lqueue_pop_n(Lqueue*, void*, size_t);
+extern size_t lqueue_move_n(Lqueue*, Lqueue*, size_t);
 extern void lqueue_destruct(Lqueue*);
 extern size_t lqueue_get_size(Lqueue const*);
 
 
-#define aqueue_get(type, q) (*(type*)lqueue_get_first(q))
+#define lqueue_get(type, q) (*(type*)lqueue_get_first(q))
 
 
 
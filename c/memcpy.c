@@ -1,22 +1,31 @@
-#include <stdio.h>
-#include <time.h>
-#include <sys/time.h>
+/**
+ * @file memcpy.c
+ * @brief memcpy implementations.
+ *        memcpy0 - memcpy3 are simple experiments.
+ *        memcpy_fast is dispatched to the best vector kernel by cpuid at startup.
+ * @author mopp
+ * @version 0.2
+ * @date 2014-10-20
+ */
+
+#include <immintrin.h>
+#include <stdbool.h>
 #include <stddef.h>
-#include <string.h>
 #include <stdint.h>
-#include <stdlib.h>
-#include <ctype.h>
-#include <limits.h>
+#include "cpu_features.h"
+#include "memcpy.h"
 
 
-static double gettimeofday_sec(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec + tv.tv_usec * 1e-6;
-}
+enum {
+    REP_MOVSB_THRESHOLD = 2048, /* rep movsb is faster than vector loop above this on ERMS CPUs. */
+};
+
+
+static size_t nt_threshold = SIZE_MAX;
+static bool use_erms       = false;
 
 
-static inline void* memcpy0(void* restrict buf1, const void* restrict buf2, size_t n) {
+void* memcpy0(void* restrict buf1, void const* restrict buf2, size_t n) {
     char* p1 = (char*)buf1;
     char const* p2 = (char const*)buf2;
 
@@ -30,7 +39,7 @@ static inline void* memcpy0(void* restrict buf1, const void* restrict buf2, size
 }
 
 
-static inline void* memcpy1(void* restrict b1, const void* restrict b2, size_t n) {
+void* memcpy1(void* restrict b1, void const* restrict b2, size_t n) {
     uint8_t* p1 = b1;
     uint8_t const* p2 = b2;
 
@@ -55,38 +64,37 @@ static inline void* memcpy1(void* restrict b1, const void* restrict b2, size_t n
 }
 
 
-static inline void* memcpy2(void* restrict b1, const void* restrict b2, size_t n) {
+void* memcpy2(void* restrict b1, void const* restrict b2, size_t n) {
+    void* d = b1;
+    void const* s = b2;
+
     __asm__ volatile(
             "cld        \n"
             "rep movsb  \n"
+            : "+D"(d), "+S"(s), "+c"(n)
             :
-            : "S"(b2), "D"(b1), "c"(n)
-            : "memory", "%esi", "%edi", "%ecx"
+            : "memory"
     );
 
     return b1;
 }
 
 
-static inline void* memcpy3(void* restrict b1, const void* restrict b2, size_t n) {
-    uint8_t* restrict p1 = b1;
-    uint8_t const* restrict p2 = b2;
-    size_t nr, t;
-
-    __asm__ volatile("cld");
+void* memcpy3(void* restrict b1, void const* restrict b2, size_t n) {
+    uint8_t* p1 = b1;
+    uint8_t const* p2 = b2;
+    size_t nr;
 
+    /* rep instructions advance rdi and rsi, so the pointers are updated by the constraints. */
     nr = n / 4;
     if (nr != 0) {
         __asm__ volatile(
-                "rep movsd  \n"
+                "rep movsl  \n"
+                : "+D"(p1), "+S"(p2), "+c"(nr)
                 :
-                : "S"(p2), "D"(p1), "c"(nr)
-                : "memory", "%esi", "%edi", "%ecx"
+                : "memory"
         );
-        t = nr * 4;
-        n -= t;
-        p1 += t;
-        p2 += t;
+        n %= 4;
     }
 
 
@@ -94,70 +102,337 @@ static inline void* memcpy3(void* restrict b1, const void* restrict b2, size_t n
     if (nr != 0) {
         __asm__ volatile(
                 "rep movsw   \n"
+                : "+D"(p1), "+S"(p2), "+c"(nr)
                 :
-                : "S"(p2), "D"(p1), "c"(nr)
-                : "memory", "%esi", "%edi", "%ecx"
+                : "memory"
         );
-        t = nr * 2;
-        n -= t;
-        p1 += t;
-        p2 += t;
+        n %= 2;
     }
 
     __asm__ volatile(
             "rep movsb   \n"
+            : "+D"(p1), "+S"(p2), "+c"(n)
             :
-            : "S"(p2), "D"(p1), "c"(n)
-            : "memory", "%esi", "%edi", "%ecx"
+            : "memory"
     );
 
     return b1;
 }
 
 
-typedef void* (*memcpy_f)(void* restrict, const void* restrict, size_t);
-static double worker(memcpy_f f, void* restrict b1, void* restrict b2, size_t n) {
-    static int cnt = 0;
-    double t1, t2;
+/* Copy less than 16 byte by two overlapping moves. */
+static inline void* copy_small(void* restrict dst, void const* restrict src, size_t n) {
+    uint8_t* d = dst;
+    uint8_t const* s = src;
+
+    if (8 <= n) {
+        uint64_t a, b;
+        __builtin_memcpy(&a, s, 8);
+        __builtin_memcpy(&b, s + n - 8, 8);
+        __builtin_memcpy(d, &a, 8);
+        __builtin_memcpy(d + n - 8, &b, 8);
+    } else if (4 <= n) {
+        uint32_t a, b;
+        __builtin_memcpy(&a, s, 4);
+        __builtin_memcpy(&b, s + n - 4, 4);
+        __builtin_memcpy(d, &a, 4);
+        __builtin_memcpy(d + n - 4, &b, 4);
+    } else if (2 <= n) {
+        uint16_t a, b;
+        __builtin_memcpy(&a, s, 2);
+        __builtin_memcpy(&b, s + n - 2, 2);
+        __builtin_memcpy(d, &a, 2);
+        __builtin_memcpy(d + n - 2, &b, 2);
+    } else if (n == 1) {
+        *d = *s;
+    }
+
+    return dst;
+}
+
+
+static inline bool is_rep_movsb_size(size_t n) {
+    return use_erms && (REP_MOVSB_THRESHOLD <= n) && (n < nt_threshold);
+}
+
+
+void* memcpy_erms(void* restrict dst, void const* restrict src, size_t n) {
+    void* d = dst;
+    void const* s = src;
+
+    __asm__ volatile(
+            "rep movsb  \n"
+            : "+D"(d), "+S"(s), "+c"(n)
+            :
+            : "memory"
+    );
+
+    return dst;
+}
+
+
+/*
+ * All vector kernels work like below.
+ *   1. Sizes up to 2 vectors are copied by overlapping head and tail moves.
+ *   2. The first vector is stored unaligned and destination is aligned up.
+ *   3. The middle is copied by aligned stores, 4 vectors per loop.
+ *      Non-temporal stores are used if the copy is larger than the last level cache.
+ *   4. The last vector is stored unaligned, it may overlap the middle.
+ */
+void* memcpy_sse2(void* restrict dst, void const* restrict src, size_t n) {
+    uint8_t* d = dst;
+    uint8_t const* s = src;
+
+    if (n < 16) {
+        return copy_small(dst, src, n);
+    }
+
+    if (n <= 32) {
+        __m128i h = _mm_loadu_si128((__m128i const*)s);
+        __m128i t = _mm_loadu_si128((__m128i const*)(s + n - 16));
+        _mm_storeu_si128((__m128i*)d, h);
+        _mm_storeu_si128((__m128i*)(d + n - 16), t);
+        return dst;
+    }
+
+    if (is_rep_movsb_size(n) == true) {
+        return memcpy_erms(dst, src, n);
+    }
+
+    __m128i head          = _mm_loadu_si128((__m128i const*)s);
+    __m128i tail          = _mm_loadu_si128((__m128i const*)(s + n - 16));
+    uint8_t* const tail_d = d + n - 16;
+    size_t const skew     = 16 - ((uintptr_t)d & 15);
+    bool const is_nt      = (nt_threshold <= n);
+
+    _mm_storeu_si128((__m128i*)d, head);
+    d += skew;
+    s += skew;
+    n -= skew;
+
+    if (is_nt == true) {
+        for (; 64 < n; n -= 64, d += 64, s += 64) {
+            __m128i a = _mm_loadu_si128((__m128i const*)(s + 0));
+            __m128i b = _mm_loadu_si128((__m128i const*)(s + 16));
+            __m128i c = _mm_loadu_si128((__m128i const*)(s + 32));
+            __m128i e = _mm_loadu_si128((__m128i const*)(s + 48));
+            _mm_stream_si128((__m128i*)(d + 0), a);
+            _mm_stream_si128((__m128i*)(d + 16), b);
+            _mm_stream_si128((__m128i*)(d + 32), c);
+            _mm_stream_si128((__m128i*)(d + 48), e);
+        }
+        _mm_sfence();
+    } else {
+        for (; 64 < n; n -= 64, d += 64, s += 64) {
+            __m128i a = _mm_loadu_si128((__m128i const*)(s + 0));
+            __m128i b = _mm_loadu_si128((__m128i const*)(s + 16));
+            __m128i c = _mm_loadu_si128((__m128i const*)(s + 32));
+            __m128i e = _mm_loadu_si128((__m128i const*)(s + 48));
+            _mm_store_si128((__m128i*)(d + 0), a);
+            _mm_store_si128((__m128i*)(d + 16), b);
+            _mm_store_si128((__m128i*)(d + 32), c);
+            _mm_store_si128((__m128i*)(d + 48), e);
+        }
+    }
+
+    for (; 16 < n; n -= 16, d += 16, s += 16) {
+        _mm_store_si128((__m128i*)d, _mm_loadu_si128((__m128i const*)s));
+    }
+
+    _mm_storeu_si128((__m128i*)tail_d, tail);
+
+    return dst;
+}
+
+
+__attribute__((target("avx2")))
+void* memcpy_avx2(void* restrict dst, void const* restrict src, size_t n) {
+    uint8_t* d = dst;
+    uint8_t const* s = src;
+
+    if (n < 32) {
+        return memcpy_sse2(dst, src, n);
+    }
+
+    if (n <= 64) {
+        __m256i h = _mm256_loadu_si256((__m256i const*)s);
+        __m256i t = _mm256_loadu_si256((__m256i const*)(s + n - 32));
+        _mm256_storeu_si256((__m256i*)d, h);
+        _mm256_storeu_si256((__m256i*)(d + n - 32), t);
+        return dst;
+    }
+
+    if (is_rep_movsb_size(n) == true) {
+        return memcpy_erms(dst, src, n);
+    }
+
+    __m256i head          = _mm256_loadu_si256((__m256i const*)s);
+    __m256i tail          = _mm256_loadu_si256((__m256i const*)(s + n - 32));
+    uint8_t* const tail_d = d + n - 32;
+    size_t const skew     = 32 - ((uintptr_t)d & 31);
+    bool const is_nt      = (nt_threshold <= n);
+
+    _mm256_storeu_si256((__m256i*)d, head);
+    d += skew;
+    s += skew;
+    n -= skew;
+
+    if (is_nt == true) {
+        for (; 128 < n; n -= 128, d += 128, s += 128) {
+            __m256i a = _mm256_loadu_si256((__m256i const*)(s + 0));
+            __m256i b = _mm256_loadu_si256((__m256i const*)(s + 32));
+            __m256i c = _mm256_loadu_si256((__m256i const*)(s + 64));
+            __m256i e = _mm256_loadu_si256((__m256i const*)(s + 96));
+            _mm256_stream_si256((__m256i*)(d + 0), a);
+            _mm256_stream_si256((__m256i*)(d + 32), b);
+            _mm256_stream_si256((__m256i*)(d + 64), c);
+            _mm256_stream_si256((__m256i*)(d + 96), e);
+        }
+        _mm_sfence();
+    } else {
+        for (; 128 < n; n -= 128, d += 128, s += 128) {
+            __m256i a = _mm256_loadu_si256((__m256i const*)(s + 0));
+            __m256i b = _mm256_loadu_si256((__m256i const*)(s + 32));
+            __m256i c = _mm256_loadu_si256((__m256i const*)(s + 64));
+            __m256i e = _mm256_loadu_si256((__m256i const*)(s + 96));
+            _mm256_store_si256((__m256i*)(d + 0), a);
+            _mm256_store_si256((__m256i*)(d + 32), b);
+            _mm256_store_si256((__m256i*)(d + 64), c);
+            _mm256_store_si256((__m256i*)(d + 96), e);
+        }
+    }
+
+    for (; 32 < n; n -= 32, d += 32, s += 32) {
+        _mm256_store_si256((__m256i*)d, _mm256_loadu_si256((__m256i const*)s));
+    }
+
+    _mm256_storeu_si256((__m256i*)tail_d, tail);
+
+    return dst;
+}
+
+
+__attribute__((target("avx512f")))
+void* memcpy_avx512(void* restrict dst, void const* restrict src, size_t n) {
+    uint8_t* d = dst;
+    uint8_t const* s = src;
+
+    if (n < 64) {
+        return memcpy_avx2(dst, src, n);
+    }
 
-    /* init randam data */
-    srand((unsigned)time(NULL));
-    for (int i = 0; i < n; i++) {
-        *(char*)b2 = (char)(rand() / CHAR_MAX);
+    if (n <= 128) {
+        __m512i h = _mm512_loadu_si512((void const*)s);
+        __m512i t = _mm512_loadu_si512((void const*)(s + n - 64));
+        _mm512_storeu_si512((void*)d, h);
+        _mm512_storeu_si512((void*)(d + n - 64), t);
+        return dst;
     }
 
-    t1 = gettimeofday_sec();
-    f(b1, b2, n);
-    t2 = gettimeofday_sec();
+    if (is_rep_movsb_size(n) == true) {
+        return memcpy_erms(dst, src, n);
+    }
 
-    printf("No.%d\n", cnt++);
-    if (memcmp(b1, b2, n) != 0) {
-        printf("validation failed\n");
+    __m512i head          = _mm512_loadu_si512((void const*)s);
+    __m512i tail          = _mm512_loadu_si512((void const*)(s + n - 64));
+    uint8_t* const tail_d = d + n - 64;
+    size_t const skew     = 64 - ((uintptr_t)d & 63);
+    bool const is_nt      = (nt_threshold <= n);
+
+    _mm512_storeu_si512((void*)d, head);
+    d += skew;
+    s += skew;
+    n -= skew;
+
+    if (is_nt == true) {
+        for (; 256 < n; n -= 256, d += 256, s += 256) {
+            __m512i a = _mm512_loadu_si512((void const*)(s + 0));
+            __m512i b = _mm512_loadu_si512((void const*)(s + 64));
+            __m512i c = _mm512_loadu_si512((void const*)(s + 128));
+            __m512i e = _mm512_loadu_si512((void const*)(s + 192));
+            _mm512_stream_si512((void*)(d + 0), a);
+            _mm512_stream_si512((void*)(d + 64), b);
+            _mm512_stream_si512((void*)(d + 128), c);
+            _mm512_stream_si512((void*)(d + 192), e);
+        }
+        _mm_sfence();
     } else {
-        printf("    %f\n", t2 - t1);
+        for (; 256 < n; n -= 256, d += 256, s += 256) {
+            __m512i a = _mm512_loadu_si512((void const*)(s + 0));
+            __m512i b = _mm512_loadu_si512((void const*)(s + 64));
+            __m512i c = _mm512_loadu_si512((void const*)(s + 128));
+            __m512i e = _mm512_loadu_si512((void const*)(s + 192));
+            _mm512_store_si512((void*)(d + 0), a);
+            _mm512_store_si512((void*)(d + 64), b);
+            _mm512_store_si512((void*)(d + 128), c);
+            _mm512_store_si512((void*)(d + 192), e);
+        }
+    }
+
+    for (; 64 < n; n -= 64, d += 64, s += 64) {
+        _mm512_store_si512((void*)d, _mm512_loadu_si512((void const*)s));
     }
 
-    return t2 - t1;
+    _mm512_storeu_si512((void*)tail_d, tail);
+
+    return dst;
 }
 
 
-int main(void) {
-    enum  {
-       n = 223810,
-    };
-    // char* b1 = malloc(sizeof(char) * n);
-    // char* b2 = malloc(sizeof(char) * n);
-    /* size_t n = 100; */
-    char* b1[n];
-    char* b2[n];
+static void* memcpy_select(void* restrict, void const* restrict, size_t);
+static memcpy_f memcpy_impl    = memcpy_select;
+static char const* memcpy_name = "none";
+
 
-    worker(memcpy0, b1, b2, n);
-    worker(memcpy1, b1, b2, n);
-    worker(memcpy2, b1, b2, n);
-    worker(memcpy3, b1, b2, n);
+static void select_memcpy(void) {
+    Cpu_features const* f = cpu_features_get();
+
+    nt_threshold = f->llc_size;
+    use_erms     = f->erms;
+
+    if (f->avx512f == true) {
+        memcpy_impl = memcpy_avx512;
+        memcpy_name = "avx512";
+    } else if (f->avx2 == true) {
+        memcpy_impl = memcpy_avx2;
+        memcpy_name = "avx2";
+    } else if (f->sse2 == true) {
+        memcpy_impl = memcpy_sse2;
+        memcpy_name = "sse2";
+    } else {
+        memcpy_impl = memcpy0;
+        memcpy_name = "byte";
+    }
+}
+
+
+/* Constructors in other files may copy before select_memcpy_at_startup() runs. */
+static void* memcpy_select(void* restrict dst, void const* restrict src, size_t n) {
+    select_memcpy();
+    return memcpy_impl(dst, src, n);
+}
+
+
+__attribute__((constructor)) static void select_memcpy_at_startup(void) {
+    select_memcpy();
+}
+
+
+void* memcpy_fast(void* restrict dst, void const* restrict src, size_t n) {
+    return memcpy_impl(dst, src, n);
+}
+
+
+char const* memcpy_fast_name(void) {
+    return memcpy_name;
+}
+
+
+size_t memcpy_get_nt_threshold(void) {
+    return nt_threshold;
+}
 
-    /* free(b1); */
-    /* free(b2); */
 
-    return 0;
+void memcpy_set_nt_threshold(size_t n) {
+    nt_threshold = n;
 }
@@ -0,0 +1,48 @@
+/**
+ * @file memcpy.h
+ * @brief memcpy implementations header.
+ * @author mopp
+ * @version 0.2
+ * @date 2014-10-20
+ */
+
+#ifndef _MEMCPY_H_
+#define _MEMCPY_H_
+
+
+
+#include <stddef.h>
+
+
+typedef void* (*memcpy_f)(void* restrict, void const* restrict, size_t);
+
+
+/* Simple experiments. */
+extern void* memcpy0(void* restrict, void const* restrict, size_t);
+extern void* memcpy1(void* restrict, void const* restrict, size_t);
+extern void* memcpy2(void* restrict, void const* restrict, size_t);
+extern void* memcpy3(void* restrict, void const* restrict, size_t);
+
+/*
+ * Vector kernels.
+ * The caller must check cpu_features_get() before calling avx2/avx512 kernels directly.
+ */
+extern void* memcpy_erms(void* restrict, void const* restrict, size_t);
+extern void* memcpy_sse2(void* restrict, void const* restrict, size_t);
+extern void* memcpy_avx2(void* restrict, void const* restrict, size_t);
+extern void* memcpy_avx512(void* restrict, void const* restrict, size_t);
+
+/* The best kernel for the running CPU, it is chosen once at startup. */
+extern void* memcpy_fast(void* restrict, void const* restrict, size_t);
+extern char const* memcpy_fast_name(void);
+
+/*
+ * Copies at least this size use non-temporal stores.
+ * It is the last level cache size by default.
+ */
+extern size_t memcpy_get_nt_threshold(void);
+extern void memcpy_set_nt_threshold(size_t);
+
+
+
+#endif
@@ -1,20 +1,31 @@
+/**
+ * @file memset.c
+ * @brief memset implementations.
+ *        memset0 - memset4 are simple experiments.
+ *        memset_fast is dispatched to the best vector kernel by cpuid at startup.
+ * @author mopp
+ * @version 0.2
+ * @date 2014-10-22
+ */
+
+#include <immintrin.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
-#include <stdlib.h>
-#include <stdio.h>
-#include <time.h>
-#include <sys/time.h>
+#include "cpu_features.h"
+#include "memset.h"
 
 
-static double gettimeofday_sec(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec + tv.tv_usec * 1e-6;
-}
+enum {
+    REP_STOSB_THRESHOLD = 2048, /* rep stosb is faster than vector loop above this on ERMS CPUs. */
+};
+
+
+static size_t nt_threshold = SIZE_MAX;
+static bool use_erms       = false;
 
 
-static void* memset0(void* s, int c, size_t n) {
+void* memset0(void* s, int c, size_t n) {
     if (n != 0) {
         register uintptr_t addr = (uintptr_t)s;
         register uintptr_t t = addr + n;
@@ -30,7 +41,7 @@ static void* memset0(void* s, int c, size_t n) {
 }
 
 
-static void* memset1(void* buf, int ch, size_t n) {
+void* memset1(void* buf, int ch, size_t n) {
     unsigned char* t = (unsigned char*)buf;
 
     while (0 < n--) {
@@ -41,12 +52,12 @@ static void* memset1(void* buf, int ch, size_t n) {
 }
 
 
-static void* memset2(void* s, int c, size_t n) {
+void* memset2(void* s, int c, size_t n) {
     register uintptr_t itr = (uintptr_t)s;
     register uintptr_t end = itr + n;
     uint8_t const uc = (uint8_t const)c;
     if (((itr | n) & 0x3) == 0) {
-        register uint32_t v = (uint32_t)((uc << 24) | (uc << 16) | (uc << 8) | uc);
+        register uint32_t v = uc * 0x01010101u;
         while (itr < end) {
             *(uint32_t*)(itr) = v;
             itr += sizeof(uint32_t);
@@ -69,7 +80,7 @@ static void* memset2(void* s, int c, size_t n) {
 }
 
 
-static void* memset3(void* s, register int c, size_t n) {
+void* memset3(void* s, register int c, size_t n) {
     register uintptr_t itr = (uintptr_t)s;
     register uintptr_t end = itr + n;
 
@@ -81,7 +92,7 @@ static void* memset3(void* s, register int c, size_t n) {
 
     end = itr + (n - mod);
 
-    register uint32_t v = (uint32_t)((c << 24) | (c << 16) | (c << 8) | c);
+    register uint32_t v = (uint8_t)c * 0x01010101u;
     while (itr < end) {
         while (itr < end) {
             *(uint32_t*)(itr) = v;
@@ -93,98 +104,326 @@ static void* memset3(void* s, register int c, size_t n) {
 }
 
 
-static void* memset4(void* s, int c, size_t n) {
+void* memset4(void* s, int c, size_t n) {
     uintptr_t itr = (uintptr_t)s;
     uintptr_t end = itr + n;
 
-    uint16_t b16 = (uint16_t)((c << 8) | c);
-    uint32_t b32 = (uint32_t)b16 << 16 | b16;
-    uint32_t b64 = (uint64_t)b32 << 32 | b32;
+    /* c is converted to unsigned char like memset(), a negative c must not fill the upper byte with its sign. */
     uint8_t b8   = (uint8_t)c;
+    uint16_t b16 = (uint16_t)(b8 * 0x0101u);
+    uint32_t b32 = (uint32_t)b16 << 16 | b16;
+    uint64_t b64 = (uint64_t)b32 << 32 | b32;
 
-    for (uint64_t v = b64; itr < end; itr += sizeof(uint32_t)) { *(uint32_t*)(itr) = v; }
-    for (uint32_t v = b32; itr < end; itr += sizeof(uint32_t)) { *(uint32_t*)(itr) = v; }
-    for (uint16_t v = b16; itr < end; itr += sizeof(uint16_t)) { *(uint16_t*)(itr) = v; }
+    for (uint64_t v = b64; sizeof(uint64_t) <= end - itr; itr += sizeof(uint64_t)) { *(uint64_t*)(itr) = v; }
+    for (uint32_t v = b32; sizeof(uint32_t) <= end - itr; itr += sizeof(uint32_t)) { *(uint32_t*)(itr) = v; }
+    for (uint16_t v = b16; sizeof(uint16_t) <= end - itr; itr += sizeof(uint16_t)) { *(uint16_t*)(itr) = v; }
     for (uint8_t v = b8; itr < end; itr += sizeof(uint8_t)) { *(uint8_t*)(itr) = v; }
 
     return s;
 }
 
 
-static bool validate(register uint8_t* s, register uint8_t c, size_t n) {
-    register uint8_t* e = s + n;
+static inline uint64_t broadcast_byte(int c) {
+    return (uint64_t)(uint8_t)c * 0x0101010101010101ull;
+}
+
+
+/* Fill less than 16 byte by two overlapping stores. */
+static inline void* set_small(void* s, uint64_t v, size_t n) {
+    uint8_t* d = s;
+
+    if (8 <= n) {
+        __builtin_memcpy(d, &v, 8);
+        __builtin_memcpy(d + n - 8, &v, 8);
+    } else if (4 <= n) {
+        uint32_t w = (uint32_t)v;
+        __builtin_memcpy(d, &w, 4);
+        __builtin_memcpy(d + n - 4, &w, 4);
+    } else if (2 <= n) {
+        uint16_t w = (uint16_t)v;
+        __builtin_memcpy(d, &w, 2);
+        __builtin_memcpy(d + n - 2, &w, 2);
+    } else if (n == 1) {
+        *d = (uint8_t)v;
+    }
+
+    return s;
+}
+
+
+static inline bool is_rep_stosb_size(size_t n) {
+    return use_erms && (REP_STOSB_THRESHOLD <= n) && (n < nt_threshold);
+}
+
+
+void* memset_erms(void* s, int c, size_t n) {
+    void* d = s;
+
+    __asm__ volatile(
+            "rep stosb  \n"
+            : "+D"(d), "+c"(n)
+            : "a"(c)
+            : "memory"
+    );
+
+    return s;
+}
+
 
-    while (s < e) {
-        if (*s++ != c) {
-            printf("%p\n", s);
-            return false;
+/*
+ * All vector kernels work like below.
+ *   1. Sizes up to 2 vectors are filled by overlapping head and tail stores.
+ *   2. The first vector is stored unaligned and destination is aligned up.
+ *   3. The middle is filled by aligned stores, 4 vectors per loop.
+ *      Non-temporal stores are used if the buffer is larger than the last level cache.
+ *   4. The last vector is stored unaligned, it may overlap the middle.
+ */
+static inline void* memset_sse2_vec(void* s, __m128i v, size_t n) {
+    uint8_t* d = s;
+
+    if (n <= 32) {
+        _mm_storeu_si128((__m128i*)d, v);
+        _mm_storeu_si128((__m128i*)(d + n - 16), v);
+        return s;
+    }
+
+    uint8_t* const tail_d = d + n - 16;
+    size_t const skew     = 16 - ((uintptr_t)d & 15);
+
+    _mm_storeu_si128((__m128i*)d, v);
+    d += skew;
+    n -= skew;
+
+    if (nt_threshold <= n) {
+        for (; 64 < n; n -= 64, d += 64) {
+            _mm_stream_si128((__m128i*)(d + 0), v);
+            _mm_stream_si128((__m128i*)(d + 16), v);
+            _mm_stream_si128((__m128i*)(d + 32), v);
+            _mm_stream_si128((__m128i*)(d + 48), v);
+        }
+        _mm_sfence();
+    } else {
+        for (; 64 < n; n -= 64, d += 64) {
+            _mm_store_si128((__m128i*)(d + 0), v);
+            _mm_store_si128((__m128i*)(d + 16), v);
+            _mm_store_si128((__m128i*)(d + 32), v);
+            _mm_store_si128((__m128i*)(d + 48), v);
         }
     }
 
-    return true;
+    for (; 16 < n; n -= 16, d += 16) {
+        _mm_store_si128((__m128i*)d, v);
+    }
+
+    _mm_storeu_si128((__m128i*)tail_d, v);
+
+    return s;
 }
 
 
-typedef void* (*memset_f)(void*, int, size_t);
+void* memset_sse2(void* s, int c, size_t n) {
+    if (n < 16) {
+        return set_small(s, broadcast_byte(c), n);
+    }
 
+    if (32 < n && is_rep_stosb_size(n) == true) {
+        return memset_erms(s, c, n);
+    }
 
-static double worker(memset_f f, int c, size_t n) {
-    double t1, t2;
+    return memset_sse2_vec(s, _mm_set1_epi8((char)c), n);
+}
+
+
+__attribute__((target("avx2")))
+static inline void* memset_avx2_vec(void* s, __m256i v, size_t n) {
+    uint8_t* d = s;
+
+    if (n <= 64) {
+        _mm256_storeu_si256((__m256i*)d, v);
+        _mm256_storeu_si256((__m256i*)(d + n - 32), v);
+        return s;
+    }
 
-    void* s = malloc(n);
+    uint8_t* const tail_d = d + n - 32;
+    size_t const skew     = 32 - ((uintptr_t)d & 31);
 
-    t1 = gettimeofday_sec();
-    f(s, c, n);
-    t2 = gettimeofday_sec();
+    _mm256_storeu_si256((__m256i*)d, v);
+    d += skew;
+    n -= skew;
 
-    if (validate(s, c & 0xff, n) == false) {
-        printf("validation false\n");
+    if (nt_threshold <= n) {
+        for (; 128 < n; n -= 128, d += 128) {
+            _mm256_stream_si256((__m256i*)(d + 0), v);
+            _mm256_stream_si256((__m256i*)(d + 32), v);
+            _mm256_stream_si256((__m256i*)(d + 64), v);
+            _mm256_stream_si256((__m256i*)(d + 96), v);
+        }
+        _mm_sfence();
+    } else {
+        for (; 128 < n; n -= 128, d += 128) {
+            _mm256_store_si256((__m256i*)(d + 0), v);
+            _mm256_store_si256((__m256i*)(d + 32), v);
+            _mm256_store_si256((__m256i*)(d + 64), v);
+            _mm256_store_si256((__m256i*)(d + 96), v);
+        }
     }
 
-    printf("    %f\n", t2 - t1);
+    for (; 32 < n; n -= 32, d += 32) {
+        _mm256_store_si256((__m256i*)d, v);
+    }
 
-    free(s);
+    _mm256_storeu_si256((__m256i*)tail_d, v);
 
-    return t2 - t1;
+    return s;
 }
 
 
-static void worker2(memset_f f) {
-    size_t const n = 10;
-    size_t sizes[10] = {100, 64 * 1024, 29 * 1024 * 1024, 43 * 1024, 1016201, 32 * 1024 * 1024, 9874389, 64 * 1024, 4096, 4096 * 1024};
-    double sum = 0;
+__attribute__((target("avx2")))
+void* memset_avx2(void* s, int c, size_t n) {
+    if (n < 32) {
+        return memset_sse2(s, c, n);
+    }
 
-    for (size_t i = 0; i < n; i++) {
-        sum += worker(f, 0xff & i, sizes[i]);
+    if (64 < n && is_rep_stosb_size(n) == true) {
+        return memset_erms(s, c, n);
     }
 
-    printf("  time avg. %f\n", sum / n);
+    return memset_avx2_vec(s, _mm256_set1_epi8((char)c), n);
 }
 
 
-static void worker3(memset_f f, size_t n) {
-    size_t const times = 10000000;
-    double sum = 0;
+__attribute__((target("avx512f")))
+static inline void* memset_avx512_vec(void* s, __m512i v, size_t n) {
+    uint8_t* d = s;
+
+    if (n <= 128) {
+        _mm512_storeu_si512((void*)d, v);
+        _mm512_storeu_si512((void*)(d + n - 64), v);
+        return s;
+    }
+
+    uint8_t* const tail_d = d + n - 64;
+    size_t const skew     = 64 - ((uintptr_t)d & 63);
+
+    _mm512_storeu_si512((void*)d, v);
+    d += skew;
+    n -= skew;
+
+    if (nt_threshold <= n) {
+        for (; 256 < n; n -= 256, d += 256) {
+            _mm512_stream_si512((void*)(d + 0), v);
+            _mm512_stream_si512((void*)(d + 64), v);
+            _mm512_stream_si512((void*)(d + 128), v);
+            _mm512_stream_si512((void*)(d + 192), v);
+        }
+        _mm_sfence();
+    } else {
+        for (; 256 < n; n -= 256, d += 256) {
+            _mm512_store_si512((void*)(d + 0), v);
+            _mm512_store_si512((void*)(d + 64), v);
+            _mm512_store_si512((void*)(d + 128), v);
+            _mm512_store_si512((void*)(d + 192), v);
+        }
+    }
+
+    for (; 64 < n; n -= 64, d += 64) {
+        _mm512_store_si512((void*)d, v);
+    }
+
+    _mm512_storeu_si512((void*)tail_d, v);
+
+    return s;
+}
+
+
+__attribute__((target("avx512f")))
+void* memset_avx512(void* s, int c, size_t n) {
+    if (n < 64) {
+        return memset_avx2(s, c, n);
+    }
+
+    if (128 < n && is_rep_stosb_size(n) == true) {
+        return memset_erms(s, c, n);
+    }
+
+    return memset_avx512_vec(s, _mm512_set1_epi32((int)(uint32_t)broadcast_byte(c)), n);
+}
 
-    double t1, t2;
 
-    t1 = gettimeofday_sec();
-    for (size_t i = 0; i < times; i++) {
-        sum += worker(f, 6, n);
+/*
+ * Zero fill does not need to broadcast the byte, the zero register is used as it is.
+ * Small sizes are the most of calloc() calls, so they are handled here before the dispatch.
+ */
+void* memset_zero(void* s, size_t n) {
+    if (n < 16) {
+        return set_small(s, 0, n);
     }
-    t2 = gettimeofday_sec();
 
-    printf("  time.     %f\n", t2 - t1);
+    if (n <= 32) {
+        __m128i const z = _mm_setzero_si128();
+        _mm_storeu_si128((__m128i*)s, z);
+        _mm_storeu_si128((__m128i*)((uint8_t*)s + n - 16), z);
+        return s;
+    }
+
+    return memset_fast(s, 0, n);
 }
 
 
-int main(void) {
-    memset_f fs[] = {memset0, memset1, memset2, memset3, memset4};
+static void* memset_select(void*, int, size_t);
+static memset_f memset_impl    = memset_select;
+static char const* memset_name = "none";
+
 
-    for (size_t i = 0; i < sizeof(fs) / sizeof(fs[0]); i++) {
-        worker2(fs[i]);
+static void select_memset(void) {
+    Cpu_features const* f = cpu_features_get();
+
+    nt_threshold = f->llc_size;
+    use_erms     = f->erms;
+
+    if (f->avx512f == true) {
+        memset_impl = memset_avx512;
+        memset_name = "avx512";
+    } else if (f->avx2 == true) {
+        memset_impl = memset_avx2;
+        memset_name = "avx2";
+    } else if (f->sse2 == true) {
+        memset_impl = memset_sse2;
+        memset_name = "sse2";
+    } else {
+        memset_impl = memset4;
+        memset_name = "word";
     }
+}
 
-    return 0;
+
+/* Constructors in other files may fill before select_memset_at_startup() runs. */
+static void* memset_select(void* s, int c, size_t n) {
+    select_memset();
+    return memset_impl(s, c, n);
 }
 
+
+__attribute__((constructor)) static void select_memset_at_startup(void) {
+    select_memset();
+}
+
+
+void* memset_fast(void* s, int c, size_t n) {
+    return memset_impl(s, c, n);
+}
+
+
+char const* memset_fast_name(void) {
+    return memset_name;
+}
+
+
+size_t memset_get_nt_threshold(void) {
+    return nt_threshold;
+}
+
+
+void memset_set_nt_threshold(size_t n) {
+    nt_threshold = n;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file memset.h
+ * @brief memset implementations header.
+ * @author mopp
+ * @version 0.2
+ * @date 2014-10-22
+ */
+
+#ifndef _MEMSET_H_
+#define _MEMSET_H_
+
+
+
+#include <stddef.h>
+
+
+typedef void* (*memset_f)(void*, int, size_t);
+
+
+/* Simple experiments. */
+extern void* memset0(void*, int, size_t);
+extern void* memset1(void*, int, size_t);
+extern void* memset2(void*, int, size_t);
+extern void* memset3(void*, int, size_t);
+extern void* memset4(void*, int, size_t);
+
+/*
+ * Vector kernels.
+ * The caller must check cpu_features_get() before calling avx2/avx512 kernels directly.
+ */
+extern void* memset_erms(void*, int, size_t);
+extern void* memset_sse2(void*, int, size_t);
+extern void* memset_avx2(void*, int, size_t);
+extern void* memset_avx512(void*, int, size_t);
+
+/* The best kernel for the running CPU, it is chosen once at startup. */
+extern void* memset_fast(void*, int, size_t);
+extern char const* memset_fast_name(void);
+
+/* Zero fill for calloc-style use. */
+extern void* memset_zero(void*, size_t);
+
+/*
+ * Buffers of at least this size are filled by non-temporal stores.
+ * It is the last level cache size by default.
+ */
+extern size_t memset_get_nt_threshold(void);
+extern void memset_set_nt_threshold(size_t);
+
+
+
+#endif
@@ -0,0 +1,250 @@
+/**
+ * @file object_pool.c
+ * @brief Fixed-size object pool.
+ *        All objects have the same size, so alloc and free are O(1) without any search.
+ *        Freed objects are linked by their first word (intrusive free list).
+ *        The objects which have never been allocated are carved by a bump pointer,
+ *        so the initialization does not touch the region and unused pages are never committed.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-25
+ */
+
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "object_pool.h"
+
+
+static inline size_t round_up(size_t x, size_t a) {
+    return (x + a - 1) & ~(a - 1);
+}
+
+
+/**
+ * @brief Initialize the pool.
+ * @param pool
+ * @param object_size The size of each object, it is rounded up to OBJECT_POOL_ALIGNMENT.
+ * @param object_nr   The number of objects.
+ * @return NULL if failed.
+ */
+Object_pool* object_pool_init(Object_pool* pool, size_t object_size, size_t object_nr) {
+    if (pool == NULL || object_size == 0 || object_nr == 0) {
+        return NULL;
+    }
+
+    size_t const s = round_up(object_size, OBJECT_POOL_ALIGNMENT);
+    if (SIZE_MAX / object_nr < s) {
+        return NULL;
+    }
+
+    size_t const region_size = round_up(s * object_nr, (size_t)sysconf(_SC_PAGESIZE));
+    void* p                  = mmap(NULL, region_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+
+    pool->base_addr   = (uintptr_t)p;
+    pool->object_size = s;
+    pool->object_nr   = object_nr;
+    pool->region_size = region_size;
+    pool->bump_addr   = pool->base_addr;
+    pool->free_list   = NULL;
+    pool->free_nr     = object_nr;
+
+    return pool;
+}
+
+
+void object_pool_destruct(Object_pool* pool) {
+    if (pool->base_addr != 0) {
+        munmap((void*)pool->base_addr, pool->region_size);
+    }
+    pool->base_addr = 0;
+    pool->free_list = NULL;
+    pool->free_nr   = 0;
+}
+
+
+void* object_pool_alloc(Object_pool* pool) {
+    void* p = pool->free_list;
+
+    if (p != NULL) {
+        pool->free_list = *(void**)p;
+    } else if (pool->free_nr != 0) {
+        p = (void*)pool->bump_addr;
+        pool->bump_addr += pool->object_size;
+    } else {
+        return NULL;
+    }
+    pool->free_nr--;
+
+    return p;
+}
+
+
+void object_pool_free(Object_pool* pool, void* p) {
+    if (p == NULL) {
+        return;
+    }
+
+    *(void**)p      = pool->free_list;
+    pool->free_list = p;
+    pool->free_nr++;
+}
+
+
+bool object_pool_is_owner(Object_pool const* pool, void const* p) {
+    uintptr_t const addr = (uintptr_t)p;
+    return pool->base_addr <= addr && addr < pool->bump_addr && (addr - pool->base_addr) % pool->object_size == 0;
+}
+
+
+size_t object_pool_get_free_nr(Object_pool const* pool) {
+    return pool->free_nr;
+}
+
+
+/*
+ * ==================== Multi-threaded pool. ====================
+ */
+
+
+enum {
+    CACHE_BATCH_SIZE = OBJECT_POOL_CACHE_SIZE / 2,
+};
+
+
+static void refill_cache(Object_pool_mt* mt, Object_pool_cache* cache) {
+    pthread_mutex_lock(&mt->lock);
+    while (cache->nr < CACHE_BATCH_SIZE) {
+        void* p = object_pool_alloc(&mt->pool);
+        if (p == NULL) {
+            break;
+        }
+        cache->objs[cache->nr++] = p;
+    }
+    pthread_mutex_unlock(&mt->lock);
+}
+
+
+static void flush_cache(Object_pool_mt* mt, Object_pool_cache* cache, size_t n) {
+    pthread_mutex_lock(&mt->lock);
+    while (n-- != 0) {
+        object_pool_free(&mt->pool, cache->objs[--cache->nr]);
+    }
+    pthread_mutex_unlock(&mt->lock);
+}
+
+
+static void release_cache(void* p) {
+    Object_pool_cache* cache = p;
+
+    flush_cache(cache->owner, cache, cache->nr);
+    free(cache);
+}
+
+
+static inline Object_pool_cache* get_cache(Object_pool_mt* mt) {
+    Object_pool_cache* cache = pthread_getspecific(mt->cache_key);
+    if (cache != NULL) {
+        return cache;
+    }
+
+    cache = malloc(sizeof(Object_pool_cache));
+    if (cache != NULL) {
+        cache->owner = mt;
+        cache->nr    = 0;
+        if (pthread_setspecific(mt->cache_key, cache) != 0) {
+            free(cache);
+            cache = NULL;
+        }
+    }
+
+    return cache;
+}
+
+
+Object_pool_mt* object_pool_mt_init(Object_pool_mt* mt, size_t object_size, size_t object_nr) {
+    if (mt == NULL || object_pool_init(&mt->pool, object_size, object_nr) == NULL) {
+        return NULL;
+    }
+
+    if (pthread_mutex_init(&mt->lock, NULL) != 0) {
+        object_pool_destruct(&mt->pool);
+        return NULL;
+    }
+
+    /* Caches of exiting threads are flushed by the key destructor. */
+    if (pthread_key_create(&mt->cache_key, release_cache) != 0) {
+        pthread_mutex_destroy(&mt->lock);
+        object_pool_destruct(&mt->pool);
+        return NULL;
+    }
+
+    return mt;
+}
+
+
+/* Other threads must have exited or flushed their caches. */
+void object_pool_mt_destruct(Object_pool_mt* mt) {
+    Object_pool_cache* cache = pthread_getspecific(mt->cache_key);
+    if (cache != NULL) {
+        pthread_setspecific(mt->cache_key, NULL);
+        release_cache(cache);
+    }
+
+    pthread_key_delete(mt->cache_key);
+    pthread_mutex_destroy(&mt->lock);
+    object_pool_destruct(&mt->pool);
+}
+
+
+void* object_pool_mt_alloc(Object_pool_mt* mt) {
+    Object_pool_cache* cache = get_cache(mt);
+
+    if (cache == NULL) {
+        pthread_mutex_lock(&mt->lock);
+        void* p = object_pool_alloc(&mt->pool);
+        pthread_mutex_unlock(&mt->lock);
+        return p;
+    }
+
+    if (cache->nr == 0) {
+        refill_cache(mt, cache);
+    }
+
+    return (cache->nr == 0) ? NULL : cache->objs[--cache->nr];
+}
+
+
+void object_pool_mt_free(Object_pool_mt* mt, void* p) {
+    if (p == NULL) {
+        return;
+    }
+
+    Object_pool_cache* cache = get_cache(mt);
+    if (cache == NULL) {
+        pthread_mutex_lock(&mt->lock);
+        object_pool_free(&mt->pool, p);
+        pthread_mutex_unlock(&mt->lock);
+        return;
+    }
+
+    if (cache->nr == OBJECT_POOL_CACHE_SIZE) {
+        flush_cache(mt, cache, CACHE_BATCH_SIZE);
+    }
+    cache->objs[cache->nr++] = p;
+}
+
+
+/**
+ * @brief Return the objects in the cache of the calling thread to the pool.
+ */
+void object_pool_mt_thread_flush(Object_pool_mt* mt) {
+    Object_pool_cache* cache = pthread_getspecific(mt->cache_key);
+
+    if (cache != NULL) {
+        flush_cache(mt, cache, cache->nr);
+    }
+}
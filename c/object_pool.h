@@ -0,0 +1,74 @@
+/**
+ * @file object_pool.h
+ * @brief Fixed-size object pool.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-25
+ */
+
+#ifndef _OBJECT_POOL_H_
+#define _OBJECT_POOL_H_
+
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+
+enum {
+    OBJECT_POOL_ALIGNMENT  = 16,
+    OBJECT_POOL_CACHE_SIZE = 64, /* Objects per thread cache, half of them are moved at once. */
+};
+
+
+struct object_pool {
+    uintptr_t base_addr;
+    size_t object_size; /* Rounded up to OBJECT_POOL_ALIGNMENT. */
+    size_t object_nr;
+    size_t region_size;
+    uintptr_t bump_addr; /* Objects at and after this address have never been allocated. */
+    void* free_list;     /* Freed objects, the first word of each object links the next one. */
+    size_t free_nr;
+};
+typedef struct object_pool Object_pool;
+
+
+extern Object_pool* object_pool_init(Object_pool*, size_t, size_t);
+extern void object_pool_destruct(Object_pool*);
+extern void* object_pool_alloc(Object_pool*);
+extern void object_pool_free(Object_pool*, void*);
+extern bool object_pool_is_owner(Object_pool const*, void const*);
+extern size_t object_pool_get_free_nr(Object_pool const*);
+
+
+/*
+ * Object pool shared by threads.
+ * Each thread keeps a few objects, the lock is taken only to move a half of the cache.
+ */
+struct object_pool_cache {
+    struct object_pool_mt* owner;
+    size_t nr;
+    void* objs[OBJECT_POOL_CACHE_SIZE];
+};
+typedef struct object_pool_cache Object_pool_cache;
+
+
+struct object_pool_mt {
+    Object_pool pool;
+    pthread_mutex_t lock;
+    pthread_key_t cache_key; /* Object_pool_cache of the calling thread. */
+};
+typedef struct object_pool_mt Object_pool_mt;
+
+
+extern Object_pool_mt* object_pool_mt_init(Object_pool_mt*, size_t, size_t);
+extern void object_pool_mt_destruct(Object_pool_mt*);
+extern void* object_pool_mt_alloc(Object_pool_mt*);
+extern void object_pool_mt_free(Object_pool_mt*, void*);
+extern void object_pool_mt_thread_flush(Object_pool_mt*);
+
+
+
+#endif
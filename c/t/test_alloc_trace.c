@@ -0,0 +1,200 @@
+#include "../minunit.h"
+#include "../alloc_trace.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+#define EVENT_NR 6
+#define RECORDER "./alloc_trace_record.so"
+#define RECORD_FILE "test_alloc_trace_record.trace"
+#define RECORD_THREAD_NR 2
+#define RECORD_LOOP_NR 20000
+#define RECORD_REALLOC_SIZE 4000 /* Reallocs to this size are counted in the trace. */
+#define LIVE_MAP_SIZE (1 << 20)
+
+
+static Alloc_trace_event const events[EVENT_NR] = {
+    {ALLOC_TRACE_MALLOC, 0x7f0000001000, 0, 100, 0},
+    {ALLOC_TRACE_MALLOC, 0x7f0000001080, 0, 1 << 20, 0},
+    {ALLOC_TRACE_REALLOC, 0x7f0000002000, 0x7f0000001000, 300, 0},
+    {ALLOC_TRACE_MEMALIGN, 0x600000, 0, 64, 4096},
+    {ALLOC_TRACE_MALLOC, 0, 0, SIZE_MAX, 0},
+    {ALLOC_TRACE_FREE, 0x7f0000001080, 0, 0, 0},
+};
+
+
+static bool is_same_event(Alloc_trace_event const* a, Alloc_trace_event const* b) {
+    return a->op == b->op && a->addr == b->addr && a->old_addr == b->old_addr && a->size == b->size && a->align == b->align;
+}
+
+
+static char const* test_alloc_trace(void) {
+    uint8_t buf[EVENT_NR * ALLOC_TRACE_EVENT_MAX_SIZE];
+    Alloc_trace_state s = {0};
+    size_t len          = 0;
+
+    for (size_t i = 0; i < EVENT_NR; i++) {
+        size_t n = alloc_trace_encode(&s, &events[i], buf + len);
+        MIN_UNIT_ASSERT("alloc_trace_encode is wrong.", 0 < n && n <= ALLOC_TRACE_EVENT_MAX_SIZE);
+        len += n;
+    }
+    /* A near address takes a few bytes. */
+    Alloc_trace_state c = {events[0].addr};
+    MIN_UNIT_ASSERT("trace is not compact.", alloc_trace_encode(&c, &events[5], buf + len) <= 3);
+
+    Alloc_trace_state d = {0};
+    Alloc_trace_event e;
+    size_t pos = 0;
+    for (size_t i = 0; i < EVENT_NR; i++) {
+        size_t n = alloc_trace_decode(&d, buf + pos, len - pos, &e);
+        MIN_UNIT_ASSERT("alloc_trace_decode is wrong.", n != 0 && is_same_event(&e, &events[i]) == true);
+        pos += n;
+    }
+    MIN_UNIT_ASSERT("alloc_trace_decode is wrong.", pos == len);
+    MIN_UNIT_ASSERT("alloc_trace_decode is wrong.", alloc_trace_decode(&d, buf + pos, 0, &e) == 0);
+
+    /* A truncated event is not read and the state is kept. */
+    Alloc_trace_state t = {0};
+    size_t n            = alloc_trace_encode(&t, &events[2], buf);
+    Alloc_trace_state r = {0};
+    MIN_UNIT_ASSERT("truncated event is read.", alloc_trace_decode(&r, buf, n - 1, &e) == 0 && r.last_addr == 0);
+    MIN_UNIT_ASSERT("alloc_trace_decode is wrong.", alloc_trace_decode(&r, buf, n, &e) == n && is_same_event(&e, &events[2]) == true);
+
+    buf[0] = 0xff;
+    MIN_UNIT_ASSERT("broken event is read.", alloc_trace_decode(&r, buf, n, &e) == 0);
+
+    return NULL;
+}
+
+
+/* This runs under the recorder, the freed old addresses of realloc are reused by malloc in the other thread. */
+static void* record_worker(void* arg) {
+    for (size_t i = 0; i < RECORD_LOOP_NR; i++) {
+        void* p = malloc(16 + i % 32);
+        void* q = realloc(p, RECORD_REALLOC_SIZE);
+        void* r = malloc(16 + i % 32);
+        free(q);
+        free(r);
+    }
+
+    return arg;
+}
+
+
+static int record_workload(void) {
+    pthread_t threads[RECORD_THREAD_NR];
+
+    for (size_t i = 0; i < RECORD_THREAD_NR; i++) {
+        pthread_create(&threads[i], NULL, record_worker, NULL);
+    }
+    for (size_t i = 0; i < RECORD_THREAD_NR; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    return 0;
+}
+
+
+/*
+ * Set of the live addresses in the trace.
+ * Open addressing without deletion, an address is marked dead instead.
+ */
+static uintptr_t live_keys[LIVE_MAP_SIZE];
+static bool live_flags[LIVE_MAP_SIZE];
+
+
+static bool* live_flag(uintptr_t addr) {
+    size_t i = (size_t)((uint64_t)addr * UINT64_C(0x9E3779B97F4A7C15) >> 44) & (LIVE_MAP_SIZE - 1);
+    while (live_keys[i] != addr && live_keys[i] != 0) {
+        i = (i + 1) & (LIVE_MAP_SIZE - 1);
+    }
+    live_keys[i] = addr;
+
+    return &live_flags[i];
+}
+
+
+static char const* test_alloc_trace_record(char const* self) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        setenv("ALLOC_TRACE_FILE", RECORD_FILE, 1);
+        setenv("LD_PRELOAD", RECORDER, 1);
+        execl(self, self, "record", (char*)NULL);
+        _exit(127);
+    }
+    int status;
+    MIN_UNIT_ASSERT("recording process failed.", 0 < pid && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    FILE* fp = fopen(RECORD_FILE, "rb");
+    MIN_UNIT_ASSERT("trace is not written.", fp != NULL);
+    static uint8_t buf[1 << 24];
+    size_t const len = fread(buf, 1, sizeof(buf), fp);
+    fclose(fp);
+    remove(RECORD_FILE);
+    MIN_UNIT_ASSERT("trace is wrong.", ALLOC_TRACE_MAGIC_SIZE <= len && len < sizeof(buf) && memcmp(buf, ALLOC_TRACE_MAGIC, ALLOC_TRACE_MAGIC_SIZE) == 0);
+
+    /* Replay the trace on the set, an address must not be allocated twice without free. */
+    Alloc_trace_state s = {0};
+    Alloc_trace_event e;
+    size_t realloc_nr = 0;
+    size_t pos        = ALLOC_TRACE_MAGIC_SIZE;
+    for (size_t n; (n = alloc_trace_decode(&s, buf + pos, len - pos, &e)) != 0; pos += n) {
+        switch (e.op) {
+            case ALLOC_TRACE_MALLOC:
+            case ALLOC_TRACE_MEMALIGN:
+                if (e.addr != 0) {
+                    bool* f = live_flag(e.addr);
+                    MIN_UNIT_ASSERT("live address is allocated again.", *f == false);
+                    *f = true;
+                }
+                break;
+            case ALLOC_TRACE_FREE:
+                *live_flag(e.addr) = false;
+                break;
+            case ALLOC_TRACE_REALLOC:
+                if (e.addr == 0) {
+                    break;
+                }
+                if (e.old_addr != 0) {
+                    *live_flag(e.old_addr) = false;
+                    realloc_nr += (e.size == RECORD_REALLOC_SIZE);
+                }
+                bool* f = live_flag(e.addr);
+                MIN_UNIT_ASSERT("realloc returns live address.", *f == false);
+                *f = true;
+                break;
+        }
+    }
+    MIN_UNIT_ASSERT("trace is broken.", pos == len);
+    MIN_UNIT_ASSERT("realloc is not recorded.", realloc_nr == RECORD_THREAD_NR * RECORD_LOOP_NR);
+
+    return NULL;
+}
+
+
+static char const* self_path;
+static char const* test_alloc_trace_record_threads(void) {
+    return test_alloc_trace_record(self_path);
+}
+
+
+static char const* all_tests(void) {
+    MIN_UNIT_RUN(test_alloc_trace);
+    MIN_UNIT_RUN(test_alloc_trace_record_threads);
+    return NULL;
+}
+
+
+int main(int argc, char** argv) {
+    if (argc == 2 && strcmp(argv[1], "record") == 0) {
+        return record_workload();
+    }
+
+    self_path = argv[0];
+    MIN_UNIT_RUN_ALL(all_tests);
+}
@@ -59,8 +59,123 @@ static char const* test_aqueue(void) {
 }
 
 
+static size_t released_nr;
+static int released_sum;
+static void release_int(void* d) {
+    released_nr++;
+    released_sum += *(int*)d;
+}
+
+
+static char const* test_aqueue_growable(void) {
+    Aqueue aq;
+    Aqueue* const p = &aq;
+
+    /* Fixed queue drops an item when it is full. */
+    aqueue_init(p, sizeof(int), 4, NULL);
+    for (int i = 0; i < 4; i++) {
+        MIN_UNIT_ASSERT("aqueue_insert is wrong.", aqueue_insert(p, &i) != NULL);
+    }
+    int x = 4;
+    MIN_UNIT_ASSERT("full queue accepts item.", aqueue_insert(p, &x) == NULL && aqueue_get_capacity(p) == 4);
+    aqueue_destruct(p);
+
+    /* The ring is wrapped in various positions before growing. */
+    for (int shift = 0; shift < 8; shift++) {
+        int next_in = 0, next_out = 0;
+
+        aqueue_init_growable(p, sizeof(int), 8, release_int);
+        for (int i = 0; i < shift; i++) {
+            aqueue_insert(p, &next_in);
+            next_in++;
+            aqueue_delete_first(p);
+            next_out++;
+        }
+
+        for (int i = 0; i < 100; i++) {
+            MIN_UNIT_ASSERT("growable aqueue_insert is wrong.", aqueue_insert(p, &next_in) != NULL);
+            next_in++;
+            if (i % 3 == 0) {
+                MIN_UNIT_ASSERT("order is broken by growing.", aqueue_get(int, p) == next_out);
+                aqueue_delete_first(p);
+                next_out++;
+            }
+        }
+        MIN_UNIT_ASSERT("queue is not grown.", aqueue_get_size(p) == (size_t)(next_in - next_out) && 64 <= aqueue_get_capacity(p));
+
+        for (int i = 0; i < 10; i++) {
+            MIN_UNIT_ASSERT("order is broken by growing.", aqueue_get(int, p) == next_out);
+            aqueue_delete_first(p);
+            next_out++;
+        }
+
+        /* The remaining elements are released. */
+        int sum = 0;
+        for (int i = next_out; i < next_in; i++) {
+            sum += i;
+        }
+        released_nr  = 0;
+        released_sum = 0;
+        aqueue_destruct(p);
+        MIN_UNIT_ASSERT("aqueue_destruct is wrong.", released_nr == (size_t)(next_in - next_out) && released_sum == sum);
+    }
+
+    aqueue_init_growable(p, sizeof(int), 0, NULL);
+    MIN_UNIT_ASSERT("zero capacity queue is not grown.", aqueue_insert(p, &x) != NULL && aqueue_get(int, p) == 4);
+    aqueue_destruct(p);
+
+    return NULL;
+}
+
+
+static char const* test_aqueue_batch(void) {
+    Aqueue aq;
+    Aqueue* const p = &aq;
+    int in[MAX_CAPACITY * 4], out[MAX_CAPACITY * 4];
+    for (int i = 0; i < MAX_CAPACITY * 4; i++) {
+        in[i] = i;
+    }
+
+    /* Fixed queue inserts as many as it can. */
+    aqueue_init(p, sizeof(int), MAX_CAPACITY, NULL);
+    MIN_UNIT_ASSERT("aqueue_insert_n is wrong.", aqueue_insert_n(p, in, 7) == 7);
+    MIN_UNIT_ASSERT("aqueue_pop_n is wrong.", aqueue_pop_n(p, out, 5) == 5 && out[0] == 0 && out[4] == 4);
+
+    /* The elements wrap around the end of buffer. */
+    MIN_UNIT_ASSERT("aqueue_insert_n on full is wrong.", aqueue_insert_n(p, in + 7, 20) == 8 && aqueue_is_full(p) == true);
+    MIN_UNIT_ASSERT("aqueue_pop_n is wrong.", aqueue_pop_n(p, out, 20) == MAX_CAPACITY && aqueue_is_empty(p) == true);
+    for (int i = 0; i < MAX_CAPACITY; i++) {
+        MIN_UNIT_ASSERT("aqueue_pop_n order is wrong.", out[i] == i + 5);
+    }
+    MIN_UNIT_ASSERT("aqueue_pop_n on empty is wrong.", aqueue_pop_n(p, out, 1) == 0);
+
+    /* Batch and single operations are mixed. */
+    aqueue_insert_n(p, in, 3);
+    int x = 3;
+    aqueue_insert(p, &x);
+    MIN_UNIT_ASSERT("aqueue_pop_n without out is wrong.", aqueue_pop_n(p, NULL, 2) == 2 && aqueue_get(int, p) == 2);
+    aqueue_destruct(p);
+
+    /* Growable queue takes all elements even if it is wrapped. */
+    aqueue_init_growable(p, sizeof(int), 4, NULL);
+    aqueue_insert_n(p, in, 3);
+    aqueue_pop_n(p, NULL, 2);
+    MIN_UNIT_ASSERT("growable aqueue_insert_n is wrong.", aqueue_insert_n(p, in + 3, MAX_CAPACITY * 3) == MAX_CAPACITY * 3);
+    MIN_UNIT_ASSERT("growable aqueue_insert_n is wrong.", aqueue_get_size(p) == MAX_CAPACITY * 3 + 1);
+    MIN_UNIT_ASSERT("aqueue_pop_n is wrong.", aqueue_pop_n(p, out, MAX_CAPACITY * 4) == MAX_CAPACITY * 3 + 1);
+    for (int i = 0; i < MAX_CAPACITY * 3 + 1; i++) {
+        MIN_UNIT_ASSERT("order is broken by growing.", out[i] == i + 2);
+    }
+    aqueue_destruct(p);
+
+    return NULL;
+}
+
+
 static char const* all_tests(void) {
     MIN_UNIT_RUN(test_aqueue);
+    MIN_UNIT_RUN(test_aqueue_growable);
+    MIN_UNIT_RUN(test_aqueue_batch);
     return NULL;
 }
 
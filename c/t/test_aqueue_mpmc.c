@@ -0,0 +1,155 @@
+#include "../minunit.h"
+#include "../aqueue_mpmc.h"
+#include "../macro.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define CAPACITY 10
+#define PRODUCER_NR 3
+#define CONSUMER_NR 3
+#define ITEM_NR 100000
+
+
+static char const* test_aqueue_mpmc(void) {
+    Aqueue_mpmc q;
+    Aqueue_mpmc* const p = &q;
+
+    MIN_UNIT_ASSERT("aqueue_mpmc_init is wrong.", aqueue_mpmc_init(p, sizeof(int), CAPACITY) == p);
+    MIN_UNIT_ASSERT("aqueue_mpmc_init is wrong.", aqueue_mpmc_get_capacity(p) == 16);
+
+    int x;
+    MIN_UNIT_ASSERT("aqueue_mpmc_try_get is wrong.", aqueue_mpmc_try_get(p, &x) == false);
+
+    for (int i = 0; i < 16; i++) {
+        MIN_UNIT_ASSERT("aqueue_mpmc_try_insert is wrong.", aqueue_mpmc_try_insert(p, &i) == true);
+    }
+    MIN_UNIT_ASSERT("aqueue_mpmc_try_insert is wrong.", aqueue_mpmc_try_insert(p, &x) == false);
+
+    for (int i = 0; i < 16; i++) {
+        MIN_UNIT_ASSERT("aqueue_mpmc_try_get is wrong.", aqueue_mpmc_try_get(p, &x) == true && x == i);
+    }
+    MIN_UNIT_ASSERT("aqueue_mpmc_try_get is wrong.", aqueue_mpmc_try_get(p, &x) == false);
+
+    aqueue_mpmc_destruct(p);
+
+    return NULL;
+}
+
+
+static char const* test_aqueue_mpmc_batch(void) {
+    Aqueue_mpmc q;
+    Aqueue_mpmc* const p = &q;
+    int in[12], out[12];
+
+    for (int i = 0; i < ARRAY_SIZE_OF(in); i++) {
+        in[i] = i;
+    }
+
+    aqueue_mpmc_init(p, sizeof(int), 16);
+
+    /* Move positions so that the next batch wraps around. */
+    MIN_UNIT_ASSERT("aqueue_mpmc_try_insert_n is wrong.", aqueue_mpmc_try_insert_n(p, in, 10) == 10);
+    MIN_UNIT_ASSERT("aqueue_mpmc_try_get_n is wrong.", aqueue_mpmc_try_get_n(p, out, 10) == 10);
+    MIN_UNIT_ASSERT("aqueue_mpmc_try_get_n is wrong.", memcmp(in, out, sizeof(int) * 10) == 0);
+
+    MIN_UNIT_ASSERT("aqueue_mpmc_try_insert_n is wrong.", aqueue_mpmc_try_insert_n(p, in, 12) == 12);
+    MIN_UNIT_ASSERT("aqueue_mpmc_try_insert_n is wrong.", aqueue_mpmc_try_insert_n(p, in, 12) == 4);
+    MIN_UNIT_ASSERT("aqueue_mpmc_try_insert_n is wrong.", aqueue_mpmc_try_insert_n(p, in, 12) == 0);
+
+    MIN_UNIT_ASSERT("aqueue_mpmc_try_get_n is wrong.", aqueue_mpmc_try_get_n(p, out, 12) == 12);
+    MIN_UNIT_ASSERT("aqueue_mpmc_try_get_n is wrong.", memcmp(in, out, sizeof(in)) == 0);
+    MIN_UNIT_ASSERT("aqueue_mpmc_try_get_n is wrong.", aqueue_mpmc_try_get_n(p, out, 12) == 4);
+    MIN_UNIT_ASSERT("aqueue_mpmc_try_get_n is wrong.", memcmp(in, out, sizeof(int) * 4) == 0);
+    MIN_UNIT_ASSERT("aqueue_mpmc_try_get_n is wrong.", aqueue_mpmc_try_get_n(p, out, 12) == 0);
+
+    aqueue_mpmc_destruct(p);
+
+    return NULL;
+}
+
+
+static void* producer(void* arg) {
+    Aqueue_mpmc* q = arg;
+
+    for (size_t i = 1; i <= ITEM_NR; i++) {
+        while (aqueue_mpmc_try_insert(q, &i) == false) {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+
+static void* consumer(void* arg) {
+    Aqueue_mpmc* q = arg;
+    size_t* sum    = malloc(sizeof(size_t));
+    size_t buf[8];
+
+    /* Each consumer takes ITEM_NR items, so all items inserted by producers are taken. */
+    *sum = 0;
+    for (size_t got = 0; got < ITEM_NR;) {
+        size_t const rest = ITEM_NR - got;
+        size_t n          = aqueue_mpmc_try_get_n(q, buf, (rest < ARRAY_SIZE_OF(buf)) ? rest : ARRAY_SIZE_OF(buf));
+        if (n == 0) {
+            sched_yield();
+            continue;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            *sum += buf[i];
+        }
+        got += n;
+    }
+
+    return sum;
+}
+
+
+static char const* test_aqueue_mpmc_threads(void) {
+    Aqueue_mpmc q;
+    pthread_t producers[PRODUCER_NR], consumers[CONSUMER_NR];
+
+    aqueue_mpmc_init(&q, sizeof(size_t), 64);
+
+    for (int i = 0; i < PRODUCER_NR; i++) {
+        pthread_create(&producers[i], NULL, producer, &q);
+    }
+    for (int i = 0; i < CONSUMER_NR; i++) {
+        pthread_create(&consumers[i], NULL, consumer, &q);
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < PRODUCER_NR; i++) {
+        pthread_join(producers[i], NULL);
+    }
+    for (int i = 0; i < CONSUMER_NR; i++) {
+        size_t* sum;
+        pthread_join(consumers[i], (void**)&sum);
+        total += *sum;
+        free(sum);
+    }
+
+    size_t const expected = (size_t)PRODUCER_NR * ITEM_NR * (ITEM_NR + 1) / 2;
+    MIN_UNIT_ASSERT("aqueue_mpmc with threads is wrong.", total == expected);
+
+    aqueue_mpmc_destruct(&q);
+
+    return NULL;
+}
+
+
+static char const* all_tests(void) {
+    MIN_UNIT_RUN(test_aqueue_mpmc);
+    MIN_UNIT_RUN(test_aqueue_mpmc_batch);
+    MIN_UNIT_RUN(test_aqueue_mpmc_threads);
+    return NULL;
+}
+
+
+int main(void) {
+    MIN_UNIT_RUN_ALL(all_tests);
+}
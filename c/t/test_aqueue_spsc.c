@@ -0,0 +1,164 @@
+#include "../minunit.h"
+#include "../aqueue_spsc.h"
+#include "../macro.h"
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+
+#define CAPACITY 10
+#define ITEM_NR 1000000
+
+
+static char const* test_aqueue_spsc(void) {
+    Aqueue_spsc q;
+    Aqueue_spsc* const p = &q;
+
+    MIN_UNIT_ASSERT("aqueue_spsc_init is wrong.", aqueue_spsc_init(p, sizeof(int), CAPACITY) == p);
+    MIN_UNIT_ASSERT("aqueue_spsc_init is wrong.", aqueue_spsc_get_capacity(p) == 16 && p->is_blocking == false);
+
+    int x;
+    MIN_UNIT_ASSERT("aqueue_spsc_try_get is wrong.", aqueue_spsc_try_get(p, &x) == false);
+
+    for (int i = 0; i < 16; i++) {
+        MIN_UNIT_ASSERT("aqueue_spsc_try_insert is wrong.", aqueue_spsc_try_insert(p, &i) == true);
+    }
+    MIN_UNIT_ASSERT("aqueue_spsc_try_insert is wrong.", aqueue_spsc_try_insert(p, &x) == false);
+
+    for (int i = 0; i < 16; i++) {
+        MIN_UNIT_ASSERT("aqueue_spsc_try_get is wrong.", aqueue_spsc_try_get(p, &x) == true && x == i);
+    }
+    MIN_UNIT_ASSERT("aqueue_spsc_try_get is wrong.", aqueue_spsc_try_get(p, &x) == false);
+
+    aqueue_spsc_destruct(p);
+
+    return NULL;
+}
+
+
+static char const* test_aqueue_spsc_batch(void) {
+    Aqueue_spsc q;
+    Aqueue_spsc* const p = &q;
+    int in[12], out[12];
+
+    for (int i = 0; i < ARRAY_SIZE_OF(in); i++) {
+        in[i] = i;
+    }
+
+    aqueue_spsc_init(p, sizeof(int), 16);
+
+    /* Move positions so that the next batch wraps around. */
+    MIN_UNIT_ASSERT("aqueue_spsc_try_insert_n is wrong.", aqueue_spsc_try_insert_n(p, in, 10) == 10);
+    MIN_UNIT_ASSERT("aqueue_spsc_try_get_n is wrong.", aqueue_spsc_try_get_n(p, out, 10) == 10);
+    MIN_UNIT_ASSERT("aqueue_spsc_try_get_n is wrong.", memcmp(in, out, sizeof(int) * 10) == 0);
+
+    MIN_UNIT_ASSERT("aqueue_spsc_try_insert_n is wrong.", aqueue_spsc_try_insert_n(p, in, 12) == 12);
+    MIN_UNIT_ASSERT("aqueue_spsc_try_insert_n is wrong.", aqueue_spsc_try_insert_n(p, in, 12) == 4);
+    MIN_UNIT_ASSERT("aqueue_spsc_try_insert_n is wrong.", aqueue_spsc_try_insert_n(p, in, 12) == 0);
+
+    MIN_UNIT_ASSERT("aqueue_spsc_try_get_n is wrong.", aqueue_spsc_try_get_n(p, out, 12) == 12);
+    MIN_UNIT_ASSERT("aqueue_spsc_try_get_n is wrong.", memcmp(in, out, sizeof(in)) == 0);
+    MIN_UNIT_ASSERT("aqueue_spsc_try_get_n is wrong.", aqueue_spsc_try_get_n(p, out, 12) == 4);
+    MIN_UNIT_ASSERT("aqueue_spsc_try_get_n is wrong.", memcmp(in, out, sizeof(int) * 4) == 0);
+    MIN_UNIT_ASSERT("aqueue_spsc_try_get_n is wrong.", aqueue_spsc_try_get_n(p, out, 12) == 0);
+
+    aqueue_spsc_destruct(p);
+
+    return NULL;
+}
+
+
+static void* spin_producer(void* arg) {
+    Aqueue_spsc* q = arg;
+
+    for (size_t i = 1; i <= ITEM_NR; i++) {
+        while (aqueue_spsc_try_insert(q, &i) == false) {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+
+static void* blocking_producer(void* arg) {
+    Aqueue_spsc* q = arg;
+
+    for (size_t i = 1; i <= ITEM_NR; i++) {
+        aqueue_spsc_insert(q, &i);
+    }
+
+    return NULL;
+}
+
+
+/* The consumer checks the order of all items. */
+static bool spin_consume(Aqueue_spsc* q) {
+    size_t buf[8];
+    size_t expected = 1;
+
+    while (expected <= ITEM_NR) {
+        size_t n = aqueue_spsc_try_get_n(q, buf, ARRAY_SIZE_OF(buf));
+        if (n == 0) {
+            sched_yield();
+            continue;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            if (buf[i] != expected++) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+static bool blocking_consume(Aqueue_spsc* q) {
+    for (size_t i = 1; i <= ITEM_NR; i++) {
+        size_t v;
+        aqueue_spsc_get(q, &v);
+        if (v != i) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+static char const* test_aqueue_spsc_threads(void) {
+    Aqueue_spsc q;
+    pthread_t producer;
+
+    aqueue_spsc_init(&q, sizeof(size_t), 64);
+    pthread_create(&producer, NULL, spin_producer, &q);
+    bool is_ordered = spin_consume(&q);
+    pthread_join(producer, NULL);
+    MIN_UNIT_ASSERT("aqueue_spsc with threads is wrong.", is_ordered == true);
+    aqueue_spsc_destruct(&q);
+
+    /* Small capacity makes both sides sleep. */
+    aqueue_spsc_init_blocking(&q, sizeof(size_t), 4);
+    pthread_create(&producer, NULL, blocking_producer, &q);
+    is_ordered = blocking_consume(&q);
+    pthread_join(producer, NULL);
+    MIN_UNIT_ASSERT("blocking aqueue_spsc with threads is wrong.", is_ordered == true);
+    aqueue_spsc_destruct(&q);
+
+    return NULL;
+}
+
+
+static char const* all_tests(void) {
+    MIN_UNIT_RUN(test_aqueue_spsc);
+    MIN_UNIT_RUN(test_aqueue_spsc_batch);
+    MIN_UNIT_RUN(test_aqueue_spsc_threads);
+    return NULL;
+}
+
+
+int main(void) {
+    MIN_UNIT_RUN_ALL(all_tests);
+}
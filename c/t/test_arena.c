@@ -0,0 +1,97 @@
+#include "../minunit.h"
+#include "../arena.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+
+#define CHUNK_SIZE 4096
+#define TLSF_POOL_SIZE (1024 * 1024)
+
+
+static char const* check_arena(Arena* a) {
+    MIN_UNIT_ASSERT("chunk is allocated by init.", arena_get_chunk_nr(a) == 0);
+
+    uint8_t* p = arena_alloc(a, 10);
+    uint8_t* q = arena_alloc(a, 10);
+    MIN_UNIT_ASSERT("arena_alloc is wrong.", p != NULL && (uintptr_t)p % ARENA_DEFAULT_ALIGN == 0);
+    MIN_UNIT_ASSERT("arena_alloc does not bump.", q == p + ARENA_DEFAULT_ALIGN);
+    memset(p, 0xaa, 10);
+    memset(q, 0xbb, 10);
+
+    uint8_t* r = arena_alloc_align(a, 1, 256);
+    MIN_UNIT_ASSERT("arena_alloc_align is wrong.", r != NULL && (uintptr_t)r % 256 == 0);
+    MIN_UNIT_ASSERT("wrong alignment is accepted.", arena_alloc_align(a, 1, 48) == NULL);
+
+    /* Rollback frees the objects after the savepoint only. */
+    Arena_savepoint sp = arena_save(a);
+    uint8_t* s         = arena_alloc(a, 100);
+    uint8_t* big       = arena_alloc(a, CHUNK_SIZE * 3);
+    MIN_UNIT_ASSERT("large object is not allocated.", big != NULL && arena_get_chunk_nr(a) == 2);
+    memset(big, 0xcc, CHUNK_SIZE * 3);
+    arena_rollback(a, sp);
+    MIN_UNIT_ASSERT("arena_rollback is wrong.", arena_alloc(a, 100) == s);
+    MIN_UNIT_ASSERT("object before the savepoint is broken.", p[9] == 0xaa && q[9] == 0xbb);
+
+    /* The chunks are reused after reset. */
+    arena_reset(a);
+    MIN_UNIT_ASSERT("arena_reset is wrong.", arena_alloc(a, 10) == p);
+    for (size_t i = 0; i < 200; i++) {
+        MIN_UNIT_ASSERT("arena_alloc is wrong.", arena_alloc(a, 100) != NULL);
+    }
+    size_t const chunk_nr = arena_get_chunk_nr(a);
+    MIN_UNIT_ASSERT("new chunk is not allocated.", 2 < chunk_nr);
+
+    arena_reset(a);
+    for (size_t i = 0; i < 200; i++) {
+        MIN_UNIT_ASSERT("arena_alloc is wrong.", arena_alloc(a, 100) != NULL);
+    }
+    MIN_UNIT_ASSERT("chunk is not reused.", arena_get_chunk_nr(a) == chunk_nr);
+
+    arena_reset(a);
+    arena_trim(a);
+    MIN_UNIT_ASSERT("arena_trim is wrong.", arena_get_chunk_nr(a) == 1);
+
+    arena_destruct(a);
+    MIN_UNIT_ASSERT("arena_destruct is wrong.", arena_get_chunk_nr(a) == 0);
+
+    return NULL;
+}
+
+
+static char const* test_arena_mmap(void) {
+    Arena a;
+    MIN_UNIT_ASSERT("arena_init is wrong.", arena_init(&a, CHUNK_SIZE, NULL) == &a);
+    return check_arena(&a);
+}
+
+
+static char const* test_arena_tlsf(void) {
+    Tlsf_manager tman;
+    Arena a;
+
+    Tlsf_stats stats;
+
+    tlsf_init(&tman);
+    tlsf_supply_memory(&tman, TLSF_POOL_SIZE);
+
+    MIN_UNIT_ASSERT("arena_init is wrong.", arena_init(&a, CHUNK_SIZE, &tman) == &a);
+    char const* msg = check_arena(&a);
+    tlsf_get_stats(&tman, &stats);
+    MIN_UNIT_ASSERT("chunks are not returned to TLSF.", msg != NULL || (stats.counters.live_size == 0 && 0 < stats.counters.free_nr));
+    tlsf_destruct(&tman);
+
+    return msg;
+}
+
+
+static char const* all_tests(void) {
+    MIN_UNIT_RUN(test_arena_mmap);
+    MIN_UNIT_RUN(test_arena_tlsf);
+    return NULL;
+}
+
+
+int main(void) {
+    MIN_UNIT_RUN_ALL(all_tests);
+}
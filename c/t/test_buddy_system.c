@@ -0,0 +1,206 @@
+#include "../minunit.h"
+#include "../buddy_system.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+
+#define THREAD_NR 4
+#define LOOP_NR 100000
+#define LIVE_NR 64
+#define FRAME_NR (1024 * 16)
+
+
+static char const* test_buddy(void) {
+    Buddy_manager bman;
+
+    MIN_UNIT_ASSERT("buddy_init is wrong.", buddy_init(&bman, FRAME_SIZE * FRAME_NR) == &bman);
+
+    Frame* f = buddy_alloc_frames(&bman, 3);
+    MIN_UNIT_ASSERT("buddy_alloc_frames is wrong.", f != NULL && f->order == 3);
+    MIN_UNIT_ASSERT("buddy_alloc_frames is wrong.", buddy_get_alloc_memory_size(&bman) == ORDER_FRAME_SIZE(3));
+    buddy_free_frames(&bman, f);
+    MIN_UNIT_ASSERT("buddy_free_frames is wrong.", buddy_get_free_memory_size(&bman) == FRAME_SIZE * FRAME_NR);
+
+    buddy_destruct(&bman);
+
+    return NULL;
+}
+
+
+static char const* test_buddy_mmap(void) {
+    Buddy_manager bman;
+    size_t const frame_size = 8192;
+    size_t const memory_size = frame_size * 100 + 123;
+    void* ps[100];
+
+    MIN_UNIT_ASSERT("buddy_init_mmap is wrong.", buddy_init_mmap(&bman, memory_size, 1000, 4) == NULL);
+    MIN_UNIT_ASSERT("buddy_init_mmap is wrong.", buddy_init_mmap(&bman, memory_size, frame_size, 0) == NULL);
+    MIN_UNIT_ASSERT("buddy_init_mmap is wrong.", buddy_init_mmap(&bman, memory_size, frame_size, BUDDY_SYSTEM_MAX_ORDER_LIMIT + 1) == NULL);
+
+    MIN_UNIT_ASSERT("buddy_init_mmap is wrong.", buddy_init_mmap(&bman, memory_size, frame_size, 6) == &bman);
+    MIN_UNIT_ASSERT("buddy_init_mmap is wrong.", buddy_get_total_memory_size(&bman) == frame_size * 100);
+    MIN_UNIT_ASSERT("buddy_init_mmap is wrong.", (bman.base_addr & (frame_size * 32 - 1)) == 0);
+
+    MIN_UNIT_ASSERT("buddy_size_to_order is wrong.", buddy_size_to_order(&bman, 1) == 0);
+    MIN_UNIT_ASSERT("buddy_size_to_order is wrong.", buddy_size_to_order(&bman, frame_size) == 0);
+    MIN_UNIT_ASSERT("buddy_size_to_order is wrong.", buddy_size_to_order(&bman, frame_size + 1) == 1);
+    MIN_UNIT_ASSERT("buddy_size_to_order is wrong.", buddy_size_to_order(&bman, frame_size * 5) == 3);
+    MIN_UNIT_ASSERT("buddy_size_to_order is wrong.", buddy_size_to_order(&bman, frame_size * 64) == 6);
+
+    /* Order 6 is out of range, the largest block is order 5. */
+    MIN_UNIT_ASSERT("buddy_alloc_memory is wrong.", buddy_alloc_memory(&bman, 6) == NULL);
+
+    uint8_t* big = buddy_alloc_memory(&bman, 5);
+    MIN_UNIT_ASSERT("buddy_alloc_memory is wrong.", big != NULL && ((uintptr_t)big & (frame_size * 32 - 1)) == 0);
+    memset(big, 0xaa, frame_size * 32);
+    buddy_free_memory(&bman, big);
+
+    for (size_t i = 0; i < 100; i++) {
+        ps[i] = buddy_alloc_memory(&bman, 0);
+        MIN_UNIT_ASSERT("buddy_alloc_memory is wrong.", ps[i] != NULL);
+        memset(ps[i], (int)i, frame_size);
+    }
+    MIN_UNIT_ASSERT("buddy_alloc_memory is wrong.", buddy_alloc_memory(&bman, 0) == NULL);
+
+    for (size_t i = 0; i < 100; i++) {
+        MIN_UNIT_ASSERT("memory is broken.", ((uint8_t*)ps[i])[frame_size - 1] == (uint8_t)i);
+        buddy_free_memory(&bman, ps[i]);
+    }
+    buddy_free_memory(&bman, NULL);
+    MIN_UNIT_ASSERT("buddy_free_memory is wrong.", buddy_get_free_memory_size(&bman) == frame_size * 100);
+
+    buddy_destruct(&bman);
+
+    return NULL;
+}
+
+
+static char const* test_buddy_pcp(void) {
+    Buddy_pcp_manager pman;
+
+    MIN_UNIT_ASSERT("buddy_pcp_init is wrong.", buddy_pcp_init(&pman, FRAME_SIZE * FRAME_NR) == &pman);
+
+    /* The first allocation refills one batch. */
+    Frame* f = buddy_pcp_alloc_frames(&pman, 0, false);
+    MIN_UNIT_ASSERT("buddy_pcp_alloc_frames is wrong.", f != NULL && f->order == 0);
+    MIN_UNIT_ASSERT("refill is wrong.", buddy_pcp_get_cached_frame_nr(&pman) == pman.batch - 1);
+
+    /* Hot frame is given again. */
+    buddy_pcp_free_frames(&pman, f, false);
+    MIN_UNIT_ASSERT("hot frame is wrong.", buddy_pcp_alloc_frames(&pman, 0, false) == f);
+
+    /* Cold frame is at the tail, it is not given by the next hot allocation. */
+    buddy_pcp_free_frames(&pman, f, true);
+    Frame* g = buddy_pcp_alloc_frames(&pman, 0, false);
+    MIN_UNIT_ASSERT("cold frame is wrong.", g != f);
+    MIN_UNIT_ASSERT("cold frame is wrong.", buddy_pcp_alloc_frames(&pman, 0, true) == f);
+    buddy_pcp_free_frames(&pman, g, false);
+
+    /* Order 1 is cached and large orders go to the shared manager. */
+    Frame* f1 = buddy_pcp_alloc_frames(&pman, 1, false);
+    Frame* f5 = buddy_pcp_alloc_frames(&pman, 5, false);
+    MIN_UNIT_ASSERT("buddy_pcp_alloc_frames is wrong.", f1 != NULL && f1->order == 1);
+    MIN_UNIT_ASSERT("buddy_pcp_alloc_frames is wrong.", f5 != NULL && f5->order == 5);
+    buddy_pcp_free_frames(&pman, f5, false);
+    buddy_pcp_free_frames(&pman, f1, false);
+    buddy_pcp_free_frames(&pman, f, false);
+
+    buddy_pcp_drain_all(&pman);
+    MIN_UNIT_ASSERT("buddy_pcp_drain_all is wrong.", buddy_pcp_get_cached_frame_nr(&pman) == 0);
+    MIN_UNIT_ASSERT("buddy_pcp_drain_all is wrong.", buddy_get_free_memory_size(&pman.bman) == FRAME_SIZE * FRAME_NR);
+
+    buddy_pcp_destruct(&pman);
+
+    return NULL;
+}
+
+
+/* Freeing many frames must keep each list below the high watermark. */
+static char const* test_buddy_pcp_watermark(void) {
+    Buddy_pcp_manager pman;
+    static Frame* fs[BUDDY_PCP_HIGH * 2];
+
+    buddy_pcp_init(&pman, FRAME_SIZE * FRAME_NR);
+
+    for (size_t i = 0; i < BUDDY_PCP_HIGH * 2; i++) {
+        fs[i] = buddy_pcp_alloc_frames(&pman, 0, false);
+        MIN_UNIT_ASSERT("buddy_pcp_alloc_frames is wrong.", fs[i] != NULL);
+    }
+
+    for (size_t i = 0; i < BUDDY_PCP_HIGH * 2; i++) {
+        buddy_pcp_free_frames(&pman, fs[i], false);
+        MIN_UNIT_ASSERT("high watermark is wrong.", buddy_pcp_get_cached_frame_nr(&pman) <= pman.high * pman.cpu_nr);
+    }
+    MIN_UNIT_ASSERT("free memory is wrong.", buddy_pcp_get_free_memory_size(&pman) == FRAME_SIZE * FRAME_NR);
+
+    buddy_pcp_destruct(&pman);
+
+    return NULL;
+}
+
+
+static void* pcp_worker(void* arg) {
+    Buddy_pcp_manager* pman = arg;
+    Frame* frames[LIVE_NR] = {NULL};
+
+    for (size_t i = 0; i < LOOP_NR; i++) {
+        size_t idx = i % LIVE_NR;
+        if (frames[idx] != NULL) {
+            buddy_pcp_free_frames(pman, frames[idx], (i & 7) == 0);
+        }
+        frames[idx] = buddy_pcp_alloc_frames(pman, i & 1, false);
+        if (frames[idx] == NULL) {
+            return arg;
+        }
+    }
+
+    for (size_t i = 0; i < LIVE_NR; i++) {
+        buddy_pcp_free_frames(pman, frames[i], false);
+    }
+
+    return NULL;
+}
+
+
+static char const* test_buddy_pcp_mt(void) {
+    Buddy_pcp_manager pman;
+    pthread_t threads[THREAD_NR];
+
+    buddy_pcp_init(&pman, FRAME_SIZE * FRAME_NR);
+
+    for (size_t i = 0; i < THREAD_NR; i++) {
+        pthread_create(&threads[i], NULL, pcp_worker, &pman);
+    }
+
+    bool is_failed = false;
+    for (size_t i = 0; i < THREAD_NR; i++) {
+        void* r;
+        pthread_join(threads[i], &r);
+        is_failed |= (r != NULL);
+    }
+    MIN_UNIT_ASSERT("buddy_pcp_alloc_frames is wrong.", is_failed == false);
+    MIN_UNIT_ASSERT("frames are leaked.", buddy_pcp_get_free_memory_size(&pman) == FRAME_SIZE * FRAME_NR);
+
+    buddy_pcp_drain_all(&pman);
+    MIN_UNIT_ASSERT("buddy_pcp_drain_all is wrong.", buddy_get_free_memory_size(&pman.bman) == FRAME_SIZE * FRAME_NR);
+
+    buddy_pcp_destruct(&pman);
+
+    return NULL;
+}
+
+
+static char const* all_tests(void) {
+    MIN_UNIT_RUN(test_buddy);
+    MIN_UNIT_RUN(test_buddy_mmap);
+    MIN_UNIT_RUN(test_buddy_pcp);
+    MIN_UNIT_RUN(test_buddy_pcp_watermark);
+    MIN_UNIT_RUN(test_buddy_pcp_mt);
+    return NULL;
+}
+
+
+int main(void) {
+    MIN_UNIT_RUN_ALL(all_tests);
+}
@@ -255,12 +255,183 @@ static char const* test_swap(void) {
 }
 
 
+static size_t released_nr = 0;
+static void count_release(Dlist* l, void* d) {
+    /* Data is in slab, so it is not freed. */
+    ++released_nr;
+}
+
+
+static char const* test_pooled_list(void) {
+    Dlist l;
+    enum { SLAB_NODE_NR = 4, NODE_NR = 25 };
+
+    dlist_init_pooled(&l, sizeof(long), NULL, SLAB_NODE_NR);
+    MIN_UNIT_ASSERT("dlist_init_pooled is wrong.", dlist_is_pooled(&l) == true);
+
+    for (long i = 0; i < NODE_NR; i++) {
+        dlist_insert_data_last(&l, &i);
+        MIN_UNIT_ASSERT("dlist_insert_data_last is wrong.", dlist_get_data(long, l.node->prev) == i);
+    }
+    MIN_UNIT_ASSERT("list element size is wrong.", dlist_get_size(&l) == NODE_NR);
+
+    /* Deleted nodes are reused. */
+    Dlist_node* freed = l.node;
+    dlist_delete_node(&l, l.node);
+    MIN_UNIT_ASSERT("dlist_delete_node is wrong.", dlist_get_data(long, l.node) == 1);
+    long x = 100;
+    dlist_insert_data_first(&l, &x);
+    MIN_UNIT_ASSERT("pooled node is NOT reused.", l.node == freed && dlist_get_data(long, l.node) == x);
+
+    /* Data may be moved between nodes by swap, deleting/inserting must keep them valid. */
+    dlist_swap_data(l.node, l.node->next->next);
+    dlist_delete_node(&l, l.node->next->next);
+    long y = 200;
+    dlist_insert_data_last(&l, &y);
+    MIN_UNIT_ASSERT("dlist_swap_data with pool is wrong.", dlist_get_data(long, l.node) == 2);
+    MIN_UNIT_ASSERT("dlist_swap_data with pool is wrong.", dlist_get_data(long, l.node->prev) == y);
+
+    long z = 3;
+    Dlist_node* n = dlist_search_node(&l, &z);
+    MIN_UNIT_ASSERT("dlist_search_node is wrong.", n != NULL && dlist_get_data(long, n) == z);
+
+    dlist_destruct(&l);
+    MIN_UNIT_ASSERT("dlist_destruct is wrong.", l.node == NULL && l.slabs == NULL && dlist_get_size(&l) == 0);
+
+    /* Release function is called for each data. */
+    dlist_init_pooled(&l, sizeof(long), count_release, SLAB_NODE_NR);
+    for (long i = 0; i < NODE_NR; i++) {
+        dlist_insert_data_first(&l, &i);
+    }
+    dlist_delete_node(&l, l.node);
+    dlist_destruct(&l);
+    MIN_UNIT_ASSERT("release function is NOT called.", released_nr == NODE_NR);
+
+    return NULL;
+}
+
+
+#define INDEX_NODE_NR 1000
+
+struct entry {
+    int key;
+    int value;
+};
+
+
+/* Entries are equal if their keys are equal. */
+static size_t hash_entry(Dlist* l, void const* d) {
+    return (size_t)((struct entry const*)d)->key * 2654435761U;
+}
+
+
+static bool comp_entry(Dlist* l, void* x, void* y) {
+    return ((struct entry*)x)->key == ((struct entry*)y)->key;
+}
+
+
+static char const* test_indexed_list(void) {
+    Dlist l;
+
+    dlist_init(&l, sizeof(long), NULL);
+    for (long i = 0; i < INDEX_NODE_NR / 2; i++) {
+        dlist_insert_data_last(&l, &i);
+    }
+    MIN_UNIT_ASSERT("dlist_enable_index is wrong.", dlist_enable_index(&l, NULL, NULL) == &l && dlist_is_indexed(&l) == true);
+
+    /* The index is extended by insertion. */
+    for (long i = INDEX_NODE_NR / 2; i < INDEX_NODE_NR; i++) {
+        dlist_insert_data_first(&l, &i);
+    }
+    for (long i = 0; i < INDEX_NODE_NR; i++) {
+        Dlist_node* n = dlist_search_node(&l, &i);
+        MIN_UNIT_ASSERT("indexed dlist_search_node is wrong.", n != NULL && dlist_get_data(long, n) == i);
+    }
+    long x = INDEX_NODE_NR;
+    MIN_UNIT_ASSERT("indexed dlist_search_node is wrong.", dlist_search_node(&l, &x) == NULL);
+
+    /* Removed nodes are not found, the others are still found. */
+    for (long i = 0; i < INDEX_NODE_NR; i += 3) {
+        dlist_delete_node(&l, dlist_search_node(&l, &i));
+    }
+    for (long i = 0; i < INDEX_NODE_NR; i++) {
+        Dlist_node* n = dlist_search_node(&l, &i);
+        MIN_UNIT_ASSERT("index is broken by removal.", (i % 3 == 0) ? n == NULL : (n != NULL && dlist_get_data(long, n) == i));
+    }
+
+    /* Swapped data are found after rebuilding. */
+    long a = 1, b = 2;
+    Dlist_node* na = dlist_search_node(&l, &a);
+    Dlist_node* nb = dlist_search_node(&l, &b);
+    dlist_swap_data(na, nb);
+    MIN_UNIT_ASSERT("dlist_rebuild_index is wrong.", dlist_rebuild_index(&l) == &l);
+    MIN_UNIT_ASSERT("dlist_rebuild_index is wrong.", dlist_search_node(&l, &a) == nb && dlist_search_node(&l, &b) == na);
+
+    dlist_disable_index(&l);
+    MIN_UNIT_ASSERT("dlist_disable_index is wrong.", dlist_is_indexed(&l) == false && dlist_search_node(&l, &a) == nb);
+    dlist_destruct(&l);
+
+    /* User functions and pooled list. */
+    dlist_init_pooled(&l, sizeof(struct entry), NULL, 64);
+    dlist_enable_index(&l, hash_entry, comp_entry);
+    for (int i = 0; i < INDEX_NODE_NR; i++) {
+        struct entry e = {i, i * 10};
+        dlist_insert_data_last(&l, &e);
+    }
+    struct entry k = {123, 0};
+    Dlist_node* n = dlist_search_node(&l, &k);
+    MIN_UNIT_ASSERT("dlist_search_node with user function is wrong.", n != NULL && dlist_get_data(struct entry, n).value == 1230);
+    dlist_destruct(&l);
+    MIN_UNIT_ASSERT("dlist_destruct does not release index.", dlist_is_indexed(&l) == false);
+
+    return NULL;
+}
+
+
+static char const* test_splice(void) {
+    Dlist l, m;
+
+    dlist_init(&l, sizeof(int), NULL);
+    dlist_init(&m, sizeof(int), NULL);
+    dlist_enable_index(&m, NULL, NULL);
+    for (int i = 0; i < 8; i++) {
+        dlist_insert_data_last(&l, &i);
+    }
+
+    MIN_UNIT_ASSERT("dlist_splice_last is wrong.", dlist_splice_last(&m, &l, 5) == 5);
+    MIN_UNIT_ASSERT("dlist_splice_last is wrong.", dlist_get_size(&l) == 3 && dlist_get_size(&m) == 5);
+    MIN_UNIT_ASSERT("dlist_splice_last is wrong.", dlist_get_data(int, l.node) == 5 && dlist_get_data(int, l.node->prev) == 7);
+    MIN_UNIT_ASSERT("dlist_splice_last is wrong.", dlist_get_data(int, m.node) == 0 && dlist_get_data(int, m.node->prev) == 4);
+
+    MIN_UNIT_ASSERT("dlist_splice_last is wrong.", dlist_splice_last(&m, &l, 10) == 3 && l.node == NULL && dlist_get_size(&l) == 0);
+    int i = 0;
+    Dlist_node* n = m.node;
+    do {
+        MIN_UNIT_ASSERT("dlist_splice_last order is wrong.", dlist_get_data(int, n) == i && dlist_get_data(int, n->next->prev) == i);
+        n = n->next;
+        i++;
+    } while (n != m.node);
+    MIN_UNIT_ASSERT("dlist_splice_last is wrong.", i == 8);
+
+    int key = 6;
+    MIN_UNIT_ASSERT("index is not updated by dlist_splice_last.", dlist_search_node(&m, &key) != NULL && dlist_search_node(&l, &key) == NULL);
+
+    dlist_destruct(&l);
+    dlist_destruct(&m);
+
+    return NULL;
+}
+
+
 static char const* all_tests(void) {
     MIN_UNIT_RUN(test_list_create_destruct);
     MIN_UNIT_RUN(test_int_list);
     MIN_UNIT_RUN(test_list_manip);
     MIN_UNIT_RUN(test_pointer_list);
     MIN_UNIT_RUN(test_swap);
+    MIN_UNIT_RUN(test_pooled_list);
+    MIN_UNIT_RUN(test_indexed_list);
+    MIN_UNIT_RUN(test_splice);
 
     return NULL;
 }
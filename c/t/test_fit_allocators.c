@@ -0,0 +1,147 @@
+#include "../minunit.h"
+#include "../fit_allocators.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+#define UNIT_SIZE 16
+#define UNIT_NR 64
+#define RANDOM_OBJECT_NR 256
+#define RANDOM_LOOP_NR 20000
+
+
+/* a(1) hole(4) b(1) hole(2) c(1) hole(rest) */
+static void make_holes(Fit_allocator* fa, void** a, void** b, void** c) {
+    *a      = fit_alloc(fa, UNIT_SIZE);
+    void* h = fit_alloc(fa, UNIT_SIZE * 4);
+    *b      = fit_alloc(fa, UNIT_SIZE);
+    void* i = fit_alloc(fa, UNIT_SIZE * 2);
+    *c      = fit_alloc(fa, UNIT_SIZE);
+    fit_free(fa, h);
+    fit_free(fa, i);
+}
+
+
+static char const* test_fit_policies(void) {
+    void* a;
+    void* b;
+    void* c;
+
+    Fit_allocator* first = fit_allocator_create(FIT_FIRST, UNIT_SIZE * UNIT_NR, UNIT_SIZE);
+    make_holes(first, &a, &b, &c);
+    MIN_UNIT_ASSERT("first-fit is wrong.", fit_alloc(first, UNIT_SIZE * 2) == (uint8_t*)a + UNIT_SIZE);
+    fit_allocator_destroy(first);
+
+    Fit_allocator* best = fit_allocator_create(FIT_BEST, UNIT_SIZE * UNIT_NR, UNIT_SIZE);
+    make_holes(best, &a, &b, &c);
+    MIN_UNIT_ASSERT("best-fit is wrong.", fit_alloc(best, UNIT_SIZE * 2) == (uint8_t*)b + UNIT_SIZE);
+    MIN_UNIT_ASSERT("best-fit is wrong.", fit_alloc(best, UNIT_SIZE * 3) == (uint8_t*)a + UNIT_SIZE);
+    fit_allocator_destroy(best);
+
+    Fit_allocator* worst = fit_allocator_create(FIT_WORST, UNIT_SIZE * UNIT_NR, UNIT_SIZE);
+    make_holes(worst, &a, &b, &c);
+    MIN_UNIT_ASSERT("worst-fit is wrong.", fit_alloc(worst, UNIT_SIZE * 2) == (uint8_t*)c + UNIT_SIZE);
+    fit_allocator_destroy(worst);
+
+    /* Next-fit continues after the last allocation. */
+    Fit_allocator* next = fit_allocator_create(FIT_NEXT, UNIT_SIZE * UNIT_NR, UNIT_SIZE);
+    make_holes(next, &a, &b, &c);
+    void* d = fit_alloc(next, UNIT_SIZE * 2);
+    MIN_UNIT_ASSERT("next-fit is wrong.", d == (uint8_t*)c + UNIT_SIZE);
+    fit_free(next, d);
+    fit_alloc(next, UNIT_SIZE * (UNIT_NR - 10));
+    MIN_UNIT_ASSERT("next-fit does not wrap around.", fit_alloc(next, UNIT_SIZE * 2) == (uint8_t*)a + UNIT_SIZE);
+    fit_allocator_destroy(next);
+
+    return NULL;
+}
+
+
+static char const* test_fit_coalesce(void) {
+    Fit_allocator* fa = fit_allocator_create(FIT_BEST, UNIT_SIZE * UNIT_NR, UNIT_SIZE);
+    MIN_UNIT_ASSERT("fit_allocator_create is wrong.", fa != NULL && fit_free_size(fa) == UNIT_SIZE * UNIT_NR);
+    MIN_UNIT_ASSERT("wrong unit size is accepted.", fit_allocator_create(FIT_BEST, 1024, 24) == NULL);
+
+    void* a = fit_alloc(fa, 1);
+    void* b = fit_alloc(fa, UNIT_SIZE * 3 - 1);
+    void* c = fit_alloc(fa, UNIT_SIZE + 1);
+    MIN_UNIT_ASSERT("fit_alloc is wrong.", a != NULL && b == (uint8_t*)a + UNIT_SIZE && c == (uint8_t*)b + UNIT_SIZE * 3);
+    MIN_UNIT_ASSERT("fit_usable_size is wrong.", fit_usable_size(fa, b) == UNIT_SIZE * 3 && fit_usable_size(fa, c) == UNIT_SIZE * 2);
+    MIN_UNIT_ASSERT("fit_alloc is wrong.", fit_free_size(fa) == UNIT_SIZE * (UNIT_NR - 6) && fit_free_run_nr(fa) == 1);
+    MIN_UNIT_ASSERT("too large object is allocated.", fit_alloc(fa, UNIT_SIZE * (UNIT_NR - 5)) == NULL);
+    MIN_UNIT_ASSERT("zero size is allocated.", fit_alloc(fa, 0) == NULL);
+
+    fit_free(fa, a);
+    fit_free(fa, c);
+    MIN_UNIT_ASSERT("fit_free is wrong.", fit_free_run_nr(fa) == 2 && fit_largest_free_size(fa) == UNIT_SIZE * (UNIT_NR - 4));
+
+    /* b is merged with the both sides. */
+    fit_free(fa, b);
+    MIN_UNIT_ASSERT("fit_free does not coalesce.", fit_free_run_nr(fa) == 1 && fit_largest_free_size(fa) == UNIT_SIZE * UNIT_NR);
+
+    void* all = fit_alloc(fa, UNIT_SIZE * UNIT_NR);
+    MIN_UNIT_ASSERT("whole memory is not allocated.", all == a && fit_free_size(fa) == 0 && fit_largest_free_size(fa) == 0);
+    MIN_UNIT_ASSERT("fit_alloc is wrong.", fit_alloc(fa, 1) == NULL);
+    fit_free(fa, all);
+
+    fit_allocator_destroy(fa);
+
+    return NULL;
+}
+
+
+/* Objects never overlap and every unit is back after all frees. */
+static char const* test_fit_random(void) {
+    static void* objs[RANDOM_OBJECT_NR];
+    static size_t sizes[RANDOM_OBJECT_NR];
+    size_t const total = UNIT_SIZE * 4096;
+
+    for (Fit_policy p = FIT_FIRST; p < FIT_POLICY_NR; p++) {
+        Fit_allocator* fa = fit_allocator_create(p, total, UNIT_SIZE);
+        unsigned int seed = 12345;
+        size_t used       = 0;
+
+        for (size_t l = 0; l < RANDOM_LOOP_NR; l++) {
+            size_t i = (size_t)rand_r(&seed) % RANDOM_OBJECT_NR;
+            if (objs[i] != NULL) {
+                MIN_UNIT_ASSERT("object is broken.", *(size_t*)objs[i] == i && ((uint8_t*)objs[i])[sizes[i] - 1] == (uint8_t)i);
+                used -= fit_usable_size(fa, objs[i]);
+                fit_free(fa, objs[i]);
+                objs[i] = NULL;
+                continue;
+            }
+
+            sizes[i] = sizeof(size_t) + 1 + (size_t)rand_r(&seed) % 1024;
+            objs[i]  = fit_alloc(fa, sizes[i]);
+            if (objs[i] != NULL) {
+                *(size_t*)objs[i]                 = i;
+                ((uint8_t*)objs[i])[sizes[i] - 1] = (uint8_t)i;
+                used += fit_usable_size(fa, objs[i]);
+            }
+            MIN_UNIT_ASSERT("free size is wrong.", fit_free_size(fa) == total - used);
+        }
+
+        for (size_t i = 0; i < RANDOM_OBJECT_NR; i++) {
+            fit_free(fa, objs[i]);
+            objs[i] = NULL;
+        }
+        MIN_UNIT_ASSERT("memory leaks.", fit_free_size(fa) == total && fit_free_run_nr(fa) == 1);
+        fit_allocator_destroy(fa);
+    }
+
+    return NULL;
+}
+
+
+static char const* all_tests(void) {
+    MIN_UNIT_RUN(test_fit_policies);
+    MIN_UNIT_RUN(test_fit_coalesce);
+    MIN_UNIT_RUN(test_fit_random);
+    return NULL;
+}
+
+
+int main(void) {
+    MIN_UNIT_RUN_ALL(all_tests);
+}
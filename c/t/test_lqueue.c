@@ -58,8 +58,73 @@ static char const* test_lqueue(void) {
 }
 
 
+static char const* test_lqueue_pooled(void) {
+    Lqueue q;
+    Lqueue* const qp = &q;
+
+    lqueue_init_pooled(qp, sizeof(int), NULL, 4);
+    MIN_UNIT_ASSERT("lqueue_init_pooled is wrong.", dlist_is_pooled(qp->list) == true);
+
+    for (int j = 0; j < 3; j++) {
+        for (int i = 0; i < check_size; i++) {
+            lqueue_insert(qp, &test_array[i]);
+        }
+        MIN_UNIT_ASSERT("lqueue_insert result is wrong.", lqueue_get_size(qp) == check_size);
+
+        for (int i = 0; i < check_size; i++) {
+            MIN_UNIT_ASSERT("lqueue_get_first is wrong.", *(int*)lqueue_get_first(qp) == test_array[i]);
+            lqueue_delete_first(qp);
+        }
+        MIN_UNIT_ASSERT("lqueue_delete_first result is wrong.", lqueue_is_empty(qp) == true);
+    }
+
+    lqueue_insert(qp, &test_array[0]);
+    lqueue_destruct(qp);
+
+    return NULL;
+}
+
+
+static char const* test_lqueue_batch(void) {
+    Lqueue q, r;
+    Lqueue* const qp = &q;
+    Lqueue* const rp = &r;
+    int out[MAX_SIZE];
+
+    lqueue_init(qp, sizeof(int), NULL);
+    lqueue_init(rp, sizeof(int), NULL);
+
+    MIN_UNIT_ASSERT("lqueue_insert_n is wrong.", lqueue_insert_n(qp, test_array, MAX_SIZE) == MAX_SIZE && lqueue_get_size(qp) == MAX_SIZE);
+    MIN_UNIT_ASSERT("lqueue_pop_n is wrong.", lqueue_pop_n(qp, out, 3) == 3 && out[0] == 1 && out[2] == 3);
+
+    /* 4 ... 7 are moved, and they are linked after 1 ... 10. */
+    lqueue_insert_n(rp, test_array, MAX_SIZE);
+    MIN_UNIT_ASSERT("lqueue_move_n is wrong.", lqueue_move_n(rp, qp, 4) == 4);
+    MIN_UNIT_ASSERT("lqueue_move_n is wrong.", lqueue_get_size(qp) == 3 && lqueue_get_size(rp) == MAX_SIZE + 4);
+    MIN_UNIT_ASSERT("lqueue_move_n is wrong.", *(int*)lqueue_get_first(qp) == 8);
+
+    MIN_UNIT_ASSERT("lqueue_pop_n is wrong.", lqueue_pop_n(rp, NULL, MAX_SIZE) == MAX_SIZE);
+    MIN_UNIT_ASSERT("lqueue_pop_n is wrong.", lqueue_pop_n(rp, out, MAX_SIZE) == 4 && lqueue_is_empty(rp) == true);
+    for (int i = 0; i < 4; i++) {
+        MIN_UNIT_ASSERT("lqueue_move_n order is wrong.", out[i] == test_array[i + 3]);
+    }
+
+    /* Move all into empty queue. */
+    MIN_UNIT_ASSERT("lqueue_move_n is wrong.", lqueue_move_n(rp, qp, MAX_SIZE) == 3 && lqueue_is_empty(qp) == true);
+    MIN_UNIT_ASSERT("lqueue_move_n is wrong.", lqueue_pop_n(rp, out, MAX_SIZE) == 3 && out[0] == 8 && out[2] == 10);
+    MIN_UNIT_ASSERT("lqueue_move_n on empty is wrong.", lqueue_move_n(rp, qp, 1) == 0);
+
+    lqueue_destruct(qp);
+    lqueue_destruct(rp);
+
+    return NULL;
+}
+
+
 static char const* all_tests(void) {
     MIN_UNIT_RUN(test_lqueue);
+    MIN_UNIT_RUN(test_lqueue_pooled);
+    MIN_UNIT_RUN(test_lqueue_batch);
 
     return NULL;
 }
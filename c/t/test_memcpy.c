@@ -0,0 +1,130 @@
+#include "../minunit.h"
+#include "../memcpy.h"
+#include "../cpu_features.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define GUARD_SIZE 64
+#define GUARD_BYTE 0xA5
+#define MAX_COPY_SIZE (64 * 1024)
+
+
+static uint8_t* src_buf;
+static uint8_t* dst_buf;
+
+
+/* Copy with each offset and check the bytes around destination are NOT changed. */
+static bool check_copy(memcpy_f f, size_t n, size_t dst_offset, size_t src_offset) {
+    uint8_t* d = dst_buf + GUARD_SIZE + dst_offset;
+    uint8_t const* s = src_buf + src_offset;
+
+    memset(dst_buf, GUARD_BYTE, MAX_COPY_SIZE + GUARD_SIZE * 3);
+    if (f(d, s, n) != d) {
+        return false;
+    }
+
+    if (memcmp(d, s, n) != 0) {
+        return false;
+    }
+
+    for (uint8_t* p = dst_buf; p < d; p++) {
+        if (*p != GUARD_BYTE) {
+            return false;
+        }
+    }
+    for (uint8_t* p = d + n; p < d + n + GUARD_SIZE; p++) {
+        if (*p != GUARD_BYTE) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+static char const* check_kernel(memcpy_f f) {
+    for (size_t n = 0; n <= 600; n++) {
+        for (size_t o = 0; o < 4; o++) {
+            MIN_UNIT_ASSERT("copy is wrong.", check_copy(f, n, o * 7, o * 3) == true);
+        }
+    }
+
+    size_t sizes[] = {1000, 2047, 2048, 4095, 4097, 10000, 33333, MAX_COPY_SIZE};
+    for (size_t i = 0; i < ARRAY_SIZE_OF(sizes); i++) {
+        MIN_UNIT_ASSERT("copy is wrong.", check_copy(f, sizes[i], 0, 0) == true);
+        MIN_UNIT_ASSERT("copy is wrong.", check_copy(f, sizes[i], 13, 5) == true);
+        MIN_UNIT_ASSERT("copy is wrong.", check_copy(f, sizes[i], 63, 1) == true);
+    }
+
+    return NULL;
+}
+
+
+static char const* test_simple(void) {
+    memcpy_f fs[] = {memcpy0, memcpy1, memcpy2, memcpy3, memcpy_erms};
+
+    for (size_t i = 0; i < ARRAY_SIZE_OF(fs); i++) {
+        char const* r = check_kernel(fs[i]);
+        if (r != NULL) {
+            return r;
+        }
+    }
+
+    return NULL;
+}
+
+
+static char const* test_vector(void) {
+    Cpu_features const* f = cpu_features_get();
+    char const* r;
+    size_t const nt       = memcpy_get_nt_threshold();
+
+    printf("memcpy_fast uses %s\n", memcpy_fast_name());
+    MIN_UNIT_ASSERT("LLC size is wrong.", f->llc_size != 0);
+
+    /* Check both temporal and non-temporal paths. */
+    for (int i = 0; i < 2; i++) {
+        memcpy_set_nt_threshold((i == 0) ? nt : 4096);
+
+        if ((r = check_kernel(memcpy_sse2)) != NULL) {
+            return r;
+        }
+        if (f->avx2 == true && (r = check_kernel(memcpy_avx2)) != NULL) {
+            return r;
+        }
+        if (f->avx512f == true && (r = check_kernel(memcpy_avx512)) != NULL) {
+            return r;
+        }
+        if ((r = check_kernel(memcpy_fast)) != NULL) {
+            return r;
+        }
+    }
+    memcpy_set_nt_threshold(nt);
+
+    return NULL;
+}
+
+
+static char const* all_tests(void) {
+    src_buf = malloc(MAX_COPY_SIZE + GUARD_SIZE);
+    dst_buf = malloc(MAX_COPY_SIZE + GUARD_SIZE * 3);
+    for (size_t i = 0; i < MAX_COPY_SIZE + GUARD_SIZE; i++) {
+        src_buf[i] = (uint8_t)(i * 31 + 7);
+    }
+
+    MIN_UNIT_RUN(test_simple);
+    MIN_UNIT_RUN(test_vector);
+
+    free(src_buf);
+    free(dst_buf);
+
+    return NULL;
+}
+
+
+int main(void) {
+    MIN_UNIT_RUN_ALL(all_tests);
+}
@@ -0,0 +1,158 @@
+#include "../minunit.h"
+#include "../memset.h"
+#include "../cpu_features.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define GUARD_SIZE 64
+#define GUARD_BYTE 0xA5
+#define MAX_SET_SIZE (64 * 1024)
+
+
+static uint8_t* buf;
+
+
+/* Fill and check the bytes around destination are NOT changed. */
+static bool check_set(memset_f f, int c, size_t n, size_t offset) {
+    uint8_t* d = buf + GUARD_SIZE + offset;
+
+    memset(buf, GUARD_BYTE, MAX_SET_SIZE + GUARD_SIZE * 3);
+    if (f(d, c, n) != d) {
+        return false;
+    }
+
+    for (uint8_t* p = buf; p < buf + MAX_SET_SIZE + GUARD_SIZE * 3; p++) {
+        bool is_inside = (d <= p && p < d + n);
+        if (*p != (is_inside ? (uint8_t)c : GUARD_BYTE)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+static char const* check_memset(memset_f f) {
+    for (size_t n = 0; n <= 300; n++) {
+        for (size_t o = 0; o < 4; o++) {
+            MIN_UNIT_ASSERT("memset is wrong.", check_set(f, (int)(n & 0xff), n, o * 5) == true);
+        }
+    }
+
+    size_t sizes[] = {1000, 2047, 2048, 4097, 10000, 33333, MAX_SET_SIZE};
+    for (size_t i = 0; i < ARRAY_SIZE_OF(sizes); i++) {
+        MIN_UNIT_ASSERT("memset is wrong.", check_set(f, 0, sizes[i], 0) == true);
+        MIN_UNIT_ASSERT("memset is wrong.", check_set(f, 0x5a, sizes[i], 13) == true);
+        MIN_UNIT_ASSERT("memset is wrong.", check_set(f, 0xff, sizes[i], 63) == true);
+    }
+
+    /* Only the low byte of c is used, (char)0x80 is passed as -128 if char is signed. */
+    int cs[] = {-128, -1, 0x1ff, 0x12380};
+    for (size_t i = 0; i < ARRAY_SIZE_OF(cs); i++) {
+        for (size_t n = 0; n <= 40; n++) {
+            MIN_UNIT_ASSERT("memset with negative or large c is wrong.", check_set(f, cs[i], n, n & 3) == true);
+        }
+        MIN_UNIT_ASSERT("memset with negative or large c is wrong.", check_set(f, cs[i], 10000, 7) == true);
+    }
+
+    return NULL;
+}
+
+
+static char const* test_simple(void) {
+    memset_f fs[] = {memset0, memset1, memset2, memset3, memset4};
+
+    for (size_t i = 0; i < ARRAY_SIZE_OF(fs); i++) {
+        char const* r = check_memset(fs[i]);
+        if (r != NULL) {
+            return r;
+        }
+    }
+
+    return NULL;
+}
+
+
+static char const* test_vector(void) {
+    Cpu_features const* f = cpu_features_get();
+    char const* r;
+    size_t const nt       = memset_get_nt_threshold();
+
+    printf("memset_fast uses %s\n", memset_fast_name());
+
+    /* Check both temporal and non-temporal paths. */
+    for (int i = 0; i < 2; i++) {
+        memset_set_nt_threshold((i == 0) ? nt : 4096);
+
+        if ((r = check_memset(memset_erms)) != NULL) {
+            return r;
+        }
+        if ((r = check_memset(memset_sse2)) != NULL) {
+            return r;
+        }
+        if (f->avx2 == true && (r = check_memset(memset_avx2)) != NULL) {
+            return r;
+        }
+        if (f->avx512f == true && (r = check_memset(memset_avx512)) != NULL) {
+            return r;
+        }
+        if ((r = check_memset(memset_fast)) != NULL) {
+            return r;
+        }
+    }
+    memset_set_nt_threshold(nt);
+
+    return NULL;
+}
+
+
+static bool check_zero(size_t n, size_t offset) {
+    uint8_t* d = buf + GUARD_SIZE + offset;
+
+    memset(buf, GUARD_BYTE, MAX_SET_SIZE + GUARD_SIZE * 3);
+    if (memset_zero(d, n) != d) {
+        return false;
+    }
+
+    for (uint8_t* p = buf; p < buf + MAX_SET_SIZE + GUARD_SIZE * 3; p++) {
+        bool is_inside = (d <= p && p < d + n);
+        if (*p != (is_inside ? 0 : GUARD_BYTE)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+static char const* test_zero(void) {
+    for (size_t n = 0; n <= 300; n++) {
+        MIN_UNIT_ASSERT("memset_zero is wrong.", check_zero(n, n & 7) == true);
+    }
+    MIN_UNIT_ASSERT("memset_zero is wrong.", check_zero(MAX_SET_SIZE, 0) == true);
+    MIN_UNIT_ASSERT("memset_zero is wrong.", check_zero(33333, 9) == true);
+
+    return NULL;
+}
+
+
+static char const* all_tests(void) {
+    buf = malloc(MAX_SET_SIZE + GUARD_SIZE * 3);
+
+    MIN_UNIT_RUN(test_simple);
+    MIN_UNIT_RUN(test_vector);
+    MIN_UNIT_RUN(test_zero);
+
+    free(buf);
+
+    return NULL;
+}
+
+
+int main(void) {
+    MIN_UNIT_RUN_ALL(all_tests);
+}
@@ -0,0 +1,125 @@
+#include "../minunit.h"
+#include "../object_pool.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+
+#define OBJECT_SIZE 40
+#define OBJECT_NR 1000
+#define THREAD_NR 4
+#define THREAD_LOOP_NR 100000
+#define THREAD_OBJECT_NR 100
+
+
+static char const* test_object_pool(void) {
+    static void* objs[OBJECT_NR];
+    Object_pool pool;
+
+    MIN_UNIT_ASSERT("zero size is accepted.", object_pool_init(&pool, 0, OBJECT_NR) == NULL);
+    MIN_UNIT_ASSERT("object_pool_init is wrong.", object_pool_init(&pool, OBJECT_SIZE, OBJECT_NR) == &pool);
+    MIN_UNIT_ASSERT("object size is not aligned.", pool.object_size % OBJECT_POOL_ALIGNMENT == 0 && OBJECT_SIZE <= pool.object_size);
+    MIN_UNIT_ASSERT("object_pool_get_free_nr is wrong.", object_pool_get_free_nr(&pool) == OBJECT_NR);
+
+    for (size_t i = 0; i < OBJECT_NR; i++) {
+        objs[i] = object_pool_alloc(&pool);
+        MIN_UNIT_ASSERT("object_pool_alloc is wrong.", objs[i] != NULL && (uintptr_t)objs[i] % OBJECT_POOL_ALIGNMENT == 0);
+        MIN_UNIT_ASSERT("object_pool_is_owner is wrong.", object_pool_is_owner(&pool, objs[i]) == true);
+        memset(objs[i], (int)i, OBJECT_SIZE);
+    }
+    MIN_UNIT_ASSERT("pool is not exhausted.", object_pool_alloc(&pool) == NULL && object_pool_get_free_nr(&pool) == 0);
+    MIN_UNIT_ASSERT("object_pool_is_owner is wrong.", object_pool_is_owner(&pool, (uint8_t*)objs[1] + 1) == false);
+
+    for (size_t i = 0; i < OBJECT_NR; i++) {
+        MIN_UNIT_ASSERT("object is broken.", ((uint8_t*)objs[i])[OBJECT_SIZE - 1] == (uint8_t)i);
+    }
+
+    /* The last freed object is reused first. */
+    object_pool_free(&pool, objs[3]);
+    object_pool_free(&pool, objs[7]);
+    MIN_UNIT_ASSERT("object_pool_free is wrong.", object_pool_get_free_nr(&pool) == 2);
+    MIN_UNIT_ASSERT("object_pool_alloc is wrong.", object_pool_alloc(&pool) == objs[7]);
+    MIN_UNIT_ASSERT("object_pool_alloc is wrong.", object_pool_alloc(&pool) == objs[3]);
+    MIN_UNIT_ASSERT("object_pool_alloc is wrong.", object_pool_alloc(&pool) == NULL);
+
+    object_pool_destruct(&pool);
+
+    return NULL;
+}
+
+
+static Object_pool_mt shared_pool;
+
+
+static void* pool_worker(void* arg) {
+    void* objs[THREAD_OBJECT_NR] = {NULL};
+    uintptr_t const tag          = (uintptr_t)arg;
+
+    for (size_t l = 0; l < THREAD_LOOP_NR; l++) {
+        size_t i = (l * 7) % THREAD_OBJECT_NR;
+        if (objs[i] != NULL) {
+            if (*(uintptr_t*)objs[i] != tag + i) {
+                return (void*)1;
+            }
+            object_pool_mt_free(&shared_pool, objs[i]);
+            objs[i] = NULL;
+        } else {
+            objs[i] = object_pool_mt_alloc(&shared_pool);
+            if (objs[i] == NULL) {
+                return (void*)1;
+            }
+            *(uintptr_t*)objs[i] = tag + i;
+        }
+    }
+
+    for (size_t i = 0; i < THREAD_OBJECT_NR; i++) {
+        object_pool_mt_free(&shared_pool, objs[i]);
+    }
+
+    return NULL;
+}
+
+
+static char const* test_object_pool_mt(void) {
+    pthread_t threads[THREAD_NR];
+
+    MIN_UNIT_ASSERT("object_pool_mt_init is wrong.", object_pool_mt_init(&shared_pool, OBJECT_SIZE, OBJECT_NR) == &shared_pool);
+
+    for (uintptr_t i = 0; i < THREAD_NR; i++) {
+        pthread_create(&threads[i], NULL, pool_worker, (void*)(i << 16));
+    }
+
+    bool is_ok = true;
+    for (size_t i = 0; i < THREAD_NR; i++) {
+        void* r;
+        pthread_join(threads[i], &r);
+        is_ok = is_ok && r == NULL;
+    }
+    MIN_UNIT_ASSERT("objects are shared by threads.", is_ok == true);
+
+    /* The caches of the exited threads are returned. */
+    MIN_UNIT_ASSERT("caches are not flushed.", object_pool_get_free_nr(&shared_pool.pool) == OBJECT_NR);
+
+    void* p = object_pool_mt_alloc(&shared_pool);
+    MIN_UNIT_ASSERT("object_pool_mt_alloc is wrong.", p != NULL && object_pool_get_free_nr(&shared_pool.pool) < OBJECT_NR - 1);
+    object_pool_mt_free(&shared_pool, p);
+    object_pool_mt_thread_flush(&shared_pool);
+    MIN_UNIT_ASSERT("object_pool_mt_thread_flush is wrong.", object_pool_get_free_nr(&shared_pool.pool) == OBJECT_NR);
+
+    object_pool_mt_destruct(&shared_pool);
+
+    return NULL;
+}
+
+
+static char const* all_tests(void) {
+    MIN_UNIT_RUN(test_object_pool);
+    MIN_UNIT_RUN(test_object_pool_mt);
+    return NULL;
+}
+
+
+int main(void) {
+    MIN_UNIT_RUN_ALL(all_tests);
+}
@@ -0,0 +1,470 @@
+#include "../minunit.h"
+#include "../tlsf.h"
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+
+
+#define THREAD_NR 4
+#define LOOP_NR 10000
+#define LIVE_NR 32
+#define CROSS_OBJECT_NR (TLSF_CACHE_MAGAZINE_SIZE * 4)
+
+
+static char const* test_tlsf(void) {
+    Tlsf_manager tman;
+    Tlsf_manager* const p = &tman;
+
+    tlsf_init(p);
+    MIN_UNIT_ASSERT("tlsf_supply_memory is wrong.", tlsf_supply_memory(p, 1 << 20) == p);
+    MIN_UNIT_ASSERT("tlsf_supply_memory is wrong.", p->total_memory_size == p->free_memory_size);
+
+    void* m = tlsf_malloc_align(p, 100, 64);
+    MIN_UNIT_ASSERT("tlsf_malloc_align is wrong.", m != NULL && ((uintptr_t)m & 63) == 0);
+    memset(m, 0xff, 100);
+    tlsf_free(p, m);
+    MIN_UNIT_ASSERT("tlsf_free is wrong.", p->total_memory_size == p->free_memory_size);
+
+    tlsf_destruct(p);
+
+    return NULL;
+}
+
+
+#define SMALL_OBJECT_NR 5000
+
+
+/* Small objects are packed in runs and do not overlap each other. */
+static char const* test_tlsf_small(void) {
+    Tlsf_manager tman;
+    Tlsf_manager* const p = &tman;
+    static uint8_t* objs[SMALL_OBJECT_NR];
+
+    tlsf_init(p);
+    tlsf_supply_memory(p, 1 << 20);
+
+    for (size_t i = 0; i < SMALL_OBJECT_NR; i++) {
+        size_t s = i % TLSF_SMALL_MAX_SIZE + 1;
+        objs[i]  = tlsf_malloc(p, s);
+        MIN_UNIT_ASSERT("tlsf_malloc is wrong.", objs[i] != NULL);
+        MIN_UNIT_ASSERT("small object is not aligned.", ((uintptr_t)objs[i] & (TLSF_SMALL_GRANULE - 1)) == 0);
+        memset(objs[i], (int)(i & 0xff), s);
+    }
+    MIN_UNIT_ASSERT("run is not registered.", p->run_nr != 0);
+
+    /* A large block is not broken by the small objects. */
+    uint8_t* large = tlsf_malloc(p, 4000);
+    MIN_UNIT_ASSERT("tlsf_malloc is wrong.", large != NULL);
+    memset(large, 0x5a, 4000);
+
+    for (size_t i = 0; i < SMALL_OBJECT_NR; i++) {
+        size_t j = (i * 7919) % SMALL_OBJECT_NR;
+        size_t s = j % TLSF_SMALL_MAX_SIZE + 1;
+        for (size_t k = 0; k < s; k++) {
+            MIN_UNIT_ASSERT("small object is broken.", objs[j][k] == (uint8_t)(j & 0xff));
+        }
+        tlsf_free(p, objs[j]);
+    }
+
+    for (size_t i = 0; i < 4000; i++) {
+        MIN_UNIT_ASSERT("large block is broken.", large[i] == 0x5a);
+    }
+    tlsf_free(p, large);
+
+    /* Only one spare run is kept for each class. */
+    MIN_UNIT_ASSERT("empty runs are not released.", p->run_nr <= TLSF_SMALL_CLASS_NR);
+    MIN_UNIT_ASSERT("tlsf_free is wrong.", p->total_memory_size == p->free_memory_size);
+
+    /* Aligned small requests go to blocks. */
+    void* a = tlsf_malloc_align(p, 32, 64);
+    MIN_UNIT_ASSERT("tlsf_malloc_align is wrong.", a != NULL && ((uintptr_t)a & 63) == 0);
+    tlsf_free(p, a);
+    MIN_UNIT_ASSERT("tlsf_free is wrong.", p->total_memory_size == p->free_memory_size);
+
+    tlsf_destruct(p);
+
+    return NULL;
+}
+
+
+/* Blocks are resized in place if possible, otherwise the contents are moved. */
+static char const* test_tlsf_realloc(void) {
+    Tlsf_manager tman;
+    Tlsf_manager* const p = &tman;
+
+    tlsf_init(p);
+    tlsf_supply_memory(p, 1 << 20);
+
+    MIN_UNIT_ASSERT("tlsf_realloc is wrong.", tlsf_realloc(p, NULL, 0) == NULL);
+
+    /* Blocks are taken from the tail of a free block, so c is followed by b and a is the last. */
+    uint8_t* a = tlsf_realloc(p, NULL, 1000);
+    uint8_t* b = tlsf_malloc(p, 1000);
+    uint8_t* c = tlsf_malloc(p, 1000);
+    MIN_UNIT_ASSERT("tlsf_malloc is wrong.", a != NULL && b != NULL && c != NULL);
+    MIN_UNIT_ASSERT("blocks are not contiguous.", c < b && b < a);
+    memset(c, 0x11, 1000);
+    tlsf_free(p, b);
+    size_t const free_size = p->free_memory_size;
+
+    /* The next block is free, so the block grows in place. */
+    uint8_t* c2 = tlsf_realloc(p, c, 1800);
+    MIN_UNIT_ASSERT("tlsf_realloc does not grow in place.", c2 == c);
+    MIN_UNIT_ASSERT("tlsf_realloc is wrong.", 1800 <= tlsf_usable_size(p, c2));
+    MIN_UNIT_ASSERT("tlsf_realloc is wrong.", p->free_memory_size < free_size);
+    for (size_t i = 0; i < 1000; i++) {
+        MIN_UNIT_ASSERT("contents are broken.", c2[i] == 0x11);
+    }
+
+    /* The tail is given back. */
+    uint8_t* c3 = tlsf_realloc(p, c2, 100);
+    MIN_UNIT_ASSERT("tlsf_realloc does not shrink in place.", c3 == c2);
+    MIN_UNIT_ASSERT("tail is not freed.", tlsf_usable_size(p, c3) < 1000 && free_size < p->free_memory_size);
+
+    /* a is followed by the sentinel, so the contents are moved. */
+    memset(a, 0x22, 1000);
+    uint8_t* a2 = tlsf_realloc(p, a, 50000);
+    MIN_UNIT_ASSERT("tlsf_realloc is wrong.", a2 != NULL && a2 != a);
+    for (size_t i = 0; i < 1000; i++) {
+        MIN_UNIT_ASSERT("contents are broken.", a2[i] == 0x22);
+    }
+
+    /* A small object is moved into a block when it outgrows its class. */
+    uint8_t* s = tlsf_malloc(p, 20);
+    MIN_UNIT_ASSERT("tlsf_usable_size is wrong.", tlsf_usable_size(p, s) == 32);
+    memset(s, 0x33, 20);
+    MIN_UNIT_ASSERT("tlsf_realloc is wrong.", tlsf_realloc(p, s, 30) == s);
+    uint8_t* s2 = tlsf_realloc(p, s, 600);
+    MIN_UNIT_ASSERT("tlsf_realloc is wrong.", s2 != NULL && s2 != s);
+    for (size_t i = 0; i < 20; i++) {
+        MIN_UNIT_ASSERT("contents are broken.", s2[i] == 0x33);
+    }
+
+    MIN_UNIT_ASSERT("tlsf_realloc is wrong.", tlsf_realloc(p, s2, 0) == NULL);
+    tlsf_free(p, c3);
+    tlsf_free(p, a2);
+    MIN_UNIT_ASSERT("tlsf_realloc is wrong.", p->total_memory_size == p->free_memory_size);
+
+    tlsf_destruct(p);
+
+    return NULL;
+}
+
+
+/* The number of resident pages in [p, p + size). */
+static size_t count_resident_pages(void const* p, size_t size) {
+    uintptr_t const head = (uintptr_t)p & ~(uintptr_t)4095;
+    size_t const nr      = ((uintptr_t)p + size - head + 4095) / 4096;
+    static unsigned char vec[4096];
+    size_t n = 0;
+
+    if (sizeof(vec) < nr || mincore((void*)head, nr * 4096, vec) != 0) {
+        return SIZE_MAX;
+    }
+    for (size_t i = 0; i < nr; i++) {
+        n += vec[i] & 1;
+    }
+
+    return n;
+}
+
+
+/* The pages of large free blocks are given back to the system. */
+static char const* test_tlsf_mmap(void) {
+    Tlsf_manager tman;
+    Tlsf_manager* const p = &tman;
+    size_t const size     = 4 << 20;
+
+    MIN_UNIT_ASSERT("tlsf_init_mmap is wrong.", tlsf_init_mmap(p, TLSF_REGION_MMAP) == p);
+    MIN_UNIT_ASSERT("tlsf_supply_memory is wrong.", tlsf_supply_memory(p, 16 << 20) == p);
+    MIN_UNIT_ASSERT("tlsf_supply_memory is wrong.", p->total_memory_size == p->free_memory_size);
+
+    uint8_t* m = tlsf_malloc(p, size);
+    MIN_UNIT_ASSERT("tlsf_malloc is wrong.", m != NULL);
+    memset(m, 0xff, size);
+    MIN_UNIT_ASSERT("pages are not resident.", count_resident_pages(m, size) == size / 4096 || count_resident_pages(m, size) == size / 4096 + 1);
+
+    tlsf_free(p, m);
+    MIN_UNIT_ASSERT("tlsf_free is wrong.", p->total_memory_size == p->free_memory_size);
+    MIN_UNIT_ASSERT("pages are not purged.", count_resident_pages(m, size) <= 2);
+
+    /* Small blocks are not purged on free, but tlsf_trim() does. */
+    p->trim_threshold = 0;
+    m = tlsf_malloc(p, 64 * 1024);
+    memset(m, 0xff, 64 * 1024);
+    tlsf_free(p, m);
+    MIN_UNIT_ASSERT("pages are purged.", 8 < count_resident_pages(m, 64 * 1024));
+    MIN_UNIT_ASSERT("tlsf_trim is wrong.", 0 < tlsf_trim(p));
+    MIN_UNIT_ASSERT("pages are not purged.", count_resident_pages(m, 64 * 1024) <= 2);
+
+    tlsf_destruct(p);
+
+    /* Both fall back to the normal pages if the huge pages are not available. */
+    MIN_UNIT_ASSERT("tlsf_init_mmap is wrong.", tlsf_init_mmap(p, TLSF_REGION_HUGETLB) == p);
+    MIN_UNIT_ASSERT("tlsf_supply_memory is wrong.", tlsf_supply_memory(p, 1 << 20) == p);
+    tlsf_free(p, tlsf_malloc(p, 1000));
+    MIN_UNIT_ASSERT("tlsf_free is wrong.", p->total_memory_size == p->free_memory_size);
+    tlsf_destruct(p);
+
+    MIN_UNIT_ASSERT("tlsf_init_mmap is wrong.", tlsf_init_mmap(p, TLSF_REGION_THP) == p);
+    MIN_UNIT_ASSERT("tlsf_supply_memory is wrong.", tlsf_supply_memory(p, 1 << 20) == p);
+    MIN_UNIT_ASSERT("region is not aligned.", ((uintptr_t)p->frames.next & ((2 << 20) - 1)) == 0);
+    tlsf_destruct(p);
+
+    return NULL;
+}
+
+
+/* Counters follow the single-threaded API. */
+static char const* test_tlsf_stats(void) {
+    Tlsf_manager tman;
+    Tlsf_manager* const p = &tman;
+    Tlsf_stats stats;
+    void* objs[16];
+
+    tlsf_init(p);
+    tlsf_supply_memory(p, 1 << 20);
+    tlsf_enable_latency_stats(p, true);
+
+    for (size_t i = 0; i < 16; i++) {
+        objs[i] = tlsf_malloc(p, (i < 8) ? 24 : 3000);
+    }
+    for (size_t i = 0; i < 16; i += 2) {
+        tlsf_free(p, objs[i]);
+    }
+    objs[1] = tlsf_realloc(p, objs[1], 5000);
+
+    tlsf_get_stats(p, &stats);
+    Tlsf_counters const* c = &stats.counters;
+    MIN_UNIT_ASSERT("malloc_nr is wrong.", c->malloc_nr == 17 && c->free_nr == 9 && c->realloc_nr == 1);
+    MIN_UNIT_ASSERT("class is wrong.", c->class_malloc_nrs[5] == 8 && c->class_live_nrs[5] == 3);
+    MIN_UNIT_ASSERT("live_size is wrong.", 3 * 32 + 4 * 3000 + 5000 <= c->live_size && c->live_size < p->total_memory_size - p->free_memory_size);
+    MIN_UNIT_ASSERT("split_nr is wrong.", c->split_nr != 0);
+    MIN_UNIT_ASSERT("largest_free_size is wrong.", 0 < stats.largest_free_size && stats.largest_free_size <= stats.free_memory_size);
+    MIN_UNIT_ASSERT("fragmentation is wrong.", 0.0 < stats.fragmentation && stats.fragmentation < 1.0);
+
+    uint64_t malloc_latency_nr = 0;
+    for (size_t i = 0; i < TLSF_STATS_LATENCY_NR; i++) {
+        malloc_latency_nr += c->malloc_latency[i];
+    }
+    MIN_UNIT_ASSERT("malloc_latency is wrong.", malloc_latency_nr == c->malloc_nr);
+
+    char buf[4096];
+    FILE* fp = fmemopen(buf, sizeof(buf), "w");
+    tlsf_print_stats_json(&stats, fp);
+    fclose(fp);
+    MIN_UNIT_ASSERT("tlsf_print_stats_json is wrong.", buf[0] == '{' && strstr(buf, "\"malloc_nr\": 17,") != NULL && strstr(buf, "\"free_latency\": [") != NULL);
+
+    fp = fmemopen(buf, sizeof(buf), "w");
+    tlsf_print_stats(&stats, fp);
+    fclose(fp);
+    MIN_UNIT_ASSERT("tlsf_print_stats is wrong.", strstr(buf, "live_size") != NULL);
+
+    for (size_t i = 1; i < 16; i += 2) {
+        tlsf_free(p, objs[i]);
+    }
+    tlsf_get_stats(p, &stats);
+    MIN_UNIT_ASSERT("live_size is wrong.", stats.counters.live_size == 0 && stats.counters.class_live_nrs[11] == 0);
+    MIN_UNIT_ASSERT("merge_nr is wrong.", stats.counters.merge_nr != 0);
+
+    tlsf_destruct(p);
+
+    return NULL;
+}
+
+
+/*
+ * A pool above 4 GiB is indexed by 64-bit size classes. Only block headers are touched.
+ * A request is rounded up to the next second level class, so the pool has one class and headers above 4 GiB.
+ */
+static char const* test_tlsf_large_pool(void) {
+    Tlsf_manager tman;
+    Tlsf_manager* const p = &tman;
+    size_t const class_size = ((size_t)1 << 32) >> TLSF_SL_MAX_INDEX_LOG2;
+    size_t const pool_size  = ((size_t)1 << 32) + class_size + ((size_t)1 << 24);
+
+    tlsf_init(p);
+    if (tlsf_supply_memory(p, pool_size) == NULL) {
+        /* The system cannot reserve the pool, nothing to test. */
+        tlsf_destruct(p);
+        return NULL;
+    }
+    MIN_UNIT_ASSERT("tlsf_supply_memory is wrong.", ((size_t)1 << 32) < p->total_memory_size);
+
+    void* m = tlsf_malloc(p, ((size_t)1 << 32) + 12345);
+    MIN_UNIT_ASSERT("tlsf_malloc is wrong.", m != NULL);
+    MIN_UNIT_ASSERT("tlsf_malloc is wrong.", p->free_memory_size < 2 * class_size);
+    MIN_UNIT_ASSERT("tlsf_malloc is wrong.", tlsf_malloc(p, ((size_t)1 << 32)) == NULL);
+    MIN_UNIT_ASSERT("tlsf_malloc is wrong.", tlsf_malloc(p, SIZE_MAX) == NULL);
+
+    tlsf_free(p, m);
+    MIN_UNIT_ASSERT("tlsf_free is wrong.", p->total_memory_size == p->free_memory_size);
+
+    tlsf_destruct(p);
+
+    return NULL;
+}
+
+
+/* Counts must match the lists. */
+static bool check_block_nrs(Tlsf_manager* p) {
+    for (size_t i = 0; i < TLSF_FL_MAX_INDEX * TLSF_SL_MAX_INDEX; i++) {
+        size_t n = 0;
+        for (Elist* l = p->blocks[i].next; l != &p->blocks[i]; l = l->next) {
+            ++n;
+        }
+        if (n != p->block_nrs[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+/* Fully free regions are given back when enough watermark blocks are free. */
+static char const* test_tlsf_release_region(void) {
+    Tlsf_manager tman;
+    Tlsf_manager* const p = &tman;
+    size_t const region_nr = 64;
+    void* objs[64];
+
+    tlsf_init(p);
+    for (size_t i = 0; i < 4; i++) {
+        tlsf_supply_memory(p, 4096 + 10 * 1024 * 1024 + 64); /* The same list as the watermark block. */
+    }
+    for (size_t i = 0; i < region_nr; i++) {
+        tlsf_supply_memory(p, 16 * 1024);
+    }
+    MIN_UNIT_ASSERT("block_nrs is wrong.", check_block_nrs(p) == true);
+    size_t const total = p->total_memory_size;
+
+    for (size_t i = 0; i < region_nr; i++) {
+        objs[i] = tlsf_malloc(p, 12 * 1024);
+        MIN_UNIT_ASSERT("tlsf_malloc is wrong.", objs[i] != NULL);
+    }
+    MIN_UNIT_ASSERT("block_nrs is wrong.", check_block_nrs(p) == true);
+
+    for (size_t i = 0; i < region_nr; i++) {
+        tlsf_free(p, objs[(i * 7) % region_nr]);
+    }
+    MIN_UNIT_ASSERT("block_nrs is wrong.", check_block_nrs(p) == true);
+    MIN_UNIT_ASSERT("region is not released.", p->total_memory_size < total);
+    MIN_UNIT_ASSERT("tlsf_free is wrong.", p->total_memory_size == p->free_memory_size);
+
+    tlsf_destruct(p);
+
+    return NULL;
+}
+
+
+static void* mt_worker(void* arg) {
+    Tlsf_mt_manager* mt = arg;
+    void* objs[LIVE_NR] = {NULL};
+
+    for (size_t i = 0; i < LOOP_NR; i++) {
+        size_t idx = i % LIVE_NR;
+        tlsf_mt_free(mt, objs[idx]);
+        objs[idx] = tlsf_mt_malloc(mt, (i * 7) % 1500 + 1);
+        if (objs[idx] == NULL) {
+            return arg;
+        }
+        memset(objs[idx], (int)idx, (i * 7) % 1500 + 1);
+    }
+
+    for (size_t i = 0; i < LIVE_NR; i++) {
+        tlsf_mt_free(mt, objs[i]);
+    }
+
+    return NULL;
+}
+
+
+/* The cached blocks are given back by the key destructor when the workers exit. */
+static char const* test_tlsf_mt(void) {
+    Tlsf_mt_manager mt;
+    pthread_t threads[THREAD_NR];
+
+    MIN_UNIT_ASSERT("tlsf_mt_init is wrong.", tlsf_mt_init(&mt) == &mt);
+    MIN_UNIT_ASSERT("tlsf_mt_supply_memory is wrong.", tlsf_mt_supply_memory(&mt, 8 << 20) == &mt);
+
+    for (size_t i = 0; i < THREAD_NR; i++) {
+        pthread_create(&threads[i], NULL, mt_worker, &mt);
+    }
+
+    bool is_failed = false;
+    for (size_t i = 0; i < THREAD_NR; i++) {
+        void* r;
+        pthread_join(threads[i], &r);
+        is_failed |= (r != NULL);
+    }
+    MIN_UNIT_ASSERT("tlsf_mt_malloc is wrong.", is_failed == false);
+    MIN_UNIT_ASSERT("thread cache is not flushed.", mt.tman.total_memory_size == mt.tman.free_memory_size);
+
+    tlsf_mt_destruct(&mt);
+
+    return NULL;
+}
+
+
+static void* cross_thread_allocator(void* arg) {
+    Tlsf_mt_manager* mt = arg;
+    void** objs         = tlsf_mt_malloc(mt, sizeof(void*) * CROSS_OBJECT_NR);
+
+    for (size_t i = 0; i < CROSS_OBJECT_NR; i++) {
+        objs[i] = tlsf_mt_malloc(mt, 48);
+        if (objs[i] == NULL) {
+            return NULL;
+        }
+    }
+
+    return objs;
+}
+
+
+/* Blocks allocated by one thread and freed by another one. */
+static char const* test_tlsf_mt_cross_thread_free(void) {
+    Tlsf_mt_manager mt;
+    void** objs;
+
+    tlsf_mt_init(&mt);
+    tlsf_mt_supply_memory(&mt, 1 << 20);
+
+    pthread_t t;
+    pthread_create(&t, NULL, cross_thread_allocator, &mt);
+    pthread_join(t, (void**)&objs);
+    MIN_UNIT_ASSERT("tlsf_mt_malloc is wrong.", objs != NULL);
+
+    for (size_t i = 0; i < CROSS_OBJECT_NR; i++) {
+        tlsf_mt_free(&mt, objs[i]);
+    }
+    tlsf_mt_free(&mt, objs);
+    MIN_UNIT_ASSERT("tlsf_mt_free is wrong.", mt.tman.total_memory_size != mt.tman.free_memory_size);
+
+    tlsf_mt_thread_flush(&mt);
+    MIN_UNIT_ASSERT("tlsf_mt_thread_flush is wrong.", mt.tman.total_memory_size == mt.tman.free_memory_size);
+
+    tlsf_mt_destruct(&mt);
+
+    return NULL;
+}
+
+
+static char const* all_tests(void) {
+    MIN_UNIT_RUN(test_tlsf);
+    MIN_UNIT_RUN(test_tlsf_small);
+    MIN_UNIT_RUN(test_tlsf_realloc);
+    MIN_UNIT_RUN(test_tlsf_mmap);
+    MIN_UNIT_RUN(test_tlsf_stats);
+    MIN_UNIT_RUN(test_tlsf_large_pool);
+    MIN_UNIT_RUN(test_tlsf_release_region);
+    MIN_UNIT_RUN(test_tlsf_mt);
+    MIN_UNIT_RUN(test_tlsf_mt_cross_thread_free);
+    return NULL;
+}
+
+
+int main(void) {
+    MIN_UNIT_RUN_ALL(all_tests);
+}
@@ -0,0 +1,177 @@
+#include "../minunit.h"
+#include "../tlsf_malloc.h"
+#include <malloc.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+
+#define THREAD_NR 4
+#define LOOP_NR 20000
+#define LIVE_NR 64
+
+
+/* The malloc family of this process is the shim. */
+static char const* test_tlsf_malloc(void) {
+    uint8_t* p = malloc(100);
+    MIN_UNIT_ASSERT("malloc is wrong.", p != NULL && ((uintptr_t)p & 15) == 0);
+    MIN_UNIT_ASSERT("malloc is not the shim.", tlsf_malloc_get_manager()->tman.total_memory_size != 0);
+    MIN_UNIT_ASSERT("malloc_usable_size is wrong.", 100 <= malloc_usable_size(p));
+    memset(p, 0x5a, 100);
+
+    p = realloc(p, 100000);
+    MIN_UNIT_ASSERT("realloc is wrong.", p != NULL);
+    for (size_t i = 0; i < 100; i++) {
+        MIN_UNIT_ASSERT("realloc does not keep the contents.", p[i] == 0x5a);
+    }
+    free(p);
+
+    uint8_t* z = calloc(1000, 3);
+    MIN_UNIT_ASSERT("calloc is wrong.", z != NULL);
+    for (size_t i = 0; i < 3000; i++) {
+        MIN_UNIT_ASSERT("calloc does not fill zero.", z[i] == 0);
+    }
+    free(z);
+    /* volatile keeps the compiler from warning about the overflowing constant product. */
+    size_t volatile huge_nr = SIZE_MAX / 2;
+    MIN_UNIT_ASSERT("calloc does not check overflow.", calloc(huge_nr, 3) == NULL);
+
+    void* a;
+    MIN_UNIT_ASSERT("posix_memalign is wrong.", posix_memalign(&a, 4096, 10) == 0 && ((uintptr_t)a & 4095) == 0);
+    free(a);
+    MIN_UNIT_ASSERT("posix_memalign is wrong.", posix_memalign(&a, 3, 10) != 0);
+    a = aligned_alloc(64, 640);
+    MIN_UNIT_ASSERT("aligned_alloc is wrong.", a != NULL && ((uintptr_t)a & 63) == 0);
+    free(a);
+
+    void* m0 = malloc(0);
+    void* m1 = malloc(0);
+    MIN_UNIT_ASSERT("malloc(0) is wrong.", m0 != NULL && m1 != NULL && m0 != m1);
+    free(m0);
+    free(m1);
+    free(NULL);
+
+    return NULL;
+}
+
+
+static void* worker(void* arg) {
+    void* objs[LIVE_NR] = {NULL};
+    unsigned int seed   = (unsigned int)(uintptr_t)arg;
+
+    for (size_t i = 0; i < LOOP_NR; i++) {
+        size_t idx  = (size_t)rand_r(&seed) % LIVE_NR;
+        size_t size = (size_t)rand_r(&seed) % 3000 + 1;
+        objs[idx]   = realloc(objs[idx], size);
+        if (objs[idx] == NULL || ((uintptr_t)objs[idx] & 15) != 0) {
+            return arg;
+        }
+        memset(objs[idx], (int)idx, size);
+    }
+
+    for (size_t i = 0; i < LIVE_NR; i++) {
+        free(objs[i]);
+    }
+
+    return NULL;
+}
+
+
+static char const* test_tlsf_malloc_thread(void) {
+    pthread_t threads[THREAD_NR];
+
+    for (size_t i = 0; i < THREAD_NR; i++) {
+        pthread_create(&threads[i], NULL, worker, (void*)(i + 1));
+    }
+
+    bool is_failed = false;
+    for (size_t i = 0; i < THREAD_NR; i++) {
+        void* r;
+        pthread_join(threads[i], &r);
+        is_failed |= (r != NULL);
+    }
+    MIN_UNIT_ASSERT("malloc is wrong in threads.", is_failed == false);
+
+    return NULL;
+}
+
+
+static void* fork_worker(void* arg) {
+    for (size_t i = 0; i < LOOP_NR; i++) {
+        free(malloc(i % 500 + 1));
+    }
+
+    return arg;
+}
+
+
+/* The child can use malloc while other threads were allocating at fork(). */
+static char const* test_tlsf_malloc_fork(void) {
+    pthread_t t;
+    pthread_create(&t, NULL, fork_worker, NULL);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        void* objs[LIVE_NR];
+        for (size_t i = 0; i < LIVE_NR; i++) {
+            objs[i] = malloc(i * 100 + 1);
+        }
+        for (size_t i = 0; i < LIVE_NR; i++) {
+            free(objs[i]);
+        }
+        _exit(EXIT_SUCCESS);
+    }
+
+    int status = -1;
+    waitpid(pid, &status, 0);
+    pthread_join(t, NULL);
+    MIN_UNIT_ASSERT("malloc is broken in the child.", 0 < pid && WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+
+    return NULL;
+}
+
+
+/* Small alignments go to the TLSF blocks when the size is larger than the cache. */
+static char const* test_tlsf_malloc_small_align(void) {
+    void* objs[LIVE_NR] = {NULL};
+    unsigned int seed   = 1;
+
+    for (size_t i = 0; i < LOOP_NR; i++) {
+        size_t idx   = (size_t)rand_r(&seed) % LIVE_NR;
+        size_t size  = (size_t)rand_r(&seed) % 6000 + TLSF_CACHE_MAX_SIZE + 1;
+        size_t align = ((rand_r(&seed) & 1) == 0) ? 8 : 16;
+
+        free(objs[idx]);
+        if ((i & 1) == 0) {
+            MIN_UNIT_ASSERT("posix_memalign is wrong.", posix_memalign(&objs[idx], align, size) == 0);
+        } else {
+            objs[idx] = aligned_alloc(align, size);
+        }
+        MIN_UNIT_ASSERT("small alignment is wrong.", objs[idx] != NULL && ((uintptr_t)objs[idx] & (align - 1)) == 0);
+        memset(objs[idx], (int)idx, size);
+    }
+
+    for (size_t i = 0; i < LIVE_NR; i++) {
+        free(objs[i]);
+    }
+
+    return NULL;
+}
+
+
+static char const* all_tests(void) {
+    MIN_UNIT_RUN(test_tlsf_malloc);
+    MIN_UNIT_RUN(test_tlsf_malloc_small_align);
+    MIN_UNIT_RUN(test_tlsf_malloc_thread);
+    MIN_UNIT_RUN(test_tlsf_malloc_fork);
+    return NULL;
+}
+
+
+int main(void) {
+    MIN_UNIT_RUN_ALL(all_tests);
+}
@@ -0,0 +1,144 @@
+#include "../minunit.h"
+#include "../ulist.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define CAPACITY 4
+#define RANDOM_NR 2000
+
+
+/* Compare the list with the array, and check every node is used. */
+static bool is_same(Ulist* l, int const* a, size_t nr) {
+    if (ulist_get_size(l) != nr) {
+        return false;
+    }
+
+    size_t i = 0;
+    for (Ulist_iter it = ulist_begin(l); ulist_iter_is_end(it) == false; it = ulist_next(l, it)) {
+        if (it.node->nr == 0 || it.node->nr > l->node_capacity || ulist_get_data(int, l, it) != a[i++]) {
+            return false;
+        }
+    }
+
+    return i == nr;
+}
+
+
+static int sum;
+static bool sum_int(Ulist* l, void* d) {
+    sum += *(int*)d;
+    return false;
+}
+
+
+static int last_seen;
+static bool stop_at_negative(Ulist* l, void* d) {
+    last_seen = *(int*)d;
+    return *(int*)d < 0;
+}
+
+
+static int release_nr;
+static void count_release(Ulist* l, void* d) {
+    release_nr++;
+}
+
+
+static char const* test_ulist_basic(void) {
+    Ulist l;
+    int expected[] = {-1, 0, 1, 2, 3, 4, 5, 6, 7, 8};
+
+    ulist_init(&l, sizeof(int), count_release, CAPACITY);
+    MIN_UNIT_ASSERT("ulist_init is wrong.", ulist_get_size(&l) == 0 && ulist_iter_is_end(ulist_begin(&l)) == true);
+
+    for (int i = 0; i < 9; i++) {
+        MIN_UNIT_ASSERT("ulist_insert_data_last is wrong.", ulist_insert_data_last(&l, &i) == &l);
+    }
+    int m = -1;
+    ulist_insert_data_first(&l, &m);
+    MIN_UNIT_ASSERT("insertion is wrong.", is_same(&l, expected, 10) == true);
+
+    sum = 0;
+    ulist_for_each(&l, sum_int, false);
+    MIN_UNIT_ASSERT("ulist_for_each is wrong.", sum == 35);
+
+    Ulist_iter it = ulist_for_each(&l, stop_at_negative, true);
+    MIN_UNIT_ASSERT("reverse ulist_for_each is wrong.", last_seen == -1 && ulist_get_data(int, &l, it) == -1);
+
+    int key = 6;
+    it      = ulist_search(&l, &key);
+    MIN_UNIT_ASSERT("ulist_search is wrong.", ulist_iter_is_end(it) == false && ulist_get_data(int, &l, it) == 6);
+    key = 100;
+    MIN_UNIT_ASSERT("ulist_search is wrong.", ulist_iter_is_end(ulist_search(&l, &key)) == true);
+
+    /* Remove 6, the next element is returned. */
+    key = 6;
+    int out;
+    it = ulist_remove(&l, ulist_search(&l, &key), &out);
+    MIN_UNIT_ASSERT("ulist_remove is wrong.", out == 6 && ulist_get_data(int, &l, it) == 7);
+    int removed[] = {-1, 0, 1, 2, 3, 4, 5, 7, 8};
+    MIN_UNIT_ASSERT("ulist_remove is wrong.", is_same(&l, removed, 9) == true);
+
+    release_nr = 0;
+    key        = 8;
+    it         = ulist_delete(&l, ulist_search(&l, &key));
+    MIN_UNIT_ASSERT("ulist_delete is wrong.", release_nr == 1 && ulist_iter_is_end(it) == true);
+
+    ulist_destruct(&l);
+    MIN_UNIT_ASSERT("ulist_destruct is wrong.", release_nr == 9 && ulist_get_size(&l) == 0 && l.first == NULL && l.last == NULL);
+
+    return NULL;
+}
+
+
+/* Random insertions and removals are compared with an array. */
+static char const* test_ulist_random(void) {
+    static int a[RANDOM_NR];
+    size_t nr         = 0;
+    unsigned int seed = 1;
+    Ulist l;
+
+    ulist_init(&l, sizeof(int), NULL, CAPACITY);
+
+    for (int k = 0; k < RANDOM_NR * 4; k++) {
+        bool const is_insert = (nr == 0) || (nr < RANDOM_NR && rand_r(&seed) % 3 != 0);
+        size_t const pos     = (size_t)rand_r(&seed) % (nr + (is_insert == true ? 1 : 0));
+
+        Ulist_iter it = ulist_begin(&l);
+        for (size_t i = 0; i < pos; i++) {
+            it = ulist_next(&l, it);
+        }
+
+        if (is_insert == true) {
+            it = ulist_insert_data(&l, it, &k);
+            MIN_UNIT_ASSERT("ulist_insert_data is wrong.", ulist_get_data(int, &l, it) == k);
+            memmove(&a[pos + 1], &a[pos], (nr - pos) * sizeof(int));
+            a[pos] = k;
+            nr++;
+        } else {
+            it = ulist_remove(&l, it, NULL);
+            memmove(&a[pos], &a[pos + 1], (nr - pos - 1) * sizeof(int));
+            nr--;
+            MIN_UNIT_ASSERT("ulist_remove returns wrong position.", (pos == nr) ? ulist_iter_is_end(it) : ulist_get_data(int, &l, it) == a[pos]);
+        }
+        MIN_UNIT_ASSERT("list is broken.", is_same(&l, a, nr) == true);
+    }
+
+    ulist_destruct(&l);
+
+    return NULL;
+}
+
+
+static char const* all_tests(void) {
+    MIN_UNIT_RUN(test_ulist_basic);
+    MIN_UNIT_RUN(test_ulist_random);
+    return NULL;
+}
+
+
+int main(void) {
+    MIN_UNIT_RUN_ALL(all_tests);
+}
@@ -27,9 +27,11 @@
  */
 
 
-#include "minunit.h"
 #include "elist.h"
+#include "tlsf.h"
 #include <assert.h>
+#include <inttypes.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -38,22 +40,28 @@
 #include <string.h>
 #include <time.h>
 #include <stdarg.h>
+#include <sys/mman.h>
 #include <sys/time.h>
 
 
-#define PO2(x) (1u << (x))
+#define PO2(x) ((size_t)1 << (x))
 
 
-typedef struct {
+/* Every region starts with its Frame. */
+struct frame {
     Elist list;
-    void* addr;
-    size_t size;
-} Frame;
+    void* addr;  /* The first block. */
+    size_t size; /* The size of whole region. */
+};
+typedef struct frame Frame;
 
 
 struct block {
     struct block* prev_block; /* Liner previous block */
-    Elist list;               /* Logical previous and next block. */
+    union {
+        Elist list;           /* Logical previous and next block. */
+        struct frame* frame;  /* Only sentinel has this, it points the frame which contains the sentinel. */
+    };
     union {
         struct {
             uint8_t is_free : 1;
@@ -67,14 +75,14 @@ typedef struct block Block;
 
 
 enum {
-    ALIGNMENT_LOG2           = 2,
+    ALIGNMENT_LOG2           = 4, /* Same as malloc() of x86-64, BLOCK_OFFSET is also multiple of this. */
     ALIGNMENT_SIZE           = PO2(ALIGNMENT_LOG2),
     ALIGNMENT_MASK           = ALIGNMENT_SIZE - 1,
 
-    FL_BASE_INDEX            = 10 - 1,
-    FL_MAX_INDEX             = (32 - FL_BASE_INDEX),
-    SL_MAX_INDEX_LOG2        = 4,
-    SL_MAX_INDEX             = PO2(SL_MAX_INDEX_LOG2),
+    FL_BASE_INDEX            = TLSF_FL_BASE_INDEX,
+    FL_MAX_INDEX             = TLSF_FL_MAX_INDEX,
+    SL_MAX_INDEX_LOG2        = TLSF_SL_MAX_INDEX_LOG2,
+    SL_MAX_INDEX             = TLSF_SL_MAX_INDEX,
     SL_INDEX_MASK            = (1u << SL_MAX_INDEX_LOG2) - 1u,
 
     FL_BLOCK_MIN_SIZE        = PO2(FL_BASE_INDEX + 1),
@@ -87,6 +95,8 @@ enum {
     BLOCK_FLAG_MASK          = 0x03,
 
     FRAME_SIZE               = 0x1000,
+    FRAME_HEADER_SIZE        = (sizeof(Frame) + 15) & ~(size_t)15,
+    HUGE_PAGE_SIZE           = PO2(21),
     MAX_ALLOC_ALIGN          = PO2(12),
     MAX_ALLOCATION_SIZE      = 5 * 1024 * 1024,
     WATERMARK_BLOCK_SIZE     = MAX_ALLOC_ALIGN + MAX_ALLOCATION_SIZE * 2, /* このサイズをブロックを水位計とする. */
@@ -95,56 +105,18 @@ enum {
 };
 
 
-struct tlsf_manager {
-    Elist blocks[FL_MAX_INDEX * SL_MAX_INDEX];
-    Elist frames;
-    size_t total_memory_size;
-    size_t free_memory_size;
-    uint32_t fl_bitmap;
-    uint16_t sl_bitmaps[FL_MAX_INDEX];
-};
-typedef struct tlsf_manager Tlsf_manager;
-
-
-
-#ifdef NO_OPTIMIZE
-#define BIT_NR(type) (sizeof(type) * 8u)
-static inline size_t find_set_bit_idx_first(size_t n) {
-    size_t mask = 1u;
-    size_t idx = 0;
-    while (((mask & n) == 0) && (mask <<= 1) != ~0u) {
-        ++idx;
-    }
-
-    return idx;
-}
-
 
+/* n must not be 0. */
 static inline size_t find_set_bit_idx_last(size_t n) {
-    size_t mask = ((size_t)1u << (BIT_NR(size_t) - 1u));
-    size_t idx = BIT_NR(size_t);
-    do {
-        --idx;
-    } while (((mask & n) == 0) && (mask >>= 1) != 0);
-
-    return idx;
+    assert(n != 0);
+    return (sizeof(unsigned long long) * 8u - 1u) - (size_t)__builtin_clzll(n);
 }
 
 
-#else
-__asm__(
-        "find_set_bit_idx_last: \n\t"
-        "bsrq %rdi, %rax        \n\t"
-        "ret                    \n\t");
-size_t find_set_bit_idx_last(size_t);
-
-
-__asm__(
-        "find_set_bit_idx_first: \n\t"
-        "bsfq %rdi, %rax         \n\t"
-        "ret                     \n\t");
-size_t find_set_bit_idx_first(size_t);
-#endif
+static inline size_t find_set_bit_idx_first(size_t n) {
+    assert(n != 0);
+    return (size_t)__builtin_ctzll(n);
+}
 
 
 static inline void set_idxs(size_t size, size_t* fl, size_t* sl) {
@@ -189,6 +161,16 @@ static inline size_t get_size(Block const* b) {
 }
 
 
+/*
+ * Get the size of an allocated block without the lock.
+ * Only the owner of the block changes its size bits, other threads only change the prev free bit by set_prev_free().
+ * The relaxed atomic load pairs with the atomic store there, and the flag bits are masked out.
+ */
+static inline size_t get_size_unlocked(Block const* b) {
+    return __atomic_load_n(&b->size, __ATOMIC_RELAXED) & (~(size_t)BLOCK_FLAG_MASK);
+}
+
+
 static inline void set_size(Block* b, size_t s) {
     b->size = ((b->size & BLOCK_FLAG_MASK) | s);
 }
@@ -204,13 +186,18 @@ static inline Block* get_phys_next_block(Block const* const b) {
 }
 
 
+/*
+ * The flag of prev free is changed by the owner of the previous block, b may be allocated by other thread.
+ * In Tlsf_mt_manager, the owner of b reads its size without the lock (see get_size_unlocked()).
+ * So the word is written by an atomic store, the read before it is safe because the writers hold the lock.
+ */
 static inline void set_prev_free(Block* b) {
-    b->size |= BLOCK_FLAG_BIT_PREV_FREE;
+    __atomic_store_n(&b->size, b->size | BLOCK_FLAG_BIT_PREV_FREE, __ATOMIC_RELAXED);
 }
 
 
 static inline void clear_prev_free(Block* b) {
-    b->size &= ~(size_t)BLOCK_FLAG_BIT_PREV_FREE;
+    __atomic_store_n(&b->size, b->size & ~(size_t)BLOCK_FLAG_BIT_PREV_FREE, __ATOMIC_RELAXED);
 }
 
 
@@ -252,8 +239,13 @@ static inline Block* convert_block(void const* p) {
 }
 
 
+static inline size_t get_block_list_idx(size_t fl, size_t sl) {
+    return fl * SL_MAX_INDEX + sl;
+}
+
+
 static inline Elist* get_block_list_head(Tlsf_manager* const tman, size_t fl, size_t sl) {
-    return &tman->blocks[fl * sizeof(Elist) + sl];
+    return &tman->blocks[get_block_list_idx(fl, sl)];
 }
 
 
@@ -357,12 +349,13 @@ static inline void insert_block(Tlsf_manager* const tman, Block* b) {
     tman->sl_bitmaps[fl] |= PO2(sl);
 
     elist_insert_next(get_block_list_head(tman, fl, sl), &b->list);
+    ++tman->block_nrs[get_block_list_idx(fl, sl)];
 }
 
 
 static inline void sync_bitmap(Tlsf_manager* tman, size_t fl, size_t sl) {
-    if (elist_is_empty(get_block_list_head(tman, fl, sl)) == true) {
-        uint16_t* sb = &tman->sl_bitmaps[fl];
+    if (tman->block_nrs[get_block_list_idx(fl, sl)] == 0) {
+        uint32_t* sb = &tman->sl_bitmaps[fl];
         *sb &= ~PO2(sl);
         if (*sb == 0) {
             tman->fl_bitmap &= ~PO2(fl);
@@ -372,7 +365,8 @@ static inline void sync_bitmap(Tlsf_manager* tman, size_t fl, size_t sl) {
 
 
 static inline Block* remove_block(Tlsf_manager* tman, Block* b) {
-    if (b->is_free == 0) {
+    /* A block which is being freed is not in any list yet. */
+    if (b->is_free == 0 || elist_is_empty(&b->list) == true) {
         return b;
     }
 
@@ -380,6 +374,7 @@ static inline Block* remove_block(Tlsf_manager* tman, Block* b) {
     set_idxs(get_size(b), &fl, &sl);
 
     elist_remove(&b->list);
+    --tman->block_nrs[get_block_list_idx(fl, sl)];
 
     sync_bitmap(tman, fl, sl);
 
@@ -392,6 +387,7 @@ static inline Block* take_any_block(Tlsf_manager* tman, size_t fl, size_t sl) {
     assert(elist_is_empty(head) == false);
 
     Block* b = elist_derive(Block, list, elist_remove(head->next));
+    --tman->block_nrs[get_block_list_idx(fl, sl)];
     sync_bitmap(tman, fl, sl);
 
     return b;
@@ -416,10 +412,10 @@ static inline Block* remove_good_block(Tlsf_manager* tman, size_t size) {
     set_idxs(size, &fl, &sl);
 
     /* 現在のsl以上のフラグのみ取得 */
-    size_t sl_map = tman->sl_bitmaps[fl] & (~0u << sl);
+    size_t sl_map = tman->sl_bitmaps[fl] & (~(uint32_t)0 << sl);
     if (sl_map == 0) {
         /* 現在のflにはメモリが無いので、一つ上のindexのフラグを取得 */
-        size_t fl_map = tman->fl_bitmap & (~0u << (fl + 1u));
+        size_t fl_map = tman->fl_bitmap & (~(uint64_t)0 << (fl + 1u));
         if (fl_map == 0) {
             return NULL;
         }
@@ -450,23 +446,25 @@ static inline Block* divide_block(Block* b, size_t size, size_t align) {
     }
 
     Block* old_next = get_phys_next_block(b);
+    Block* new_next = (Block*)((uintptr_t)old_next - nblock_all_size);
 
-    set_size(b, get_size(b) - nblock_all_size);
-    Block* new_next = get_phys_next_block(b);
-
+    size_t diff = 0;
     if (align != 0) {
-        /* mallocの戻り値はオフセット分加算されるのでその分を引いておく. */
-        uintptr_t t = (uintptr_t)align_down((size_t)new_next, align) - BLOCK_OFFSET;
-        uintptr_t diff = (uintptr_t)new_next - t;
-
-        assert(get_size(b) >= diff);
-
-        size += diff;
-        set_size(b, get_size(b) - (size_t)diff);
+        /* mallocの戻り値はオフセット分加算されるので, その位置を揃える. */
+        uintptr_t t = (uintptr_t)align_down((size_t)new_next + BLOCK_OFFSET, align) - BLOCK_OFFSET;
+        diff        = (uintptr_t)new_next - t;
+        new_next    = (Block*)t;
+    }
 
-        new_next = (Block*)t;
+    /* The front block must keep a minimum block, otherwise it cannot be in the free lists. */
+    if (get_size(b) < nblock_all_size + diff + ALIGNMENT_SIZE) {
+        return NULL;
     }
 
+    size += diff;
+    set_size(b, get_size(b) - nblock_all_size - diff);
+    assert(get_phys_next_block(b) == new_next);
+
     old_next->prev_block = new_next;
     new_next->prev_block = b;
 
@@ -491,6 +489,7 @@ static inline void merge_phys_block(Tlsf_manager* tman, Block* b1, Block* b2) {
 
     remove_block(tman, b1);
     remove_block(tman, b2);
+    ++tman->counters.merge_nr;
 
     Block* old_next      = get_phys_next_block(b2);
     old_next->prev_block = b1;
@@ -531,61 +530,189 @@ static inline Block* merge_phys_neighbor_blocks(Tlsf_manager* tman, Block* b) {
 }
 
 
+/*
+ * ==================== Regions. ====================
+ * A region is obtained by malloc() or, if TLSF_REGION_MMAP is set, by mmap().
+ * The Frame is put at the head of the region, so no other memory is needed to manage it.
+ * The mmap backend also gives the interior pages of large free blocks back to the system,
+ * so the resident size follows the live data.
+ */
+
+
+static inline bool is_mmap_region(Tlsf_manager const* tman) {
+    return (tman->region_flags & TLSF_REGION_MMAP) != 0;
+}
+
+
+static inline size_t get_trim_granule(Tlsf_manager const* tman) {
+    /* Purging a part of a huge page splits it. */
+    return ((tman->region_flags & ~(uint32_t)TLSF_REGION_MMAP) != 0) ? HUGE_PAGE_SIZE : FRAME_SIZE;
+}
+
+
+static void* map_region(Tlsf_manager const* tman, size_t* size) {
+    int const prot  = PROT_READ | PROT_WRITE;
+    int const flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+    if ((tman->region_flags & TLSF_REGION_HUGETLB) == TLSF_REGION_HUGETLB) {
+        size_t const s = align_up(*size, HUGE_PAGE_SIZE);
+        void* r        = mmap(NULL, s, prot, flags | MAP_HUGETLB, -1, 0);
+        if (r != MAP_FAILED) {
+            *size = s;
+            return r;
+        }
+        /* No huge page is reserved, use the normal pages. */
+    }
+
+    if ((tman->region_flags & TLSF_REGION_THP) == TLSF_REGION_THP) {
+        /* Align the region to the huge page so that the kernel can back it by transparent huge pages. */
+        size_t const s = align_up(*size, HUGE_PAGE_SIZE);
+        uint8_t* r     = mmap(NULL, s + HUGE_PAGE_SIZE, prot, flags, -1, 0);
+        if (r == MAP_FAILED) {
+            return NULL;
+        }
+
+        uintptr_t const base = align_up((uintptr_t)r, HUGE_PAGE_SIZE);
+        size_t const head    = base - (uintptr_t)r;
+        if (head != 0) {
+            munmap(r, head);
+        }
+        if (HUGE_PAGE_SIZE != head) {
+            munmap((void*)(base + s), HUGE_PAGE_SIZE - head);
+        }
+        madvise((void*)base, s, MADV_HUGEPAGE);
+
+        *size = s;
+        return (void*)base;
+    }
+
+    size_t const s = align_up(*size, FRAME_SIZE);
+    void* r        = mmap(NULL, s, prot, flags, -1, 0);
+    if (r == MAP_FAILED) {
+        return NULL;
+    }
+
+    *size = s;
+    return r;
+}
+
+
+/* The size may be rounded up to the page size. */
+static Frame* alloc_region(Tlsf_manager const* tman, size_t* size) {
+    if (is_mmap_region(tman) == true) {
+        return map_region(tman, size);
+    }
+
+    return malloc(*size);
+}
+
+
+static void release_region(Tlsf_manager const* tman, Frame* f) {
+    if (is_mmap_region(tman) == true) {
+        munmap(f, f->size);
+    } else {
+        free(f);
+    }
+}
+
+
+static size_t purge_pages(Tlsf_manager* tman, uintptr_t head, uintptr_t tail) {
+    size_t const g = get_trim_granule(tman);
+    head           = align_up(head, g);
+    tail           = align_down(tail, g);
+    if (tail <= head) {
+        return 0;
+    }
+
+    madvise((void*)head, tail - head, MADV_DONTNEED);
+    tman->counters.purged_size += tail - head;
+
+    return tail - head;
+}
+
+
+/* Give the pages inside of the free block b back to the system. Its header is kept. */
+static inline size_t purge_free_block(Tlsf_manager* tman, Block const* b) {
+    return purge_pages(tman, (uintptr_t)convert_mem_ptr(b), (uintptr_t)get_phys_next_block(b));
+}
+
+
+/*
+ * [head, tail) is the block which was freed and merged into b.
+ * The rest of b was purged when it was freed if it was large, so only the range is purged.
+ */
+static inline void trim_free_block(Tlsf_manager* tman, Block const* b, uintptr_t head, uintptr_t tail) {
+    if (is_mmap_region(tman) == false || tman->trim_threshold == 0 || get_size(b) < tman->trim_threshold) {
+        return;
+    }
+
+    uintptr_t const m = (uintptr_t)convert_mem_ptr(b);
+    purge_pages(tman, (head < m) ? m : head, tail);
+}
+
+
 Tlsf_manager* tlsf_init(Tlsf_manager* tman) {
     memset(tman, 0, sizeof(Tlsf_manager));
     elist_init(&tman->frames);
     for (size_t i = 0; i < (FL_MAX_INDEX * SL_MAX_INDEX); i++) {
         elist_init(tman->blocks + i);
     }
+    for (size_t i = 0; i < TLSF_SMALL_CLASS_NR; i++) {
+        elist_init(tman->small_runs + i);
+    }
 
     return tman;
 }
 
 
-void tlsf_destruct(Tlsf_manager* tman) {
-    if (elist_is_empty(&tman->frames) == true) {
-        return;
-    }
+/*
+ * Regions are obtained by mmap().
+ * flags is TLSF_REGION_MMAP and optionally TLSF_REGION_HUGETLB or TLSF_REGION_THP.
+ */
+Tlsf_manager* tlsf_init_mmap(Tlsf_manager* tman, uint32_t flags) {
+    tlsf_init(tman);
+    tman->region_flags   = flags | TLSF_REGION_MMAP;
+    tman->trim_threshold = TLSF_TRIM_THRESHOLD;
 
-    elist_foreach(itr, &tman->frames, Frame, list) {
-        free(itr->addr);
-    }
+    return tman;
+}
 
+
+void tlsf_destruct(Tlsf_manager* tman) {
     Elist* l = tman->frames.next;
-    do {
+    while (l != NULL && l != &tman->frames) {
+        /* The list is in the region. */
         Elist* next = l->next;
-        free(l);
+        release_region(tman, elist_derive(Frame, list, l));
         l = next;
-    } while (&tman->frames != l);
+    }
 
     memset(tman, 0, sizeof(Tlsf_manager));
 }
 
 
 Tlsf_manager* tlsf_supply_memory(Tlsf_manager* tman, size_t size) {
-    assert((2 * BLOCK_OFFSET) <= size);
-    if (size < (2 * BLOCK_OFFSET)) {
+    assert((FRAME_HEADER_SIZE + 2 * BLOCK_OFFSET) < size);
+    if (size <= (FRAME_HEADER_SIZE + 2 * BLOCK_OFFSET)) {
         return NULL;
     }
 
-    /* FIXME: */
-    Frame* f = malloc(sizeof(Frame));
-    f->addr  = malloc(size);
-    if (f->addr == NULL) {
-        printf("ERROR!\n");
-        free(f);
+    Frame* f = alloc_region(tman, &size);
+    if (f == NULL) {
         return NULL;
     }
+    f->addr = (void*)((uintptr_t)f + FRAME_HEADER_SIZE);
     f->size = size;
     elist_insert_next(&tman->frames, &f->list);
 
-    size_t ns = (f->size - BLOCK_OFFSET);
+    size_t ns = align_down(f->size - FRAME_HEADER_SIZE - BLOCK_OFFSET, ALIGNMENT_SIZE);
     Block* new_block = generate_block(f->addr, ns);
     set_free(new_block);
     elist_init(&new_block->list);
 
     Block* sentinel      = (Block*)((uintptr_t)f->addr + (uintptr_t)ns);
     sentinel->prev_block = new_block;
+    sentinel->frame      = f;
     sentinel->size       = 0;
 
     assert(get_phys_next_block(new_block) == sentinel);
@@ -601,32 +728,50 @@ Tlsf_manager* tlsf_supply_memory(Tlsf_manager* tman, size_t size) {
 }
 
 
+/*
+ * Give the pages inside of all free blocks back to the system regardless of trim_threshold.
+ * Return the number of the purged bytes.
+ */
+size_t tlsf_trim(Tlsf_manager* tman) {
+    if (tman == NULL || is_mmap_region(tman) == false) {
+        return 0;
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < (FL_MAX_INDEX * SL_MAX_INDEX); i++) {
+        elist_foreach(itr, &tman->blocks[i], Block, list) {
+            n += purge_free_block(tman, itr);
+        }
+    }
+
+    return n;
+}
+
+
 static inline void check_alloc_watermark(Tlsf_manager* tman) {
     size_t const w = block_align_up(WATERMARK_BLOCK_SIZE);
     size_t fl, sl;
     set_idxs(w, &fl, &sl);
 
-    size_t fl_map = tman->fl_bitmap & (~0u << fl);
+    size_t fl_map = tman->fl_bitmap & (~(uint64_t)0 << fl);
     if (fl_map == 0) {
         /* WATERMARK_BLOCK_SIZE以上のブロックが無いので確保. */
-        void* m = tlsf_supply_memory(tman, w + BLOCK_OFFSET * 3);
-        if (m == NULL) {
-            printf("alloc failed\n");
+        /* Nothing is printed on failure because this may be the malloc() of the process. */
+        if (tlsf_supply_memory(tman, w + FRAME_HEADER_SIZE + BLOCK_OFFSET * 3) != NULL) {
+            ++tman->counters.supply_nr;
         }
     }
 }
 
 
-void* tlsf_malloc_align(Tlsf_manager* tman, size_t size, size_t align) {
-    assert((align == 0) || ((align - 1u) & align) == 0);
-    assert(align <= MAX_ALLOC_ALIGN);
+static void* malloc_block(Tlsf_manager* tman, size_t size, size_t align) {
+    check_alloc_watermark(tman);
 
-    if (size == 0 || tman == NULL) {
-        return NULL;
+    /* Every block is aligned by ALIGNMENT_SIZE. */
+    if (align <= ALIGNMENT_SIZE) {
+        align = 0;
     }
 
-    check_alloc_watermark(tman);
-
     size_t a_size = adjust_size(size + align + BLOCK_OFFSET);
 
     Block* gb = remove_good_block(tman, a_size);
@@ -637,6 +782,8 @@ void* tlsf_malloc_align(Tlsf_manager* tman, size_t size, size_t align) {
     assert(a_size < get_size(gb));
 
     Block* sb, * ab = divide_block(gb, adjust_size(size), align);
+    /* a_size has the room of alignment, so an aligned block is always divided. */
+    assert(align == 0 || ab != NULL);
     if (ab == NULL) {
         /* 分割出来なかったのでそのまま使用 */
         sb = gb;
@@ -645,6 +792,7 @@ void* tlsf_malloc_align(Tlsf_manager* tman, size_t size, size_t align) {
         sb = ab;
         insert_block(tman, gb);
         tman->free_memory_size -= BLOCK_OFFSET;
+        ++tman->counters.split_nr;
     }
 
     tman->free_memory_size -= get_size(sb);
@@ -654,100 +802,108 @@ void* tlsf_malloc_align(Tlsf_manager* tman, size_t size, size_t align) {
 }
 
 
-void* tlsf_malloc(Tlsf_manager* tman, size_t size) {
-    return tlsf_malloc_align(tman, size, 0);
-}
 
 
-static inline void check_free_watermark(Tlsf_manager* tman, Block* b) {
+
+/* Return true if the region of b is given back. */
+static inline bool check_free_watermark(Tlsf_manager* tman, Block* b) {
     if (b->prev_block != NULL || is_sentinel(get_phys_next_block(b)) == false) {
-        return;
+        return false;
     }
 
     size_t const w = block_align_up(WATERMARK_BLOCK_SIZE);
-    size_t fl, sl, cnt = 1;
+    size_t fl, sl;
     set_idxs(w, &fl, &sl);
-    elist_foreach(i, get_block_list_head(tman, fl, sl), Block, list) {
-        if (WATERMARK_BLOCK_NR_FREE < cnt++) {
-            break;
-        }
+    if (tman->block_nrs[get_block_list_idx(fl, sl)] < WATERMARK_BLOCK_NR_FREE) {
+        return false;
     }
 
-    if (cnt <= WATERMARK_BLOCK_NR_FREE) {
-        return;
-    }
+    /* The block covers whole of the frame, so the next block is the sentinel of the frame. */
+    Frame* f = get_phys_next_block(b)->frame;
+    assert(f != NULL);
+    assert((uintptr_t)f->addr == (uintptr_t)b);
 
     remove_block(tman, b);
     tman->free_memory_size -= get_size(b);
     tman->total_memory_size -= get_size(b);
 
-    Frame* f = NULL;
-    elist_foreach(i, &tman->frames, Frame, list) {
-        if ((uintptr_t)i->addr == (uintptr_t)b) {
-            f = i;
-        }
-    }
-    assert(f != NULL);
-
-    // FIXME:
     elist_remove(&f->list);
-    free(f->addr);
-    free(f);
-}
+    release_region(tman, f);
+    ++tman->counters.release_nr;
 
+    return true;
+}
 
-void tlsf_free(Tlsf_manager* tman, void* p) {
-    if (tman == NULL || p == NULL) {
-        return;
-    }
 
+static void free_block(Tlsf_manager* tman, void* p) {
     Block* b = convert_block(p);
     assert(b->is_free == 0);
 
+    uintptr_t const head = (uintptr_t)b;
+    uintptr_t const tail = (uintptr_t)get_phys_next_block(b);
+
     set_free(b);
 
     tman->free_memory_size += (get_size(b) + BLOCK_OFFSET);
 
     b = merge_phys_neighbor_blocks(tman, b);
 
-    check_free_watermark(tman, b);
+    if (check_free_watermark(tman, b) == false) {
+        trim_free_block(tman, b, head, tail);
+    }
 }
 
 
-static char const* test_indexes(void) {
-    size_t fl, sl;
+/*
+ * ==================== Small objects. ====================
+ * Objects of one class are packed in a run without Block header.
+ * The run header is at the head of the run and the set bits of free_bitmap are free objects.
+ * A run is only aligned to TLSF_SMALL_GRANULE because larger alignment is paid by padding in the block.
+ * So run_table maps every page touched by a run to the run, and a page is touched by two runs at most.
+ * Other blocks never overlap runs, so the lookup never mistakes them.
+ */
 
-    size_t sizes[] = {140, 32, 11, 1024, 16 << 20, (4 << 20) * 1024 - 1u, 0xffffffff, 0x4000, 0x8000, 0x8000 + 0x1000};
-    size_t ans_fl[] = {0, 0, 0, 1, 15, 22, 22, 5, 6, 6};
-    size_t ans_sl[] = {2, 0, 0, 0, 0, 15, 15, 0, 0, 2};
 
-    for (int i = 0; i < sizeof(sizes) / sizeof(size_t); i++) {
-        set_idxs(sizes[i], &fl, &sl);
-        /* printf("size = 0x%08zx, fl = %02zu, sl = %02zu\n", sizes[i], fl, sl); */
-        MIN_UNIT_ASSERT("set_idxs is wrong.", fl == ans_fl[i] && sl == ans_sl[i]);
-    }
+enum {
+    SMALL_RUN_HEADER_SIZE = (sizeof(Tlsf_small_run) + TLSF_SMALL_GRANULE - 1) & ~(size_t)(TLSF_SMALL_GRANULE - 1),
+    RUN_TABLE_INIT_SIZE   = 64,
+    RUN_TABLE_PAGE_LOG2   = 12,
+};
 
-    return NULL;
+
+static inline size_t small_class_size(size_t c) {
+    return (c + 1u) << TLSF_SMALL_GRANULE_LOG2;
 }
 
 
-static char const* test_find_bit(void) {
-    for (size_t i = 0; i < 32; i++) {
-        size_t s = 1u << i;
-        MIN_UNIT_ASSERT("find_set_bit_idx_first is wrong.", find_set_bit_idx_first(s) == i);
-        MIN_UNIT_ASSERT("find_set_bit_idx_last is wrong.", find_set_bit_idx_last(s) == i);
-    }
-    MIN_UNIT_ASSERT("find_set_bit_idx_first is wrong.", find_set_bit_idx_first(0x80008000) == 15);
-    MIN_UNIT_ASSERT("find_set_bit_idx_last is wrong.", find_set_bit_idx_last(0x7FFFFFFF) == 30);
+static inline uintptr_t get_page(uintptr_t addr) {
+    return addr >> RUN_TABLE_PAGE_LOG2;
+}
 
-    return NULL;
+
+static inline size_t run_table_hash(Tlsf_manager const* tman, uintptr_t page) {
+    /* Fibonacci hashing. */
+    return (size_t)((uint64_t)page * UINT64_C(0x9E3779B97F4A7C15) >> 32) & (tman->run_table_size - 1u);
 }
 
 
-static char const* test_block_align_up(void) {
-    for (size_t i = ALIGNMENT_SIZE; i < 0x100000; i *= ALIGNMENT_SIZE) {
-        for (size_t j = 1; j < ALIGNMENT_SIZE; j++) {
-            MIN_UNIT_ASSERT("block_align_up is wrong.", block_align_up(i - j) == i);
+static inline bool is_in_run(Tlsf_small_run const* run, uintptr_t addr) {
+    return ((uintptr_t)run <= addr) && (addr < (uintptr_t)run + TLSF_SMALL_RUN_SIZE);
+}
+
+
+/* Return the run which has the address or NULL. */
+static inline Tlsf_small_run* find_small_run(Tlsf_manager const* tman, uintptr_t addr) {
+    if (tman->run_nr == 0) {
+        return NULL;
+    }
+
+    uintptr_t const page = get_page(addr);
+    size_t const mask    = tman->run_table_size - 1u;
+    for (size_t i = run_table_hash(tman, page); tman->run_table[i].run != NULL; i = (i + 1u) & mask) {
+        Tlsf_run_entry const* e = &tman->run_table[i];
+        if (e->page == page && is_in_run(e->run, addr) == true) {
+            return e->run;
         }
     }
 
@@ -755,89 +911,985 @@ static char const* test_block_align_up(void) {
 }
 
 
-static char const* test_align_down(void) {
-    MIN_UNIT_ASSERT("align_down is wrong.", align_down(0xff, 2) == 0xfe);
-    MIN_UNIT_ASSERT("align_down is wrong.", align_down(0x7ff5ef4f7760, 0x2000) == 0x7ff5ef4f6000);
-
-    return NULL;
+/*
+ * The size taken from free_memory_size by malloc_block() and given back by free_block().
+ * malloc_block() always divides the found block, so the header is also counted.
+ */
+static inline size_t get_charged_size(void const* p) {
+    return get_size(convert_block(p)) + BLOCK_OFFSET;
 }
 
 
-static char const* all_tests(void) {
-    MIN_UNIT_RUN(test_indexes);
-    MIN_UNIT_RUN(test_find_bit);
-    MIN_UNIT_RUN(test_block_align_up);
-    MIN_UNIT_RUN(test_align_down);
-    return NULL;
+/*
+ * The run table is not counted in total_memory_size nor free_memory_size.
+ * Its size is taken from total_memory_size as long as it is alive.
+ */
+static void* malloc_run_table(Tlsf_manager* tman, size_t size) {
+    void* p = malloc_block(tman, size, 0);
+    if (p != NULL) {
+        tman->total_memory_size -= get_charged_size(p);
+    }
+
+    return p;
 }
 
 
-static inline int do_all_tests(void) {
-    MIN_UNIT_RUN_ALL(all_tests);
+static void free_run_table(Tlsf_manager* tman, void* p) {
+    tman->total_memory_size += get_charged_size(p);
+    free_block(tman, p);
 }
 
 
-static double gettimeofday_sec(void) {
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    return tv.tv_sec + tv.tv_usec * 1e-6;
+static inline void run_table_put(Tlsf_manager* tman, uintptr_t page, Tlsf_small_run* run) {
+    size_t i = run_table_hash(tman, page);
+    while (tman->run_table[i].run != NULL) {
+        i = (i + 1u) & (tman->run_table_size - 1u);
+    }
+    tman->run_table[i] = (Tlsf_run_entry){page, run};
+    ++tman->run_entry_nr;
 }
 
 
-int main(void) {
-    do_all_tests();
+static bool run_table_insert(Tlsf_manager* tman, Tlsf_small_run* run) {
+    uintptr_t const first = get_page((uintptr_t)run);
+    uintptr_t const last  = get_page((uintptr_t)run + TLSF_SMALL_RUN_SIZE - 1u);
 
-    Tlsf_manager tman;
-    Tlsf_manager* p = &tman;
+    /* Keep the load factor under 1/2. */
+    if (tman->run_table_size <= (tman->run_entry_nr + 2u) * 2u) {
+        size_t const old_size     = tman->run_table_size;
+        Tlsf_run_entry* old_table = tman->run_table;
+        size_t const new_size     = (old_size == 0) ? RUN_TABLE_INIT_SIZE : old_size * 2u;
+        Tlsf_run_entry* new_table = malloc_run_table(tman, sizeof(Tlsf_run_entry) * new_size);
+        if (new_table == NULL) {
+            return false;
+        }
 
-    tlsf_init(p);
+        memset(new_table, 0, sizeof(Tlsf_run_entry) * new_size);
+        tman->run_table      = new_table;
+        tman->run_table_size = new_size;
+        tman->run_entry_nr   = 0;
+        for (size_t i = 0; i < old_size; i++) {
+            if (old_table[i].run != NULL) {
+                run_table_put(tman, old_table[i].page, old_table[i].run);
+            }
+        }
 
-    tlsf_supply_memory(p, 128 << 20);
-    assert(p->total_memory_size == p->free_memory_size);
+        if (old_table != NULL) {
+            free_run_table(tman, old_table);
+        }
+    }
 
-    printf("\nStart Loop\n");
-    printf("total_memory_size: 0x%zx - %zuMB\n", p->total_memory_size, p->total_memory_size >> 20);
+    for (uintptr_t page = first; page <= last; page++) {
+        run_table_put(tman, page, run);
+    }
+    ++tman->run_nr;
 
-    size_t cnt                     = 0;
-    size_t limit                   = 1000000;
-    size_t failed                  = 0;
-    static size_t const array_size = 100;
-    void* allocs[array_size];
+    return true;
+}
 
-    srand((unsigned int)time(NULL));
-    double begin = gettimeofday_sec();
-    for (size_t times = 0; times < limit; times++) {
-        size_t r_size = (((size_t)rand() % MAX_ALLOCATION_SIZE) + 1u);
-        size_t align  = PO2((size_t)rand() % 12 + 1u);
-        void* m       = tlsf_malloc_align(p, r_size, align);
 
-        assert(((uintptr_t)m & (align - 1)) == 0);
+/* Backward shift deletion for linear probing, no tombstone is needed. */
+static void run_table_delete(Tlsf_manager* tman, uintptr_t page, Tlsf_small_run const* run) {
+    size_t const mask = tman->run_table_size - 1u;
+    size_t i          = run_table_hash(tman, page);
+    while (tman->run_table[i].page != page || tman->run_table[i].run != run) {
+        assert(tman->run_table[i].run != NULL);
+        i = (i + 1u) & mask;
+    }
 
-        if (m == NULL) {
-            failed++;
-        } else {
-            /* memset(m, 0xff, r_size); */
+    size_t j = i;
+    while (true) {
+        j = (j + 1u) & mask;
+        Tlsf_run_entry const e = tman->run_table[j];
+        if (e.run == NULL) {
+            break;
         }
 
-        allocs[cnt] = m;
-
-        ++cnt;
-        if (array_size <= cnt || m == NULL || times == limit - 1) {
-            for (int i = 0; i <= (cnt - 1u); i++) {
-                tlsf_free(p, allocs[i]);
-            }
-            cnt = 0;
-            assert(p->total_memory_size == p->free_memory_size);
+        /* Move e into the hole if its home slot is not in (i, j]. */
+        size_t h = run_table_hash(tman, e.page);
+        if (((j - h) & mask) >= ((j - i) & mask)) {
+            tman->run_table[i] = e;
+            i = j;
         }
     }
-    double end = gettimeofday_sec();
+    tman->run_table[i].run = NULL;
 
-    printf("Finish Loop\n\n");
-    printf("Time is %f\n", end - begin);
-    printf("failed is %zu\n", failed);
-    printf("total_memory_size: 0x%zx - %zuMB\n", p->total_memory_size, p->total_memory_size >> 20);
+    --tman->run_entry_nr;
+}
 
-    tlsf_destruct(p);
 
-    return 0;
+static void run_table_remove(Tlsf_manager* tman, Tlsf_small_run const* run) {
+    uintptr_t const first = get_page((uintptr_t)run);
+    uintptr_t const last  = get_page((uintptr_t)run + TLSF_SMALL_RUN_SIZE - 1u);
+
+    for (uintptr_t page = first; page <= last; page++) {
+        run_table_delete(tman, page, run);
+    }
+    --tman->run_nr;
 }
+
+
+static Tlsf_small_run* create_small_run(Tlsf_manager* tman, size_t c) {
+    Tlsf_small_run* run = tman->spare_runs[c];
+    if (run != NULL) {
+        tman->spare_runs[c] = NULL;
+        tman->free_memory_size -= get_charged_size(run);
+        elist_insert_next(&tman->small_runs[c], &run->list);
+        return run;
+    }
+
+    /* Blocks are aligned to ALIGNMENT_SIZE which is enough for the objects. */
+    run = malloc_block(tman, TLSF_SMALL_RUN_SIZE, 0);
+    if (run == NULL) {
+        return NULL;
+    }
+
+    if (run_table_insert(tman, run) == false) {
+        free_block(tman, run);
+        return NULL;
+    }
+
+    size_t const obj_nr = (TLSF_SMALL_RUN_SIZE - SMALL_RUN_HEADER_SIZE) / small_class_size(c);
+    run->class   = (uint16_t)c;
+    run->obj_nr  = (uint16_t)obj_nr;
+    run->free_nr = (uint16_t)obj_nr;
+    memset(run->free_bitmap, 0, sizeof(run->free_bitmap));
+    for (size_t i = 0; i < obj_nr; i++) {
+        run->free_bitmap[i / 64u] |= UINT64_C(1) << (i % 64u);
+    }
+    elist_insert_next(&tman->small_runs[c], &run->list);
+
+    return run;
+}
+
+
+static void* malloc_small(Tlsf_manager* tman, size_t size) {
+    size_t const c = ((size + TLSF_SMALL_GRANULE - 1u) >> TLSF_SMALL_GRANULE_LOG2) - 1u;
+    Elist* head    = &tman->small_runs[c];
+
+    Tlsf_small_run* run = (elist_is_empty(head) == true) ? create_small_run(tman, c) : elist_derive(Tlsf_small_run, list, head->next);
+    if (run == NULL) {
+        return NULL;
+    }
+
+    size_t w = 0;
+    while (run->free_bitmap[w] == 0) {
+        ++w;
+    }
+    size_t const bit = find_set_bit_idx_first(run->free_bitmap[w]);
+    run->free_bitmap[w] &= ~(UINT64_C(1) << bit);
+
+    if (--run->free_nr == 0) {
+        /* Full runs are not in the list. */
+        elist_remove(&run->list);
+    }
+
+    return (void*)((uintptr_t)run + SMALL_RUN_HEADER_SIZE + (w * 64u + bit) * small_class_size(c));
+}
+
+
+static void free_small(Tlsf_manager* tman, Tlsf_small_run* run, void* p) {
+    size_t const c   = run->class;
+    size_t const idx = ((uintptr_t)p - (uintptr_t)run - SMALL_RUN_HEADER_SIZE) / small_class_size(c);
+    assert(((uintptr_t)p - (uintptr_t)run - SMALL_RUN_HEADER_SIZE) % small_class_size(c) == 0);
+    assert((run->free_bitmap[idx / 64u] & (UINT64_C(1) << (idx % 64u))) == 0);
+
+    run->free_bitmap[idx / 64u] |= UINT64_C(1) << (idx % 64u);
+
+    if (run->free_nr++ == 0) {
+        elist_insert_next(&tman->small_runs[c], &run->list);
+    }
+
+    if (run->free_nr != run->obj_nr) {
+        return;
+    }
+
+    /* The run is empty. */
+    elist_remove(&run->list);
+    if (tman->spare_runs[c] == NULL) {
+        /* The spare run can be used by any request of the class, so it is counted as free. */
+        tman->spare_runs[c] = run;
+        tman->free_memory_size += get_charged_size(run);
+        return;
+    }
+
+    run_table_remove(tman, run);
+    free_block(tman, run);
+}
+
+
+/*
+ * ==================== Statistics. ====================
+ * The counters are updated by the single-threaded API.
+ * The multi-threaded mode moves blocks between the magazines and the manager without them,
+ * so only split/merge and the watermark counters are meaningful there.
+ */
+
+
+static inline size_t get_stats_class(size_t size) {
+    return find_set_bit_idx_last(size);
+}
+
+
+static inline void count_live(Tlsf_manager* tman, size_t usable_size) {
+    tman->counters.live_size += usable_size;
+    ++tman->counters.class_live_nrs[get_stats_class(usable_size)];
+}
+
+
+static inline void uncount_live(Tlsf_manager* tman, size_t usable_size) {
+    tman->counters.live_size -= usable_size;
+    --tman->counters.class_live_nrs[get_stats_class(usable_size)];
+}
+
+
+static inline void recount_live(Tlsf_manager* tman, size_t old_size, size_t new_size) {
+    uncount_live(tman, old_size);
+    count_live(tman, new_size);
+}
+
+
+static inline uint64_t begin_latency(Tlsf_manager const* tman) {
+    if (tman->counters.is_latency_enabled == false) {
+        return 0;
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+
+static inline void end_latency(Tlsf_manager const* tman, uint64_t* histogram, uint64_t begin) {
+    if (tman->counters.is_latency_enabled == false) {
+        return;
+    }
+
+    uint64_t const ns = begin_latency(tman) - begin;
+    size_t const i    = (ns == 0) ? 0 : find_set_bit_idx_last(ns);
+    ++histogram[(i < TLSF_STATS_LATENCY_NR) ? i : (TLSF_STATS_LATENCY_NR - 1)];
+}
+
+
+void tlsf_enable_latency_stats(Tlsf_manager* tman, bool is_enabled) {
+    tman->counters.is_latency_enabled = is_enabled;
+}
+
+
+static size_t get_largest_free_size(Tlsf_manager* tman) {
+    if (tman->fl_bitmap == 0) {
+        return 0;
+    }
+
+    /* The largest block is in the highest list, but the blocks in the list are not sorted. */
+    size_t const fl = find_set_bit_idx_last(tman->fl_bitmap);
+    size_t const sl = find_set_bit_idx_last(tman->sl_bitmaps[fl]);
+    size_t s        = 0;
+    elist_foreach(itr, get_block_list_head(tman, fl, sl), Block, list) {
+        if (s < get_size(itr)) {
+            s = get_size(itr);
+        }
+    }
+
+    return s;
+}
+
+
+Tlsf_stats* tlsf_get_stats(Tlsf_manager* tman, Tlsf_stats* stats) {
+    stats->total_memory_size = tman->total_memory_size;
+    stats->free_memory_size  = tman->free_memory_size;
+    stats->largest_free_size = get_largest_free_size(tman);
+    stats->fragmentation     = (tman->free_memory_size == 0) ? 0.0 : 1.0 - (double)stats->largest_free_size / (double)tman->free_memory_size;
+    stats->counters          = tman->counters;
+
+    return stats;
+}
+
+
+void tlsf_print_stats(Tlsf_stats const* stats, FILE* fp) {
+    Tlsf_counters const* c = &stats->counters;
+
+    fprintf(fp, "total_memory_size : %zu\n", stats->total_memory_size);
+    fprintf(fp, "free_memory_size  : %zu\n", stats->free_memory_size);
+    fprintf(fp, "live_size         : %zu\n", c->live_size);
+    fprintf(fp, "largest_free_size : %zu\n", stats->largest_free_size);
+    fprintf(fp, "fragmentation     : %.4f\n", stats->fragmentation);
+    fprintf(fp, "malloc/free/realloc/failed : %" PRIu64 " / %" PRIu64 " / %" PRIu64 " / %" PRIu64 "\n", c->malloc_nr, c->free_nr, c->realloc_nr, c->failed_nr);
+    fprintf(fp, "split/merge                : %" PRIu64 " / %" PRIu64 "\n", c->split_nr, c->merge_nr);
+    fprintf(fp, "supply/release/purged size : %" PRIu64 " / %" PRIu64 " / %" PRIu64 "\n", c->supply_nr, c->release_nr, c->purged_size);
+
+    fprintf(fp, "class (bytes), malloc, live\n");
+    for (size_t i = 0; i < TLSF_STATS_CLASS_NR; i++) {
+        if (c->class_malloc_nrs[i] != 0 || c->class_live_nrs[i] != 0) {
+            fprintf(fp, "  >= %-20zu, %" PRIu64 ", %" PRIu64 "\n", PO2(i), c->class_malloc_nrs[i], c->class_live_nrs[i]);
+        }
+    }
+
+    if (c->is_latency_enabled == false) {
+        return;
+    }
+
+    fprintf(fp, "latency (ns), malloc, free\n");
+    for (size_t i = 0; i < TLSF_STATS_LATENCY_NR; i++) {
+        if (c->malloc_latency[i] != 0 || c->free_latency[i] != 0) {
+            fprintf(fp, "  >= %-10zu, %" PRIu64 ", %" PRIu64 "\n", PO2(i), c->malloc_latency[i], c->free_latency[i]);
+        }
+    }
+}
+
+
+static void print_json_array(FILE* fp, char const* name, uint64_t const* a, size_t n) {
+    fprintf(fp, ", \"%s\": [", name);
+    for (size_t i = 0; i < n; i++) {
+        fprintf(fp, (i == 0) ? "%" PRIu64 : ", %" PRIu64, a[i]);
+    }
+    fprintf(fp, "]");
+}
+
+
+/* One JSON object in one line. */
+void tlsf_print_stats_json(Tlsf_stats const* stats, FILE* fp) {
+    Tlsf_counters const* c = &stats->counters;
+
+    fprintf(fp, "{\"total_memory_size\": %zu, \"free_memory_size\": %zu, \"live_size\": %zu", stats->total_memory_size, stats->free_memory_size, c->live_size);
+    fprintf(fp, ", \"largest_free_size\": %zu, \"fragmentation\": %.6f", stats->largest_free_size, stats->fragmentation);
+    fprintf(fp, ", \"malloc_nr\": %" PRIu64 ", \"free_nr\": %" PRIu64 ", \"realloc_nr\": %" PRIu64 ", \"failed_nr\": %" PRIu64, c->malloc_nr, c->free_nr, c->realloc_nr, c->failed_nr);
+    fprintf(fp, ", \"split_nr\": %" PRIu64 ", \"merge_nr\": %" PRIu64, c->split_nr, c->merge_nr);
+    fprintf(fp, ", \"supply_nr\": %" PRIu64 ", \"release_nr\": %" PRIu64 ", \"purged_size\": %" PRIu64, c->supply_nr, c->release_nr, c->purged_size);
+    print_json_array(fp, "class_malloc_nrs", c->class_malloc_nrs, TLSF_STATS_CLASS_NR);
+    print_json_array(fp, "class_live_nrs", c->class_live_nrs, TLSF_STATS_CLASS_NR);
+    if (c->is_latency_enabled == true) {
+        print_json_array(fp, "malloc_latency", c->malloc_latency, TLSF_STATS_LATENCY_NR);
+        print_json_array(fp, "free_latency", c->free_latency, TLSF_STATS_LATENCY_NR);
+    }
+    fprintf(fp, "}\n");
+}
+
+
+void* tlsf_malloc_align(Tlsf_manager* tman, size_t size, size_t align) {
+    assert((align == 0) || ((align - 1u) & align) == 0);
+    assert(align <= MAX_ALLOC_ALIGN);
+
+    /* Too large size overflows while it is rounded up. */
+    if (size == 0 || tman == NULL || (SIZE_MAX >> 1) < size) {
+        return NULL;
+    }
+
+    uint64_t const t = begin_latency(tman);
+
+    void* p       = NULL;
+    size_t usable = 0;
+    if (size <= TLSF_SMALL_MAX_SIZE && align <= TLSF_SMALL_GRANULE) {
+        p      = malloc_small(tman, size);
+        usable = align_up(size, TLSF_SMALL_GRANULE);
+    }
+
+    if (p == NULL) {
+        p      = malloc_block(tman, size, align);
+        usable = (p == NULL) ? 0 : get_size(convert_block(p));
+    }
+
+    if (p == NULL) {
+        ++tman->counters.failed_nr;
+    } else {
+        ++tman->counters.malloc_nr;
+        ++tman->counters.class_malloc_nrs[get_stats_class(usable)];
+        count_live(tman, usable);
+    }
+
+    end_latency(tman, tman->counters.malloc_latency, t);
+
+    return p;
+}
+
+
+void* tlsf_malloc(Tlsf_manager* tman, size_t size) {
+    return tlsf_malloc_align(tman, size, 0);
+}
+
+
+void tlsf_free(Tlsf_manager* tman, void* p) {
+    if (tman == NULL || p == NULL) {
+        return;
+    }
+
+    uint64_t const t = begin_latency(tman);
+
+    ++tman->counters.free_nr;
+    Tlsf_small_run* run = find_small_run(tman, (uintptr_t)p);
+    if (run != NULL) {
+        uncount_live(tman, small_class_size(run->class));
+        free_small(tman, run, p);
+    } else {
+        uncount_live(tman, get_size(convert_block(p)));
+        free_block(tman, p);
+    }
+
+    end_latency(tman, tman->counters.free_latency, t);
+}
+
+
+/*
+ * ==================== Reallocation. ====================
+ * A block is resized in place if possible.
+ * Shrinking gives the tail back as a free block and growing absorbs the physically next free block.
+ * Only when both fail, the contents are copied into a new block.
+ */
+
+
+enum {
+    REALLOC_SPLIT_MIN_SIZE = BLOCK_OFFSET + SL_BLOCK_MIN_SIZE, /* Smaller tails are left in the block. */
+};
+
+
+/* Give the tail of the allocated block b after size bytes back. */
+static void shrink_block(Tlsf_manager* tman, Block* b, size_t size) {
+    assert(size <= get_size(b));
+
+    size_t const rest = get_size(b) - size;
+    if (rest < REALLOC_SPLIT_MIN_SIZE) {
+        return;
+    }
+
+    Block* next = get_phys_next_block(b);
+    set_size(b, size);
+
+    /* The tail is made as an allocated block and it is freed as usual. */
+    Block* tail      = get_phys_next_block(b);
+    tail->prev_block = b;
+    tail->size       = rest - BLOCK_OFFSET;
+    elist_init(&tail->list);
+    next->prev_block = tail;
+    ++tman->counters.split_nr;
+
+    /* The charge of b is divided into b and the tail, so free_block() gives back rest bytes. */
+    free_block(tman, convert_mem_ptr(tail));
+}
+
+
+/* Absorb the physically next free block if b becomes size bytes at least. */
+static bool grow_block(Tlsf_manager* tman, Block* b, size_t size) {
+    Block* next = get_phys_next_block(b);
+    if (is_sentinel(next) == true || next->is_free == 0) {
+        return false;
+    }
+
+    size_t const new_size = get_size(b) + BLOCK_OFFSET + get_size(next);
+    if (new_size < size) {
+        return false;
+    }
+
+    remove_block(tman, next);
+    tman->free_memory_size -= get_size(next) + BLOCK_OFFSET;
+
+    Block* nn      = get_phys_next_block(next);
+    nn->prev_block = b;
+    set_size(b, new_size);
+    clear_prev_free(nn);
+
+    shrink_block(tman, b, size);
+
+    return true;
+}
+
+
+/*
+ * The number of bytes which can be used from p.
+ * It may be larger than the requested size.
+ */
+size_t tlsf_usable_size(Tlsf_manager* tman, void const* p) {
+    if (tman == NULL || p == NULL) {
+        return 0;
+    }
+
+    Tlsf_small_run const* run = find_small_run(tman, (uintptr_t)p);
+    if (run != NULL) {
+        return small_class_size(run->class);
+    }
+
+    return get_size(convert_block(p));
+}
+
+
+/*
+ * Same as realloc() of the C standard library.
+ * The alignment given to tlsf_malloc_align() is not kept when the contents are moved.
+ */
+void* tlsf_realloc(Tlsf_manager* tman, void* p, size_t size) {
+    if (tman == NULL) {
+        return NULL;
+    }
+
+    if (p == NULL) {
+        return tlsf_malloc(tman, size);
+    }
+
+    if (size == 0) {
+        tlsf_free(tman, p);
+        return NULL;
+    }
+
+    if ((SIZE_MAX >> 1) < size) {
+        return NULL;
+    }
+
+    ++tman->counters.realloc_nr;
+    size_t old_size;
+    Tlsf_small_run const* run = find_small_run(tman, (uintptr_t)p);
+    if (run != NULL) {
+        old_size = small_class_size(run->class);
+        if (size <= old_size) {
+            return p;
+        }
+    } else {
+        Block* b            = convert_block(p);
+        size_t const a_size = adjust_size(size);
+        old_size            = get_size(b);
+        if (a_size <= old_size) {
+            shrink_block(tman, b, a_size);
+            recount_live(tman, old_size, get_size(b));
+            return p;
+        }
+
+        if (grow_block(tman, b, a_size) == true) {
+            recount_live(tman, old_size, get_size(b));
+            return p;
+        }
+    }
+
+    void* n = tlsf_malloc(tman, size);
+    if (n == NULL) {
+        return NULL;
+    }
+
+    memcpy(n, p, (size < old_size) ? size : old_size);
+    tlsf_free(tman, p);
+
+    return n;
+}
+
+
+/*
+ * ==================== Multi-threaded mode. ====================
+ * The shared Tlsf_manager is only touched under mt->lock.
+ * Small blocks (up to TLSF_CACHE_MAX_SIZE) are served from per-thread magazines.
+ * A magazine of class c holds blocks whose usable size is at least (c + 1) * TLSF_CACHE_GRANULE,
+ * so a block freed by any thread can be reused by that thread for the same class.
+ * This is how cross-thread frees are handled: the block goes into the freeing thread's magazine
+ * and, once the magazine overflows, back to the shared manager where every thread can take it again.
+ * The magazines already serve small objects, so this mode uses blocks only and never makes small runs.
+ * Then every pointer has the Block header which tlsf_mt_free() reads.
+ */
+
+
+static inline size_t cache_class_size(size_t c) {
+    return (c + 1u) << TLSF_CACHE_GRANULE_LOG2;
+}
+
+
+static inline void lock_manager(Tlsf_mt_manager* mt) {
+    pthread_mutex_lock(&mt->lock);
+}
+
+
+static inline void unlock_manager(Tlsf_mt_manager* mt) {
+    pthread_mutex_unlock(&mt->lock);
+}
+
+
+/* Give the first n objects in the magazine back to the shared manager. */
+static inline void flush_magazine(Tlsf_mt_manager* mt, Tlsf_magazine* mag, size_t n) {
+    assert(n <= mag->nr);
+
+    lock_manager(mt);
+    for (size_t i = 0; i < n; i++) {
+        free_block(&mt->tman, mag->objs[i]);
+    }
+    unlock_manager(mt);
+
+    mag->nr -= n;
+    memmove(mag->objs, mag->objs + n, sizeof(void*) * mag->nr);
+}
+
+
+static inline void refill_magazine(Tlsf_mt_manager* mt, Tlsf_magazine* mag, size_t c) {
+    size_t const s = cache_class_size(c);
+
+    lock_manager(mt);
+    while (mag->nr < TLSF_CACHE_BATCH_SIZE) {
+        void* p = malloc_block(&mt->tman, s, 0);
+        if (p == NULL) {
+            break;
+        }
+        mag->objs[mag->nr++] = p;
+    }
+    unlock_manager(mt);
+}
+
+
+static void release_thread_cache(void* p) {
+    Tlsf_thread_cache* cache = p;
+    Tlsf_mt_manager* mt      = cache->owner;
+
+    for (size_t i = 0; i < TLSF_CACHE_CLASS_NR; i++) {
+        Tlsf_magazine* mag = &cache->magazines[i];
+        if (mag->nr != 0) {
+            flush_magazine(mt, mag, mag->nr);
+        }
+    }
+
+    lock_manager(mt);
+    free_block(&mt->tman, cache);
+    unlock_manager(mt);
+}
+
+
+static __thread bool is_creating_cache;
+
+
+static inline Tlsf_thread_cache* get_thread_cache(Tlsf_mt_manager* mt) {
+    Tlsf_thread_cache* cache = pthread_getspecific(mt->cache_key);
+    if (cache != NULL) {
+        return cache;
+    }
+
+    /* pthread_setspecific() may call malloc() and it may be this mode (tlsf_malloc.c), then use the lock. */
+    if (is_creating_cache == true) {
+        return NULL;
+    }
+    is_creating_cache = true;
+
+    /* The cache itself lives in the managed memory. */
+    lock_manager(mt);
+    cache = malloc_block(&mt->tman, sizeof(Tlsf_thread_cache), 0);
+    unlock_manager(mt);
+    if (cache != NULL) {
+        memset(cache, 0, sizeof(Tlsf_thread_cache));
+        cache->owner = mt;
+        pthread_setspecific(mt->cache_key, cache);
+    }
+
+    is_creating_cache = false;
+
+    return cache;
+}
+
+
+Tlsf_mt_manager* tlsf_mt_init(Tlsf_mt_manager* mt) {
+    tlsf_init(&mt->tman);
+
+    if (pthread_mutex_init(&mt->lock, NULL) != 0) {
+        return NULL;
+    }
+
+    /* Caches of exiting threads are flushed by the key destructor. */
+    if (pthread_key_create(&mt->cache_key, release_thread_cache) != 0) {
+        pthread_mutex_destroy(&mt->lock);
+        return NULL;
+    }
+
+    return mt;
+}
+
+
+/* Regions are obtained by mmap(), see tlsf_init_mmap(). */
+Tlsf_mt_manager* tlsf_mt_init_mmap(Tlsf_mt_manager* mt, uint32_t flags) {
+    if (tlsf_mt_init(mt) == NULL) {
+        return NULL;
+    }
+    tlsf_init_mmap(&mt->tman, flags);
+
+    return mt;
+}
+
+
+/*
+ * Other threads must have exited or called tlsf_mt_thread_flush() before this.
+ */
+void tlsf_mt_destruct(Tlsf_mt_manager* mt) {
+    tlsf_mt_thread_flush(mt);
+    pthread_key_delete(mt->cache_key);
+    pthread_mutex_destroy(&mt->lock);
+    tlsf_destruct(&mt->tman);
+}
+
+
+Tlsf_mt_manager* tlsf_mt_supply_memory(Tlsf_mt_manager* mt, size_t size) {
+    lock_manager(mt);
+    Tlsf_manager* t = tlsf_supply_memory(&mt->tman, size);
+    unlock_manager(mt);
+
+    return (t == NULL) ? NULL : mt;
+}
+
+
+void* tlsf_mt_malloc_align(Tlsf_mt_manager* mt, size_t size, size_t align) {
+    if (size == 0 || mt == NULL || (SIZE_MAX >> 1) < size) {
+        return NULL;
+    }
+
+    if (size <= TLSF_CACHE_MAX_SIZE && align <= ALIGNMENT_SIZE) {
+        Tlsf_thread_cache* cache = get_thread_cache(mt);
+        if (cache != NULL) {
+            size_t c           = ((size + TLSF_CACHE_GRANULE - 1u) >> TLSF_CACHE_GRANULE_LOG2) - 1u;
+            Tlsf_magazine* mag = &cache->magazines[c];
+            if (mag->nr == 0) {
+                refill_magazine(mt, mag, c);
+            }
+
+            if (mag->nr != 0) {
+                return mag->objs[--mag->nr];
+            }
+        }
+    }
+
+    lock_manager(mt);
+    void* p = malloc_block(&mt->tman, size, align);
+    unlock_manager(mt);
+
+    return p;
+}
+
+
+void* tlsf_mt_malloc(Tlsf_mt_manager* mt, size_t size) {
+    return tlsf_mt_malloc_align(mt, size, 0);
+}
+
+
+void tlsf_mt_free(Tlsf_mt_manager* mt, void* p) {
+    if (mt == NULL || p == NULL) {
+        return;
+    }
+
+    size_t const s = get_size_unlocked(convert_block(p));
+    if (TLSF_CACHE_GRANULE <= s && s <= TLSF_CACHE_MAX_SIZE) {
+        Tlsf_thread_cache* cache = get_thread_cache(mt);
+        if (cache != NULL) {
+            Tlsf_magazine* mag = &cache->magazines[(s >> TLSF_CACHE_GRANULE_LOG2) - 1u];
+            if (mag->nr == TLSF_CACHE_MAGAZINE_SIZE) {
+                flush_magazine(mt, mag, TLSF_CACHE_BATCH_SIZE);
+            }
+            mag->objs[mag->nr++] = p;
+            return;
+        }
+    }
+
+    lock_manager(mt);
+    free_block(&mt->tman, p);
+    unlock_manager(mt);
+}
+
+
+/* Every pointer of this mode has the Block header, see tlsf_mt_free(). */
+size_t tlsf_mt_usable_size(Tlsf_mt_manager* mt, void const* p) {
+    return (mt == NULL || p == NULL) ? 0 : get_size_unlocked(convert_block(p));
+}
+
+
+void* tlsf_mt_realloc(Tlsf_mt_manager* mt, void* p, size_t size) {
+    if (mt == NULL) {
+        return NULL;
+    }
+
+    if (p == NULL) {
+        return tlsf_mt_malloc(mt, size);
+    }
+
+    if (size == 0) {
+        tlsf_mt_free(mt, p);
+        return NULL;
+    }
+
+    if ((SIZE_MAX >> 1) < size) {
+        return NULL;
+    }
+
+    Block* b            = convert_block(p);
+    size_t const a_size = adjust_size(size);
+
+    lock_manager(mt);
+    size_t const old_size = get_size(b);
+    bool is_resized       = true;
+    if (a_size <= old_size) {
+        shrink_block(&mt->tman, b, a_size);
+    } else {
+        is_resized = grow_block(&mt->tman, b, a_size);
+    }
+    unlock_manager(mt);
+
+    if (is_resized == true) {
+        return p;
+    }
+
+    void* n = tlsf_mt_malloc(mt, size);
+    if (n != NULL) {
+        memcpy(n, p, old_size);
+        tlsf_mt_free(mt, p);
+    }
+
+    return n;
+}
+
+
+/*
+ * Give all blocks cached by the calling thread back to the shared manager.
+ */
+void tlsf_mt_thread_flush(Tlsf_mt_manager* mt) {
+    Tlsf_thread_cache* cache = pthread_getspecific(mt->cache_key);
+    if (cache == NULL) {
+        return;
+    }
+
+    pthread_setspecific(mt->cache_key, NULL);
+    release_thread_cache(cache);
+}
+
+
+#ifndef TLSF_LIBRARY
+
+
+#include "minunit.h"
+
+
+static char const* test_indexes(void) {
+    size_t fl, sl;
+
+#if TLSF_SL_MAX_INDEX_LOG2 == 4
+    size_t sizes[] = {140, 32, 11, 1024, 16 << 20, (4 << 20) * 1024 - 1u, 0xffffffff, 0x4000, 0x8000, 0x8000 + 0x1000, (size_t)1 << 40, 0x300000000, SIZE_MAX};
+    size_t ans_fl[] = {0, 0, 0, 1, 15, 22, 22, 5, 6, 6, 31, 24, 54};
+    size_t ans_sl[] = {2, 0, 0, 0, 0, 15, 15, 0, 0, 2, 0, 8, 15};
+
+    for (int i = 0; i < sizeof(sizes) / sizeof(size_t); i++) {
+        set_idxs(sizes[i], &fl, &sl);
+        /* printf("size = 0x%08zx, fl = %02zu, sl = %02zu\n", sizes[i], fl, sl); */
+        MIN_UNIT_ASSERT("set_idxs is wrong.", fl == ans_fl[i] && sl == ans_sl[i]);
+    }
+#endif
+
+    /* Every size is in the range of its list for any SL_MAX_INDEX_LOG2. */
+    for (size_t s = FL_BLOCK_MIN_SIZE; s != 0 && s < SIZE_MAX / 3; s = s * 3 + 1) {
+        set_idxs(s, &fl, &sl);
+        size_t const fs = PO2(fl + FL_BASE_INDEX);
+        size_t const ss = fs + sl * (fs >> SL_MAX_INDEX_LOG2);
+        MIN_UNIT_ASSERT("set_idxs is wrong.", fl < FL_MAX_INDEX && sl < SL_MAX_INDEX);
+        MIN_UNIT_ASSERT("set_idxs is wrong.", ss <= s && s < ss + (fs >> SL_MAX_INDEX_LOG2));
+    }
+
+    return NULL;
+}
+
+
+static char const* test_find_bit(void) {
+    for (size_t i = 0; i < 64; i++) {
+        size_t s = PO2(i);
+        MIN_UNIT_ASSERT("find_set_bit_idx_first is wrong.", find_set_bit_idx_first(s) == i);
+        MIN_UNIT_ASSERT("find_set_bit_idx_last is wrong.", find_set_bit_idx_last(s) == i);
+    }
+    MIN_UNIT_ASSERT("find_set_bit_idx_first is wrong.", find_set_bit_idx_first(0x80008000) == 15);
+    MIN_UNIT_ASSERT("find_set_bit_idx_last is wrong.", find_set_bit_idx_last(0x7FFFFFFF) == 30);
+    MIN_UNIT_ASSERT("find_set_bit_idx_first is wrong.", find_set_bit_idx_first(0x8000000100000000) == 32);
+    MIN_UNIT_ASSERT("find_set_bit_idx_last is wrong.", find_set_bit_idx_last(0x8000000100000000) == 63);
+
+    return NULL;
+}
+
+
+static char const* test_block_align_up(void) {
+    for (size_t i = ALIGNMENT_SIZE; i < 0x100000; i *= ALIGNMENT_SIZE) {
+        for (size_t j = 1; j < ALIGNMENT_SIZE; j++) {
+            MIN_UNIT_ASSERT("block_align_up is wrong.", block_align_up(i - j) == i);
+        }
+    }
+
+    return NULL;
+}
+
+
+static char const* test_align_down(void) {
+    MIN_UNIT_ASSERT("align_down is wrong.", align_down(0xff, 2) == 0xfe);
+    MIN_UNIT_ASSERT("align_down is wrong.", align_down(0x7ff5ef4f7760, 0x2000) == 0x7ff5ef4f6000);
+
+    return NULL;
+}
+
+
+static char const* all_tests(void) {
+    MIN_UNIT_RUN(test_indexes);
+    MIN_UNIT_RUN(test_find_bit);
+    MIN_UNIT_RUN(test_block_align_up);
+    MIN_UNIT_RUN(test_align_down);
+    return NULL;
+}
+
+
+static inline int do_all_tests(void) {
+    MIN_UNIT_RUN_ALL(all_tests);
+}
+
+
+static double gettimeofday_sec(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+int main(void) {
+    do_all_tests();
+
+    Tlsf_manager tman;
+    Tlsf_manager* p = &tman;
+
+    tlsf_init(p);
+
+    tlsf_supply_memory(p, 128 << 20);
+    assert(p->total_memory_size == p->free_memory_size);
+
+    printf("\nStart Loop\n");
+    printf("total_memory_size: 0x%zx - %zuMB\n", p->total_memory_size, p->total_memory_size >> 20);
+
+    size_t cnt                     = 0;
+    size_t limit                   = 1000000;
+    size_t failed                  = 0;
+    static size_t const array_size = 100;
+    void* allocs[array_size];
+
+    srand((unsigned int)time(NULL));
+    double begin = gettimeofday_sec();
+    for (size_t times = 0; times < limit; times++) {
+        size_t r_size = (((size_t)rand() % MAX_ALLOCATION_SIZE) + 1u);
+        size_t align  = PO2((size_t)rand() % 12 + 1u);
+        void* m       = tlsf_malloc_align(p, r_size, align);
+
+        assert(((uintptr_t)m & (align - 1)) == 0);
+
+        if (m == NULL) {
+            failed++;
+        } else {
+            /* memset(m, 0xff, r_size); */
+        }
+
+        allocs[cnt] = m;
+
+        ++cnt;
+        if (array_size <= cnt || m == NULL || times == limit - 1) {
+            for (int i = 0; i <= (cnt - 1u); i++) {
+                tlsf_free(p, allocs[i]);
+            }
+            cnt = 0;
+            assert(p->total_memory_size == p->free_memory_size);
+        }
+    }
+    double end = gettimeofday_sec();
+
+    printf("Finish Loop\n\n");
+    printf("Time is %f\n", end - begin);
+    printf("failed is %zu\n", failed);
+    printf("total_memory_size: 0x%zx - %zuMB\n", p->total_memory_size, p->total_memory_size >> 20);
+
+    tlsf_destruct(p);
+
+    return 0;
+}
+
+#endif
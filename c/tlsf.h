@@ -0,0 +1,217 @@
+/**
+ * @file tlsf.h
+ * @brief Two level Segregated Fit allocater header.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-09-29
+ */
+
+#ifndef _TLSF_H_
+#define _TLSF_H_
+
+
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "elist.h"
+
+
+/*
+ * The number of second level lists is 2^TLSF_SL_MAX_INDEX_LOG2.
+ * 5 halves the internal fragmentation of 4 and doubles the list heads.
+ * The library and its users must be built with the same value.
+ */
+#ifndef TLSF_SL_MAX_INDEX_LOG2
+#define TLSF_SL_MAX_INDEX_LOG2 4
+#endif
+
+#if (TLSF_SL_MAX_INDEX_LOG2 < 1) || (5 < TLSF_SL_MAX_INDEX_LOG2)
+#error "TLSF_SL_MAX_INDEX_LOG2 must be 1 - 5."
+#endif
+
+
+enum {
+    TLSF_FL_BASE_INDEX     = 10 - 1,
+    TLSF_FL_MAX_INDEX      = (64 - TLSF_FL_BASE_INDEX),
+    TLSF_SL_MAX_INDEX      = (1 << TLSF_SL_MAX_INDEX_LOG2),
+};
+
+
+/*
+ * Small objects up to TLSF_SMALL_MAX_SIZE are packed in runs.
+ * A run is one TLSF block of TLSF_SMALL_RUN_SIZE and holds objects of one class.
+ */
+enum {
+    TLSF_SMALL_GRANULE_LOG2 = 4,
+    TLSF_SMALL_GRANULE      = (1 << TLSF_SMALL_GRANULE_LOG2),
+    TLSF_SMALL_MAX_SIZE     = 256,
+    TLSF_SMALL_CLASS_NR     = (TLSF_SMALL_MAX_SIZE / TLSF_SMALL_GRANULE),
+    TLSF_SMALL_RUN_SIZE     = 4096,
+    TLSF_SMALL_BITMAP_NR    = (TLSF_SMALL_RUN_SIZE / TLSF_SMALL_GRANULE / 64),
+};
+
+
+struct tlsf_small_run {
+    Elist list;       /* Runs which have free objects. */
+    uint16_t class;
+    uint16_t obj_nr;
+    uint16_t free_nr;
+    uint64_t free_bitmap[TLSF_SMALL_BITMAP_NR];
+};
+typedef struct tlsf_small_run Tlsf_small_run;
+
+
+struct tlsf_run_entry {
+    uintptr_t page;         /* Address >> 12 of a page which the run touches. */
+    Tlsf_small_run* run;    /* NULL means the empty slot. */
+};
+typedef struct tlsf_run_entry Tlsf_run_entry;
+
+
+/*
+ * Where regions come from.
+ * With TLSF_REGION_MMAP, free blocks larger than trim_threshold give their pages back to the system.
+ * TLSF_REGION_HUGETLB falls back to the normal pages if no huge page is reserved.
+ */
+enum {
+    TLSF_REGION_MALLOC  = 0x00,
+    TLSF_REGION_MMAP    = 0x01,
+    TLSF_REGION_HUGETLB = 0x02 | TLSF_REGION_MMAP,
+    TLSF_REGION_THP     = 0x04 | TLSF_REGION_MMAP,
+    TLSF_TRIM_THRESHOLD = 1024 * 1024,
+};
+
+
+/*
+ * Statistics.
+ * Objects are counted by their usable size, class i has the sizes in [2^i, 2^(i+1)).
+ * Latency bucket i has the calls which took [2^i, 2^(i+1)) nano seconds.
+ */
+enum {
+    TLSF_STATS_CLASS_NR   = 64,
+    TLSF_STATS_LATENCY_NR = 32,
+};
+
+
+struct tlsf_counters {
+    uint64_t malloc_nr;
+    uint64_t free_nr;
+    uint64_t realloc_nr;
+    uint64_t failed_nr;
+    uint64_t split_nr;
+    uint64_t merge_nr;
+    uint64_t supply_nr;  /* Regions supplied by the watermark. */
+    uint64_t release_nr; /* Regions released by the watermark. */
+    uint64_t purged_size;
+    size_t live_size;
+    uint64_t class_malloc_nrs[TLSF_STATS_CLASS_NR];
+    uint64_t class_live_nrs[TLSF_STATS_CLASS_NR];
+    bool is_latency_enabled;
+    uint64_t malloc_latency[TLSF_STATS_LATENCY_NR];
+    uint64_t free_latency[TLSF_STATS_LATENCY_NR];
+};
+typedef struct tlsf_counters Tlsf_counters;
+
+
+struct tlsf_stats {
+    size_t total_memory_size;
+    size_t free_memory_size;
+    size_t largest_free_size;
+    double fragmentation; /* 1 - largest_free_size / free_memory_size */
+    Tlsf_counters counters;
+};
+typedef struct tlsf_stats Tlsf_stats;
+
+
+struct tlsf_manager {
+    Elist blocks[TLSF_FL_MAX_INDEX * TLSF_SL_MAX_INDEX];
+    Elist frames;
+    size_t total_memory_size;
+    size_t free_memory_size;
+    uint64_t fl_bitmap;
+    uint32_t sl_bitmaps[TLSF_FL_MAX_INDEX];
+    uint32_t block_nrs[TLSF_FL_MAX_INDEX * TLSF_SL_MAX_INDEX]; /* The number of blocks in each list. */
+    Elist small_runs[TLSF_SMALL_CLASS_NR];
+    Tlsf_small_run* spare_runs[TLSF_SMALL_CLASS_NR]; /* An empty run is kept for each class to avoid thrashing. */
+    Tlsf_run_entry* run_table;                       /* Open addressing hash table from pages to runs. */
+    size_t run_table_size;
+    size_t run_entry_nr;
+    size_t run_nr;
+    uint32_t region_flags;
+    size_t trim_threshold; /* 0 disables trimming. */
+    Tlsf_counters counters;
+};
+typedef struct tlsf_manager Tlsf_manager;
+
+
+extern Tlsf_manager* tlsf_init(Tlsf_manager*);
+extern Tlsf_manager* tlsf_init_mmap(Tlsf_manager*, uint32_t);
+extern void tlsf_destruct(Tlsf_manager*);
+extern Tlsf_manager* tlsf_supply_memory(Tlsf_manager*, size_t);
+extern void* tlsf_malloc_align(Tlsf_manager*, size_t, size_t);
+extern void* tlsf_malloc(Tlsf_manager*, size_t);
+extern void tlsf_free(Tlsf_manager*, void*);
+extern void* tlsf_realloc(Tlsf_manager*, void*, size_t);
+extern size_t tlsf_usable_size(Tlsf_manager*, void const*);
+extern size_t tlsf_trim(Tlsf_manager*);
+extern void tlsf_enable_latency_stats(Tlsf_manager*, bool);
+extern Tlsf_stats* tlsf_get_stats(Tlsf_manager*, Tlsf_stats*);
+extern void tlsf_print_stats(Tlsf_stats const*, FILE*);
+extern void tlsf_print_stats_json(Tlsf_stats const*, FILE*);
+
+
+/*
+ * Multi-threaded mode.
+ * Each thread keeps magazines (small stacks) of recently freed blocks per size class.
+ * Magazines are refilled from and flushed to the shared manager in batches under its lock,
+ * so most small malloc/free calls never touch fl_bitmap/sl_bitmaps.
+ */
+enum {
+    TLSF_CACHE_GRANULE_LOG2  = 4,
+    TLSF_CACHE_GRANULE       = (1 << TLSF_CACHE_GRANULE_LOG2),
+    TLSF_CACHE_MAX_SIZE      = 1024,
+    TLSF_CACHE_CLASS_NR      = (TLSF_CACHE_MAX_SIZE / TLSF_CACHE_GRANULE),
+    TLSF_CACHE_MAGAZINE_SIZE = 32,
+    TLSF_CACHE_BATCH_SIZE    = (TLSF_CACHE_MAGAZINE_SIZE / 2),
+};
+
+
+struct tlsf_magazine {
+    size_t nr;
+    void* objs[TLSF_CACHE_MAGAZINE_SIZE];
+};
+typedef struct tlsf_magazine Tlsf_magazine;
+
+
+struct tlsf_thread_cache {
+    struct tlsf_mt_manager* owner;
+    Tlsf_magazine magazines[TLSF_CACHE_CLASS_NR];
+};
+typedef struct tlsf_thread_cache Tlsf_thread_cache;
+
+
+struct tlsf_mt_manager {
+    Tlsf_manager tman;
+    pthread_mutex_t lock;
+    pthread_key_t cache_key; /* Tlsf_thread_cache of the calling thread. */
+};
+typedef struct tlsf_mt_manager Tlsf_mt_manager;
+
+
+extern Tlsf_mt_manager* tlsf_mt_init(Tlsf_mt_manager*);
+extern Tlsf_mt_manager* tlsf_mt_init_mmap(Tlsf_mt_manager*, uint32_t);
+extern void tlsf_mt_destruct(Tlsf_mt_manager*);
+extern Tlsf_mt_manager* tlsf_mt_supply_memory(Tlsf_mt_manager*, size_t);
+extern void* tlsf_mt_malloc_align(Tlsf_mt_manager*, size_t, size_t);
+extern void* tlsf_mt_malloc(Tlsf_mt_manager*, size_t);
+extern void tlsf_mt_free(Tlsf_mt_manager*, void*);
+extern void* tlsf_mt_realloc(Tlsf_mt_manager*, void*, size_t);
+extern size_t tlsf_mt_usable_size(Tlsf_mt_manager*, void const*);
+extern void tlsf_mt_thread_flush(Tlsf_mt_manager*);
+
+
+
+#endif
@@ -0,0 +1,184 @@
+/**
+ * @file tlsf_malloc.c
+ * @brief Drop-in malloc(), free() and the friends on Tlsf_mt_manager.
+ *        gcc -O2 -shared -fPIC -DTLSF_LIBRARY tlsf.c tlsf_malloc.c memset.c cpu_features.c -o libtlsf_malloc.so -lpthread
+ *        LD_PRELOAD=./libtlsf_malloc.so ./app
+ *
+ *        The regions are obtained by mmap(), so the allocator never calls malloc() of glibc.
+ *        The lock of the manager is taken while fork(), then the child has a consistent manager.
+ *        Other threads do not exist in the child, their cached blocks are just not reused.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-22
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+#include "memset.h"
+#include "tlsf.h"
+#include "tlsf_malloc.h"
+
+
+static Tlsf_mt_manager manager;
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+static bool is_ready            = false;
+
+
+static void init_manager(void) {
+    if (tlsf_mt_init_mmap(&manager, TLSF_REGION_MMAP) == NULL) {
+        return;
+    }
+
+    tlsf_mt_supply_memory(&manager, TLSF_MALLOC_INIT_POOL_SIZE);
+    is_ready = true;
+}
+
+
+static inline Tlsf_mt_manager* get_manager(void) {
+    if (__builtin_expect(is_ready == false, 0)) {
+        pthread_once(&init_once, init_manager);
+    }
+
+    return (is_ready == true) ? &manager : NULL;
+}
+
+
+static void lock_before_fork(void) {
+    if (is_ready == true) {
+        pthread_mutex_lock(&manager.lock);
+    }
+}
+
+
+static void unlock_after_fork(void) {
+    if (is_ready == true) {
+        pthread_mutex_unlock(&manager.lock);
+    }
+}
+
+
+static void reset_after_fork(void) {
+    if (is_ready == true) {
+        pthread_mutex_init(&manager.lock, NULL);
+    }
+}
+
+
+/* pthread_atfork() may call malloc(), so it is not called in init_manager(). */
+__attribute__((constructor)) static void register_fork_handlers(void) {
+    get_manager();
+    pthread_atfork(lock_before_fork, unlock_after_fork, reset_after_fork);
+}
+
+
+Tlsf_mt_manager* tlsf_malloc_get_manager(void) {
+    return get_manager();
+}
+
+
+static inline void* malloc_align(size_t size, size_t align) {
+    Tlsf_mt_manager* mt = get_manager();
+    if (mt == NULL || TLSF_MALLOC_MAX_ALIGN < align) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    /* malloc(0) returns an unique pointer. */
+    void* p = tlsf_mt_malloc_align(mt, (size == 0) ? 1 : size, align);
+    if (p == NULL) {
+        errno = ENOMEM;
+    }
+
+    return p;
+}
+
+
+void* malloc(size_t size) {
+    return malloc_align(size, 0);
+}
+
+
+void free(void* p) {
+    if (p != NULL) {
+        tlsf_mt_free(&manager, p);
+    }
+}
+
+
+void* calloc(size_t n, size_t size) {
+    size_t s;
+    if (__builtin_mul_overflow(n, size, &s) == true) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    void* p = malloc_align(s, 0);
+    if (p != NULL) {
+        memset_zero(p, s);
+    }
+
+    return p;
+}
+
+
+void* realloc(void* p, size_t size) {
+    if (p == NULL) {
+        return malloc_align(size, 0);
+    }
+
+    if (size == 0) {
+        free(p);
+        return NULL;
+    }
+
+    void* n = tlsf_mt_realloc(&manager, p, size);
+    if (n == NULL) {
+        errno = ENOMEM;
+    }
+
+    return n;
+}
+
+
+int posix_memalign(void** r, size_t align, size_t size) {
+    if (align < sizeof(void*) || (align & (align - 1)) != 0) {
+        return EINVAL;
+    }
+
+    void* p = malloc_align(size, align);
+    if (p == NULL) {
+        return ENOMEM;
+    }
+    *r = p;
+
+    return 0;
+}
+
+
+void* aligned_alloc(size_t align, size_t size) {
+    if (align == 0 || (align & (align - 1)) != 0) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return malloc_align(size, align);
+}
+
+
+void* memalign(size_t align, size_t size) {
+    return aligned_alloc(align, size);
+}
+
+
+void* valloc(size_t size) {
+    return malloc_align(size, (size_t)sysconf(_SC_PAGESIZE));
+}
+
+
+size_t malloc_usable_size(void* p) {
+    return tlsf_mt_usable_size(&manager, p);
+}
@@ -0,0 +1,26 @@
+/**
+ * @file tlsf_malloc.h
+ * @brief malloc() family on the multi-threaded TLSF.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-22
+ */
+
+#ifndef _TLSF_MALLOC_H_
+#define _TLSF_MALLOC_H_
+
+
+#include "tlsf.h"
+
+
+enum {
+    TLSF_MALLOC_INIT_POOL_SIZE = 16 * 1024 * 1024,
+    TLSF_MALLOC_MAX_ALIGN      = 4096, /* Larger alignment is not supported. */
+};
+
+
+extern Tlsf_mt_manager* tlsf_malloc_get_manager(void);
+
+
+
+#endif
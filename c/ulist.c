@@ -0,0 +1,389 @@
+/*
+ * @file ulist.c
+ * @brief This list is unrolled doubly linked list.
+ *      Each node has an array of elements, so an iteration touches one node per several elements.
+ *      first                                       last
+ *        [e0 e1 e2 e3] <-> [e4 e5 - -] <-> [e6 e7 e8 -]
+ *      A full node is split into halves at insertion,
+ *      a node less than half full is merged with the next one at removal if they fit in one node.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-27
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ulist.h"
+
+
+static inline unsigned char* get_element(Ulist const* l, Ulist_node* n, size_t i) {
+    return n->elements + i * l->data_type_size;
+}
+
+
+/**
+ * @brief Allocate new empty node.
+ * @param l Pointer to list.
+ * @return Pointer to node or NULL.
+ */
+static Ulist_node* ulist_new_node(Ulist const* l) {
+    Ulist_node* n = malloc(sizeof(Ulist_node) + l->node_capacity * l->data_type_size);
+    if (n == NULL) {
+        return NULL;
+    }
+
+    n->next = n->prev = NULL;
+    n->nr = 0;
+
+    return n;
+}
+
+
+/**
+ * @brief Link new node after target.
+ * @param l Pointer to list.
+ * @param target Pointer to base node, NULL means new node becames first.
+ * @param new Pointer to added node.
+ */
+static void ulist_link_node(Ulist* l, Ulist_node* target, Ulist_node* new) {
+    new->prev = target;
+    new->next = (target == NULL) ? l->first : target->next;
+
+    if (new->next == NULL) {
+        l->last = new;
+    } else {
+        new->next->prev = new;
+    }
+
+    if (target == NULL) {
+        l->first = new;
+    } else {
+        target->next = new;
+    }
+}
+
+
+static void ulist_unlink_node(Ulist* l, Ulist_node* n) {
+    if (n->prev == NULL) {
+        l->first = n->next;
+    } else {
+        n->prev->next = n->next;
+    }
+
+    if (n->next == NULL) {
+        l->last = n->prev;
+    } else {
+        n->next->prev = n->prev;
+    }
+}
+
+
+/**
+ * @brief Put data into node at index, the elements after index are shifted.
+ */
+static inline Ulist_iter ulist_put(Ulist* l, Ulist_node* n, size_t i, void const* data) {
+    assert(n->nr < l->node_capacity && i <= n->nr);
+
+    unsigned char* e = get_element(l, n, i);
+    memmove(e + l->data_type_size, e, (n->nr - i) * l->data_type_size);
+    memcpy(e, data, l->data_type_size);
+    n->nr++;
+    l->size++;
+
+    return (Ulist_iter){n, i};
+}
+
+
+/**
+ * @brief Initialize list.
+ * @param l Pointer to list.
+ * @param size Size of stored data type in list.
+ * @param f Pointer to function for release resources in element or NULL.
+ * @param node_capacity The number of element in one node, 0 means it is decided by ULIST_DEFAULT_NODE_SIZE.
+ * @return Pointer to list.
+ */
+Ulist* ulist_init(Ulist* l, size_t size, ulist_release_func f, size_t node_capacity) {
+    assert(size != 0);
+
+    if (node_capacity == 0) {
+        node_capacity = (ULIST_DEFAULT_NODE_SIZE - sizeof(Ulist_node)) / size;
+    }
+    /* A full node must be split into two non-empty nodes. */
+    node_capacity = (node_capacity < 2) ? 2 : node_capacity;
+
+    l->first = l->last = NULL;
+    l->free = f;
+    l->size = 0;
+    l->data_type_size = size;
+    l->node_capacity = node_capacity;
+
+    return l;
+}
+
+
+/**
+ * @brief All element and node in list be freed.
+ * @param l Pointer to list.
+ */
+void ulist_destruct(Ulist* l) {
+    Ulist_node* n = l->first;
+
+    while (n != NULL) {
+        if (l->free != NULL) {
+            for (size_t i = 0; i < n->nr; i++) {
+                l->free(l, get_element(l, n, i));
+            }
+        }
+
+        Ulist_node* next = n->next;
+        free(n);
+        n = next;
+    }
+
+    l->first = l->last = NULL;
+    l->size = 0;
+}
+
+
+/**
+ * @brief Get the number of element in list.
+ * @param l Pointer to list.
+ * @return The number of element.
+ */
+size_t ulist_get_size(Ulist const* l) {
+    return l->size;
+}
+
+
+Ulist_iter ulist_begin(Ulist const* l) {
+    return (Ulist_iter){l->first, 0};
+}
+
+
+Ulist_iter ulist_next(Ulist const* l, Ulist_iter it) {
+    assert(it.node != NULL);
+
+    if (it.index + 1 < it.node->nr) {
+        return (Ulist_iter){it.node, it.index + 1};
+    }
+
+    return (Ulist_iter){it.node->next, 0};
+}
+
+
+/**
+ * @brief Insert data before the position.
+ *        If the node of the position is full, it is split into halves.
+ * @param l Pointer to list.
+ * @param pos Position of insertion, the end position means last.
+ * @param data Pointer to added data.
+ * @return Position of added data, its node is NULL if failed.
+ */
+Ulist_iter ulist_insert_data(Ulist* l, Ulist_iter pos, void const* data) {
+    if (pos.node == NULL) {
+        return (ulist_insert_data_last(l, data) == NULL) ? pos : (Ulist_iter){l->last, l->last->nr - 1};
+    }
+
+    Ulist_node* n = pos.node;
+    size_t i = pos.index;
+
+    if (n->nr == l->node_capacity) {
+        Ulist_node* m = ulist_new_node(l);
+        if (m == NULL) {
+            return (Ulist_iter){NULL, 0};
+        }
+
+        size_t const h = n->nr / 2;
+        memcpy(m->elements, get_element(l, n, h), (n->nr - h) * l->data_type_size);
+        m->nr = n->nr - h;
+        n->nr = h;
+        ulist_link_node(l, n, m);
+
+        if (h < i) {
+            n = m;
+            i -= h;
+        }
+    }
+
+    return ulist_put(l, n, i, data);
+}
+
+
+/**
+ * @brief Add new data into first position in list.
+ * @param l Pointer to list.
+ * @param data Pointer to added data.
+ * @return Pointer to list or NULL.
+ */
+Ulist* ulist_insert_data_first(Ulist* l, void const* data) {
+    Ulist_node* n = l->first;
+
+    if (n == NULL || n->nr == l->node_capacity) {
+        n = ulist_new_node(l);
+        if (n == NULL) {
+            return NULL;
+        }
+        ulist_link_node(l, NULL, n);
+    }
+    ulist_put(l, n, 0, data);
+
+    return l;
+}
+
+
+/**
+ * @brief Add new data into last position in list.
+ *        A new node is not split from the last node, so appended nodes are full.
+ * @param l Pointer to list.
+ * @param data Pointer to added data.
+ * @return Pointer to list or NULL.
+ */
+Ulist* ulist_insert_data_last(Ulist* l, void const* data) {
+    Ulist_node* n = l->last;
+
+    if (n == NULL || n->nr == l->node_capacity) {
+        n = ulist_new_node(l);
+        if (n == NULL) {
+            return NULL;
+        }
+        ulist_link_node(l, l->last, n);
+    }
+    ulist_put(l, n, n->nr, data);
+
+    return l;
+}
+
+
+/**
+ * @brief Remove element at the position.
+ *        And this NOT releases resources in element.
+ * @param l Pointer to list.
+ * @param pos Position of removed element.
+ * @param out Pointer to copy the removed element or NULL.
+ * @return Position of the next element of removed one.
+ */
+Ulist_iter ulist_remove(Ulist* l, Ulist_iter pos, void* out) {
+    assert(pos.node != NULL && pos.index < pos.node->nr);
+
+    Ulist_node* n = pos.node;
+    size_t const i = pos.index;
+    unsigned char* e = get_element(l, n, i);
+
+    if (out != NULL) {
+        memcpy(out, e, l->data_type_size);
+    }
+    memmove(e, e + l->data_type_size, (n->nr - i - 1) * l->data_type_size);
+    n->nr--;
+    l->size--;
+
+    if (n->nr == 0) {
+        Ulist_node* next = n->next;
+        ulist_unlink_node(l, n);
+        free(n);
+        return (Ulist_iter){next, 0};
+    }
+
+    Ulist_node* next = n->next;
+    if (next != NULL && n->nr < l->node_capacity / 2 && n->nr + next->nr <= l->node_capacity) {
+        memcpy(get_element(l, n, n->nr), next->elements, next->nr * l->data_type_size);
+        n->nr += next->nr;
+        ulist_unlink_node(l, next);
+        free(next);
+    }
+
+    return (i < n->nr) ? (Ulist_iter){n, i} : (Ulist_iter){n->next, 0};
+}
+
+
+/**
+ * @brief Delete element at the position.
+ *        And this releases resources in element.
+ * @param l Pointer to list.
+ * @param pos Position of deleted element.
+ * @return Position of the next element of deleted one.
+ */
+Ulist_iter ulist_delete(Ulist* l, Ulist_iter pos) {
+    if (l->free != NULL) {
+        l->free(l, ulist_iter_data(l, pos));
+    }
+
+    return ulist_remove(l, pos, NULL);
+}
+
+
+/**
+ * @brief This function provide for_each loop.
+ * @param l Pointer to list.
+ * @param f Pointer to function witch decide stop or continue loop.
+ * @param is_reverse Loop direction flag. if it is true, loop is last to first.
+ * @return Position when loop stoped or the end position.
+ */
+Ulist_iter ulist_for_each(Ulist* const l, ulist_for_each_func const f, bool const is_reverse) {
+    assert(f != NULL);
+
+    if (is_reverse == true) {
+        for (Ulist_node* n = l->last; n != NULL; n = n->prev) {
+            for (size_t i = n->nr; i-- != 0;) {
+                if (f(l, get_element(l, n, i)) == true) {
+                    return (Ulist_iter){n, i};
+                }
+            }
+        }
+    } else {
+        for (Ulist_node* n = l->first; n != NULL; n = n->next) {
+            for (size_t i = 0; i < n->nr; i++) {
+                if (f(l, get_element(l, n, i)) == true) {
+                    return (Ulist_iter){n, i};
+                }
+            }
+        }
+    }
+
+    return (Ulist_iter){NULL, 0};
+}
+
+
+/**
+ * @brief Search element which equals argument data.
+ * @param l Pointer to list.
+ * @param data Pointer to search key data.
+ * @return Position of the first found element or the end position.
+ */
+Ulist_iter ulist_search(Ulist* l, void const* data) {
+    size_t const s = l->data_type_size;
+
+    /* memcmp() with a variable size is a call per element, the common sizes are compared as integers. */
+    uint64_t key64 = 0;
+    uint32_t key32 = 0;
+    if (s == sizeof(key64)) {
+        memcpy(&key64, data, s);
+    } else if (s == sizeof(key32)) {
+        memcpy(&key32, data, s);
+    }
+
+    for (Ulist_node* n = l->first; n != NULL; n = n->next) {
+        unsigned char const* e = n->elements;
+        for (size_t i = 0; i < n->nr; i++, e += s) {
+            bool is_found;
+            if (s == sizeof(uint64_t)) {
+                uint64_t v;
+                memcpy(&v, e, sizeof(v));
+                is_found = (v == key64);
+            } else if (s == sizeof(uint32_t)) {
+                uint32_t v;
+                memcpy(&v, e, sizeof(v));
+                is_found = (v == key32);
+            } else {
+                is_found = (memcmp(e, data, s) == 0);
+            }
+
+            if (is_found == true) {
+                return (Ulist_iter){n, i};
+            }
+        }
+    }
+
+    return (Ulist_iter){NULL, 0};
+}
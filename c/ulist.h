@@ -0,0 +1,94 @@
+/*
+ * @file ulist.h
+ * @brief Unrolled doubly linked list Header.
+ * @author mopp
+ * @version 0.1
+ * @date 2014-10-27
+ */
+
+#ifndef _ULIST_H_
+#define _ULIST_H_
+
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+struct ulist;
+
+/*
+ * for each function for list element.
+ * if return value is true, loop is abort
+ */
+typedef bool (*ulist_for_each_func)(struct ulist*, void*);
+
+/*
+ * release function for list element.
+ * The element is in node, so this must NOT free it.
+ * It is used when the element has other resources.
+ */
+typedef void (*ulist_release_func)(struct ulist*, void*);
+
+
+/* The default size of one node, the number of element in node is decided by this. */
+#define ULIST_DEFAULT_NODE_SIZE 512
+
+
+/*
+ * List node structure.
+ * Elements are stored in the node itself.
+ *      | next | prev | nr | element 0 | element 1 | ... |
+ */
+struct ulist_node {
+    struct ulist_node* next; /* NULL at last node. */
+    struct ulist_node* prev; /* NULL at first node. */
+    size_t nr;               /* the number of element in this node. */
+    _Alignas(max_align_t) unsigned char elements[];
+};
+typedef struct ulist_node Ulist_node;
+
+
+/* List structure */
+struct ulist {
+    Ulist_node* first;
+    Ulist_node* last;
+    ulist_release_func free; /* function for releasing resources in element or NULL. */
+    size_t size;             /* the number of element. */
+    size_t data_type_size;   /* it provided by sizeof(data). */
+    size_t node_capacity;    /* the max number of element in one node. */
+};
+typedef struct ulist Ulist;
+
+
+/*
+ * Position of element.
+ * It is invalidated by insertion and removal, because elements are moved in nodes.
+ */
+struct ulist_iter {
+    Ulist_node* node; /* NULL means the end of list. */
+    size_t index;
+};
+typedef struct ulist_iter Ulist_iter;
+
+
+extern Ulist* ulist_init(Ulist*, size_t, ulist_release_func, size_t);
+extern void ulist_destruct(Ulist*);
+extern size_t ulist_get_size(Ulist const*);
+extern Ulist_iter ulist_begin(Ulist const*);
+extern Ulist_iter ulist_next(Ulist const*, Ulist_iter);
+extern Ulist_iter ulist_insert_data(Ulist*, Ulist_iter, void const*);
+extern Ulist* ulist_insert_data_first(Ulist*, void const*);
+extern Ulist* ulist_insert_data_last(Ulist*, void const*);
+extern Ulist_iter ulist_remove(Ulist*, Ulist_iter, void*);
+extern Ulist_iter ulist_delete(Ulist*, Ulist_iter);
+extern Ulist_iter ulist_for_each(Ulist* const, ulist_for_each_func const, bool const);
+extern Ulist_iter ulist_search(Ulist*, void const*);
+
+
+#define ulist_iter_is_end(it) ((it).node == NULL)
+#define ulist_iter_data(l, it) ((void*)((it).node->elements + (it).index * (l)->data_type_size))
+#define ulist_get_data(type, l, it) (*(type*)ulist_iter_data(l, it))
+
+
+
+#endif